@@ -5,6 +5,7 @@
  * Copyright (C) 1995-1997, Thomas G. Lane.
  * libjpeg-turbo Modifications:
  * Copyright (C) 2015, D. R. Commander.
+ * Copyright (C) 2016, Google, Inc.
  * For conditions of distribution and use, see the accompanying README.ijg
  * file.
  *
@@ -25,6 +26,48 @@
 
 #ifdef D_PROGRESSIVE_SUPPORTED
 
+/*
+ * Bitmaps of coefficient positions, indexed by zigzag order, for the AC
+ * refinement decoder.  MASK_FROM(k) has bits k..63 set, and MASK_BELOW(k) has
+ * bits 0..k-1 set (1 <= k <= 64).  MASK_CTZ(m) returns the index of the
+ * lowest set bit in m (m != 0).
+ */
+
+typedef unsigned long long coef_mask;
+
+#define MASK_FROM(k)  ((~(coef_mask) 0) << (k))
+#define MASK_BELOW(k)  ((((coef_mask) 2) << ((k) - 1)) - 1)
+
+#if defined __GNUC__
+#define MASK_CTZ(m)  __builtin_ctzll(m)
+#elif defined _MSC_VER && defined _WIN64
+#include <intrin.h>
+#pragma intrinsic(_BitScanForward64)
+LOCAL(int)
+mask_ctz (coef_mask m)
+{
+  unsigned long index;
+  _BitScanForward64(&index, m);
+  return (int) index;
+}
+#define MASK_CTZ(m)  mask_ctz(m)
+#else
+LOCAL(int)
+mask_ctz (coef_mask m)
+{
+  int n = 0;
+  while (((unsigned int) m & 0xFF) == 0) {
+    m >>= 8;  n += 8;
+  }
+  while (((unsigned int) m & 1) == 0) {
+    m >>= 1;  n++;
+  }
+  return n;
+}
+#define MASK_CTZ(m)  mask_ctz(m)
+#endif
+
+
 /*
  * Expanded entropy decoder object for progressive Huffman decoding.
  *
@@ -72,6 +115,14 @@ typedef struct {
   d_derived_tbl *derived_tbls[NUM_HUFF_TBLS];
 
   d_derived_tbl *ac_derived_tbl; /* active table during an AC scan */
+
+  /* Lookahead table for AC initial scans (see make_ac_fast_tbl()) */
+  int ac_fast[1<<HUFF_LOOKAHEAD];
+
+  /* nonzero_tbl[i][n] is the bitmap of the coefficients in natural-order
+   * positions 4*i..4*i+3 that are flagged in nibble n (see nonzero_nibble())
+   */
+  coef_mask nonzero_tbl[DCTSIZE2/4][16];
 } phuff_entropy_decoder;
 
 typedef phuff_entropy_decoder *phuff_entropy_ptr;
@@ -85,6 +136,7 @@ METHODDEF(boolean) decode_mcu_DC_refine (j_decompress_ptr cinfo,
                                          JBLOCKROW *MCU_data);
 METHODDEF(boolean) decode_mcu_AC_refine (j_decompress_ptr cinfo,
                                          JBLOCKROW *MCU_data);
+LOCAL(void) make_ac_fast_tbl (phuff_entropy_ptr entropy);
 
 
 /*
@@ -179,6 +231,8 @@ start_pass_phuff_decoder (j_decompress_ptr cinfo)
       jpeg_make_d_derived_tbl(cinfo, FALSE, tbl, pdtbl);
       /* remember the single active table */
       entropy->ac_derived_tbl = entropy->derived_tbls[tbl];
+      if (cinfo->Ah == 0)
+        make_ac_fast_tbl(entropy);
     }
     /* Initialize DC predictions to 0 */
     entropy->saved.last_dc_val[ci] = 0;
@@ -225,6 +279,56 @@ static const int extend_offset[16] = /* entry n is (-1 << n) + 1 */
 #endif /* AVOID_TABLES */
 
 
+/*
+ * Build the lookahead table used by decode_mcu_AC_first().  Most AC symbols in
+ * an initial scan have a short code and only a few magnitude bits, so the
+ * Huffman code and the magnitude bits together usually fit in the
+ * HUFF_LOOKAHEAD bits that we peek at.  For each such bit pattern, ac_fast[]
+ * holds the decoded coefficient value * 256, plus the run length << 4, plus
+ * the total number of bits consumed.  Entries are 0 for patterns that must be
+ * decoded the normal way (long codes, EOB/ZRL, or too many magnitude bits.)
+ */
+
+LOCAL(void)
+make_ac_fast_tbl (phuff_entropy_ptr entropy)
+{
+  d_derived_tbl *tbl = entropy->ac_derived_tbl;
+  int look, nb, rs, r, s, v;
+
+  for (look = 0; look < (1 << HUFF_LOOKAHEAD); look++) {
+    entropy->ac_fast[look] = 0;
+    nb = tbl->lookup[look] >> HUFF_LOOKAHEAD;
+    rs = tbl->lookup[look] & ((1 << HUFF_LOOKAHEAD) - 1);
+    r = rs >> 4;
+    s = rs & 15;
+    if (nb <= HUFF_LOOKAHEAD && s && nb + s <= HUFF_LOOKAHEAD) {
+      v = (look >> (HUFF_LOOKAHEAD - nb - s)) & ((1 << s) - 1);
+      v = HUFF_EXTEND(v, s);
+      entropy->ac_fast[look] = v * 256 + (r << 4) + nb + s;
+    }
+  }
+}
+
+
+/*
+ * Given four coefficients copied into x, return a nibble with one bit set for
+ * each coefficient that is nonzero.  (JCOEF is 16 bits, so x holds exactly
+ * four of them.)  Which bit goes with which coefficient depends on the byte
+ * order of the machine, so jinit_phuff_decoder() builds nonzero_tbl[] by
+ * calling this function as well.
+ */
+
+LOCAL(int)
+nonzero_nibble (coef_mask x)
+{
+  /* Set the high bit of each 16-bit lane that is nonzero */
+  x = (x | ((x & 0x7FFF7FFF7FFF7FFFULL) + 0x7FFF7FFF7FFF7FFFULL)) &
+      0x8000800080008000ULL;
+  /* Gather the four high bits into bits 48..51 */
+  return (int) (((x >> 15) * 0x0001000200040008ULL) >> 48) & 15;
+}
+
+
 /*
  * Check for a restart marker & resynchronize decoder.
  * Returns FALSE if must suspend.
@@ -370,6 +474,7 @@ decode_mcu_AC_first (j_decompress_ptr cinfo, JBLOCKROW *MCU_data)
   JBLOCKROW block;
   BITREAD_STATE_VARS;
   d_derived_tbl *tbl;
+  SHIFT_TEMPS
 
   /* Process restart marker if needed; may have to suspend */
   if (cinfo->restart_interval) {
@@ -398,6 +503,22 @@ decode_mcu_AC_first (j_decompress_ptr cinfo, JBLOCKROW *MCU_data)
       tbl = entropy->ac_derived_tbl;
 
       for (k = cinfo->Ss; k <= Se; k++) {
+        /* Try the fast path first */
+        if (bits_left < HUFF_LOOKAHEAD) {
+          if (! jpeg_fill_bit_buffer(&br_state, get_buffer, bits_left, 0))
+            return FALSE;
+          get_buffer = br_state.get_buffer; bits_left = br_state.bits_left;
+        }
+        if (bits_left >= HUFF_LOOKAHEAD) {
+          s = entropy->ac_fast[PEEK_BITS(HUFF_LOOKAHEAD)];
+          if (s) {
+            DROP_BITS(s & 15);
+            k += (s >> 4) & 15;
+            s = RIGHT_SHIFT(s, 8);
+            (*block)[jpeg_natural_order[k]] = (JCOEF) LEFT_SHIFT(s, Al);
+            continue;
+          }
+        }
         HUFF_DECODE(s, br_state, tbl, return FALSE, label2);
         r = s >> 4;
         s &= 15;
@@ -491,6 +612,12 @@ decode_mcu_DC_refine (j_decompress_ptr cinfo, JBLOCKROW *MCU_data)
 
 /*
  * MCU decoding for AC successive approximation refinement scan.
+ *
+ * Most blocks end in an EOB run, after which each coefficient that is already
+ * nonzero takes a correction bit.  Rather than testing the rest of the band
+ * one coefficient at a time in zigzag order, we build a zigzag-order bitmap
+ * of the nonzero coefficients by reading the block four coefficients at a
+ * time, and then we hop from one set bit to the next.
  */
 
 METHODDEF(boolean)
@@ -508,6 +635,8 @@ decode_mcu_AC_refine (j_decompress_ptr cinfo, JBLOCKROW *MCU_data)
   d_derived_tbl *tbl;
   int num_newnz;
   int newnz_pos[DCTSIZE2];
+  coef_mask x, nonzero, corr;
+  int i;
 
   /* Process restart marker if needed; may have to suspend */
   if (cinfo->restart_interval) {
@@ -602,11 +731,18 @@ decode_mcu_AC_refine (j_decompress_ptr cinfo, JBLOCKROW *MCU_data)
        * bit to each already-nonzero coefficient.  A correction bit is 1
        * if the absolute value of the coefficient must be increased.
        */
-      for (; k <= Se; k++) {
-        thiscoef = *block + jpeg_natural_order[k];
-        if (*thiscoef != 0) {
+      if (k <= Se) {
+        nonzero = 0;
+        for (i = 0; i < DCTSIZE2/4; i++) {
+          MEMCOPY(&x, *block + 4 * i, sizeof(x));
+          if (x)
+            nonzero |= entropy->nonzero_tbl[i][nonzero_nibble(x)];
+        }
+        for (corr = nonzero & MASK_FROM(k) & MASK_BELOW(Se + 1); corr;
+             corr &= corr - 1) {
           CHECK_BIT_BUFFER(br_state, 1, goto undoit);
           if (GET_BITS(1)) {
+            thiscoef = *block + jpeg_natural_order[MASK_CTZ(corr)];
             if ((*thiscoef & p1) == 0) { /* do nothing if already changed it */
               if (*thiscoef >= 0)
                 *thiscoef += p1;
@@ -649,6 +785,7 @@ jinit_phuff_decoder (j_decompress_ptr cinfo)
   phuff_entropy_ptr entropy;
   int *coef_bit_ptr;
   int ci, i;
+  int zigzag[DCTSIZE2];
 
   entropy = (phuff_entropy_ptr)
     (*cinfo->mem->alloc_small) ((j_common_ptr) cinfo, JPOOL_IMAGE,
@@ -661,6 +798,27 @@ jinit_phuff_decoder (j_decompress_ptr cinfo)
     entropy->derived_tbls[i] = NULL;
   }
 
+  /* Build the table used by decode_mcu_AC_refine() to find nonzero
+   * coefficients.  zigzag[] is the inverse of jpeg_natural_order[].
+   */
+  for (i = 0; i < DCTSIZE2; i++)
+    zigzag[jpeg_natural_order[i]] = i;
+  MEMZERO(entropy->nonzero_tbl, sizeof(entropy->nonzero_tbl));
+  for (i = 0; i < DCTSIZE2; i++) {
+    JCOEF coefs[4];
+    coef_mask x;
+    int n, bit;
+
+    MEMZERO(coefs, sizeof(coefs));
+    coefs[i % 4] = 1;
+    MEMCOPY(&x, coefs, sizeof(x));
+    bit = nonzero_nibble(x);
+    for (n = 0; n < 16; n++) {
+      if (n & bit)
+        entropy->nonzero_tbl[i / 4][n] |= (coef_mask) 1 << zigzag[i];
+    }
+  }
+
   /* Create progression status table */
   cinfo->coef_bits = (int (*)[DCTSIZE2])
     (*cinfo->mem->alloc_small) ((j_common_ptr) cinfo, JPOOL_IMAGE,
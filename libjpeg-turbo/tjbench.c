@@ -728,6 +728,9 @@ void usage(char *progname)
 	printf("     codec\n");
 	printf("-accuratedct = Use the most accurate DCT/IDCT algorithms available in the\n");
 	printf("     underlying codec\n");
+	printf("-parallel = Decompress JPEG images that contain restart markers in bands, one\n");
+	printf("     thread per processor (set TJ_THREADS to change the number of threads and\n");
+	printf("     TJ_RESTART to add restart markers when compressing)\n");
 	printf("-subsamp <s> = When testing JPEG compression, this option specifies the level\n");
 	printf("     of chrominance subsampling to use (<s> = 444, 422, 440, 420, 411, or\n");
 	printf("     GRAY).  The default is to test Grayscale, 4:2:0, 4:2:2, and 4:4:4 in\n");
@@ -826,6 +829,11 @@ int main(int argc, char *argv[])
 				printf("Using most accurate DCT/IDCT algorithm\n\n");
 				flags|=TJFLAG_ACCURATEDCT;
 			}
+			if(!strcasecmp(argv[i], "-parallel"))
+			{
+				printf("Using parallel decompression\n\n");
+				flags|=TJFLAG_PARALLEL;
+			}
 			if(!strcasecmp(argv[i], "-rgb")) pf=TJPF_RGB;
 			if(!strcasecmp(argv[i], "-rgbx")) pf=TJPF_RGBX;
 			if(!strcasecmp(argv[i], "-bgr")) pf=TJPF_BGR;
@@ -0,0 +1,123 @@
+/*
+ * Copyright (C)2016 Google, Inc.  All Rights Reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ * - Neither the name of the libjpeg-turbo Project nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS",
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include "./tjthread.h"
+
+#ifdef _WIN32
+
+#include <windows.h>
+
+struct _tjthread
+{
+	HANDLE handle;
+	void (*func)(void *);
+	void *arg;
+};
+
+static DWORD WINAPI threadMain(LPVOID param)
+{
+	tjthread thread=(tjthread)param;
+	thread->func(thread->arg);
+	return 0;
+}
+
+int tjGetNumProcessors(void)
+{
+	SYSTEM_INFO si;
+	GetSystemInfo(&si);
+	return si.dwNumberOfProcessors>0? (int)si.dwNumberOfProcessors:1;
+}
+
+tjthread tjThreadCreate(void (*func)(void *), void *arg)
+{
+	tjthread thread=(tjthread)malloc(sizeof(struct _tjthread));
+	if(!thread) return NULL;
+	thread->func=func;  thread->arg=arg;
+	if((thread->handle=CreateThread(NULL, 0, threadMain, thread, 0,
+		NULL))==NULL)
+	{
+		free(thread);  return NULL;
+	}
+	return thread;
+}
+
+void tjThreadJoin(tjthread thread)
+{
+	WaitForSingleObject(thread->handle, INFINITE);
+	CloseHandle(thread->handle);
+	free(thread);
+}
+
+#else
+
+#include <pthread.h>
+#include <unistd.h>
+
+struct _tjthread
+{
+	pthread_t handle;
+	void (*func)(void *);
+	void *arg;
+};
+
+static void *threadMain(void *param)
+{
+	tjthread thread=(tjthread)param;
+	thread->func(thread->arg);
+	return NULL;
+}
+
+int tjGetNumProcessors(void)
+{
+	#ifdef _SC_NPROCESSORS_ONLN
+	long n=sysconf(_SC_NPROCESSORS_ONLN);
+	if(n>0) return (int)n;
+	#endif
+	return 1;
+}
+
+tjthread tjThreadCreate(void (*func)(void *), void *arg)
+{
+	tjthread thread=(tjthread)malloc(sizeof(struct _tjthread));
+	if(!thread) return NULL;
+	thread->func=func;  thread->arg=arg;
+	if(pthread_create(&thread->handle, NULL, threadMain, thread)!=0)
+	{
+		free(thread);  return NULL;
+	}
+	return thread;
+}
+
+void tjThreadJoin(tjthread thread)
+{
+	pthread_join(thread->handle, NULL);
+	free(thread);
+}
+
+#endif
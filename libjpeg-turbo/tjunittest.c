@@ -686,6 +686,72 @@ void bufSizeTest(void)
 }
 
 
+/* Decompress JPEG images that contain restart markers with and without
+   TJFLAG_PARALLEL, and check that the results are identical. */
+
+void parallelTest(void)
+{
+	static char *restartEnv[2]={"TJ_RESTART=1", "TJ_RESTART=4B"};
+	int w=97, h=700, i, r, subsamp, nsf=0, flags;
+	unsigned char *srcBuf=NULL, *jpegBuf=NULL, *dstBuf=NULL, *parBuf=NULL;
+	tjhandle chandle=NULL, dhandle=NULL;
+	tjscalingfactor *sf=NULL;
+	unsigned long jpegSize=0;
+
+	if((chandle=tjInitCompress())==NULL || (dhandle=tjInitDecompress())==NULL)
+		_throwtj();
+	if((sf=tjGetScalingFactors(&nsf))==NULL || nsf==0) _throwtj();
+	if((srcBuf=(unsigned char *)malloc(w*h*3))==NULL
+		|| (dstBuf=(unsigned char *)malloc(w*h*3))==NULL
+		|| (parBuf=(unsigned char *)malloc(w*h*3))==NULL)
+		_throw("Memory allocation failure");
+	initBuf(srcBuf, w, h, TJPF_RGB, 0);
+	for(i=0; i<w*h*3; i++) srcBuf[i]^=(unsigned char)(random()&31);
+
+	printf("Parallel decompression test\n");
+	putenv("TJ_THREADS=3");
+	for(r=0; r<2; r++)
+	{
+		putenv(restartEnv[r]);
+		for(subsamp=0; subsamp<TJ_NUMSAMP; subsamp++)
+		{
+			_tj(tjCompress2(chandle, srcBuf, w, 0, h, TJPF_RGB, &jpegBuf,
+				&jpegSize, subsamp, 90, 0));
+			for(i=0; i<nsf; i++)
+			{
+				int sw=TJSCALED(w, sf[i]), sh=TJSCALED(h, sf[i]);
+				if(sf[i].num>sf[i].denom) continue;
+				for(flags=0; flags<=TJFLAG_FASTUPSAMPLE; flags+=TJFLAG_FASTUPSAMPLE)
+				{
+					_tj(tjDecompress2(dhandle, jpegBuf, jpegSize, dstBuf, sw, 0, sh,
+						TJPF_RGB, flags));
+					_tj(tjDecompress2(dhandle, jpegBuf, jpegSize, parBuf, sw, 0, sh,
+						TJPF_RGB, flags|TJFLAG_PARALLEL));
+					if(memcmp(dstBuf, parBuf, sw*sh*3))
+					{
+						printf("%s %d/%d %s%s: ", subNameLong[subsamp], sf[i].num,
+							sf[i].denom, restartEnv[r], flags? " -fastupsample":"");
+						_throw("Parallel decompression produced a different image");
+					}
+				}
+			}
+			tjFree(jpegBuf);  jpegBuf=NULL;
+		}
+	}
+	printf("Done.\n");
+
+	bailout:
+	putenv("TJ_RESTART=");
+	putenv("TJ_THREADS=");
+	if(srcBuf) free(srcBuf);
+	if(dstBuf) free(dstBuf);
+	if(parBuf) free(parBuf);
+	if(jpegBuf) tjFree(jpegBuf);
+	if(chandle) tjDestroy(chandle);
+	if(dhandle) tjDestroy(dhandle);
+}
+
+
 int main(int argc, char *argv[])
 {
 	int i, num4bf=5;
@@ -719,6 +785,7 @@ int main(int argc, char *argv[])
 	doTest(41, 35, _3byteFormats, 2, TJSAMP_GRAY, "test");
 	doTest(35, 39, _4byteFormats, 4, TJSAMP_GRAY, "test");
 	bufSizeTest();
+	if(!doyuv) parallelTest();
 	if(doyuv)
 	{
 		printf("\n--------------------\n\n");
@@ -41,6 +41,7 @@
 #include "./tjutil.h"
 #include "transupp.h"
 #include "./jpegcomp.h"
+#include "./tjthread.h"
 
 extern void jpeg_mem_dest_tj(j_compress_ptr, unsigned char **,
 	unsigned long *, boolean);
@@ -1338,6 +1339,334 @@ DLLEXPORT tjscalingfactor* DLLCALL tjGetScalingFactors(int *numscalingfactors)
 }
 
 
+/* Parallel decompression (TJFLAG_PARALLEL)
+
+   The entropy-coded data of a baseline JPEG image with restart markers can be
+   split at any restart marker, since the DC predictions are reset there.  A
+   band of MCU rows that starts at a restart marker is decompressed by a
+   separate libjpeg decompressor, which reads the JPEG headers with the image
+   height in the SOF marker reduced so that the image appears to start at the
+   band, followed by the entropy-coded data after the restart marker.  The
+   decompressor expects RST0 to be the first restart marker it sees, so bands
+   start only after every eighth restart marker.
+
+   Smooth upsampling uses the chrominance rows above and below each row, and
+   the first and last rows of a band don't have them.  Thus, each band also
+   decompresses the first half of the first MCU row of the next band, and the
+   rows in the first half of an MCU row that starts a band are taken from the
+   band above it. */
+
+#define MAXBANDS 32
+
+typedef struct
+{
+	struct jpeg_source_mgr pub;
+	const JOCTET *seg[4];
+	size_t segSize[4];
+	int nseg, curseg;
+} band_source_mgr;
+
+typedef struct
+{
+	struct jpeg_decompress_struct dinfo;
+	struct my_error_mgr jerr;
+	band_source_mgr src;
+	JOCTET height[2];
+	JSAMPROW *row_pointer;
+	JDIMENSION firstRow, keepRow, endRow, outputWidth, outputHeight;
+	unsigned int scaleNum, scaleDenom;
+	int pixelFormat, flags, failed;
+} tjband;
+
+static void band_init_source(j_decompress_ptr dinfo)
+{
+}
+
+static boolean band_fill_input_buffer(j_decompress_ptr dinfo)
+{
+	static const JOCTET eoi[2]={0xFF, JPEG_EOI};
+	band_source_mgr *src=(band_source_mgr *)dinfo->src;
+
+	while(++src->curseg<src->nseg && src->segSize[src->curseg]==0) {}
+	if(src->curseg<src->nseg)
+	{
+		src->pub.next_input_byte=src->seg[src->curseg];
+		src->pub.bytes_in_buffer=src->segSize[src->curseg];
+	}
+	else
+	{
+		WARNMS(dinfo, JWRN_JPEG_EOF);
+		src->pub.next_input_byte=eoi;
+		src->pub.bytes_in_buffer=2;
+	}
+	return TRUE;
+}
+
+static void band_skip_input_data(j_decompress_ptr dinfo, long num_bytes)
+{
+	struct jpeg_source_mgr *src=dinfo->src;
+
+	if(num_bytes>0)
+	{
+		while(num_bytes>(long)src->bytes_in_buffer)
+		{
+			num_bytes-=(long)src->bytes_in_buffer;
+			(*src->fill_input_buffer)(dinfo);
+		}
+		src->next_input_byte+=(size_t)num_bytes;
+		src->bytes_in_buffer-=(size_t)num_bytes;
+	}
+}
+
+static void band_term_source(j_decompress_ptr dinfo)
+{
+}
+
+/* The band's error handler doesn't touch errStr, which belongs to the calling
+   thread.  If a band fails, the whole image is decompressed again on the
+   calling thread, and that reports the error. */
+
+static void band_output_message(j_common_ptr cinfo)
+{
+}
+
+static void decompressBand(void *arg)
+{
+	tjband *band=(tjband *)arg;
+	j_decompress_ptr dinfo=&band->dinfo;
+
+	dinfo->err=jpeg_std_error(&band->jerr.pub);
+	band->jerr.pub.error_exit=my_error_exit;
+	band->jerr.pub.output_message=band_output_message;
+	band->jerr.emit_message=band->jerr.pub.emit_message;
+	band->jerr.pub.emit_message=my_emit_message;
+
+	if(setjmp(band->jerr.setjmp_buffer))
+	{
+		band->failed=1;
+		jpeg_destroy_decompress(dinfo);
+		return;
+	}
+
+	jpeg_create_decompress(dinfo);
+	dinfo->src=&band->src.pub;
+	jpeg_read_header(dinfo, TRUE);
+	if(setDecompDefaults(dinfo, band->pixelFormat, band->flags)==-1)
+		band->failed=1;
+	if(band->flags&TJFLAG_FASTUPSAMPLE) dinfo->do_fancy_upsampling=FALSE;
+	dinfo->scale_num=band->scaleNum;
+	dinfo->scale_denom=band->scaleDenom;
+
+	jpeg_start_decompress(dinfo);
+	if(dinfo->output_width!=band->outputWidth
+		|| band->firstRow+dinfo->output_height!=band->outputHeight)
+		band->failed=1;
+
+	if(!band->failed)
+	{
+		JSAMPARRAY scratch=(*dinfo->mem->alloc_sarray)((j_common_ptr)dinfo,
+			JPOOL_IMAGE, dinfo->output_width*dinfo->output_components, 1);
+
+		while(band->firstRow+dinfo->output_scanline<band->keepRow)
+			jpeg_read_scanlines(dinfo, scratch, 1);
+		while(band->firstRow+dinfo->output_scanline<band->endRow)
+			jpeg_read_scanlines(dinfo,
+				&band->row_pointer[band->firstRow+dinfo->output_scanline],
+				band->endRow-band->firstRow-dinfo->output_scanline);
+	}
+
+	if(band->jerr.warning) band->failed=1;
+	jpeg_destroy_decompress(dinfo);
+}
+
+/* Returns the offset of the image height in the SOF marker of a baseline or
+   extended sequential Huffman-coded JPEG image, or 0 if the SOF marker isn't
+   found before sosEnd. */
+
+static unsigned long findSOFHeight(const unsigned char *jpegBuf,
+	unsigned long sosEnd)
+{
+	unsigned long pos=2;
+
+	while(pos+4<=sosEnd && jpegBuf[pos]==0xFF)
+	{
+		int marker;
+		while(pos<sosEnd && jpegBuf[pos]==0xFF) pos++;
+		if(pos+3>sosEnd) break;
+		marker=jpegBuf[pos++];
+		if(marker==0xC0 || marker==0xC1)
+			return pos+5<=sosEnd? pos+3:0;
+		if(marker==0xDA) break;
+		pos+=((unsigned long)jpegBuf[pos]<<8)+jpegBuf[pos+1];
+	}
+	return 0;
+}
+
+/* Checks that the entropy-coded data of a single-scan JPEG image, which
+   starts at jpegBuf[pos], contains nIntervals-1 restart markers in the
+   correct order and is followed by the EOI marker.  Also stores in offset[i]
+   the offset of the data that follows the marker[i]th restart marker (the
+   markers are counted from 1, and marker[] must be increasing.)  Returns -1
+   if the data isn't as expected. */
+
+static int findRestarts(const unsigned char *jpegBuf, unsigned long jpegSize,
+	unsigned long pos, unsigned long nIntervals, const unsigned long *marker,
+	unsigned long *offset, int n)
+{
+	unsigned long count=0;  int i=0;
+
+	while(pos<jpegSize)
+	{
+		const unsigned char *ptr=memchr(&jpegBuf[pos], 0xFF, jpegSize-pos);
+		int code;
+
+		if(!ptr) break;
+		pos=ptr-jpegBuf+1;
+		while(pos<jpegSize && jpegBuf[pos]==0xFF) pos++;
+		if(pos>=jpegSize) break;
+		code=jpegBuf[pos++];
+		if(code==0) continue;
+		if(code==JPEG_EOI)
+			return count==nIntervals-1 && i==n? 0:-1;
+		if(code!=JPEG_RST0+(int)(count&7)) break;
+		count++;
+		if(i<n && marker[i]==count) offset[i++]=pos;
+	}
+	return -1;
+}
+
+static int getNumThreads(void)
+{
+	int n=tjGetNumProcessors();
+	#ifndef NO_GETENV
+	char *env=NULL;
+	if((env=getenv("TJ_THREADS"))!=NULL && strlen(env)>0)
+	{
+		int temp=-1;
+		if(sscanf(env, "%d", &temp)==1 && temp>0) n=temp;
+	}
+	#endif
+	return n;
+}
+
+/* Decompresses the image that dinfo has started to decompress into the rows
+   in row_pointer, in bands on separate threads.  Returns -1, having written
+   nothing or having written rows that must be written again, if the image
+   should be decompressed in the usual way instead. */
+
+static int decompressParallel(j_decompress_ptr dinfo,
+	const unsigned char *jpegBuf, unsigned long jpegSize,
+	JSAMPROW *row_pointer, int pixelFormat, int flags)
+{
+	tjband *band=NULL;  tjthread thread[MAXBANDS];
+	unsigned long mcusPerRow, mcuRows, step, cuts, sosEnd, sofHeight;
+	unsigned long firstMCURow[MAXBANDS], marker[MAXBANDS], offset[MAXBANDS];
+	JDIMENSION outputRows, split;
+	int nbands, vsamp, i, retval=-1;
+
+	if(dinfo->progressive_mode || dinfo->arith_code
+		|| dinfo->restart_interval==0 || dinfo->buffered_image
+		|| dinfo->comps_in_scan!=dinfo->num_components
+		|| dinfo->unread_marker!=0 || dinfo->src->next_input_byte<jpegBuf
+		|| dinfo->src->next_input_byte+dinfo->src->bytes_in_buffer
+			!=jpegBuf+jpegSize)
+		return -1;
+
+	/* Bands start at the first MCU row after every eighth restart marker, so
+	   they can start at every step MCU rows. */
+	mcusPerRow=dinfo->MCUs_per_row;  mcuRows=dinfo->MCU_rows_in_scan;
+	for(step=1; step<mcuRows; step++)
+	{
+		if((step*mcusPerRow)%dinfo->restart_interval==0
+			&& ((step*mcusPerRow)/dinfo->restart_interval)%8==0)
+			break;
+	}
+	cuts=(mcuRows-1)/step;
+	nbands=getNumThreads();
+	if(nbands>MAXBANDS) nbands=MAXBANDS;
+	if((unsigned long)nbands>cuts+1) nbands=(int)cuts+1;
+	if(nbands<2) return -1;
+
+	firstMCURow[0]=0;
+	for(i=1; i<nbands; i++)
+	{
+		unsigned long c=(mcuRows*i/nbands+step/2)/step;
+		if(c<=firstMCURow[i-1]/step) c=firstMCURow[i-1]/step+1;
+		if(c>cuts-(nbands-1-i)) c=cuts-(nbands-1-i);
+		firstMCURow[i]=c*step;
+		marker[i-1]=firstMCURow[i]*mcusPerRow/dinfo->restart_interval;
+	}
+
+	sosEnd=(unsigned long)(dinfo->src->next_input_byte-jpegBuf);
+	sofHeight=findSOFHeight(jpegBuf, sosEnd);
+	if(sofHeight==0 || ((JDIMENSION)jpegBuf[sofHeight]<<8)+jpegBuf[sofHeight+1]
+		!=dinfo->image_height)
+		return -1;
+	if(findRestarts(jpegBuf, jpegSize, sosEnd,
+		(mcusPerRow*mcuRows+dinfo->restart_interval-1)/dinfo->restart_interval,
+		marker, offset, nbands-1)==-1)
+		return -1;
+
+	if((band=(tjband *)malloc(sizeof(tjband)*nbands))==NULL) return -1;
+	MEMZERO(band, sizeof(tjband)*nbands);
+
+	vsamp=dinfo->comps_in_scan==1? 1:dinfo->max_v_samp_factor;
+	outputRows=vsamp*dinfo->_min_DCT_scaled_size;
+	split=outputRows/2;
+	for(i=0; i<nbands; i++)
+	{
+		band_source_mgr *src=&band[i].src;
+		JDIMENSION height=dinfo->image_height
+			-(JDIMENSION)firstMCURow[i]*vsamp*DCTSIZE;
+
+		band[i].height[0]=(JOCTET)(height>>8);
+		band[i].height[1]=(JOCTET)(height&0xFF);
+		src->seg[0]=jpegBuf;  src->segSize[0]=sofHeight;
+		src->seg[1]=band[i].height;  src->segSize[1]=2;
+		src->seg[2]=&jpegBuf[sofHeight+2];  src->segSize[2]=sosEnd-sofHeight-2;
+		src->seg[3]=&jpegBuf[i==0? sosEnd:offset[i-1]];
+		src->segSize[3]=jpegSize-(i==0? sosEnd:offset[i-1]);
+		src->nseg=4;
+		src->pub.init_source=band_init_source;
+		src->pub.fill_input_buffer=band_fill_input_buffer;
+		src->pub.skip_input_data=band_skip_input_data;
+		src->pub.resync_to_restart=jpeg_resync_to_restart;
+		src->pub.term_source=band_term_source;
+		src->pub.next_input_byte=src->seg[0];
+		src->pub.bytes_in_buffer=src->segSize[0];
+
+		band[i].row_pointer=row_pointer;
+		band[i].firstRow=(JDIMENSION)firstMCURow[i]*outputRows;
+		band[i].keepRow=i==0? 0:
+			min(band[i].firstRow+split, dinfo->output_height);
+		band[i].endRow=i==nbands-1? dinfo->output_height:
+			min((JDIMENSION)firstMCURow[i+1]*outputRows+split,
+				dinfo->output_height);
+		band[i].outputWidth=dinfo->output_width;
+		band[i].outputHeight=dinfo->output_height;
+		band[i].scaleNum=dinfo->scale_num;
+		band[i].scaleDenom=dinfo->scale_denom;
+		band[i].pixelFormat=pixelFormat;
+		band[i].flags=flags;
+	}
+
+	for(i=1; i<nbands; i++)
+		thread[i]=tjThreadCreate(decompressBand, &band[i]);
+	decompressBand(&band[0]);
+	for(i=1; i<nbands; i++)
+	{
+		if(thread[i]) tjThreadJoin(thread[i]);
+		else decompressBand(&band[i]);
+	}
+
+	retval=0;
+	for(i=0; i<nbands; i++)
+		if(band[i].failed) retval=-1;
+	free(band);
+	return retval;
+}
+
+
 DLLEXPORT int DLLCALL tjDecompress2(tjhandle handle,
 	const unsigned char *jpegBuf, unsigned long jpegSize, unsigned char *dstBuf,
 	int width, int pitch, int height, int pixelFormat, int flags)
@@ -1419,12 +1748,16 @@ DLLEXPORT int DLLCALL tjDecompress2(tjhandle handle,
 			row_pointer[i]=&dstBuf[(dinfo->output_height-i-1)*pitch];
 		else row_pointer[i]=&dstBuf[i*pitch];
 	}
-	while(dinfo->output_scanline<dinfo->output_height)
+	if((flags&TJFLAG_PARALLEL)==0 || decompressParallel(dinfo, jpegBuf,
+		jpegSize, row_pointer, pixelFormat, flags)==-1)
 	{
-		jpeg_read_scanlines(dinfo, &row_pointer[dinfo->output_scanline],
-			dinfo->output_height-dinfo->output_scanline);
+		while(dinfo->output_scanline<dinfo->output_height)
+		{
+			jpeg_read_scanlines(dinfo, &row_pointer[dinfo->output_scanline],
+				dinfo->output_height-dinfo->output_scanline);
+		}
+		jpeg_finish_decompress(dinfo);
 	}
-	jpeg_finish_decompress(dinfo);
 
 	#ifndef JCS_EXTENSIONS
 	fromRGB(rgbBuf, _dstBuf, width, _pitch, height, pixelFormat);
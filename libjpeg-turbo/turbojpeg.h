@@ -383,6 +383,18 @@ enum TJCS
  * when decompressing, because this has been shown to have a larger effect.
  */
 #define TJFLAG_ACCURATEDCT   4096
+/**
+ * When decompressing a baseline JPEG image that contains restart markers,
+ * split the image into bands of MCU rows that start at restart markers, and
+ * decompress the bands in parallel, using one thread per processor (or the
+ * number of threads given by the <tt>TJ_THREADS</tt> environment variable.)
+ * The decompressed image is identical to the one produced without this flag.
+ * Images without restart markers, progressive and arithmetic-coded images, and
+ * images whose restart markers rarely coincide with the start of an MCU row
+ * are decompressed on one thread.  This flag currently affects only
+ * #tjDecompress2().
+ */
+#define TJFLAG_PARALLEL      8192
 
 
 /**
@@ -0,0 +1,249 @@
+/* timefilter.c
+ *
+ * Last changed in libpng 1.6.15 [November 20, 2014]
+ *
+ * This code is released under the libpng license.
+ * For conditions of distribution and use, see the disclaimer
+ * and license in png.h
+ *
+ * Decode each PNG file named on the command line from memory, first with the
+ * C row filter functions and then with the SSE2 ones (PNG_INTEL_SSE), and
+ * report the decode speed of each in MB/s of decoded image data.  The two
+ * decoded images are compared; the program fails if they differ.
+ *
+ *   timefilter FILE.png...
+ */
+#define _POSIX_C_SOURCE 199309L /* for clock_gettime */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <time.h>
+
+#if defined(HAVE_CONFIG_H) && !defined(PNG_NO_CONFIG_H)
+#  include <config.h>
+#endif
+
+/* Define the following to use this test against your installed libpng, rather
+ * than the one being built here:
+ */
+#ifdef PNG_FREESTANDING_TESTS
+#  include <png.h>
+#else
+#  include "../../png.h"
+#endif
+
+#if defined(PNG_READ_SUPPORTED) && defined(PNG_SET_OPTION_SUPPORTED) &&\
+   defined(PNG_INTEL_SSE)
+
+/* Decode about this much image data per measurement. */
+#define DECODE_BYTES (64 << 20)
+
+typedef struct
+{
+   png_const_bytep data;
+   png_size_t      size;
+   png_size_t      pos;
+} memory_file;
+
+static void
+read_memory(png_structp png_ptr, png_bytep out, png_size_t count)
+{
+   memory_file *mf = (memory_file*)png_get_io_ptr(png_ptr);
+
+   if (count > mf->size - mf->pos)
+      png_error(png_ptr, "read beyond end of file");
+
+   memcpy(out, mf->data + mf->pos, count);
+   mf->pos += count;
+}
+
+static double
+now(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Decode the whole image into *image (allocated here on first use) with the
+ * SSE2 option set to 'sse', and return the size of the image in bytes, or 0 on
+ * error.
+ */
+static png_size_t
+decode(png_const_bytep data, png_size_t size, int sse, png_bytep *image)
+{
+   memory_file mf;
+   png_structp png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING,0,0,0);
+   png_infop info_ptr = NULL;
+   png_bytep *rows = NULL;
+   png_size_t image_size = 0;
+
+   if (png_ptr == NULL)
+      return 0;
+
+   if (setjmp(png_jmpbuf(png_ptr)))
+   {
+      png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
+      free(rows);
+      return 0;
+   }
+
+   mf.data = data;
+   mf.size = size;
+   mf.pos = 0;
+   png_set_read_fn(png_ptr, &mf, read_memory);
+   png_set_option(png_ptr, PNG_INTEL_SSE, sse);
+
+   info_ptr = png_create_info_struct(png_ptr);
+   if (info_ptr == NULL)
+      png_error(png_ptr, "OOM allocating info structure");
+
+   png_read_info(png_ptr, info_ptr);
+
+   {
+      png_size_t rowbytes = png_get_rowbytes(png_ptr, info_ptr);
+      png_uint_32 height = png_get_image_height(png_ptr, info_ptr);
+      png_uint_32 y;
+
+      image_size = rowbytes * height;
+
+      if (*image == NULL)
+         *image = malloc(image_size);
+
+      rows = malloc(height * sizeof *rows);
+
+      if (*image == NULL || rows == NULL)
+         png_error(png_ptr, "OOM allocating image");
+
+      for (y = 0; y < height; ++y)
+         rows[y] = *image + y * rowbytes;
+
+      png_read_image(png_ptr, rows);
+      png_read_end(png_ptr, NULL);
+   }
+
+   png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
+   free(rows);
+   return image_size;
+}
+
+/* Return the decode speed in MB/s, or 0 on error. */
+static double
+time_decode(png_const_bytep data, png_size_t size, int sse, png_bytep *image)
+{
+   png_size_t image_size = decode(data, size, sse, image);
+   double start;
+   int reps, i;
+
+   if (image_size == 0)
+      return 0;
+
+   reps = (int)(DECODE_BYTES / image_size) + 1;
+   start = now();
+
+   for (i = 0; i < reps; ++i)
+      if (decode(data, size, sse, image) != image_size)
+         return 0;
+
+   return (double)image_size * reps / (now() - start) / (1 << 20);
+}
+
+static png_bytep
+read_file(const char *name, png_size_t *size)
+{
+   FILE *fp = fopen(name, "rb");
+   png_bytep data = NULL;
+   long n;
+
+   if (fp == NULL)
+      return NULL;
+
+   if (fseek(fp, 0, SEEK_END) == 0 && (n = ftell(fp)) > 0 &&
+       fseek(fp, 0, SEEK_SET) == 0)
+   {
+      data = malloc((size_t)n);
+
+      if (data != NULL && fread(data, 1, (size_t)n, fp) != (size_t)n)
+      {
+         free(data);
+         data = NULL;
+      }
+
+      *size = (png_size_t)n;
+   }
+
+   fclose(fp);
+   return data;
+}
+
+int
+main(int argc, char **argv)
+{
+   double c_time = 0, sse_time = 0, total = 0;
+   int i, errors = 0;
+
+   if (argc < 2)
+   {
+      fprintf(stderr, "usage: timefilter FILE.png...\n");
+      return 2;
+   }
+
+   printf("%-32s %10s %10s\n", "file", "C MB/s", "SSE2 MB/s");
+
+   for (i = 1; i < argc; ++i)
+   {
+      png_size_t size = 0, image_size;
+      png_bytep data = read_file(argv[i], &size);
+      png_bytep c_image = NULL, sse_image = NULL;
+      double c_rate, sse_rate;
+
+      if (data == NULL)
+      {
+         fprintf(stderr, "%s: cannot read\n", argv[i]);
+         ++errors;
+         continue;
+      }
+
+      c_rate = time_decode(data, size, PNG_OPTION_OFF, &c_image);
+      sse_rate = time_decode(data, size, PNG_OPTION_ON, &sse_image);
+      image_size = decode(data, size, PNG_OPTION_ON, &sse_image);
+
+      if (c_rate == 0 || sse_rate == 0 || image_size == 0 ||
+          memcmp(c_image, sse_image, image_size) != 0)
+      {
+         printf("%-32.32s %21s\n", argv[i], "wrong output");
+         ++errors;
+      }
+
+      else
+      {
+         printf("%-32.32s %10.1f %10.1f\n", argv[i], c_rate, sse_rate);
+         c_time += image_size / c_rate;
+         sse_time += image_size / sse_rate;
+         total += image_size;
+      }
+
+      free(sse_image);
+      free(c_image);
+      free(data);
+   }
+
+   /* Totals weight each file by its decoded size. */
+   if (c_time > 0 && sse_time > 0)
+      printf("%-32s %10.1f %10.1f\n", "total", total / c_time,
+         total / sse_time);
+
+   return errors != 0;
+}
+#else /* !(READ && SET_OPTION && INTEL_SSE) */
+int
+main(void)
+{
+   fprintf(stderr, "timefilter: test requires the SSE2 filter functions\n");
+   /* So the test is skipped: */
+   return 77;
+}
+#endif
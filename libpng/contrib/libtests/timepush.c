@@ -0,0 +1,265 @@
+/* timepush.c
+ *
+ * Last changed in libpng 1.6.15 [November 20, 2014]
+ *
+ * This code is released under the libpng license.
+ * For conditions of distribution and use, see the disclaimer
+ * and license in png.h
+ *
+ * Decode each PNG file named on the command line with the progressive reader,
+ * passing the file to png_process_data in pieces as they might arrive from a
+ * network.  Each file is decoded twice: first with png_progressive_combine_row
+ * copying each row into the image, then with png_set_progressive_image
+ * decoding the rows straight into it.  The speed of each is reported in MB/s of
+ * decoded image data.  The two decoded images are compared; the program fails
+ * if they differ.
+ *
+ *   timepush [--piece=BYTES] FILE.png...
+ */
+#define _POSIX_C_SOURCE 199309L /* for clock_gettime */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <time.h>
+
+#if defined(HAVE_CONFIG_H) && !defined(PNG_NO_CONFIG_H)
+#  include <config.h>
+#endif
+
+/* Define the following to use this test against your installed libpng, rather
+ * than the one being built here:
+ */
+#ifdef PNG_FREESTANDING_TESTS
+#  include <png.h>
+#else
+#  include "../../png.h"
+#endif
+
+#ifdef PNG_PROGRESSIVE_READ_SUPPORTED
+
+/* Decode about this much image data per measurement. */
+#define DECODE_BYTES (64 << 20)
+
+typedef struct
+{
+   int        direct;     /* use png_set_progressive_image */
+   png_bytep  image;      /* the decoded image, allocated on first use */
+   png_size_t rowbytes;
+   png_size_t image_size;
+} decoder;
+
+static void PNGCBAPI
+info_callback(png_structp png_ptr, png_infop info_ptr)
+{
+   decoder *dp = (decoder*)png_get_progressive_ptr(png_ptr);
+
+   png_set_interlace_handling(png_ptr);
+   png_read_update_info(png_ptr, info_ptr);
+
+   dp->rowbytes = png_get_rowbytes(png_ptr, info_ptr);
+   dp->image_size = dp->rowbytes * png_get_image_height(png_ptr, info_ptr);
+
+   if (dp->image == NULL)
+   {
+      dp->image = malloc(dp->image_size);
+
+      if (dp->image == NULL)
+         png_error(png_ptr, "OOM allocating image");
+   }
+
+   if (dp->direct)
+      png_set_progressive_image(png_ptr, dp->image, dp->rowbytes);
+}
+
+static void PNGCBAPI
+row_callback(png_structp png_ptr, png_bytep new_row, png_uint_32 row_num,
+   int pass)
+{
+   decoder *dp = (decoder*)png_get_progressive_ptr(png_ptr);
+
+   /* With png_set_progressive_image this does nothing, because new_row is
+    * already the row in the image.
+    */
+   png_progressive_combine_row(png_ptr, dp->image + row_num * dp->rowbytes,
+      new_row);
+   (void)pass;
+}
+
+static void
+process(png_structp png_ptr, png_infop info_ptr, png_bytep data,
+   png_size_t size, png_size_t piece)
+{
+   while (size > 0)
+   {
+      png_size_t n = size < piece ? size : piece;
+
+      png_process_data(png_ptr, info_ptr, data, n);
+      data += n;
+      size -= n;
+   }
+}
+
+/* Decode the whole image into dp->image, 'piece' bytes of the file at a time,
+ * and return the size of the image in bytes, or 0 on error.
+ */
+static png_size_t
+decode(png_bytep data, png_size_t size, png_size_t piece, decoder *dp)
+{
+   png_structp png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING,0,0,0);
+   png_infop info_ptr = NULL;
+
+   if (png_ptr == NULL)
+      return 0;
+
+   if (setjmp(png_jmpbuf(png_ptr)))
+   {
+      png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
+      return 0;
+   }
+
+   info_ptr = png_create_info_struct(png_ptr);
+   if (info_ptr == NULL)
+      png_error(png_ptr, "OOM allocating info structure");
+
+   png_set_progressive_read_fn(png_ptr, dp, info_callback, row_callback,
+      NULL);
+   dp->image_size = 0;
+   process(png_ptr, info_ptr, data, size, piece);
+
+   png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
+   return dp->image_size;
+}
+
+/* Return the decode speed in MB/s, or 0 on error. */
+static double
+time_decode(png_bytep data, png_size_t size, png_size_t piece, decoder *dp)
+{
+   png_size_t image_size = decode(data, size, piece, dp);
+   struct timespec start, end;
+   int reps, i;
+
+   if (image_size == 0)
+      return 0;
+
+   reps = (int)(DECODE_BYTES / image_size) + 1;
+   clock_gettime(CLOCK_MONOTONIC, &start);
+
+   for (i = 0; i < reps; ++i)
+      if (decode(data, size, piece, dp) != image_size)
+         return 0;
+
+   clock_gettime(CLOCK_MONOTONIC, &end);
+   return (double)image_size * reps / (end.tv_sec - start.tv_sec +
+      (end.tv_nsec - start.tv_nsec) / 1e9) / (1 << 20);
+}
+
+static png_bytep
+read_file(const char *name, png_size_t *size)
+{
+   FILE *fp = fopen(name, "rb");
+   png_bytep data = NULL;
+   long n;
+
+   if (fp == NULL)
+      return NULL;
+
+   if (fseek(fp, 0, SEEK_END) == 0 && (n = ftell(fp)) > 0 &&
+       fseek(fp, 0, SEEK_SET) == 0)
+   {
+      data = malloc((size_t)n);
+
+      if (data != NULL && fread(data, 1, (size_t)n, fp) != (size_t)n)
+      {
+         free(data);
+         data = NULL;
+      }
+
+      *size = (png_size_t)n;
+   }
+
+   fclose(fp);
+   return data;
+}
+
+int
+main(int argc, char **argv)
+{
+   double combine_time = 0, direct_time = 0, total = 0;
+   png_size_t piece = 16384;
+   int i, errors = 0;
+
+   if (argc > 1 && strncmp(argv[1], "--piece=", 8) == 0)
+   {
+      piece = (png_size_t)strtoul(argv[1]+8, NULL, 0);
+      ++argv, --argc;
+   }
+
+   if (argc < 2 || piece == 0)
+   {
+      fprintf(stderr, "usage: timepush [--piece=BYTES] FILE.png...\n");
+      return 2;
+   }
+
+   printf("%-32s %10s %10s\n", "file", "copy MB/s", "image MB/s");
+
+   for (i = 1; i < argc; ++i)
+   {
+      png_size_t size = 0;
+      png_bytep data = read_file(argv[i], &size);
+      decoder combine, direct;
+      double combine_rate, direct_rate;
+
+      if (data == NULL)
+      {
+         fprintf(stderr, "%s: cannot read\n", argv[i]);
+         ++errors;
+         continue;
+      }
+
+      memset(&combine, 0, sizeof combine);
+      memset(&direct, 0, sizeof direct);
+      direct.direct = 1;
+
+      combine_rate = time_decode(data, size, piece, &combine);
+      direct_rate = time_decode(data, size, piece, &direct);
+
+      if (combine_rate == 0 || direct_rate == 0 ||
+          combine.image_size != direct.image_size ||
+          memcmp(combine.image, direct.image, direct.image_size) != 0)
+      {
+         printf("%-32.32s %21s\n", argv[i], "wrong output");
+         ++errors;
+      }
+
+      else
+      {
+         printf("%-32.32s %10.1f %10.1f\n", argv[i], combine_rate,
+            direct_rate);
+         combine_time += direct.image_size / combine_rate;
+         direct_time += direct.image_size / direct_rate;
+         total += direct.image_size;
+      }
+
+      free(direct.image);
+      free(combine.image);
+      free(data);
+   }
+
+   /* Totals weight each file by its decoded size. */
+   if (combine_time > 0 && direct_time > 0)
+      printf("%-32s %10.1f %10.1f\n", "total", total / combine_time,
+         total / direct_time);
+
+   return errors != 0;
+}
+#else /* !PROGRESSIVE_READ */
+int
+main(void)
+{
+   fprintf(stderr, "timepush: test requires progressive read support\n");
+   /* So the test is skipped: */
+   return 77;
+}
+#endif
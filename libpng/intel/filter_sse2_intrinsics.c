@@ -0,0 +1,335 @@
+/* filter_sse2_intrinsics.c - SSE2 optimized filter functions
+ *
+ * Last changed in libpng 1.6.15 [November 20, 2014]
+ *
+ * This code is released under the libpng license.
+ * For conditions of distribution and use, see the disclaimer
+ * and license in png.h
+ */
+
+#include "../pngpriv.h"
+
+#ifdef PNG_READ_SUPPORTED
+#if PNG_INTEL_SSE_OPT > 0
+
+#include <emmintrin.h>
+
+/* Functions in this file look at most 3 pixels (a,b,c) to predict the 4th (d).
+ * They're positioned like this:
+ *    prev:  c b
+ *    row:   a d
+ * The Sub filter predicts d=a, Avg d=(a+b)/2, and Paeth predicts d to be
+ * whichever of a, b, or c is closest to p=a+b-c.
+ *
+ * Pixels are loaded into the low bytes of an __m128i one at a time.  Rows
+ * are not aligned, and a 3 byte pixel is loaded with memcpy() so that
+ * nothing past the end of the row is read.
+ */
+
+static PNG_SSE2_TARGET __m128i
+load4(const void *p)
+{
+   int tmp;
+   memcpy(&tmp, p, sizeof(tmp));
+   return _mm_cvtsi32_si128(tmp);
+}
+
+static PNG_SSE2_TARGET void
+store4(void *p, __m128i v)
+{
+   int tmp = _mm_cvtsi128_si32(v);
+   memcpy(p, &tmp, sizeof(int));
+}
+
+static PNG_SSE2_TARGET __m128i
+load3(const void *p)
+{
+   png_uint_32 tmp = 0;
+   memcpy(&tmp, p, 3);
+   return _mm_cvtsi32_si128((int)tmp);
+}
+
+static PNG_SSE2_TARGET void
+store3(void *p, __m128i v)
+{
+   int tmp = _mm_cvtsi128_si32(v);
+   memcpy(p, &tmp, 3);
+}
+
+PNG_SSE2_TARGET void
+png_read_filter_row_up_sse2(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev_row)
+{
+   /* Up does not depend on the pixel size: d=b for every byte, 16 at a
+    * time.
+    */
+   png_size_t rb = row_info->rowbytes;
+   png_const_bytep prev = prev_row;
+
+   png_debug(1, "in png_read_filter_row_up_sse2");
+
+   while (rb >= 16)
+   {
+      __m128i b = _mm_loadu_si128((const __m128i *)prev);
+      __m128i d = _mm_loadu_si128((const __m128i *)row);
+
+      _mm_storeu_si128((__m128i *)row, _mm_add_epi8(d, b));
+
+      prev += 16;
+      row  += 16;
+      rb   -= 16;
+   }
+   while (rb > 0)
+   {
+      *row = (png_byte)(*row + *prev++);
+      row++;
+      rb--;
+   }
+}
+
+PNG_SSE2_TARGET void
+png_read_filter_row_sub3_sse2(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev_row)
+{
+   /* The Sub filter predicts each pixel as the previous pixel, a.
+    * There is no pixel to the left of the first pixel.  It's encoded directly.
+    * That works with our main loop if we just say that left pixel was zero.
+    */
+   png_size_t rb = row_info->rowbytes;
+   __m128i a, d = _mm_setzero_si128();
+
+   png_debug(1, "in png_read_filter_row_sub3_sse2");
+
+   PNG_UNUSED(prev_row)
+
+   /* While at least 4 bytes are left, a 4 byte load is safe. */
+   while (rb >= 4)
+   {
+      a = d; d = load4(row);
+      d = _mm_add_epi8(d, a);
+      store3(row, d);
+
+      row += 3;
+      rb  -= 3;
+   }
+   if (rb > 0)
+   {
+      a = d; d = load3(row);
+      d = _mm_add_epi8(d, a);
+      store3(row, d);
+   }
+}
+
+PNG_SSE2_TARGET void
+png_read_filter_row_sub4_sse2(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev_row)
+{
+   /* The Sub filter predicts each pixel as the previous pixel, a.
+    * Just like sub3, but with 4 byte pixels.
+    */
+   png_size_t rb = row_info->rowbytes;
+   __m128i a, d = _mm_setzero_si128();
+
+   png_debug(1, "in png_read_filter_row_sub4_sse2");
+
+   PNG_UNUSED(prev_row)
+
+   while (rb > 0)
+   {
+      a = d; d = load4(row);
+      d = _mm_add_epi8(d, a);
+      store4(row, d);
+
+      row += 4;
+      rb  -= 4;
+   }
+}
+
+/* The Avg filter predicts each pixel as the rounded-down average of a and b.
+ * _mm_avg_epu8() rounds up, so subtract the rounding, 1 where a+b is odd.
+ */
+#define AVG(a, b) _mm_sub_epi8(_mm_avg_epu8(a, b), \
+   _mm_and_si128(_mm_xor_si128(a, b), _mm_set1_epi8(1)))
+
+PNG_SSE2_TARGET void
+png_read_filter_row_avg3_sse2(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev_row)
+{
+   /* There is no pixel to the left of the first pixel, so a is zero there,
+    * just as in sub3.
+    */
+   png_size_t rb = row_info->rowbytes;
+   png_const_bytep prev = prev_row;
+   __m128i b;
+   __m128i a, d = _mm_setzero_si128();
+
+   png_debug(1, "in png_read_filter_row_avg3_sse2");
+
+   while (rb >= 4)
+   {
+      b = load4(prev);
+      a = d; d = load4(row);
+      d = _mm_add_epi8(d, AVG(a, b));
+      store3(row, d);
+
+      prev += 3;
+      row  += 3;
+      rb   -= 3;
+   }
+   if (rb > 0)
+   {
+      b = load3(prev);
+      a = d; d = load3(row);
+      d = _mm_add_epi8(d, AVG(a, b));
+      store3(row, d);
+   }
+}
+
+PNG_SSE2_TARGET void
+png_read_filter_row_avg4_sse2(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev_row)
+{
+   /* Just like avg3, but with 4 byte pixels. */
+   png_size_t rb = row_info->rowbytes;
+   png_const_bytep prev = prev_row;
+   __m128i b;
+   __m128i a, d = _mm_setzero_si128();
+
+   png_debug(1, "in png_read_filter_row_avg4_sse2");
+
+   while (rb > 0)
+   {
+      b = load4(prev);
+      a = d; d = load4(row);
+      d = _mm_add_epi8(d, AVG(a, b));
+      store4(row, d);
+
+      prev += 4;
+      row  += 4;
+      rb   -= 4;
+   }
+}
+
+/* Returns |x| for 16-bit lanes.  SSSE3 has _mm_abs_epi16(); with SSE2 flip
+ * the bits of the negative lanes and add one.
+ */
+static PNG_SSE2_TARGET __m128i
+abs_i16(__m128i x)
+{
+   __m128i is_negative = _mm_cmplt_epi16(x, _mm_setzero_si128());
+
+   x = _mm_xor_si128(x, is_negative);
+   return _mm_sub_epi16(x, is_negative);
+}
+
+/* Bytewise c ? t : e. */
+static PNG_SSE2_TARGET __m128i
+if_then_else(__m128i c, __m128i t, __m128i e)
+{
+   return _mm_or_si128(_mm_and_si128(c, t), _mm_andnot_si128(c, e));
+}
+
+/* The Paeth filter predicts whichever of a, b and c is closest to a+b-c,
+ * preferring a, then b, on ties.  The distances need 9 bits, so the pixels
+ * are widened to 16-bit lanes.
+ *
+ *    |p-a| = |a+b-c - a| = |b-c|
+ *    |p-b| = |a+b-c - b| = |a-c|
+ *    |p-c| = |a+b-c - c| = |(b-c) + (a-c)|
+ */
+#define PAETH(a, b, c, nearest) do { \
+      __m128i pa = _mm_sub_epi16(b, c); \
+      __m128i pb = _mm_sub_epi16(a, c); \
+      __m128i pc = _mm_add_epi16(pa, pb); \
+      __m128i smallest; \
+      pa = abs_i16(pa); \
+      pb = abs_i16(pb); \
+      pc = abs_i16(pc); \
+      smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb)); \
+      nearest = if_then_else(_mm_cmpeq_epi16(smallest, pa), a, \
+                if_then_else(_mm_cmpeq_epi16(smallest, pb), b, c)); \
+   } while (0)
+
+PNG_SSE2_TARGET void
+png_read_filter_row_paeth3_sse2(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev_row)
+{
+   /* There is no pixel to the left of the first pixel, and no pixel above and
+    * to its left, so a and c start out as zero.  Then Paeth predicts b, which
+    * is right.
+    */
+   png_size_t rb = row_info->rowbytes;
+   png_const_bytep prev = prev_row;
+   const __m128i zero = _mm_setzero_si128();
+   __m128i c, b = zero,
+           a, d = zero;
+
+   png_debug(1, "in png_read_filter_row_paeth3_sse2");
+
+   while (rb >= 4)
+   {
+      /* It's easiest to do this math (particularly, deal with pc) with 16-bit
+       * intermediates.  d is kept unpacked too, for the next a.
+       */
+      __m128i nearest;
+
+      c = b; b = _mm_unpacklo_epi8(load4(prev), zero);
+      a = d; d = _mm_unpacklo_epi8(load4(row),  zero);
+
+      PAETH(a, b, c, nearest);
+
+      /* Adding bytes in 16-bit lanes keeps the high bytes zero. */
+      d = _mm_add_epi8(d, nearest);
+      store3(row, _mm_packus_epi16(d, d));
+
+      prev += 3;
+      row  += 3;
+      rb   -= 3;
+   }
+   if (rb > 0)
+   {
+      __m128i nearest;
+
+      c = b; b = _mm_unpacklo_epi8(load3(prev), zero);
+      a = d; d = _mm_unpacklo_epi8(load3(row),  zero);
+
+      PAETH(a, b, c, nearest);
+
+      d = _mm_add_epi8(d, nearest);
+      store3(row, _mm_packus_epi16(d, d));
+   }
+}
+
+PNG_SSE2_TARGET void
+png_read_filter_row_paeth4_sse2(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev_row)
+{
+   /* Just like paeth3, but with 4 byte pixels. */
+   png_size_t rb = row_info->rowbytes;
+   png_const_bytep prev = prev_row;
+   const __m128i zero = _mm_setzero_si128();
+   __m128i c, b = zero,
+           a, d = zero;
+
+   png_debug(1, "in png_read_filter_row_paeth4_sse2");
+
+   while (rb > 0)
+   {
+      __m128i nearest;
+
+      c = b; b = _mm_unpacklo_epi8(load4(prev), zero);
+      a = d; d = _mm_unpacklo_epi8(load4(row),  zero);
+
+      PAETH(a, b, c, nearest);
+
+      d = _mm_add_epi8(d, nearest);
+      store4(row, _mm_packus_epi16(d, d));
+
+      prev += 4;
+      row  += 4;
+      rb   -= 4;
+   }
+}
+
+#endif /* PNG_INTEL_SSE_OPT > 0 */
+#endif /* PNG_READ_SUPPORTED */
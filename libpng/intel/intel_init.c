@@ -0,0 +1,87 @@
+/* intel_init.c - SSE2 optimized filter functions
+ *
+ * Last changed in libpng 1.6.15 [November 20, 2014]
+ *
+ * This code is released under the libpng license.
+ * For conditions of distribution and use, see the disclaimer
+ * and license in png.h
+ */
+
+#include "../pngpriv.h"
+
+#ifdef PNG_READ_SUPPORTED
+#if PNG_INTEL_SSE_OPT > 0
+
+#if defined(__x86_64__) || defined(_M_X64)
+   /* SSE2 is part of the x86-64 architecture. */
+#  define png_have_sse2() 1
+#else
+#  if defined(_MSC_VER)
+#     include <intrin.h>
+#  elif defined(__GNUC__)
+#     include <cpuid.h>
+#  endif
+
+/* 32-bit x86: SSE2 is bit 26 of EDX from CPUID leaf 1.  Unlike the ARM case
+ * this needs no help from the operating system.
+ */
+static int
+png_have_sse2(void)
+{
+#  if defined(_MSC_VER)
+   int info[4];
+
+   __cpuid(info, 1);
+   return (info[3] & (1 << 26)) != 0;
+#  elif defined(__GNUC__)
+   unsigned int eax, ebx, ecx, edx;
+
+   if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) == 0)
+      return 0;
+
+   return (edx & (1U << 26)) != 0;
+#  else
+   return 0;
+#  endif
+}
+#endif
+
+void
+png_init_filter_functions_sse2(png_structp pp, unsigned int bpp)
+{
+   /* Unlike the ARM NEON option the SSE2 code is used by default: the check
+    * above is cheap and reliable.  An application can still turn it OFF with
+    * png_set_option(png_ptr, PNG_INTEL_SSE, 0), for example to compare the
+    * speed of the C code.
+    */
+#ifdef PNG_SET_OPTION_SUPPORTED
+   if (((pp->options >> PNG_INTEL_SSE) & 3) == PNG_OPTION_OFF)
+      return;
+#endif
+
+   if (!png_have_sse2())
+      return;
+
+   /* IMPORTANT: any new external functions used here must be declared using
+    * PNG_INTERNAL_FUNCTION in ../pngpriv.h, see arm/arm_init.c.
+    */
+   pp->read_filter[PNG_FILTER_VALUE_UP-1] = png_read_filter_row_up_sse2;
+
+   if (bpp == 3)
+   {
+      pp->read_filter[PNG_FILTER_VALUE_SUB-1] = png_read_filter_row_sub3_sse2;
+      pp->read_filter[PNG_FILTER_VALUE_AVG-1] = png_read_filter_row_avg3_sse2;
+      pp->read_filter[PNG_FILTER_VALUE_PAETH-1] =
+         png_read_filter_row_paeth3_sse2;
+   }
+
+   else if (bpp == 4)
+   {
+      pp->read_filter[PNG_FILTER_VALUE_SUB-1] = png_read_filter_row_sub4_sse2;
+      pp->read_filter[PNG_FILTER_VALUE_AVG-1] = png_read_filter_row_avg4_sse2;
+      pp->read_filter[PNG_FILTER_VALUE_PAETH-1] =
+         png_read_filter_row_paeth4_sse2;
+   }
+}
+#endif /* PNG_INTEL_SSE_OPT > 0 */
+#endif /* PNG_READ_SUPPORTED */
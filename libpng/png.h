@@ -1495,6 +1495,14 @@ PNG_EXPORT(51, void, png_set_flush, (png_structrp png_ptr, int nrows));
 PNG_EXPORT(52, void, png_write_flush, (png_structrp png_ptr));
 #endif
 
+#ifdef PNG_WRITE_THREADS_SUPPORTED
+/* Filter and compress the image data on 'threads' threads, 'band_rows' rows
+ * at a time (0 for about 256K bytes); 0 or 1 threads to write serially.
+ */
+PNG_EXPORT(245, void, png_set_write_threads, (png_structrp png_ptr,
+    int threads, png_uint_32 band_rows));
+#endif
+
 /* Optional update palette with requested transformations */
 PNG_EXPORT(53, void, png_start_read_image, (png_structrp png_ptr));
 
@@ -1872,6 +1880,15 @@ PNG_EXPORT(220, png_uint_32, png_process_data_skip, (png_structrp));
  */
 PNG_EXPORT(93, void, png_progressive_combine_row, (png_const_structrp png_ptr,
     png_bytep old_row, png_const_bytep new_row));
+
+/* Decode the rows straight into the application's image: row y is at
+ * image + y * row_stride.  Call after png_start_read_image or
+ * png_read_update_info, before any image data.  The row callback then gets a
+ * pointer to the row in the image, which is already complete, and the image
+ * rows must not be changed until the whole image has been read.
+ */
+PNG_EXPORT(246, void, png_set_progressive_image, (png_structrp png_ptr,
+    png_bytep image, png_size_t row_stride));
 #endif /* PROGRESSIVE_READ */
 
 PNG_EXPORTA(94, png_voidp, png_malloc, (png_const_structrp png_ptr,
@@ -3243,7 +3260,8 @@ PNG_EXPORT(243, int, png_get_palette_max, (png_const_structp png_ptr,
 #endif
 #define PNG_MAXIMUM_INFLATE_WINDOW 2 /* SOFTWARE: force maximum window */
 #define PNG_SKIP_sRGB_CHECK_PROFILE 4 /* SOFTWARE: Check ICC profile for sRGB */
-#define PNG_OPTION_NEXT  6 /* Next option - numbers must be even */
+#define PNG_INTEL_SSE   10 /* HARDWARE: x86 SSE2; used if present unless OFF */
+#define PNG_OPTION_NEXT 12 /* Next option - numbers must be even */
 
 /* Return values: NOTE: there are four values and 'off' is *not* zero */
 #define PNG_OPTION_UNSET   0 /* Unset - defaults to off */
@@ -3267,7 +3285,7 @@ PNG_EXPORT(244, int, png_set_option, (png_structrp png_ptr, int option,
  * one to use is one more than this.)
  */
 #ifdef PNG_EXPORT_LAST_ORDINAL
-  PNG_EXPORT_LAST_ORDINAL(244);
+  PNG_EXPORT_LAST_ORDINAL(246);
 #endif
 
 #ifdef __cplusplus
@@ -144,6 +144,7 @@
 #define PNG_WRITE_SWAP_ALPHA_SUPPORTED
 #define PNG_WRITE_SWAP_SUPPORTED
 #define PNG_WRITE_TEXT_SUPPORTED
+#define PNG_WRITE_THREADS_SUPPORTED
 #define PNG_WRITE_TRANSFORMS_SUPPORTED
 #define PNG_WRITE_UNKNOWN_CHUNKS_SUPPORTED
 #define PNG_WRITE_USER_TRANSFORM_SUPPORTED
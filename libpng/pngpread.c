@@ -286,10 +286,11 @@ png_push_read_chunk(png_structrp png_ptr, png_inforp info_ptr)
       png_ptr->idat_size = png_ptr->push_length;
       png_ptr->process_mode = PNG_READ_IDAT_MODE;
       png_push_have_info(png_ptr, info_ptr);
-      png_ptr->zstream.avail_out =
-          (uInt) PNG_ROWBYTES(png_ptr->pixel_depth,
-          png_ptr->iwidth) + 1;
-      png_ptr->zstream.next_out = png_ptr->row_buf;
+      /* png_process_IDAT_data sets up the output for each row; it depends on
+       * png_set_progressive_image, which may have been called just now.
+       */
+      png_ptr->zstream.avail_out = 0;
+      png_ptr->zstream.next_out = NULL;
       return;
    }
 
@@ -729,6 +730,7 @@ png_process_IDAT_data(png_structrp png_ptr, png_bytep buffer,
       !(png_ptr->flags & PNG_FLAG_ZSTREAM_ENDED))
    {
       int ret;
+      png_bytep next_out;
 
       /* We have data for zlib, but we must check that zlib
        * has someplace to put the results.  It doesn't matter
@@ -737,13 +739,40 @@ png_process_IDAT_data(png_structrp png_ptr, png_bytep buffer,
        */
       if (!(png_ptr->zstream.avail_out > 0))
       {
-         /* TODO: WARNING: TRUNCATION ERROR: DANGER WILL ROBINSON: */
-         png_ptr->zstream.avail_out = (uInt)(PNG_ROWBYTES(png_ptr->pixel_depth,
-             png_ptr->iwidth) + 1);
+         /* With png_set_progressive_image and no transforms the row goes
+          * straight into the application's image, and only the filter byte
+          * goes into row_buf.
+          */
+         if (png_ptr->push_image_direct != 0 &&
+             png_ptr->row_number < png_ptr->num_rows)
+         {
+            if (png_ptr->push_image_row != 0)
+            {
+               /* TODO: WARNING: TRUNCATION ERROR: DANGER WILL ROBINSON: */
+               png_ptr->zstream.avail_out = (uInt)png_ptr->rowbytes;
+               png_ptr->zstream.next_out = png_ptr->push_image +
+                  png_ptr->row_number * png_ptr->push_image_stride;
+            }
+
+            else
+            {
+               png_ptr->zstream.avail_out = 1;
+               png_ptr->zstream.next_out = png_ptr->row_buf;
+            }
+         }
+
+         else
+         {
+            /* TODO: WARNING: TRUNCATION ERROR: DANGER WILL ROBINSON: */
+            png_ptr->zstream.avail_out = (uInt)(PNG_ROWBYTES(
+                png_ptr->pixel_depth, png_ptr->iwidth) + 1);
 
-         png_ptr->zstream.next_out = png_ptr->row_buf;
+            png_ptr->zstream.next_out = png_ptr->row_buf;
+         }
       }
 
+      next_out = png_ptr->zstream.next_out;
+
       /* Using Z_SYNC_FLUSH here means that an unterminated
        * LZ stream (a stream with a missing end code) can still
        * be handled, otherwise (Z_NO_FLUSH) a future zlib
@@ -775,7 +804,7 @@ png_process_IDAT_data(png_structrp png_ptr, png_bytep buffer,
       }
 
       /* Did inflate output any data? */
-      if (png_ptr->zstream.next_out != png_ptr->row_buf)
+      if (png_ptr->zstream.next_out != next_out)
       {
          /* Is this unexpected data after the last row?
           * If it is, artificially terminate the LZ output
@@ -797,7 +826,19 @@ png_process_IDAT_data(png_structrp png_ptr, png_bytep buffer,
 
          /* Do we have a complete row? */
          if (png_ptr->zstream.avail_out == 0)
-            png_push_process_row(png_ptr);
+         {
+            if (png_ptr->push_image_direct == 0)
+               png_push_process_row(png_ptr);
+
+            else if (png_ptr->push_image_row == 0)
+               png_ptr->push_image_row = 1; /* the row data is next */
+
+            else
+            {
+               png_ptr->push_image_row = 0;
+               png_push_process_image_row(png_ptr);
+            }
+         }
       }
 
       /* And check for the end of the stream. */
@@ -1042,6 +1083,43 @@ png_push_process_row(png_structrp png_ptr)
    }
 }
 
+/* As png_push_process_row for a row that is already in the application's image,
+ * from png_set_progressive_image.  There are no transforms or interlacing, so
+ * the row is unfiltered in place, using the row above it in the image.
+ */
+void /* PRIVATE */
+png_push_process_image_row(png_structrp png_ptr)
+{
+   png_row_info row_info;
+   png_bytep row = png_ptr->push_image +
+      png_ptr->row_number * png_ptr->push_image_stride;
+
+   row_info.width = png_ptr->iwidth;
+   row_info.color_type = png_ptr->color_type;
+   row_info.bit_depth = png_ptr->bit_depth;
+   row_info.channels = png_ptr->channels;
+   row_info.pixel_depth = png_ptr->pixel_depth;
+   row_info.rowbytes = png_ptr->rowbytes;
+
+   if (png_ptr->row_buf[0] > PNG_FILTER_VALUE_NONE)
+   {
+      /* prev_row is still all zero for the first row. */
+      png_const_bytep prev_row = png_ptr->row_number > 0 ?
+         row - png_ptr->push_image_stride : png_ptr->prev_row + 1;
+
+      if (png_ptr->row_buf[0] < PNG_FILTER_VALUE_LAST)
+         png_read_filter_row(png_ptr, &row_info, row, prev_row,
+            png_ptr->row_buf[0]);
+      else
+         png_error(png_ptr, "bad adaptive filter value");
+   }
+
+   png_ptr->transformed_pixel_depth = row_info.pixel_depth;
+
+   png_push_have_row(png_ptr, row);
+   png_read_push_finish_row(png_ptr);
+}
+
 void /* PRIVATE */
 png_read_push_finish_row(png_structrp png_ptr)
 {
@@ -1122,6 +1200,16 @@ png_push_have_end(png_structrp png_ptr, png_inforp info_ptr)
 void /* PRIVATE */
 png_push_have_row(png_structrp png_ptr, png_bytep row)
 {
+   /* With png_set_progressive_image a row still in row_buf is combined into
+    * the application's image, and the callback gets the row there.
+    */
+   if (png_ptr->push_image != NULL && row == png_ptr->row_buf + 1)
+   {
+      row = png_ptr->push_image +
+         png_ptr->row_number * png_ptr->push_image_stride;
+      png_combine_row(png_ptr, row, 1/*blocky display*/);
+   }
+
    if (png_ptr->row_fn != NULL)
       (*(png_ptr->row_fn))(png_ptr, row, png_ptr->row_number,
          (int)png_ptr->pass);
@@ -1136,12 +1224,79 @@ png_progressive_combine_row(png_const_structrp png_ptr, png_bytep old_row,
 
    /* new_row is a flag here - if it is NULL then the app callback was called
     * from an empty row (see the calls to png_struct::row_fn below), otherwise
-    * it must be png_ptr->row_buf+1
+    * it must be png_ptr->row_buf+1, or, with png_set_progressive_image, the row
+    * in the application's image, which is complete already.
     */
-   if (new_row != NULL)
+   if (new_row != NULL && new_row != old_row)
       png_combine_row(png_ptr, old_row, 1/*blocky display*/);
 }
 
+void PNGAPI
+png_set_progressive_image(png_structrp png_ptr, png_bytep image,
+    png_size_t row_stride)
+{
+   png_debug(1, "in png_set_progressive_image");
+
+   if (png_ptr == NULL)
+      return;
+
+   /* Once image data has been inflated into row_buf it is too late to change
+    * where the rows go.
+    */
+   if (png_ptr->row_number != 0 || png_ptr->pass != 0 ||
+       ((png_ptr->flags & PNG_FLAG_ROW_INIT) != 0 &&
+        png_ptr->zstream.avail_out != 0))
+   {
+      png_app_error(png_ptr,
+         "png_set_progressive_image called after image data was read");
+      return;
+   }
+
+   png_ptr->push_image = NULL;
+   png_ptr->push_image_direct = 0;
+
+   if (image == NULL)
+      return;
+
+   /* The transforms, and so the size of the rows, are fixed by
+    * png_start_read_image or png_read_update_info.
+    */
+   if ((png_ptr->flags & PNG_FLAG_ROW_INIT) == 0)
+   {
+      png_app_error(png_ptr,
+         "png_set_progressive_image called before png_start_read_image");
+      return;
+   }
+
+   /* Rows of the separate passes are not rows of the image. */
+   if (png_ptr->interlaced != 0 &&
+       (png_ptr->transformations & PNG_INTERLACE) == 0)
+   {
+      png_app_error(png_ptr,
+         "png_set_progressive_image requires png_set_interlace_handling");
+      return;
+   }
+
+   if (row_stride < (png_ptr->transformations == 0 ? png_ptr->rowbytes :
+       png_ptr->info_rowbytes))
+   {
+      png_app_error(png_ptr, "png_set_progressive_image: row_stride too small");
+      return;
+   }
+
+   png_ptr->push_image = image;
+   png_ptr->push_image_stride = row_stride;
+
+   /* Without transforms or interlacing the rows of the image are the rows in
+    * the IDAT data, so inflate them into the image and unfilter them there.
+    * This saves two copies of every row: to prev_row, which is the row above in
+    * the image, and into the image.
+    */
+   png_ptr->push_image_direct = png_ptr->interlaced == 0 &&
+      png_ptr->transformations == 0;
+   png_ptr->push_image_row = 0;
+}
+
 void PNGAPI
 png_set_progressive_read_fn(png_structrp png_ptr, png_voidp progressive_ptr,
     png_progressive_info_ptr info_fn, png_progressive_row_ptr row_fn,
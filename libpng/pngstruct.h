@@ -282,6 +282,12 @@ struct png_struct_def
    png_uint_32 flush_rows;    /* number of rows written since last flush */
 #endif
 
+#ifdef PNG_WRITE_THREADS_SUPPORTED
+   int write_threads;         /* threads for IDAT compression, 0 - serial */
+   png_uint_32 write_band_rows; /* rows per band, 0 - default */
+   struct png_write_par_s *write_par; /* parallel state, see pngwutil.c */
+#endif
+
 #ifdef PNG_READ_GAMMA_SUPPORTED
    int gamma_shift;      /* number of "insignificant" bits in 16-bit gamma */
    png_fixed_point screen_gamma; /* screen gamma value (display_exponent) */
@@ -330,6 +336,10 @@ struct png_struct_def
    png_size_t current_buffer_size;   /* amount of data now in current_buffer */
    int process_mode;                 /* what push library is currently doing */
    int cur_palette;                  /* current push library palette index */
+   png_bytep push_image;             /* png_set_progressive_image rows */
+   png_size_t push_image_stride;     /* bytes from one row to the next */
+   int push_image_direct;            /* rows are inflated into push_image */
+   int push_image_row;               /* set when the filter byte is read */
 
 #endif /* PROGRESSIVE_READ */
 
@@ -359,7 +369,7 @@ struct png_struct_def
 
    /* Options */
 #ifdef PNG_SET_OPTION_SUPPORTED
-   png_byte options;           /* On/off state (up to 4 options) */
+   png_uint_32 options;        /* On/off state (up to 16 options) */
 #endif
 
 #if PNG_LIBPNG_VER < 10700
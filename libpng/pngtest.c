@@ -123,6 +123,9 @@ static char tIME_string[PNG_tIME_STRING_LENGTH] = "tIME chunk is not present";
 static int verbose = 0;
 static int strict = 0;
 static int relaxed = 0;
+#ifdef PNG_WRITE_THREADS_SUPPORTED
+static int write_threads = 0; /* --threads: see png_set_write_threads */
+#endif
 static int unsupported_chunks = 0; /* chunk unsupported by libpng in input */
 static int error_count = 0; /* count calls to png_error */
 static int warning_count = 0; /* count calls to png_warning */
@@ -825,6 +828,55 @@ pngtest_check_text_support(png_const_structp png_ptr, png_textp text_ptr,
 #endif
 /* END of code to check that libpng has the required text support */
 
+#if defined(PNG_WRITE_THREADS_SUPPORTED) &&\
+   defined(PNG_SIMPLIFIED_READ_SUPPORTED) && defined(PNG_STDIO_SUPPORTED)
+/* With --threads the IDAT data is compressed in bands, so the output file is
+ * not the same as the input; instead check that the decoded images match.
+ */
+static int
+compare_images(PNG_CONST char *inname, PNG_CONST char *outname)
+{
+   png_image image[2];
+   png_bytep buffer[2] = { NULL, NULL };
+   PNG_CONST char *name[2];
+   int i, result = 1;
+
+   name[0] = inname;
+   name[1] = outname;
+   memset(image, 0, sizeof image);
+
+   for (i = 0; i < 2; ++i)
+   {
+      image[i].version = PNG_IMAGE_VERSION;
+
+      if (png_image_begin_read_from_file(&image[i], name[i]) == 0)
+         break;
+
+      /* Both in the input's format, without a color-map */
+      image[i].format = image[0].format & ~PNG_FORMAT_FLAG_COLORMAP;
+      buffer[i] = (png_bytep)malloc(PNG_IMAGE_SIZE(image[i]));
+
+      if (buffer[i] == NULL ||
+          png_image_finish_read(&image[i], NULL, buffer[i], 0, NULL) == 0)
+         break;
+   }
+
+   if (i == 2 && PNG_IMAGE_SIZE(image[0]) == PNG_IMAGE_SIZE(image[1]) &&
+       memcmp(buffer[0], buffer[1], PNG_IMAGE_SIZE(image[0])) == 0)
+      result = 0;
+
+   else
+      fprintf(STDERR, "\n  %s: decoded image differs from %s %s\n", outname,
+         inname, i < 2 ? image[i].message : "");
+
+   png_image_free(&image[0]);
+   png_image_free(&image[1]);
+   free(buffer[0]);
+   free(buffer[1]);
+   return result;
+}
+#endif
+
 /* Test one file */
 static int
 test_one_file(PNG_CONST char *inname, PNG_CONST char *outname)
@@ -889,6 +941,10 @@ test_one_file(PNG_CONST char *inname, PNG_CONST char *outname)
 #endif
    png_set_error_fn(write_ptr, &error_parameters, pngtest_error,
       pngtest_warning);
+#ifdef PNG_WRITE_THREADS_SUPPORTED
+   /* Small bands, so that even the small test images have several */
+   png_set_write_threads(write_ptr, write_threads, 4);
+#endif
 #endif
    pngtest_debug("Allocating read_info, write_info and end_info structures");
    read_info_ptr = png_create_info_struct(read_ptr);
@@ -1767,6 +1823,15 @@ main(int argc, char *argv[])
          relaxed = 0;
       }
 
+#ifdef PNG_WRITE_THREADS_SUPPORTED
+      else if (strcmp(argv[1], "--threads") == 0)
+      {
+         multiple = 1;
+         status_dots_requested = 0;
+         write_threads = 4;
+      }
+#endif
+
       else if (strcmp(argv[1], "--relaxed") == 0)
       {
          status_dots_requested = 0;
@@ -1813,6 +1878,11 @@ main(int argc, char *argv[])
          fprintf(STDERR, "\n");
 #endif
          kerror = test_one_file(argv[i], outname);
+#if defined(PNG_WRITE_THREADS_SUPPORTED) &&\
+   defined(PNG_SIMPLIFIED_READ_SUPPORTED) && defined(PNG_STDIO_SUPPORTED)
+         if (kerror == 0 && write_threads > 0)
+            kerror = compare_images(argv[i], outname);
+#endif
          if (kerror == 0)
          {
 #ifdef PNG_READ_USER_TRANSFORM_SUPPORTED
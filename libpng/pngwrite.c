@@ -917,6 +917,24 @@ png_write_flush(png_structrp png_ptr)
 }
 #endif /* WRITE_FLUSH */
 
+#ifdef PNG_WRITE_THREADS_SUPPORTED
+/* Set the number of threads used to filter and compress the image data, and
+ * the number of rows each thread works on at a time, or 0 for the default.
+ */
+void PNGAPI
+png_set_write_threads(png_structrp png_ptr, int threads,
+    png_uint_32 band_rows)
+{
+   png_debug(1, "in png_set_write_threads");
+
+   if (png_ptr == NULL)
+      return;
+
+   png_ptr->write_threads = (threads < 0 ? 0 : threads);
+   png_ptr->write_band_rows = band_rows;
+}
+#endif /* WRITE_THREADS */
+
 #ifdef PNG_WRITE_WEIGHTED_FILTER_SUPPORTED
 static void png_reset_filter_heuristics(png_structrp png_ptr);/* forward decl */
 #endif
@@ -927,6 +945,11 @@ png_write_destroy(png_structrp png_ptr)
 {
    png_debug(1, "in png_write_destroy");
 
+#ifdef PNG_WRITE_THREADS_SUPPORTED
+   /* Stops the threads if the write was abandoned */
+   png_write_par_free(png_ptr);
+#endif
+
    /* Free any memory zlib uses */
    if ((png_ptr->flags & PNG_FLAG_ZSTREAM_INITIALIZED) != 0)
       deflateEnd(&png_ptr->zstream);
@@ -987,6 +987,12 @@ png_write_PLTE(png_structrp png_ptr, png_const_colorp palette,
    png_ptr->mode |= PNG_HAVE_PLTE;
 }
 
+#ifdef PNG_WRITE_THREADS_SUPPORTED
+static void png_write_par_start(png_structrp png_ptr);
+static void png_write_par_flush(png_structrp png_ptr, int flush);
+static void png_write_par_row(png_structrp png_ptr, png_row_infop row_info);
+#endif
+
 /* This is similar to png_text_compress, above, except that it does not require
  * all of the data at once and, instead of buffering the compressed result,
  * writes it as IDAT chunks.  Unlike png_text_compress it *can* png_error out
@@ -1008,6 +1014,15 @@ void /* PRIVATE */
 png_compress_IDAT(png_structrp png_ptr, png_const_bytep input,
    png_alloc_size_t input_len, int flush)
 {
+#ifdef PNG_WRITE_THREADS_SUPPORTED
+   if (png_ptr->write_par != NULL)
+   {
+      /* Rows go to png_write_par_row, so only flushes get here. */
+      png_write_par_flush(png_ptr, flush);
+      return;
+   }
+#endif
+
    if (png_ptr->zowner != png_IDAT)
    {
       /* First time.   Ensure we have a temporary buffer for compression and
@@ -2043,6 +2058,10 @@ png_write_start_row(png_structrp png_ptr)
       png_ptr->num_rows = png_ptr->height;
       png_ptr->usr_width = png_ptr->width;
    }
+
+#ifdef PNG_WRITE_THREADS_SUPPORTED
+   png_write_par_start(png_ptr);
+#endif
 }
 
 /* Internal use only.  Called when finished processing a row of data. */
@@ -2322,11 +2341,32 @@ png_write_filtered_row(png_structrp png_ptr, png_bytep filtered_row,
 #define PNG_HISHIFT 10
 #define PNG_LOMASK ((png_uint_32)0xffffL)
 #define PNG_HIMASK ((png_uint_32)(~PNG_LOMASK >> PNG_HISHIFT))
-void /* PRIVATE */
-png_write_find_filter(png_structrp png_ptr, png_row_infop row_info)
+#ifdef PNG_WRITE_FILTER_SUPPORTED
+/* The rows png_find_filter works on.  Each has room for the filter byte at
+ * [0]; prev_row is the unfiltered row above, zero for the first row, and the
+ * four filter rows receive the output of each filter, as allocated in
+ * png_write_start_row.
+ */
+typedef struct
+{
+   png_bytep row_buf;
+   png_bytep prev_row;
+   png_bytep sub_row;
+   png_bytep up_row;
+   png_bytep avg_row;
+   png_bytep paeth_row;
+} png_filter_rows;
+
+/* Chooses the filter for the row in rows->row_buf, the row with number
+ * row_number in the current pass, and returns the filtered row, which is one of
+ * the rows in 'rows'.  This does not change png_ptr, so with separate row
+ * buffers it can run for several rows at once.
+ */
+static png_bytep
+png_find_filter(png_const_structrp png_ptr, png_row_infop row_info,
+   png_uint_32 row_number, const png_filter_rows *rows)
 {
    png_bytep best_row;
-#ifdef PNG_WRITE_FILTER_SUPPORTED
    png_bytep prev_row, row_buf;
    png_uint_32 mins, bpp;
    png_byte filter_to_do = png_ptr->do_filter;
@@ -2335,23 +2375,21 @@ png_write_find_filter(png_structrp png_ptr, png_row_infop row_info)
    int num_p_filters = png_ptr->num_prev_filters;
 #endif
 
-   png_debug(1, "in png_write_find_filter");
-
 #ifndef PNG_WRITE_WEIGHTED_FILTER_SUPPORTED
-  if (png_ptr->row_number == 0 && filter_to_do == PNG_ALL_FILTERS)
+  if (row_number == 0 && filter_to_do == PNG_ALL_FILTERS)
   {
      /* These will never be selected so we need not test them. */
      filter_to_do &= ~(PNG_FILTER_UP | PNG_FILTER_PAETH);
   }
+#else
+   PNG_UNUSED(row_number)
 #endif
 
    /* Find out how many bytes offset each pixel is */
    bpp = (row_info->pixel_depth + 7) >> 3;
 
-   prev_row = png_ptr->prev_row;
-#endif
-   best_row = png_ptr->row_buf;
-#ifdef PNG_WRITE_FILTER_SUPPORTED
+   prev_row = rows->prev_row;
+   best_row = rows->row_buf;
    row_buf = best_row;
    mins = PNG_MAXSUM;
 
@@ -2444,7 +2482,7 @@ png_write_find_filter(png_structrp png_ptr, png_row_infop row_info)
       png_bytep rp, lp, dp;
       png_size_t i;
 
-      for (i = 0, rp = row_buf + 1, dp = png_ptr->sub_row + 1; i < bpp;
+      for (i = 0, rp = row_buf + 1, dp = rows->sub_row + 1; i < bpp;
            i++, rp++, dp++)
       {
          *dp = *rp;
@@ -2456,7 +2494,7 @@ png_write_find_filter(png_structrp png_ptr, png_row_infop row_info)
          *dp = (png_byte)(((int)*rp - (int)*lp) & 0xff);
       }
 
-      best_row = png_ptr->sub_row;
+      best_row = rows->sub_row;
    }
 
    else if ((filter_to_do & PNG_FILTER_SUB) != 0)
@@ -2504,7 +2542,7 @@ png_write_find_filter(png_structrp png_ptr, png_row_infop row_info)
       }
 #endif
 
-      for (i = 0, rp = row_buf + 1, dp = png_ptr->sub_row + 1; i < bpp;
+      for (i = 0, rp = row_buf + 1, dp = rows->sub_row + 1; i < bpp;
            i++, rp++, dp++)
       {
          v = *dp = *rp;
@@ -2560,7 +2598,7 @@ png_write_find_filter(png_structrp png_ptr, png_row_infop row_info)
       if (sum < mins)
       {
          mins = sum;
-         best_row = png_ptr->sub_row;
+         best_row = rows->sub_row;
       }
    }
 
@@ -2570,14 +2608,14 @@ png_write_find_filter(png_structrp png_ptr, png_row_infop row_info)
       png_bytep rp, dp, pp;
       png_size_t i;
 
-      for (i = 0, rp = row_buf + 1, dp = png_ptr->up_row + 1,
+      for (i = 0, rp = row_buf + 1, dp = rows->up_row + 1,
           pp = prev_row + 1; i < row_bytes;
           i++, rp++, pp++, dp++)
       {
          *dp = (png_byte)(((int)*rp - (int)*pp) & 0xff);
       }
 
-      best_row = png_ptr->up_row;
+      best_row = rows->up_row;
    }
 
    else if ((filter_to_do & PNG_FILTER_UP) != 0)
@@ -2622,7 +2660,7 @@ png_write_find_filter(png_structrp png_ptr, png_row_infop row_info)
       }
 #endif
 
-      for (i = 0, rp = row_buf + 1, dp = png_ptr->up_row + 1,
+      for (i = 0, rp = row_buf + 1, dp = rows->up_row + 1,
           pp = prev_row + 1; i < row_bytes; i++)
       {
          v = *dp++ = (png_byte)(((int)*rp++ - (int)*pp++) & 0xff);
@@ -2670,7 +2708,7 @@ png_write_find_filter(png_structrp png_ptr, png_row_infop row_info)
       if (sum < mins)
       {
          mins = sum;
-         best_row = png_ptr->up_row;
+         best_row = rows->up_row;
       }
    }
 
@@ -2680,7 +2718,7 @@ png_write_find_filter(png_structrp png_ptr, png_row_infop row_info)
       png_bytep rp, dp, pp, lp;
       png_uint_32 i;
 
-      for (i = 0, rp = row_buf + 1, dp = png_ptr->avg_row + 1,
+      for (i = 0, rp = row_buf + 1, dp = rows->avg_row + 1,
            pp = prev_row + 1; i < bpp; i++)
       {
          *dp++ = (png_byte)(((int)*rp++ - ((int)*pp++ / 2)) & 0xff);
@@ -2691,7 +2729,7 @@ png_write_find_filter(png_structrp png_ptr, png_row_infop row_info)
          *dp++ = (png_byte)(((int)*rp++ - (((int)*pp++ + (int)*lp++) / 2))
                  & 0xff);
       }
-      best_row = png_ptr->avg_row;
+      best_row = rows->avg_row;
    }
 
    else if ((filter_to_do & PNG_FILTER_AVG) != 0)
@@ -2735,7 +2773,7 @@ png_write_find_filter(png_structrp png_ptr, png_row_infop row_info)
       }
 #endif
 
-      for (i = 0, rp = row_buf + 1, dp = png_ptr->avg_row + 1,
+      for (i = 0, rp = row_buf + 1, dp = rows->avg_row + 1,
            pp = prev_row + 1; i < bpp; i++)
       {
          v = *dp++ = (png_byte)(((int)*rp++ - ((int)*pp++ / 2)) & 0xff);
@@ -2791,7 +2829,7 @@ png_write_find_filter(png_structrp png_ptr, png_row_infop row_info)
       if (sum < mins)
       {
          mins = sum;
-         best_row = png_ptr->avg_row;
+         best_row = rows->avg_row;
       }
    }
 
@@ -2801,7 +2839,7 @@ png_write_find_filter(png_structrp png_ptr, png_row_infop row_info)
       png_bytep rp, dp, pp, cp, lp;
       png_size_t i;
 
-      for (i = 0, rp = row_buf + 1, dp = png_ptr->paeth_row + 1,
+      for (i = 0, rp = row_buf + 1, dp = rows->paeth_row + 1,
           pp = prev_row + 1; i < bpp; i++)
       {
          *dp++ = (png_byte)(((int)*rp++ - (int)*pp++) & 0xff);
@@ -2832,7 +2870,7 @@ png_write_find_filter(png_structrp png_ptr, png_row_infop row_info)
 
          *dp++ = (png_byte)(((int)*rp++ - p) & 0xff);
       }
-      best_row = png_ptr->paeth_row;
+      best_row = rows->paeth_row;
    }
 
    else if ((filter_to_do & PNG_FILTER_PAETH) != 0)
@@ -2876,7 +2914,7 @@ png_write_find_filter(png_structrp png_ptr, png_row_infop row_info)
       }
 #endif
 
-      for (i = 0, rp = row_buf + 1, dp = png_ptr->paeth_row + 1,
+      for (i = 0, rp = row_buf + 1, dp = rows->paeth_row + 1,
           pp = prev_row + 1; i < bpp; i++)
       {
          v = *dp++ = (png_byte)(((int)*rp++ - (int)*pp++) & 0xff);
@@ -2965,11 +3003,752 @@ png_write_find_filter(png_structrp png_ptr, png_row_infop row_info)
 
       if (sum < mins)
       {
-         best_row = png_ptr->paeth_row;
+         best_row = rows->paeth_row;
       }
    }
+
+   return best_row;
+}
 #endif /* WRITE_FILTER */
 
+#ifdef PNG_WRITE_THREADS_SUPPORTED
+/* Parallel IDAT compression, turned on by png_set_write_threads.  The image is
+ * split into bands of rows.  A worker thread filters each band, choosing the
+ * filter for each row exactly as png_write_find_filter does, then deflates it
+ * as a raw deflate stream that ends with a Z_SYNC_FLUSH, or a Z_FINISH for the
+ * last band.  The end of the band above is the dictionary, so little
+ * compression is lost at the band boundaries.  The calling thread writes the
+ * bands in order between a zlib header and an Adler-32 trailer put together
+ * with adler32_combine(), so the IDAT chunks hold one ordinary zlib stream.
+ */
+#ifdef _WIN32
+#  include <windows.h>
+   typedef CRITICAL_SECTION png_lock;
+   typedef CONDITION_VARIABLE png_cond;
+   typedef HANDLE png_thread;
+#  define png_lock_init(l) InitializeCriticalSection(l)
+#  define png_lock_free(l) DeleteCriticalSection(l)
+#  define png_lock_get(l) EnterCriticalSection(l)
+#  define png_lock_put(l) LeaveCriticalSection(l)
+#  define png_cond_init(c) InitializeConditionVariable(c)
+#  define png_cond_free(c)
+#  define png_cond_wait(c, l) SleepConditionVariableCS(c, l, INFINITE)
+#  define png_cond_wake_all(c) WakeAllConditionVariable(c)
+#else
+#  include <pthread.h>
+   typedef pthread_mutex_t png_lock;
+   typedef pthread_cond_t png_cond;
+   typedef pthread_t png_thread;
+#  define png_lock_init(l) pthread_mutex_init(l, NULL)
+#  define png_lock_free(l) pthread_mutex_destroy(l)
+#  define png_lock_get(l) pthread_mutex_lock(l)
+#  define png_lock_put(l) pthread_mutex_unlock(l)
+#  define png_cond_init(c) pthread_cond_init(c, NULL)
+#  define png_cond_free(c) pthread_cond_destroy(c)
+#  define png_cond_wait(c, l) pthread_cond_wait(c, l)
+#  define png_cond_wake_all(c) pthread_cond_broadcast(c)
+#endif
+
+#define PNG_WRITE_BAND_SIZE 262144 /* default band size in bytes */
+#define PNG_WRITE_DICT 32768       /* dictionary size, the deflate window */
+
+/* One band of rows and its compressed data */
+typedef struct png_write_job_s
+{
+   struct png_write_job_s *next;  /* next in the work queue or free list */
+   struct png_write_job_s *order; /* next to write */
+   struct png_write_job_s *prev;  /* band above, for the dictionary, or NULL */
+   png_bytep in;                  /* the row above, then the band's rows */
+   png_bytep filtered;            /* the filtered rows */
+#ifdef PNG_WRITE_FILTER_SUPPORTED
+   png_bytep filter_rows;         /* sub, up, avg and paeth rows */
+#endif
+   png_bytep out;                 /* compressed data */
+   png_alloc_size_t size;         /* allocated size of out */
+   png_alloc_size_t have;         /* length of the compressed data */
+   png_uint_32 row_number;        /* number of the first row */
+   png_uint_32 rows;              /* number of rows in the band */
+   int flush;                     /* Z_SYNC_FLUSH, or Z_FINISH for the last */
+   uLong adler;                   /* adler32() of the filtered rows */
+   int filtered_done;             /* set when 'filtered' is complete */
+   int done;                      /* 1 when compressed, -1 on a zlib error */
+} png_write_job;
+
+typedef struct
+{
+   struct png_write_par_s *par;
+   z_stream zstream;              /* reused from band to band */
+   png_thread tid;
+} png_write_worker;
+
+struct png_write_par_s
+{
+      /* shared with the worker threads */
+   png_lock lock;                 /* protects the queue, stop and job flags */
+   png_cond work;                 /* signals a queued job or stop */
+   png_cond done;                 /* signals a filtered or compressed job */
+   png_write_job *head;           /* work queue */
+   png_write_job *tail;
+   int stop;                      /* set to make the workers exit */
+   png_const_structrp png_ptr;    /* only read, by png_find_filter */
+   png_row_info row_info;         /* the same for every row */
+   png_size_t stride;             /* row bytes including the filter byte */
+      /* only used by the calling thread */
+   int ready;                     /* set when lock, work and done exist */
+   int zstreams;                  /* number of worker zstreams initialized */
+   int threads;                   /* number of worker threads started */
+   png_write_worker *workers;
+   png_uint_32 band_rows;
+   png_bytep above;               /* last row queued, unfiltered */
+   png_write_job *first;          /* jobs not written yet, in order */
+   png_write_job *last;
+   int pending;                   /* number of jobs from first to last */
+   png_write_job *written;        /* last written, kept for the dictionary */
+   png_write_job *cur;            /* job being filled, or NULL */
+   png_write_job *free;           /* jobs to reuse */
+   int started;                   /* set when the zlib header is written */
+   uLong adler;                   /* adler32() of the zlib stream so far */
+   uInt avail;                    /* space left in the IDAT buffer */
+   int window_bits;
+   int level;
+   int strategy;
+};
+
+/* Filter every row of a band, on a worker thread. */
+static void
+png_write_par_filter(struct png_write_par_s *par, png_write_job *job)
+{
+   png_size_t stride = par->stride;
+   png_bytep row = job->in + stride;
+   png_bytep out = job->filtered;
+   png_uint_32 i;
+
+   for (i = 0; i < job->rows; i++, row += stride, out += stride)
+   {
+#ifdef PNG_WRITE_FILTER_SUPPORTED
+      png_filter_rows rows;
+
+      rows.row_buf = row;
+      rows.prev_row = row - stride;
+      rows.sub_row = job->filter_rows;
+      rows.up_row = rows.sub_row + stride;
+      rows.avg_row = rows.up_row + stride;
+      rows.paeth_row = rows.avg_row + stride;
+
+      memcpy(out, png_find_filter(par->png_ptr, &par->row_info,
+         job->row_number + i, &rows), stride);
+#else
+      memcpy(out, row, stride);
+#endif
+   }
+}
+
+/* Deflate a filtered band, on a worker thread.  Returns 1 on success, -1 on a
+ * zlib error.
+ */
+static int
+png_write_par_deflate(struct png_write_par_s *par, z_streamp zs,
+   png_write_job *job)
+{
+   uInt len = (uInt)(job->rows * par->stride);
+   int ret;
+
+   if (deflateReset(zs) != Z_OK)
+      return -1;
+
+   if (job->prev != NULL)
+   {
+      uInt dict = (uInt)(job->prev->rows * par->stride);
+      png_bytep end = job->prev->filtered + dict;
+
+      if (dict > PNG_WRITE_DICT)
+         dict = PNG_WRITE_DICT;
+
+      if (deflateSetDictionary(zs, end - dict, dict) != Z_OK)
+         return -1;
+   }
+
+   zs->next_in = job->filtered;
+   zs->avail_in = len;
+   zs->next_out = job->out;
+   zs->avail_out = (uInt)job->size;
+
+   ret = deflate(zs, job->flush);
+
+   /* The output buffer is large enough for all of the output, so anything
+    * left over is an error.
+    */
+   if (ret != (job->flush == Z_FINISH ? Z_STREAM_END : Z_OK) ||
+       zs->avail_in != 0 || zs->avail_out == 0)
+      return -1;
+
+   job->have = job->size - zs->avail_out;
+   job->adler = adler32(adler32(0, NULL, 0), job->filtered, len);
+   return 1;
+}
+
+/* Worker thread: filter and compress queued bands until told to stop. */
+static void
+png_write_worker_run(png_write_worker *worker)
+{
+   struct png_write_par_s *par = worker->par;
+
+   for (;;)
+   {
+      png_write_job *job;
+      int done;
+
+      png_lock_get(&par->lock);
+      while (par->head == NULL && par->stop == 0)
+         png_cond_wait(&par->work, &par->lock);
+
+      job = par->head;
+      if (job == NULL)
+      {
+         png_lock_put(&par->lock);
+         break;
+      }
+
+      par->head = job->next;
+      if (par->head == NULL)
+         par->tail = NULL;
+      png_lock_put(&par->lock);
+
+      png_write_par_filter(par, job);
+
+      /* Bands are taken in order, so the band above is already being filtered
+       * and this wait is short.
+       */
+      png_lock_get(&par->lock);
+      job->filtered_done = 1;
+      png_cond_wake_all(&par->done);
+      while (job->prev != NULL && job->prev->filtered_done == 0)
+         png_cond_wait(&par->done, &par->lock);
+      png_lock_put(&par->lock);
+
+      done = png_write_par_deflate(par, &worker->zstream, job);
+
+      png_lock_get(&par->lock);
+      job->done = done;
+      png_cond_wake_all(&par->done);
+      png_lock_put(&par->lock);
+   }
+}
+
+#ifdef _WIN32
+static DWORD WINAPI
+png_write_worker_main(LPVOID worker)
+{
+   png_write_worker_run((png_write_worker *)worker);
+   return 0;
+}
+#else
+static void *
+png_write_worker_main(void *worker)
+{
+   png_write_worker_run((png_write_worker *)worker);
+   return NULL;
+}
+#endif
+
+#ifdef PNG_WRITE_FILTER_SUPPORTED
+#  define png_write_par_free_filter_rows(png_ptr, job) \
+      png_free(png_ptr, job->filter_rows)
+#else
+#  define png_write_par_free_filter_rows(png_ptr, job)
+#endif
+
+/* Free a list of jobs linked through 'link'. */
+#define png_write_par_free_jobs(png_ptr, list, link) \
+   while (list != NULL) \
+   { \
+      png_write_job *next_job = list->link; \
+      png_free(png_ptr, list->in); \
+      png_free(png_ptr, list->filtered); \
+      png_write_par_free_filter_rows(png_ptr, list); \
+      png_free(png_ptr, list->out); \
+      png_free(png_ptr, list); \
+      list = next_job; \
+   }
+
+/* Stop the worker threads and free the parallel state.  This is also called
+ * from png_write_destroy after an error, with jobs in any state.
+ */
+void /* PRIVATE */
+png_write_par_free(png_structrp png_ptr)
+{
+   struct png_write_par_s *par = png_ptr->write_par;
+   int n;
+
+   if (par == NULL)
+      return;
+
+   if (par->ready != 0)
+   {
+      png_lock_get(&par->lock);
+      par->stop = 1;
+      png_cond_wake_all(&par->work);
+      png_lock_put(&par->lock);
+   }
+
+   /* The workers finish the jobs already queued before they exit. */
+   for (n = 0; n < par->threads; n++)
+   {
+#ifdef _WIN32
+      WaitForSingleObject(par->workers[n].tid, INFINITE);
+      CloseHandle(par->workers[n].tid);
+#else
+      pthread_join(par->workers[n].tid, NULL);
+#endif
+   }
+
+   for (n = 0; n < par->zstreams; n++)
+      deflateEnd(&par->workers[n].zstream);
+
+   if (par->ready != 0)
+   {
+      png_cond_free(&par->done);
+      png_cond_free(&par->work);
+      png_lock_free(&par->lock);
+   }
+
+   png_write_par_free_jobs(png_ptr, par->cur, next)
+   png_write_par_free_jobs(png_ptr, par->first, order)
+   png_write_par_free_jobs(png_ptr, par->written, next)
+   png_write_par_free_jobs(png_ptr, par->free, next)
+
+   png_free(png_ptr, par->above);
+   png_free(png_ptr, par->workers);
+   png_free(png_ptr, par);
+   png_ptr->write_par = NULL;
+}
+
+/* Start parallel compression if it was asked for and can be used with this
+ * image, otherwise leave png_ptr->write_par NULL so that the rows are written
+ * the ordinary way.
+ */
+static void
+png_write_par_start(png_structrp png_ptr)
+{
+   struct png_write_par_s *par;
+   png_size_t stride = png_ptr->rowbytes + 1;
+   png_uint_32 band_rows = png_ptr->write_band_rows;
+   int threads = png_ptr->write_threads;
+   int n;
+
+   /* Bands are cut from whole rows of one pass, the weighted filter heuristic
+    * depends on the filters chosen for the rows above, and flushing needs
+    * every row written as it arrives; all of these are left to the serial
+    * code.
+    */
+   if (threads < 2 || png_ptr->interlaced != 0 || png_ptr->zowner != 0)
+      return;
+
+#ifdef PNG_WRITE_WEIGHTED_FILTER_SUPPORTED
+   if (png_ptr->heuristic_method == PNG_FILTER_HEURISTIC_WEIGHTED)
+      return;
+#endif
+
+#ifdef PNG_WRITE_FLUSH_SUPPORTED
+   if (png_ptr->flush_dist > 0)
+      return;
+#endif
+
+   if (band_rows == 0)
+      band_rows = (png_uint_32)(PNG_WRITE_BAND_SIZE / stride);
+
+   /* Keep each band, and its compressed data, within one zlib call. */
+   if (band_rows > (ZLIB_IO_MAX >> 1) / stride)
+      band_rows = (png_uint_32)((ZLIB_IO_MAX >> 1) / stride);
+
+   if (band_rows == 0)
+      band_rows = 1;
+
+   /* A single band gains nothing. */
+   if (png_ptr->num_rows <= band_rows || stride > (ZLIB_IO_MAX >> 1))
+      return;
+
+   par = png_voidcast(struct png_write_par_s *,
+      png_calloc(png_ptr, sizeof *par));
+   png_ptr->write_par = par;
+
+   par->png_ptr = png_ptr;
+   par->stride = stride;
+   par->band_rows = band_rows;
+   par->workers = png_voidcast(png_write_worker *,
+      png_calloc(png_ptr, threads * sizeof *par->workers));
+   par->above = png_voidcast(png_bytep, png_calloc(png_ptr, stride));
+
+   png_lock_init(&par->lock);
+   png_cond_init(&par->work);
+   png_cond_init(&par->done);
+   par->ready = 1;
+
+   /* The same parameters as png_deflate_claim, except that windowBits is not
+    * reduced for small images because the bands are compressed separately.
+    */
+   par->level = png_ptr->zlib_level;
+   par->window_bits = png_ptr->zlib_window_bits;
+
+   if ((png_ptr->flags & PNG_FLAG_ZLIB_CUSTOM_STRATEGY) != 0)
+      par->strategy = png_ptr->zlib_strategy;
+
+   else if (png_ptr->do_filter != PNG_FILTER_NONE)
+      par->strategy = PNG_Z_DEFAULT_STRATEGY;
+
+   else
+      par->strategy = PNG_Z_DEFAULT_NOFILTER_STRATEGY;
+
+   /* zlib does not support an 8 bit window for deflate, it uses 9. */
+   if (par->window_bits == 8)
+      par->window_bits = 9;
+
+   /* The zstreams are set up here so that all of the allocation happens on
+    * this thread, with the application's memory functions.
+    */
+   for (n = 0; n < threads; n++)
+   {
+      z_streamp zs = &par->workers[n].zstream;
+
+      zs->zalloc = png_zalloc;
+      zs->zfree = png_zfree;
+      zs->opaque = png_ptr;
+
+      if (deflateInit2(zs, par->level, png_ptr->zlib_method,
+          -par->window_bits, png_ptr->zlib_mem_level, par->strategy) != Z_OK)
+         break;
+
+      par->zstreams++;
+   }
+
+   for (n = 0; n < par->zstreams; n++)
+   {
+      png_write_worker *worker = par->workers + n;
+
+      worker->par = par;
+#ifdef _WIN32
+      worker->tid = CreateThread(NULL, 0, png_write_worker_main, worker, 0,
+         NULL);
+      if (worker->tid == NULL)
+         break;
+#else
+      if (pthread_create(&worker->tid, NULL, png_write_worker_main,
+          worker) != 0)
+         break;
+#endif
+
+      par->threads++;
+   }
+
+   if (par->threads < 2)
+   {
+      png_write_par_free(png_ptr);
+      png_warning(png_ptr, "cannot start threads, writing serially");
+      return;
+   }
+
+   /* As png_compress_IDAT, get a buffer for the IDAT data. */
+   if (png_ptr->zbuffer_list == NULL)
+   {
+      png_ptr->zbuffer_list = png_voidcast(png_compression_bufferp,
+         png_malloc(png_ptr, PNG_COMPRESSION_BUFFER_SIZE(png_ptr)));
+      png_ptr->zbuffer_list->next = NULL;
+   }
+
+   else
+      png_free_buffer_list(png_ptr, &png_ptr->zbuffer_list->next);
+
+   par->avail = png_ptr->zbuffer_size;
+}
+
+/* Write the IDAT buffer, which holds 'size' bytes, as an IDAT chunk. */
+static void
+png_write_par_IDAT(png_structrp png_ptr, uInt size)
+{
+   png_bytep data = png_ptr->zbuffer_list->output;
+
+#ifdef PNG_WRITE_OPTIMIZE_CMF_SUPPORTED
+   if ((png_ptr->mode & PNG_HAVE_IDAT) == 0 &&
+       png_ptr->compression_type == PNG_COMPRESSION_TYPE_BASE)
+      optimize_cmf(data, png_image_size(png_ptr));
+#endif
+
+   png_write_complete_chunk(png_ptr, png_IDAT, data, size);
+   png_ptr->mode |= PNG_HAVE_IDAT;
+   png_ptr->write_par->avail = png_ptr->zbuffer_size;
+}
+
+/* Add zlib stream data to the IDAT buffer, writing it out when it is full. */
+static void
+png_write_par_output(png_structrp png_ptr, png_const_bytep data,
+   png_alloc_size_t len)
+{
+   struct png_write_par_s *par = png_ptr->write_par;
+
+   while (len > 0)
+   {
+      uInt have = png_ptr->zbuffer_size - par->avail;
+      uInt n = par->avail;
+
+      if (n > len)
+         n = (uInt)len;
+
+      memcpy(png_ptr->zbuffer_list->output + have, data, n);
+      par->avail -= n;
+      data += n;
+      len -= n;
+
+      if (par->avail == 0)
+         png_write_par_IDAT(png_ptr, png_ptr->zbuffer_size);
+   }
+}
+
+/* Wait for the first band not yet written, and write it. */
+static void
+png_write_par_next(png_structrp png_ptr)
+{
+   struct png_write_par_s *par = png_ptr->write_par;
+   png_write_job *job = par->first;
+
+   png_lock_get(&par->lock);
+   while (job->done == 0)
+      png_cond_wait(&par->done, &par->lock);
+   png_lock_put(&par->lock);
+
+   par->first = job->order;
+   if (par->first == NULL)
+      par->last = NULL;
+   par->pending--;
+
+   /* The band written before this one was the dictionary for this one, so it
+    * can be reused now; this one is kept for the band after it.
+    */
+   if (par->written != NULL)
+   {
+      par->written->next = par->free;
+      par->free = par->written;
+   }
+
+   job->next = NULL;
+   par->written = job;
+
+   if (job->done < 0)
+      png_error(png_ptr, "zlib error compressing IDAT on a worker thread");
+
+   if (par->started == 0)
+   {
+      /* The zlib header, as deflate writes it. */
+      int level = par->level == Z_DEFAULT_COMPRESSION ? 6 : par->level;
+      unsigned int cmf = Z_DEFLATED + ((par->window_bits - 8) << 4);
+      unsigned int flg;
+      png_byte header[2];
+
+      if (par->strategy >= Z_HUFFMAN_ONLY || level < 2)
+         flg = 0;
+
+      else if (level < 6)
+         flg = 1;
+
+      else if (level == 6)
+         flg = 2;
+
+      else
+         flg = 3;
+
+      flg <<= 6;
+      flg += 31 - ((cmf << 8) + flg) % 31;
+
+      header[0] = (png_byte)cmf;
+      header[1] = (png_byte)flg;
+      png_write_par_output(png_ptr, header, 2);
+
+      par->adler = job->adler;
+      par->started = 1;
+   }
+
+   else
+      par->adler = adler32_combine(par->adler, job->adler,
+         (z_off_t)(job->rows * par->stride));
+
+   png_write_par_output(png_ptr, job->out, job->have);
+
+   if (job->flush == Z_FINISH)
+   {
+      png_byte trailer[4];
+
+      png_save_uint_32(trailer, (png_uint_32)par->adler);
+      png_write_par_output(png_ptr, trailer, 4);
+
+      if (par->avail < png_ptr->zbuffer_size)
+         png_write_par_IDAT(png_ptr, png_ptr->zbuffer_size - par->avail);
+
+      png_ptr->mode |= PNG_AFTER_IDAT;
+   }
+}
+
+/* Queue the band being filled, ending it with 'flush'. */
+static void
+png_write_par_queue(png_structrp png_ptr, int flush)
+{
+   struct png_write_par_s *par = png_ptr->write_par;
+   png_write_job *job = par->cur;
+
+   par->cur = NULL;
+   job->flush = flush;
+   job->prev = par->last != NULL ? par->last : par->written;
+   job->filtered_done = 0;
+   job->done = 0;
+   job->next = NULL;
+   job->order = NULL;
+   memcpy(par->above, job->in + job->rows * par->stride, par->stride);
+
+   if (par->last == NULL)
+      par->first = job;
+
+   else
+      par->last->order = job;
+
+   par->last = job;
+   par->pending++;
+
+   png_lock_get(&par->lock);
+   if (par->tail == NULL)
+      par->head = job;
+
+   else
+      par->tail->next = job;
+
+   par->tail = job;
+   png_cond_wake_all(&par->work);
+   png_lock_put(&par->lock);
+
+   /* Two bands per thread keep the threads busy while the oldest band is
+    * being written; more would just use memory.
+    */
+   while (par->pending >= 2 * par->threads)
+      png_write_par_next(png_ptr);
+}
+
+/* Add a row, in png_ptr->row_buf, to the band being filled. */
+static void
+png_write_par_row(png_structrp png_ptr, png_row_infop row_info)
+{
+   struct png_write_par_s *par = png_ptr->write_par;
+   png_write_job *job = par->cur;
+   png_bytep row;
+
+   if (row_info->rowbytes + 1 != par->stride)
+      png_error(png_ptr, "internal error: row size changed");
+
+   if (job == NULL)
+   {
+      if (png_ptr->row_number == 0)
+         par->row_info = *row_info;
+
+      job = par->free;
+
+      if (job != NULL)
+      {
+         par->free = job->next;
+         par->cur = job;
+      }
+
+      else
+      {
+         png_alloc_size_t band_size = par->band_rows * par->stride;
+
+         job = png_voidcast(png_write_job *, png_calloc(png_ptr, sizeof *job));
+         par->cur = job;
+
+         job->in = png_voidcast(png_bytep,
+            png_malloc(png_ptr, band_size + par->stride));
+         job->filtered = png_voidcast(png_bytep,
+            png_malloc(png_ptr, band_size));
+         job->size = band_size + (band_size >> 3) + 64;
+         job->out = png_voidcast(png_bytep, png_malloc(png_ptr, job->size));
+
+#ifdef PNG_WRITE_FILTER_SUPPORTED
+         job->filter_rows = png_voidcast(png_bytep,
+            png_malloc(png_ptr, 4 * par->stride));
+         job->filter_rows[0] = PNG_FILTER_VALUE_SUB;
+         job->filter_rows[par->stride] = PNG_FILTER_VALUE_UP;
+         job->filter_rows[2 * par->stride] = PNG_FILTER_VALUE_AVG;
+         job->filter_rows[3 * par->stride] = PNG_FILTER_VALUE_PAETH;
+#endif
+      }
+
+      job->row_number = png_ptr->row_number;
+      job->rows = 0;
+      memcpy(job->in, par->above, par->stride);
+   }
+
+   job->rows++;
+   row = job->in + job->rows * par->stride;
+   row[0] = PNG_FILTER_VALUE_NONE;
+   memcpy(row + 1, png_ptr->row_buf + 1, row_info->rowbytes);
+
+   if (png_ptr->row_number + 1 >= png_ptr->num_rows)
+      png_write_par_queue(png_ptr, Z_FINISH);
+
+   else if (job->rows == par->band_rows)
+      png_write_par_queue(png_ptr, Z_SYNC_FLUSH);
+}
+
+/* Called through png_compress_IDAT: queue any partial band and write out
+ * everything queued.  After Z_FINISH the threads are stopped.
+ */
+static void
+png_write_par_flush(png_structrp png_ptr, int flush)
+{
+   struct png_write_par_s *par = png_ptr->write_par;
+
+   if (par->cur != NULL)
+      png_write_par_queue(png_ptr, flush);
+
+   while (par->first != NULL)
+      png_write_par_next(png_ptr);
+
+   if (flush == Z_FINISH)
+      png_write_par_free(png_ptr);
+}
+#endif /* WRITE_THREADS */
+
+void /* PRIVATE */
+png_write_find_filter(png_structrp png_ptr, png_row_infop row_info)
+{
+   png_bytep best_row;
+#ifdef PNG_WRITE_FILTER_SUPPORTED
+#ifdef PNG_WRITE_WEIGHTED_FILTER_SUPPORTED
+   int num_p_filters = png_ptr->num_prev_filters;
+#endif
+   png_filter_rows rows;
+#endif
+
+   png_debug(1, "in png_write_find_filter");
+
+#ifdef PNG_WRITE_THREADS_SUPPORTED
+   if (png_ptr->write_par != NULL)
+   {
+      /* The row is filtered and compressed later, on a worker thread. */
+      png_write_par_row(png_ptr, row_info);
+      png_write_finish_row(png_ptr);
+      return;
+   }
+#endif
+
+#ifdef PNG_WRITE_FILTER_SUPPORTED
+   rows.row_buf = png_ptr->row_buf;
+   rows.prev_row = png_ptr->prev_row;
+   rows.sub_row = png_ptr->sub_row;
+   rows.up_row = png_ptr->up_row;
+   rows.avg_row = png_ptr->avg_row;
+   rows.paeth_row = png_ptr->paeth_row;
+
+   best_row = png_find_filter(png_ptr, row_info, png_ptr->row_number, &rows);
+#else
+   best_row = png_ptr->row_buf;
+#endif
+
    /* Do the actual writing of the filtered row data from the chosen filter. */
    png_write_filtered_row(png_ptr, best_row, row_info->rowbytes+1);
 
@@ -665,6 +665,16 @@ struct sqlite3_file {
 ** fails to zero-fill short reads might seem to work.  However,
 ** failure to zero-fill short reads will eventually lead to
 ** database corruption.
+**
+** The xFetch() method, available when iVersion is 3 or greater, asks
+** the VFS for a pointer to iAmt bytes of file content starting at
+** offset iOfst, typically within a memory mapping of the file.  ^If
+** the VFS is unable or unwilling to provide such a pointer it sets
+** *pp to NULL and returns SQLITE_OK, in which case SQLite falls back
+** to xRead().  Each successful xFetch() is balanced by a call to
+** xUnfetch() with the same offset and pointer.  A call to xUnfetch()
+** with a NULL pointer is a hint that the VFS may release any mapping
+** it currently holds.
 */
 typedef struct sqlite3_io_methods sqlite3_io_methods;
 struct sqlite3_io_methods {
@@ -687,6 +697,9 @@ struct sqlite3_io_methods {
   void (*xShmBarrier)(sqlite3_file*);
   int (*xShmUnmap)(sqlite3_file*, int deleteFlag);
   /* Methods above are valid for version 2 */
+  int (*xFetch)(sqlite3_file*, sqlite3_int64 iOfst, int iAmt, void **pp);
+  int (*xUnfetch)(sqlite3_file*, sqlite3_int64 iOfst, void *p);
+  /* Methods above are valid for version 3 */
   /* Additional methods may be added in future releases */
 };
 
@@ -734,6 +747,15 @@ struct sqlite3_io_methods {
 ** Applications should not call [sqlite3_file_control()] with this
 ** opcode as doing so may disrupt the operation of the specialized VFSes
 ** that do require it.  
+**
+** The [SQLITE_FCNTL_MMAP_SIZE] opcode is used to query or set the maximum
+** number of bytes of the file that the VFS may memory-map for use by
+** xFetch().  The argument is a pointer to an sqlite3_int64.  ^On entry,
+** a non-negative value is the requested new limit; a negative value
+** leaves the limit unchanged.  ^On return the sqlite3_int64 holds the
+** limit that was in effect before the call.  The limit is capped by the
+** maximum configured with [SQLITE_CONFIG_MMAP_SIZE].  See also
+** [PRAGMA mmap_size].
 */
 #define SQLITE_FCNTL_LOCKSTATE        1
 #define SQLITE_GET_LOCKPROXYFILE      2
@@ -743,6 +765,7 @@ struct sqlite3_io_methods {
 #define SQLITE_FCNTL_CHUNK_SIZE       6
 #define SQLITE_FCNTL_FILE_POINTER     7
 #define SQLITE_FCNTL_SYNC_OMITTED     8
+#define SQLITE_FCNTL_MMAP_SIZE       18
 
 
 /*
@@ -1429,6 +1452,17 @@ struct sqlite3_mem_methods {
 ** In a multi-threaded application, the application-defined logger
 ** function must be threadsafe. </dd>
 **
+** <dt>SQLITE_CONFIG_MMAP_SIZE</dt>
+** <dd> ^SQLITE_CONFIG_MMAP_SIZE takes two 64-bit integer (sqlite3_int64)
+** values that are the default mmap size limit (the default setting for
+** [PRAGMA mmap_size]) and the maximum allowed mmap size limit.
+** ^The default setting can be overridden by each database connection
+** using [PRAGMA mmap_size], but it cannot be raised above the maximum.
+** ^A negative argument leaves the corresponding setting unchanged.
+** ^Both values are silently truncated to the compile-time
+** SQLITE_MAX_MMAP_SIZE limit, which is zero on platforms that do not
+** support memory-mapped I/O. </dd>
+**
 ** </dl>
 */
 #define SQLITE_CONFIG_SINGLETHREAD  1  /* nil */
@@ -1447,6 +1481,7 @@ struct sqlite3_mem_methods {
 #define SQLITE_CONFIG_PCACHE       14  /* sqlite3_pcache_methods* */
 #define SQLITE_CONFIG_GETPCACHE    15  /* sqlite3_pcache_methods* */
 #define SQLITE_CONFIG_LOG          16  /* xFunc, void* */
+#define SQLITE_CONFIG_MMAP_SIZE    22  /* sqlite3_int64, sqlite3_int64 */
 
 /*
 ** CAPI3REF: Database Connection Configuration Options
@@ -1504,11 +1539,50 @@ struct sqlite3_mem_methods {
 ** following this call.  The second parameter may be a NULL pointer, in
 ** which case the trigger setting is not reported back. </dd>
 **
+** <dt>SQLITE_DBCONFIG_STMT_CACHE</dt>
+** <dd> ^This option sets the size of the per-connection cache of compiled
+** statements used by [sqlite3_prepare_v2()] and [sqlite3_prepare16_v2()].
+** There should be two additional arguments.
+** The first argument is the maximum number of statements to keep in the
+** cache, zero to disable the cache and discard its contents, or negative
+** to leave the setting unchanged.  The second parameter is a pointer to an
+** integer into which is written the maximum size of the cache following
+** this call, or a NULL pointer.  ^The cache is disabled by default.
+** ^(While the cache is enabled, [sqlite3_finalize()] resets a statement
+** and keeps it in the cache instead of destroying it, and a later call
+** to prepare the same SQL text returns that statement, with all
+** parameters set to NULL, instead of compiling it again.)^  ^Cached
+** statements are never returned once the schema has changed, and any
+** change to the functions, collating sequences or authorizer of the
+** connection discards the contents of the cache. </dd>
+**
+** <dt>SQLITE_DBCONFIG_WAL_BGCHECKPOINT</dt>
+** <dd> ^This option is used to move the automatic checkpoints configured
+** by [sqlite3_wal_autocheckpoint()] off the committing thread.
+** There should be two additional arguments.
+** The first argument is an integer which is 0 to run automatic checkpoints
+** inline, positive to run them in a background thread, or negative to
+** leave the setting unchanged.
+** The second parameter is a pointer to an integer into which is written
+** 0 or 1 to indicate whether background checkpoints are enabled following
+** this call.  The second parameter may be a NULL pointer.
+** ^(While enabled, a commit that crosses the auto-checkpoint threshold
+** starts a [SQLITE_CHECKPOINT_PASSIVE | passive] checkpoint of the
+** database file on a separate thread, using a private connection, and
+** returns without waiting for it.)^  ^If a background checkpoint is
+** still running, no new checkpoint is started.  ^Temporary and in-memory
+** databases are always checkpointed inline, as are all databases if
+** SQLite was built or configured without mutexes.
+** ^[sqlite3_wal_checkpoint_v2()] and [sqlite3_close()] wait for a running
+** background checkpoint to finish. </dd>
+**
 ** </dl>
 */
 #define SQLITE_DBCONFIG_LOOKASIDE       1001  /* void* int int */
 #define SQLITE_DBCONFIG_ENABLE_FKEY     1002  /* int int* */
 #define SQLITE_DBCONFIG_ENABLE_TRIGGER  1003  /* int int* */
+#define SQLITE_DBCONFIG_STMT_CACHE      1004  /* int int* */
+#define SQLITE_DBCONFIG_WAL_BGCHECKPOINT 1005 /* int int* */
 
 
 /*
@@ -2577,6 +2651,13 @@ SQLITE_API int sqlite3_limit(sqlite3*, int id, int newVal);
 **
 ** ^(<dt>SQLITE_LIMIT_TRIGGER_DEPTH</dt>
 ** <dd>The maximum depth of recursion for triggers.</dd>)^
+**
+** ^(<dt>SQLITE_LIMIT_WORKER_THREADS</dt>
+** <dd>The maximum number of background threads that a single
+** [prepared statement] may start to help it sort large amounts of
+** data.  The default is zero, meaning that all sorting is done by the
+** thread that calls [sqlite3_step()].  Collating functions used by
+** ORDER BY clauses and indexes may be invoked from these threads.</dd>)^
 ** </dl>
 */
 #define SQLITE_LIMIT_LENGTH                    0
@@ -2590,6 +2671,7 @@ SQLITE_API int sqlite3_limit(sqlite3*, int id, int newVal);
 #define SQLITE_LIMIT_LIKE_PATTERN_LENGTH       8
 #define SQLITE_LIMIT_VARIABLE_NUMBER           9
 #define SQLITE_LIMIT_TRIGGER_DEPTH            10
+#define SQLITE_LIMIT_WORKER_THREADS           11
 
 /*
 ** CAPI3REF: Compiling An SQL Statement
@@ -5039,6 +5121,43 @@ SQLITE_API int sqlite3_blob_read(sqlite3_blob *, void *Z, int N, int iOffset);
 */
 SQLITE_API int sqlite3_blob_write(sqlite3_blob *, const void *z, int n, int iOffset);
 
+/*
+** CAPI3REF: Read Data From A BLOB Without Copying It
+**
+** ^(This function reads N bytes of data from an open [BLOB handle],
+** starting at offset iOffset, without copying it into a caller-supplied
+** buffer. Instead, each piece of the requested range that is stored
+** contiguously in the database file is passed to the callback X, in
+** order, as a pointer P and a size in bytes.)^ ^The first argument to X
+** is the A argument passed to sqlite3_blob_stream(). A large BLOB is
+** stored on a chain of overflow pages, so X is usually invoked once per
+** page (a little less than the [page_size] in bytes).
+**
+** ^The pointers passed to X refer to the page cache or, if the database
+** file is memory-mapped (see [SQLITE_CONFIG_MMAP_SIZE]) and no write
+** transaction is open, directly to the mapping. They remain valid only
+** until X returns. The callback must not modify the data, and must not
+** call any API on the [database connection] that owns the BLOB handle.
+**
+** ^If X returns SQLITE_OK, the next piece of the BLOB is passed to it.
+** ^Otherwise, no further pieces are passed to X and
+** sqlite3_blob_stream() returns the value that X returned. The callback
+** should not return [SQLITE_ABORT], as that indicates that the BLOB
+** handle has expired.
+**
+** ^The range and error checks are the same as for [sqlite3_blob_read()].
+** ^On success, sqlite3_blob_stream() returns SQLITE_OK.
+**
+** See also: [sqlite3_blob_read()].
+*/
+SQLITE_API int sqlite3_blob_stream(
+  sqlite3_blob *,
+  int N,
+  int iOffset,
+  int (*X)(void *A, const void *P, int nByte),
+  void *A
+);
+
 /*
 ** CAPI3REF: Virtual File System Objects
 **
@@ -5620,6 +5739,18 @@ SQLITE_API int sqlite3_db_status(sqlite3*, int op, int *pCur, int *pHiwtr, int r
 ** the database connection.)^
 ** ^The highwater mark associated with SQLITE_DBSTATUS_STMT_USED is always 0.
 ** </dd>
+**
+** ^(<dt>SQLITE_DBSTATUS_STMT_CACHE_HIT</dt>
+** <dd>This parameter returns the number of calls to [sqlite3_prepare_v2()]
+** that were satisfied from the [SQLITE_DBCONFIG_STMT_CACHE | statement
+** cache]. Only the high-water value is meaningful;
+** the current value is the number of statements in the cache.)^
+**
+** ^(<dt>SQLITE_DBSTATUS_STMT_CACHE_MISS</dt>
+** <dd>This parameter returns the number of calls to [sqlite3_prepare_v2()]
+** made while the statement cache was enabled that had to compile the
+** statement. Only the high-water value is meaningful;
+** the current value is always zero.)^
 ** </dl>
 */
 #define SQLITE_DBSTATUS_LOOKASIDE_USED       0
@@ -5629,7 +5760,9 @@ SQLITE_API int sqlite3_db_status(sqlite3*, int op, int *pCur, int *pHiwtr, int r
 #define SQLITE_DBSTATUS_LOOKASIDE_HIT        4
 #define SQLITE_DBSTATUS_LOOKASIDE_MISS_SIZE  5
 #define SQLITE_DBSTATUS_LOOKASIDE_MISS_FULL  6
-#define SQLITE_DBSTATUS_MAX                  6   /* Largest defined DBSTATUS */
+#define SQLITE_DBSTATUS_STMT_CACHE_HIT       7
+#define SQLITE_DBSTATUS_STMT_CACHE_MISS      8
+#define SQLITE_DBSTATUS_MAX                  8   /* Largest defined DBSTATUS */
 
 
 /*
@@ -6062,6 +6195,71 @@ SQLITE_API int sqlite3_backup_finish(sqlite3_backup *p);
 SQLITE_API int sqlite3_backup_remaining(sqlite3_backup *p);
 SQLITE_API int sqlite3_backup_pagecount(sqlite3_backup *p);
 
+/*
+** CAPI3REF: Online Compaction Object
+**
+** The sqlite3_compact object records state information about an ongoing
+** online compaction of a database.  ^The sqlite3_compact object is
+** created by a call to [sqlite3_compact_init()] and is destroyed by a
+** call to [sqlite3_compact_finish()].
+*/
+typedef struct sqlite3_compact sqlite3_compact;
+
+/*
+** CAPI3REF: Online Compaction API.
+**
+** The compaction API removes the free pages from a database file a few
+** at a time, in a series of short write transactions. Unlike [VACUUM],
+** which rebuilds the whole database in one transaction, it does not
+** stop other connections from writing to the database for longer than
+** one step takes. The database must be an [auto_vacuum] database, either
+** FULL or INCREMENTAL. Each step is equivalent to running
+** "[PRAGMA incremental_vacuum](N)": the last N pages of the file are
+** moved into free pages nearer its start, and the file is truncated.
+**
+** ^The sqlite3_compact_init(D,N,R) interface prepares to compact the
+** database named N (for example "main", "temp" or the name of an attached
+** database) of [database connection] D. ^If R is greater than zero, no
+** more than R pages per second are removed from the file, averaged over
+** calls to sqlite3_compact_step(). ^If the database does not exist or is
+** not an auto_vacuum database, NULL is returned and an error code and
+** message are left in the database connection.
+**
+** ^The sqlite3_compact_step(C,N) interface removes up to N free pages
+** from the database in a single transaction, or all of them if N is
+** negative. ^If the connection already has a transaction open, the pages
+** are removed as part of it, and are written to disk when it is
+** committed. ^If a page rate limit was set, sqlite3_compact_step() first
+** sleeps for as long as is needed to stay below it. ^It returns
+** [SQLITE_DONE] if there are no free pages left in the database, or
+** [SQLITE_OK] if there are. ^If the database is locked by another
+** connection it returns [SQLITE_BUSY] or [SQLITE_LOCKED] and may be
+** called again later. ^Other errors are returned as error codes, and the
+** error message is available through [sqlite3_errmsg()].
+**
+** ^The sqlite3_compact_remaining() and sqlite3_compact_pagecount()
+** interfaces return the number of free pages in the database and the
+** total number of pages in the database file, as of the most recent call
+** to sqlite3_compact_init() or sqlite3_compact_step(). They may be used
+** to report the progress of a compaction.
+**
+** ^The sqlite3_compact_finish() interface releases the resources held by
+** a compaction. ^It returns [SQLITE_OK] unless the most recent call to
+** sqlite3_compact_step() failed with an error other than [SQLITE_BUSY] or
+** [SQLITE_LOCKED], in which case that error code is returned. Every
+** sqlite3_compact object must be finished before its database connection
+** is closed.
+*/
+SQLITE_API sqlite3_compact *sqlite3_compact_init(
+  sqlite3 *db,                           /* Database handle */
+  const char *zDbName,                   /* Database name */
+  int nMaxRate                           /* Max pages per second, or 0 */
+);
+SQLITE_API int sqlite3_compact_step(sqlite3_compact *p, int nPage);
+SQLITE_API int sqlite3_compact_finish(sqlite3_compact *p);
+SQLITE_API int sqlite3_compact_remaining(sqlite3_compact *p);
+SQLITE_API int sqlite3_compact_pagecount(sqlite3_compact *p);
+
 /*
 ** CAPI3REF: Unlock Notification
 **
@@ -0,0 +1,187 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Bulk-insert benchmark for the _TOKENIZE function and the LOCALIZED and
+// UNICODE collations. It inserts contacts-style names into a table with a
+// trigger that tokenizes each one, then sorts them with each collation.
+// Every sort is checked against ucol_strcoll(), so it also tests that the
+// ASCII fast path agrees with ICU for a number of locales.
+//
+// Usage: TokenizeBenchmark [NROWS]
+
+#include "sqlite3_android.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <unicode/ucol.h>
+#include <unicode/ustring.h>
+
+static const char* kFirstNames[] = {
+    "James", "Mary", "John", "Patricia", "Robert", "Jennifer", "Michael",
+    "Linda", "William", "Elizabeth", "David", "Barbara", "Richard", "Susan",
+    "Joseph", "Jessica", "Thomas", "Sarah", "Charles", "Karen", "Aaron",
+    "Chloe", "Hugo", "Lars", "Zoe", "van", "O'Brien", "Anne-Marie",
+};
+
+static const char* kLastNames[] = {
+    "Smith", "Johnson", "Williams", "Brown", "Jones", "Garcia", "Miller",
+    "Davis", "Rodriguez", "Martinez", "Hernandez", "Lopez", "Gonzalez",
+    "Wilson", "Anderson", "Thomas", "Taylor", "Moore", "Jackson", "Martin",
+    "Chavez", "Llorente", "Aalto", "Czerny", "Yilmaz", "Vogel", "Wolfe",
+    "M\xc3\xbcller", "\xc3\x85str\xc3\xb6m", "\xe5\xb1\xb1\xe7\x94\xb0",
+};
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+
+static double now_ms()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+static bool exec(sqlite3* db, const char* sql)
+{
+    char* err = NULL;
+    if (sqlite3_exec(db, sql, NULL, NULL, &err) != SQLITE_OK) {
+        printf("%s: %s\n", sql, err);
+        sqlite3_free(err);
+        return false;
+    }
+    return true;
+}
+
+// Returns the name of row i. Names repeat, as they do in real contacts
+// data, and some have a numeric suffix so that not every token is cached.
+static void make_name(int i, char* buf, size_t size)
+{
+    const char* first = kFirstNames[(i * 7) % ARRAY_SIZE(kFirstNames)];
+    const char* last = kLastNames[(i * 13) % ARRAY_SIZE(kLastNames)];
+    if (i % 5 == 0) {
+        snprintf(buf, size, "%s %s %d", first, last, i % 1000);
+    } else {
+        snprintf(buf, size, "%s %s", first, last);
+    }
+}
+
+// Checks that the rows of "SELECT name FROM raw ORDER BY name COLLATE <coll>"
+// are in the order given by ucol_strcoll() for a collator of the same
+// locale and strength.
+static bool check_order(sqlite3* db, const char* coll, const char* locale,
+        UCollationStrength strength)
+{
+    UErrorCode status = U_ZERO_ERROR;
+    UCollator* collator = ucol_open(locale, &status);
+    ucol_setStrength(collator, strength);
+
+    char* sql = sqlite3_mprintf("SELECT name FROM raw ORDER BY name COLLATE %s", coll);
+    sqlite3_stmt* stmt;
+    sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
+    sqlite3_free(sql);
+
+    bool ok = true;
+    UChar prev[256] = {0};
+    int32_t prevLen = 0;
+    int rows = 0;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        UChar cur[256];
+        int32_t curLen = 0;
+        status = U_ZERO_ERROR;
+        u_strFromUTF8(cur, 256, &curLen, (const char*)sqlite3_column_text(stmt, 0), -1, &status);
+        if (rows > 0 && ucol_strcoll(collator, prev, prevLen, cur, curLen) == UCOL_GREATER) {
+            ok = false;
+        }
+        memcpy(prev, cur, curLen * sizeof(UChar));
+        prevLen = curLen;
+        rows++;
+    }
+    sqlite3_finalize(stmt);
+    ucol_close(collator);
+    return ok;
+}
+
+static bool run(const char* locale, int utf16Storage, int nRows)
+{
+    sqlite3* db;
+    sqlite3_open(":memory:", &db);
+
+    double t0 = now_ms();
+    if (register_android_functions(db, utf16Storage) != SQLITE_OK
+        || register_localized_collators(db, locale, utf16Storage) != SQLITE_OK) {
+        printf("registration failed for %s\n", locale);
+        sqlite3_close(db);
+        return false;
+    }
+    double tRegister = now_ms() - t0;
+
+    exec(db, "CREATE TABLE raw(_id INTEGER PRIMARY KEY, name TEXT);"
+             "CREATE TABLE tokens(token TEXT, source INTEGER, token_index INTEGER);"
+             "CREATE INDEX tokens_token ON tokens(token);"
+             "CREATE TRIGGER raw_tokenize AFTER INSERT ON raw BEGIN"
+             "  SELECT _TOKENIZE('tokens', new._id, new.name, ' ', 1);"
+             "END;");
+
+    sqlite3_stmt* insert;
+    sqlite3_prepare_v2(db, "INSERT INTO raw(name) VALUES(?)", -1, &insert, NULL);
+    t0 = now_ms();
+    exec(db, "BEGIN");
+    for (int i = 0; i < nRows; i++) {
+        char name[128];
+        make_name(i, name, sizeof(name));
+        sqlite3_bind_text(insert, 1, name, -1, SQLITE_STATIC);
+        sqlite3_step(insert);
+        sqlite3_reset(insert);
+    }
+    exec(db, "COMMIT");
+    double tInsert = now_ms() - t0;
+    sqlite3_finalize(insert);
+
+    t0 = now_ms();
+    exec(db, "SELECT count(*) FROM (SELECT name FROM raw ORDER BY name COLLATE LOCALIZED)");
+    double tLocalized = now_ms() - t0;
+    t0 = now_ms();
+    exec(db, "SELECT count(*) FROM (SELECT name FROM raw ORDER BY name COLLATE UNICODE)");
+    double tUnicode = now_ms() - t0;
+
+    bool ok = check_order(db, "LOCALIZED", locale, UCOL_PRIMARY)
+        && check_order(db, "UNICODE", NULL, UCOL_DEFAULT_STRENGTH);
+
+    printf("%-6s %s register %6.2f ms  insert %8.1f ms  "
+           "sort LOCALIZED %7.1f ms  sort UNICODE %7.1f ms  %s\n",
+           locale, utf16Storage ? "utf16" : "utf8 ", tRegister, tInsert,
+           tLocalized, tUnicode, ok ? "ok" : "WRONG ORDER");
+    sqlite3_close(db);
+    return ok;
+}
+
+int main(int argc, char** argv)
+{
+    int nRows = argc > 1 ? atoi(argv[1]) : 20000;
+    static const char* kLocales[] = {
+        "en_US", "en_US", "da", "cs", "es", "sv", "lt", "ja",
+    };
+
+    bool ok = true;
+    for (size_t i = 0; i < ARRAY_SIZE(kLocales); i++) {
+        ok = run(kLocales[i], 0, nRows) && ok;
+        ok = run(kLocales[i], 1, nRows) && ok;
+    }
+    printf("\n%s\n", ok ? "Success" : "Failure");
+    return ok ? 0 : 1;
+}
@@ -17,12 +17,15 @@
 #define LOG_TAG "sqlite3_android"
 
 #include <ctype.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
 #include <unicode/ucol.h>
 #include <unicode/uiter.h>
+#include <unicode/uloc.h>
+#include <unicode/uset.h>
 #include <unicode/ustring.h>
 #include <unicode/utypes.h>
 #include <android/log.h>
@@ -37,11 +40,261 @@
 
 #define ALOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
 
+// Number of entries in the sort key cache of each _TOKENIZE function, and
+// the longest token (in UTF-16 code units) that is cached.
+#define SORT_KEY_CACHE_SIZE 256
+#define SORT_KEY_CACHE_MAX_TOKEN 32
+
+/**
+ * Collators are expensive to open: ucol_open() loads and builds the
+ * tailoring for the locale each time. One collator per locale is kept
+ * open for the life of the process, and each connection is given a clone
+ * of it, which is cheap. The pool only grows by one entry for each
+ * distinct locale used. Each entry also holds the asciiRank table (see
+ * LocalizedCollator) for primary strength collators of its locale, which
+ * is filled in the first time one is created.
+ */
+struct CollatorPoolEntry {
+    CollatorPoolEntry* next;
+    UCollator* collator;
+    char* locale;
+    bool hasPrimaryRanks;
+    uint8_t primaryAsciiRank[128];
+};
+
+static pthread_mutex_t sCollatorPoolLock = PTHREAD_MUTEX_INITIALIZER;
+static CollatorPoolEntry* sCollatorPool = NULL;
+
+/**
+ * Returns a new collator for the given locale (NULL for the default
+ * locale), which the caller must close with ucol_close().
+ */
+static UCollator* open_pooled_collator(const char* locale, UErrorCode* status)
+{
+    const char* key = locale ? locale : uloc_getDefault();
+    UCollator* collator = NULL;
+
+    pthread_mutex_lock(&sCollatorPoolLock);
+    CollatorPoolEntry* entry = sCollatorPool;
+    while (entry && strcmp(entry->locale, key) != 0) {
+        entry = entry->next;
+    }
+    if (!entry) {
+        UCollator* base = ucol_open(key, status);
+        if (U_SUCCESS(*status)) {
+            entry = (CollatorPoolEntry*)malloc(sizeof(CollatorPoolEntry));
+            char* copy = strdup(key);
+            if (entry && copy) {
+                entry->next = sCollatorPool;
+                entry->collator = base;
+                entry->locale = copy;
+                entry->hasPrimaryRanks = false;
+                sCollatorPool = entry;
+            } else {
+                free(entry);
+                free(copy);
+                entry = NULL;
+                collator = base;
+            }
+        }
+    }
+    if (entry) {
+        collator = ucol_safeClone(entry->collator, NULL, NULL, status);
+    }
+    pthread_mutex_unlock(&sCollatorPoolLock);
+    return collator;
+}
+
+/**
+ * The user data of the collation functions: an ICU collator, and a table
+ * that allows strings made up only of ASCII characters to be compared
+ * without calling ICU.
+ *
+ * asciiRank[c] is the position of character c in the collation order, or
+ * 0 if strings containing c must be compared by ICU. Characters that are
+ * equal at the collator's strength have the same rank. The table is only
+ * filled in if comparing two ASCII strings one rank at a time gives the
+ * same result as ICU: the strength must be primary, and no ASCII character
+ * may be ignorable, expand to more than one collation element, or be part
+ * of a contraction made only of ASCII characters. Otherwise every entry
+ * is 0.
+ */
+struct LocalizedCollator {
+    UCollator* collator;
+    uint8_t asciiRank[128];
+};
+
+static void localized_collator_dtor(void* p)
+{
+    LocalizedCollator* lc = (LocalizedCollator*)p;
+    ucol_close(lc->collator);
+    free(lc);
+}
+
+static void init_ascii_ranks(LocalizedCollator* lc);
+
+/**
+ * Returns a new LocalizedCollator for collator, which must have been
+ * returned by open_pooled_collator(locale) and already have its attributes
+ * set. On failure the collator is closed and NULL returned.
+ */
+static LocalizedCollator* new_localized_collator(UCollator* collator, const char* locale)
+{
+    LocalizedCollator* lc = (LocalizedCollator*)malloc(sizeof(LocalizedCollator));
+    if (!lc) {
+        ucol_close(collator);
+        return NULL;
+    }
+    lc->collator = collator;
+    if (ucol_getStrength(collator) != UCOL_PRIMARY) {
+        memset(lc->asciiRank, 0, sizeof(lc->asciiRank));
+        return lc;
+    }
+
+    const char* key = locale ? locale : uloc_getDefault();
+    pthread_mutex_lock(&sCollatorPoolLock);
+    CollatorPoolEntry* entry = sCollatorPool;
+    while (entry && strcmp(entry->locale, key) != 0) {
+        entry = entry->next;
+    }
+    if (entry && entry->hasPrimaryRanks) {
+        memcpy(lc->asciiRank, entry->primaryAsciiRank, sizeof(lc->asciiRank));
+    } else {
+        init_ascii_ranks(lc);
+        if (entry) {
+            memcpy(entry->primaryAsciiRank, lc->asciiRank, sizeof(lc->asciiRank));
+            entry->hasPrimaryRanks = true;
+        }
+    }
+    pthread_mutex_unlock(&sCollatorPoolLock);
+    return lc;
+}
+
+static int compare_sort_keys(const void* a, const void* b)
+{
+    return strcmp(*(const char* const*)a, *(const char* const*)b);
+}
+
+/**
+ * Returns true if set contains a string made only of ASCII characters, or
+ * an ASCII code point.
+ */
+static bool set_has_ascii(const USet* set)
+{
+    int32_t count = uset_getItemCount(set);
+    for (int32_t i = 0; i < count; i++) {
+        UChar32 start, end;
+        UChar str[16];
+        UErrorCode status = U_ZERO_ERROR;
+        int32_t len = uset_getItem(set, i, &start, &end, str, 16, &status);
+        if (len == 0) {
+            if (start < 128) {
+                return true;
+            }
+        } else if (U_SUCCESS(status)) {
+            int32_t j = 0;
+            while (j < len && str[j] < 128) {
+                j++;
+            }
+            if (j == len) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+static void init_ascii_ranks(LocalizedCollator* lc)
+{
+    UCollator* coll = lc->collator;
+    UErrorCode status = U_ZERO_ERROR;
+
+    memset(lc->asciiRank, 0, sizeof(lc->asciiRank));
+    if (ucol_getStrength(coll) != UCOL_PRIMARY
+        || ucol_getAttribute(coll, UCOL_CASE_LEVEL, &status) != UCOL_OFF
+        || ucol_getAttribute(coll, UCOL_ALTERNATE_HANDLING, &status) != UCOL_NON_IGNORABLE
+        || ucol_getAttribute(coll, UCOL_NUMERIC_COLLATION, &status) != UCOL_OFF
+        || U_FAILURE(status)) {
+        return;
+    }
+
+    USet* contractions = uset_openEmpty();
+    USet* expansions = uset_openEmpty();
+    ucol_getContractionsAndExpansions(coll, contractions, expansions, TRUE, &status);
+    bool usable = U_SUCCESS(status)
+        && !set_has_ascii(contractions) && !set_has_ascii(expansions);
+    uset_close(contractions);
+    uset_close(expansions);
+    if (!usable) {
+        return;
+    }
+
+    // Rank the printable characters, plus tab and newline, by the sort key
+    // of each on its own. Other control characters are left for ICU.
+    char keys[128][16];
+    const char* order[128];
+    int n = 0;
+    for (int c = 0; c < 128; c++) {
+        if (c < 0x20 && c != '\t' && c != '\n') {
+            continue;
+        }
+        UChar uc = (UChar)c;
+        int32_t len = ucol_getSortKey(coll, &uc, 1, (uint8_t*)keys[c], sizeof(keys[c]));
+        if (len <= 1 || len > (int32_t)sizeof(keys[c])) {
+            // Ignorable, or a key too long to be a single collation element.
+            continue;
+        }
+        order[n++] = keys[c];
+    }
+    qsort(order, n, sizeof(order[0]), compare_sort_keys);
+    int rank = 0;
+    for (int i = 0; i < n; i++) {
+        if (i == 0 || strcmp(order[i - 1], order[i]) != 0) {
+            rank++;
+        }
+        lc->asciiRank[(order[i] - keys[0]) / sizeof(keys[0])] = (uint8_t)rank;
+    }
+}
+
+/**
+ * Compares two strings using the asciiRank table of a LocalizedCollator.
+ * Returns -1, 0 or 1, or 2 if either string contains a character that is
+ * not in the table, in which case ICU must be used.
+ */
+template<typename CharT>
+static int collate_ascii(const uint8_t* rank, const CharT* s1, int n1, const CharT* s2, int n2)
+{
+    for (int i = 0; i < n1; i++) {
+        if ((unsigned)s1[i] >= 128 || rank[s1[i]] == 0) return 2;
+    }
+    for (int i = 0; i < n2; i++) {
+        if ((unsigned)s2[i] >= 128 || rank[s2[i]] == 0) return 2;
+    }
+    int n = n1 < n2 ? n1 : n2;
+    for (int i = 0; i < n; i++) {
+        int r1 = rank[s1[i]];
+        int r2 = rank[s2[i]];
+        if (r1 != r2) {
+            return r1 < r2 ? -1 : 1;
+        }
+    }
+    return n1 == n2 ? 0 : (n1 < n2 ? -1 : 1);
+}
+
 static int collate16(void *p, int n1, const void *v1, int n2, const void *v2)
 {
-    UCollator *coll = (UCollator *) p;
-    UCollationResult result = ucol_strcoll(coll, (const UChar *) v1, n1,
-                                                 (const UChar *) v2, n2);
+    LocalizedCollator *lc = (LocalizedCollator *) p;
+    if (n1 == n2 && memcmp(v1, v2, n1) == 0) {
+        return 0;
+    }
+    int fast = collate_ascii(lc->asciiRank, (const UChar *) v1, n1 / 2,
+                                            (const UChar *) v2, n2 / 2);
+    if (fast != 2) {
+        return fast;
+    }
+
+    UCollationResult result = ucol_strcoll(lc->collator, (const UChar *) v1, n1 / 2,
+                                                         (const UChar *) v2, n2 / 2);
 
     if (result == UCOL_LESS) {
         return -1;
@@ -54,14 +307,23 @@ static int collate16(void *p, int n1, const void *v1, int n2, const void *v2)
 
 static int collate8(void *p, int n1, const void *v1, int n2, const void *v2)
 {
-    UCollator *coll = (UCollator *) p;
+    LocalizedCollator *lc = (LocalizedCollator *) p;
     UCharIterator i1, i2;
     UErrorCode status = U_ZERO_ERROR;
 
+    if (n1 == n2 && memcmp(v1, v2, n1) == 0) {
+        return 0;
+    }
+    int fast = collate_ascii(lc->asciiRank, (const unsigned char *) v1, n1,
+                                            (const unsigned char *) v2, n2);
+    if (fast != 2) {
+        return fast;
+    }
+
     uiter_setUTF8(&i1, (const char *) v1, n1);
     uiter_setUTF8(&i2, (const char *) v2, n2);
 
-    UCollationResult result = ucol_strcollIter(coll, &i1, &i2, &status);
+    UCollationResult result = ucol_strcollIter(lc->collator, &i1, &i2, &status);
 
     if (U_FAILURE(status)) {
 //        ALOGE("Collation iterator error: %d\n", status);
@@ -276,6 +538,110 @@ struct SqliteUserData {
     UCollator* collator;
 };
 
+/**
+ * The user data of the _TOKENIZE functions: a collator, and a cache of the
+ * hex-encoded sort keys of recently tokenized strings. Contacts data has
+ * the same names and words over and over, and computing a sort key is
+ * the most expensive part of inserting a token. The cache is direct-mapped
+ * on a hash of the token. It is only used by the connection the function
+ * is registered with, which SQLite never calls on two threads at once, so
+ * it needs no lock.
+ */
+struct SortKeyCacheEntry {
+    int tokenLen;                           // Length of token, or 0 if unused
+    UChar token[SORT_KEY_CACHE_MAX_TOKEN];  // The token
+    char* key;                              // Its hex-encoded sort key
+    uint32_t keyLen;                        // Length of key in bytes
+};
+
+struct TokenizeContext {
+    UCollator* collator;
+    int refs;                               // Functions using this context
+    SortKeyCacheEntry cache[SORT_KEY_CACHE_SIZE];
+};
+
+static void tokenize_context_dtor(void* p)
+{
+    TokenizeContext* ctx = (TokenizeContext*)p;
+    if (--ctx->refs > 0) {
+        return;
+    }
+    for (int i = 0; i < SORT_KEY_CACHE_SIZE; i++) {
+        free(ctx->cache[i].key);
+    }
+    ucol_close(ctx->collator);
+    free(ctx);
+}
+
+/**
+ * Returns the hex-encoded sort key of the len code units at token, in a
+ * buffer allocated with malloc(), and sets *pKeyLen to its length. Returns
+ * NULL if memory cannot be allocated.
+ */
+static char* hex_sort_key(UCollator* collator, const UChar* token, int len, uint32_t* pKeyLen)
+{
+    char keybuf[1024];
+    char* key = keybuf;
+    int32_t result = ucol_getSortKey(collator, token, len, (uint8_t*)keybuf, sizeof(keybuf));
+    if (result > (int32_t)sizeof(keybuf)) {
+        key = (char*)malloc(result);
+        if (!key) {
+            return NULL;
+        }
+        result = ucol_getSortKey(collator, token, len, (uint8_t*)key, result);
+    }
+
+    // The sort key includes a terminating 0 byte, which is not encoded.
+    uint32_t keysize = result > 0 ? result - 1 : 0;
+    char* base16buf = (char*)malloc(keysize*2 + 1);
+    if (base16buf) {
+        base16Encode(base16buf, key, keysize);
+        *pKeyLen = keysize*2;
+    }
+    if (key != keybuf) {
+        free(key);
+    }
+    return base16buf;
+}
+
+/**
+ * Returns the hex-encoded sort key of the NUL-terminated token, and sets
+ * *pKeyLen to its length. If the key is not held by the cache, *pToFree is
+ * set to the returned buffer, which the caller must free(). Otherwise it
+ * is set to NULL, and the key remains valid until the next call. Returns
+ * NULL if memory cannot be allocated.
+ */
+static const char* cached_hex_sort_key(TokenizeContext* ctx, const UChar* token,
+        uint32_t* pKeyLen, char** pToFree)
+{
+    int len = u_strlen(token);
+    *pToFree = NULL;
+    if (len == 0 || len > SORT_KEY_CACHE_MAX_TOKEN) {
+        *pToFree = hex_sort_key(ctx->collator, token, len, pKeyLen);
+        return *pToFree;
+    }
+
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < len; i++) {
+        hash = (hash ^ token[i]) * 16777619u;
+    }
+    SortKeyCacheEntry* entry = &ctx->cache[hash % SORT_KEY_CACHE_SIZE];
+    if (entry->tokenLen == len && memcmp(entry->token, token, len*sizeof(UChar)) == 0) {
+        *pKeyLen = entry->keyLen;
+        return entry->key;
+    }
+
+    char* key = hex_sort_key(ctx->collator, token, len, pKeyLen);
+    if (key) {
+        free(entry->key);
+        entry->key = key;
+        entry->keyLen = *pKeyLen;
+        entry->tokenLen = len;
+        memcpy(entry->token, token, len*sizeof(UChar));
+    }
+    return key;
+}
+
 /**
  * This function is invoked as:
  *
@@ -327,7 +693,7 @@ static void tokenize(sqlite3_context * context, int argc, sqlite3_value ** argv)
     }
 
     sqlite3 * handle = sqlite3_context_db_handle(context);
-    UCollator* collator = (UCollator*)sqlite3_user_data(context);
+    TokenizeContext* tokenizeContext = (TokenizeContext*)sqlite3_user_data(context);
     char const * tokenTable = (char const *)sqlite3_value_text(argv[0]);
     if (tokenTable == NULL) {
         ALOGE("tokenTable null");
@@ -408,19 +774,14 @@ static void tokenize(sqlite3_context * context, int argc, sqlite3_value ** argv)
 
         // Reset the program so we can use it to perform the insert
         sqlite3_reset(statement);
-        UErrorCode status = U_ZERO_ERROR;
-        char keybuf[1024];
-        uint32_t result = ucol_getSortKey(collator, token, -1, (uint8_t*)keybuf, sizeof(keybuf)-1);
-        if (result > sizeof(keybuf)) {
-            // TODO allocate memory for this super big string
-            ALOGE("ucol_getSortKey needs bigger buffer %d", result);
+        uint32_t base16Size;
+        char *base16buf;
+        const char *key = cached_hex_sort_key(tokenizeContext, token, &base16Size, &base16buf);
+        if (key == NULL) {
+            ALOGE("out of memory computing sort key");
             break;
         }
-        uint32_t keysize = result-1;
-        uint32_t base16Size = keysize*2;
-        char *base16buf = (char*)malloc(base16Size);
-        base16Encode(base16buf, keybuf, keysize);
-        err = sqlite3_bind_text(statement, 1, base16buf, base16Size, SQLITE_STATIC);
+        err = sqlite3_bind_text(statement, 1, key, base16Size, SQLITE_STATIC);
 
         if (err != SQLITE_OK) {
             ALOGE(" sqlite3_bind_text16 error %d", err);
@@ -453,11 +814,6 @@ static void tokenize(sqlite3_context * context, int argc, sqlite3_value ** argv)
     sqlite3_result_int(context, numTokens);
 }
 
-static void localized_collator_dtor(UCollator* collator)
-{
-    ucol_close(collator);
-}
-
 #define LOCALIZED_COLLATOR_NAME "LOCALIZED"
 
 // This collator may be removed in the near future, so you MUST not use now.
@@ -469,44 +825,67 @@ extern "C" int register_localized_collators(sqlite3* handle, const char* systemL
     UErrorCode status = U_ZERO_ERROR;
     void* icudata;
 
-    UCollator* collator = ucol_open(systemLocale, &status);
+    UCollator* collator = open_pooled_collator(systemLocale, &status);
     if (U_FAILURE(status)) {
         return -1;
     }
 
     ucol_setAttribute(collator, UCOL_STRENGTH, UCOL_PRIMARY, &status);
     if (U_FAILURE(status)) {
+        ucol_close(collator);
         return -1;
     }
 
-    status = U_ZERO_ERROR;
-    char buf[1024];
-    ucol_getShortDefinitionString(collator, NULL, buf, 1024, &status);
+    // The _TOKENIZE functions use their own clone of the collator, as the
+    // collation may be replaced independently of them.
+    TokenizeContext* tokenizeContext = (TokenizeContext*)calloc(1, sizeof(TokenizeContext));
+    if (tokenizeContext == NULL) {
+        ucol_close(collator);
+        return SQLITE_NOMEM;
+    }
+    tokenizeContext->collator = ucol_safeClone(collator, NULL, NULL, &status);
+    if (U_FAILURE(status)) {
+        free(tokenizeContext);
+        ucol_close(collator);
+        return -1;
+    }
 
+    LocalizedCollator* localized = new_localized_collator(collator, systemLocale);
+    if (localized == NULL) {
+        tokenizeContext->refs = 1;
+        tokenize_context_dtor(tokenizeContext);
+        return SQLITE_NOMEM;
+    }
     if (utf16Storage) {
-        err = sqlite3_create_collation_v2(handle, LOCALIZED_COLLATOR_NAME, SQLITE_UTF16, collator,
-                collate16, (void(*)(void*))localized_collator_dtor);
+        err = sqlite3_create_collation_v2(handle, LOCALIZED_COLLATOR_NAME, SQLITE_UTF16, localized,
+                collate16, localized_collator_dtor);
     } else {
-        err = sqlite3_create_collation_v2(handle, LOCALIZED_COLLATOR_NAME, SQLITE_UTF8, collator,
-                collate8, (void(*)(void*))localized_collator_dtor);
+        err = sqlite3_create_collation_v2(handle, LOCALIZED_COLLATOR_NAME, SQLITE_UTF8, localized,
+                collate8, localized_collator_dtor);
     }
 
     if (err != SQLITE_OK) {
+        tokenizeContext->refs = 1;
+        tokenize_context_dtor(tokenizeContext);
         return err;
     }
 
-    // Register the _TOKENIZE function
-    err = sqlite3_create_function(handle, "_TOKENIZE", 4, SQLITE_UTF16, collator, tokenize, NULL, NULL);
-    if (err != SQLITE_OK) {
-        return err;
-    }
-    err = sqlite3_create_function(handle, "_TOKENIZE", 5, SQLITE_UTF16, collator, tokenize, NULL, NULL);
-    if (err != SQLITE_OK) {
-        return err;
-    }
-    err = sqlite3_create_function(handle, "_TOKENIZE", 6, SQLITE_UTF16, collator, tokenize, NULL, NULL);
-    if (err != SQLITE_OK) {
-        return err;
+    // Register the _TOKENIZE function. Each registration holds a reference
+    // to the context, which SQLite releases by calling the destructor when
+    // the function is replaced or the connection closed, or at once if the
+    // registration fails.
+    tokenizeContext->refs = 3;
+    for (int nArg = 4; nArg <= 6; nArg++) {
+        err = sqlite3_create_function_v2(handle, "_TOKENIZE", nArg, SQLITE_UTF16, tokenizeContext,
+                tokenize, NULL, NULL, tokenize_context_dtor);
+        if (err != SQLITE_OK) {
+            // Release the references that the remaining registrations
+            // would have held.
+            while (++nArg <= 6) {
+                tokenize_context_dtor(tokenizeContext);
+            }
+            return err;
+        }
     }
 
 
@@ -514,11 +893,11 @@ extern "C" int register_localized_collators(sqlite3* handle, const char* systemL
     // The collator may be removed in the near future. Do not depend on it.
     // TODO: it might be better to have another function for registering phonebook collator.
     status = U_ZERO_ERROR;
+    const char* phonebookLocale = systemLocale;
     if (strcmp(systemLocale, "ja") == 0 || strcmp(systemLocale, "ja_JP") == 0) {
-        collator = ucol_open("ja@collation=phonebook", &status);
-    } else {
-        collator = ucol_open(systemLocale, &status);
+        phonebookLocale = "ja@collation=phonebook";
     }
+    collator = open_pooled_collator(phonebookLocale, &status);
     if (U_FAILURE(status)) {
         return -1;
     }
@@ -526,17 +905,20 @@ extern "C" int register_localized_collators(sqlite3* handle, const char* systemL
     status = U_ZERO_ERROR;
     ucol_setAttribute(collator, UCOL_STRENGTH, UCOL_PRIMARY, &status);
     if (U_FAILURE(status)) {
+        ucol_close(collator);
         return -1;
     }
 
-    status = U_ZERO_ERROR;
-    // ucol_getShortDefinitionString(collator, NULL, buf, 1024, &status);
+    localized = new_localized_collator(collator, phonebookLocale);
+    if (localized == NULL) {
+        return SQLITE_NOMEM;
+    }
     if (utf16Storage) {
-        err = sqlite3_create_collation_v2(handle, PHONEBOOK_COLLATOR_NAME, SQLITE_UTF16, collator,
-                collate16, (void(*)(void*))localized_collator_dtor);
+        err = sqlite3_create_collation_v2(handle, PHONEBOOK_COLLATOR_NAME, SQLITE_UTF16, localized,
+                collate16, localized_collator_dtor);
     } else {
-        err = sqlite3_create_collation_v2(handle, PHONEBOOK_COLLATOR_NAME, SQLITE_UTF8, collator,
-                collate8, (void(*)(void*))localized_collator_dtor);
+        err = sqlite3_create_collation_v2(handle, PHONEBOOK_COLLATOR_NAME, SQLITE_UTF8, localized,
+                collate8, localized_collator_dtor);
     }
 
     if (err != SQLITE_OK) {
@@ -553,24 +935,29 @@ extern "C" int register_android_functions(sqlite3 * handle, int utf16Storage)
     int err;
     UErrorCode status = U_ZERO_ERROR;
 
-    UCollator * collator = ucol_open(NULL, &status);
+    UCollator * collator = open_pooled_collator(NULL, &status);
     if (U_FAILURE(status)) {
         return -1;
     }
+    LocalizedCollator * localized = new_localized_collator(collator, NULL);
+    if (localized == NULL) {
+        return SQLITE_NOMEM;
+    }
 
     if (utf16Storage) {
         // Note that text should be stored as UTF-16
         err = sqlite3_exec(handle, "PRAGMA encoding = 'UTF-16'", 0, 0, 0);
         if (err != SQLITE_OK) {
+            localized_collator_dtor(localized);
             return err;
         }
 
         // Register the UNICODE collation
-        err = sqlite3_create_collation_v2(handle, "UNICODE", SQLITE_UTF16, collator, collate16,
-                (void(*)(void*))localized_collator_dtor);
+        err = sqlite3_create_collation_v2(handle, "UNICODE", SQLITE_UTF16, localized, collate16,
+                localized_collator_dtor);
     } else {
-        err = sqlite3_create_collation_v2(handle, "UNICODE", SQLITE_UTF8, collator, collate8,
-                (void(*)(void*))localized_collator_dtor);
+        err = sqlite3_create_collation_v2(handle, "UNICODE", SQLITE_UTF8, localized, collate8,
+                localized_collator_dtor);
     }
 
     if (err != SQLITE_OK) {
@@ -39,6 +39,7 @@ typedef struct AsyncFile AsyncFile;
 typedef struct AsyncFileData AsyncFileData;
 typedef struct AsyncFileLock AsyncFileLock;
 typedef struct AsyncLock AsyncLock;
+typedef struct AsyncQueue AsyncQueue;
 
 /* Enable for debugging */
 #ifndef NDEBUG
@@ -63,9 +64,10 @@ static void asyncTrace(const char *zFormat, ...){
 **
 ** Basic rules:
 **
-**     * Both read and write access to the global write-op queue must be 
-**       protected by the async.queueMutex. As are the async.ioError and
-**       async.nFile variables.
+**     * Both read and write access to the write-op queues (and the
+**       async.pQueue list of queues) must be protected by the
+**       async.queueMutex. As are the async.ioError and async.nFile
+**       variables.
 **
 **     * The async.pLock list and all AsyncLock and AsyncFileLock
 **       structures must be protected by the async.lockMutex mutex.
@@ -78,16 +80,10 @@ static void asyncTrace(const char *zFormat, ...){
 **
 ** Deadlock prevention:
 **
-**     There are three mutex used by the system: the "writer" mutex, 
-**     the "queue" mutex and the "lock" mutex. Rules are:
-**
-**     * It is illegal to block on the writer mutex when any other mutex
-**       are held, and 
-**
-**     * It is illegal to block on the queue mutex when the lock mutex
-**       is held.
-**
-**     i.e. mutex's must be grabbed in the order "writer", "queue", "lock".
+**     There are two mutexes used by the system: the "queue" mutex and
+**     the "lock" mutex. It is illegal to block on the queue mutex when 
+**     the lock mutex is held. i.e. mutex's must be grabbed in the order
+**     "queue", "lock".
 **
 ** File system operations (invoked by SQLite thread):
 **
@@ -99,20 +95,22 @@ static void asyncTrace(const char *zFormat, ...){
 **
 **         asyncWrite, asyncClose, asyncTruncate, asyncSync 
 **    
-**     The operations above add an entry to the global write-op list. They
-**     prepare the entry, acquire the async.queueMutex momentarily while
-**     list pointers are  manipulated to insert the new entry, then release
-**     the mutex and signal the writer thread to wake up in case it happens
-**     to be asleep.
+**     The operations above add an entry to the write-op queue for the
+**     file. They prepare the entry, acquire the async.queueMutex 
+**     momentarily while list pointers are  manipulated to insert the new
+**     entry, then release the mutex and signal the writer threads to wake
+**     up in case they happen to be asleep. If a limit has been configured
+**     on the amount of data queued (see SQLITEASYNC_MAXQUEUE), asyncWrite
+**     may first block until the writer threads have made enough room.
 **
 **    
 **         asyncRead, asyncFileSize.
 **
 **     Read operations. Both of these read from both the underlying file
 **     first then adjust their result based on pending writes in the 
-**     write-op queue.   So async.queueMutex is held for the duration
-**     of these operations to prevent other threads from changing the
-**     queue in mid operation.
+**     file's write-op queue.   So async.queueMutex is held for the 
+**     duration of these operations to prevent other threads from changing
+**     the queue in mid operation.
 **    
 **
 **         asyncLock, asyncUnlock, asyncCheckReservedLock
@@ -123,21 +121,39 @@ static void asyncTrace(const char *zFormat, ...){
 **     and will therefore not honor them.
 **
 **
-** The writer thread:
+** The write-op queues:
 **
-**     The async.writerMutex is used to make sure only there is only
-**     a single writer thread running at a time.
+**     Each database has its own write-op queue (an AsyncQueue structure),
+**     shared by the database file and its journal files. Operations on a
+**     single queue are performed in the order in which SQLite requested
+**     them, so the on-disk state of each database always passes through
+**     the same sequence of states as it would if the parent VFS were 
+**     used directly. Operations on the queues of different databases are
+**     independent of each other and may be performed in any order, or
+**     concurrently by two or more writer threads, except that operations
+**     on a master journal file (and deletes of files that belong to no
+**     open database) are barriers. See asyncNextQueue() for details.
 **
-**     Inside the writer thread is a loop that works like this:
+** The writer threads:
 **
-**         WHILE (write-op list is not empty)
-**             Do IO operation at head of write-op list
-**             Remove entry from head of write-op list
+**     Any number of threads may call sqlite3async_run() at the same time.
+**     Inside each writer thread is a loop that works like this:
+**
+**         WHILE (any write-op queue is not empty)
+**             Choose a queue that no other writer is using
+**             Do IO operation at head of the queue
+**             Remove entry from head of the queue
 **         END WHILE
 **
-**     The async.queueMutex is always held during the <write-op list is 
-**     not empty> test, and when the entry is removed from the head
-**     of the write-op list. Sometimes it is held for the interim
+**     If the operation at the head of the queue is an ASYNC_WRITE, then
+**     any ASYNC_WRITE operations that immediately follow it on the same
+**     queue, for the same file handle, and write to the region of the file
+**     that immediately follows it are gathered into a single buffer and
+**     written using a single call to the xWrite() method of the parent VFS.
+**
+**     The async.queueMutex is always held while a queue is chosen, and
+**     when the entry is removed from the head of the queue. Sometimes it
+**     is held for the interim
 **     period (while the IO is performed), and sometimes it is
 **     relinquished. It is relinquished if (a) the IO op is an
 **     ASYNC_CLOSE or (b) when the file handle was opened, two of
@@ -176,31 +192,33 @@ static void asyncTrace(const char *zFormat, ...){
 ** compatible systems and one for Win32. These functions isolate the OS
 ** specific code required by each platform.
 **
-** The system uses three mutexes and a single condition variable. To
-** block on a mutex, async_mutex_enter() is called. The parameter passed
-** to async_mutex_enter(), which must be one of ASYNC_MUTEX_LOCK,
-** ASYNC_MUTEX_QUEUE or ASYNC_MUTEX_WRITER, identifies which of the three
-** mutexes to lock. Similarly, to unlock a mutex, async_mutex_leave() is
-** called with a parameter identifying the mutex being unlocked. Mutexes
+** The system uses two mutexes and two condition variables. To block on a
+** mutex, async_mutex_enter() is called. The parameter passed to 
+** async_mutex_enter(), which must be one of ASYNC_MUTEX_LOCK or
+** ASYNC_MUTEX_QUEUE, identifies which of the two mutexes to lock. 
+** Similarly, to unlock a mutex, async_mutex_leave() is called with a
+** parameter identifying the mutex being unlocked. Mutexes
 ** are not recursive - it is an error to call async_mutex_enter() to
 ** lock a mutex that is already locked, or to call async_mutex_leave()
 ** to unlock a mutex that is not currently locked.
 **
 ** The async_cond_wait() and async_cond_signal() functions are modelled
 ** on the pthreads functions with similar names. The first parameter to
-** both functions is always ASYNC_COND_QUEUE. When async_cond_wait()
+** both functions is either ASYNC_COND_QUEUE, which is signalled when
+** operations are added to or removed from the write-op queues, or
+** ASYNC_COND_SPACE, which is signalled when room is made for new 
+** ASYNC_WRITE operations on the queues. When async_cond_wait()
 ** is called the mutex identified by the second parameter must be held.
 ** The mutex is unlocked, and the calling thread simultaneously begins 
 ** waiting for the condition variable to be signalled by another thread.
 ** After another thread signals the condition variable, the calling
 ** thread stops waiting, locks mutex eMutex and returns. The 
-** async_cond_signal() function is used to signal the condition variable. 
-** It is assumed that the mutex used by the thread calling async_cond_wait() 
-** is held by the caller of async_cond_signal() (otherwise there would be 
-** a race condition).
+** async_cond_signal() function is used to signal the condition variable,
+** waking all threads that are waiting on it. It is assumed that the mutex
+** used by the thread calling async_cond_wait() is held by the caller of 
+** async_cond_signal() (otherwise there would be a race condition).
 **
-** It is guaranteed that no other thread will call async_cond_wait() when
-** there is already a thread waiting on the condition variable.
+** Any number of threads may wait on each condition variable at once.
 **
 ** The async_sched_yield() function is called to suggest to the operating
 ** system that it would be a good time to shift the current thread off the
@@ -237,10 +255,10 @@ static void async_os_shutdown(void);
 */
 #define ASYNC_MUTEX_LOCK    0
 #define ASYNC_MUTEX_QUEUE   1
-#define ASYNC_MUTEX_WRITER  2
 
 /* Values for use as the 'eCond' argument of the above functions. */
 #define ASYNC_COND_QUEUE    0
+#define ASYNC_COND_SPACE    1
 
 /*************************************************************************
 ** Start of OS specific code.
@@ -255,9 +273,9 @@ static void async_os_shutdown(void);
 
 static struct AsyncPrimitives {
   int isInit;
-  DWORD aHolder[3];
-  CRITICAL_SECTION aMutex[3];
-  HANDLE aCond[1];
+  DWORD aHolder[2];
+  CRITICAL_SECTION aMutex[2];
+  HANDLE aCond[2];
 } primitives = { 0 };
 
 static int async_os_initialize(void){
@@ -266,9 +284,13 @@ static int async_os_initialize(void){
     if( primitives.aCond[0]==NULL ){
       return 1;
     }
+    primitives.aCond[1] = CreateEvent(NULL, TRUE, FALSE, 0);
+    if( primitives.aCond[1]==NULL ){
+      CloseHandle(primitives.aCond[0]);
+      return 1;
+    }
     InitializeCriticalSection(&primitives.aMutex[0]);
     InitializeCriticalSection(&primitives.aMutex[1]);
-    InitializeCriticalSection(&primitives.aMutex[2]);
     primitives.isInit = 1;
   }
   return 0;
@@ -277,23 +299,22 @@ static void async_os_shutdown(void){
   if( primitives.isInit ){
     DeleteCriticalSection(&primitives.aMutex[0]);
     DeleteCriticalSection(&primitives.aMutex[1]);
-    DeleteCriticalSection(&primitives.aMutex[2]);
     CloseHandle(primitives.aCond[0]);
+    CloseHandle(primitives.aCond[1]);
     primitives.isInit = 0;
   }
 }
 
 /* The following block contains the Win32 specific code. */
 static void async_mutex_enter(int eMutex){
-  assert( eMutex==0 || eMutex==1 || eMutex==2 );
-  assert( eMutex!=2 || (!mutex_held(0) && !mutex_held(1) && !mutex_held(2)) );
+  assert( eMutex==0 || eMutex==1 );
   assert( eMutex!=1 || (!mutex_held(0) && !mutex_held(1)) );
   assert( eMutex!=0 || (!mutex_held(0)) );
   EnterCriticalSection(&primitives.aMutex[eMutex]);
   TESTONLY( primitives.aHolder[eMutex] = GetCurrentThreadId(); )
 }
 static void async_mutex_leave(int eMutex){
-  assert( eMutex==0 || eMutex==1 || eMutex==2 );
+  assert( eMutex==0 || eMutex==1 );
   assert( mutex_held(eMutex) );
   TESTONLY( primitives.aHolder[eMutex] = 0; )
   LeaveCriticalSection(&primitives.aMutex[eMutex]);
@@ -323,34 +344,33 @@ static int  async_os_initialize(void) {return 0;}
 static void async_os_shutdown(void) {}
 
 static struct AsyncPrimitives {
-  pthread_mutex_t aMutex[3];
-  pthread_cond_t aCond[1];
-  pthread_t aHolder[3];
+  pthread_mutex_t aMutex[2];
+  pthread_cond_t aCond[2];
+  pthread_t aHolder[2];
 } primitives = {
   { PTHREAD_MUTEX_INITIALIZER, 
-    PTHREAD_MUTEX_INITIALIZER, 
     PTHREAD_MUTEX_INITIALIZER
   } , {
+    PTHREAD_COND_INITIALIZER,
     PTHREAD_COND_INITIALIZER
-  } , { 0, 0, 0 }
+  } , { 0, 0 }
 };
 
 static void async_mutex_enter(int eMutex){
-  assert( eMutex==0 || eMutex==1 || eMutex==2 );
-  assert( eMutex!=2 || (!mutex_held(0) && !mutex_held(1) && !mutex_held(2)) );
+  assert( eMutex==0 || eMutex==1 );
   assert( eMutex!=1 || (!mutex_held(0) && !mutex_held(1)) );
   assert( eMutex!=0 || (!mutex_held(0)) );
   pthread_mutex_lock(&primitives.aMutex[eMutex]);
   TESTONLY( primitives.aHolder[eMutex] = pthread_self(); )
 }
 static void async_mutex_leave(int eMutex){
-  assert( eMutex==0 || eMutex==1 || eMutex==2 );
+  assert( eMutex==0 || eMutex==1 );
   assert( mutex_held(eMutex) );
   TESTONLY( primitives.aHolder[eMutex] = 0; )
   pthread_mutex_unlock(&primitives.aMutex[eMutex]);
 }
 static void async_cond_wait(int eCond, int eMutex){
-  assert( eMutex==0 || eMutex==1 || eMutex==2 );
+  assert( eMutex==0 || eMutex==1 );
   assert( mutex_held(eMutex) );
   TESTONLY( primitives.aHolder[eMutex] = 0; )
   pthread_cond_wait(&primitives.aCond[eCond], &primitives.aMutex[eMutex]);
@@ -358,7 +378,7 @@ static void async_cond_wait(int eCond, int eMutex){
 }
 static void async_cond_signal(int eCond){
   assert( mutex_held(ASYNC_MUTEX_QUEUE) );
-  pthread_cond_signal(&primitives.aCond[eCond]);
+  pthread_cond_broadcast(&primitives.aCond[eCond]);
 }
 static void async_sched_yield(void){
   sched_yield();
@@ -376,22 +396,67 @@ static void async_sched_yield(void){
 #define SQLITE_ASYNC_TWO_FILEHANDLES 1
 #endif
 
+/*
+** The largest number of bytes that a writer thread will gather from
+** contiguous ASYNC_WRITE operations into a single call to xWrite().
+*/
+#ifndef SQLITE_ASYNC_MAX_COALESCE
+# define SQLITE_ASYNC_MAX_COALESCE 131072
+#endif
+
+/*
+** An instance of this structure is allocated for each database that has
+** files open using the asynchronous VFS, and for each anonymous temporary
+** file. All operations on the database file and its journal files are
+** added to the same queue, in the order in which SQLite requests them.
+**
+** Queues are identified by AsyncQueue.zKey, the name of the database
+** file (see asyncQueueKey()). zKey is NULL for queues belonging to
+** anonymous files. All queues are linked into the async.pQueue list.
+** A queue is freed once it is empty and no file handle refers to it.
+**
+** If AsyncQueue.isBarrier is true, then each operation on the queue is
+** a barrier: it is not started until all operations queued before it (on
+** any queue) have been completed, and no operation queued after it (on
+** any queue) is started until it has completed. This is used for master
+** journal files, and for the queue of deletes of files that do not belong
+** to any open database (asyncMiscQueue).
+*/
+struct AsyncQueue {
+  AsyncWrite *pFirst;          /* Next operation to be processed */
+  AsyncWrite *pLast;           /* Last operation on the queue */
+  char *zKey;                  /* Database name, or NULL */
+  int nKey;                    /* Length of zKey in bytes */
+  int nRef;                    /* Number of file handles using this queue */
+  int isBusy;                  /* True while a writer is processing pFirst */
+  int isBarrier;               /* True if all ops on this queue are barriers */
+  AsyncQueue *pNext;           /* Next in linked list headed by async.pQueue */
+};
+
+static AsyncQueue asyncMiscQueue = { 0, 0, 0, 0, 0, 0, 1, 0 };
+
 /*
 ** State information is held in the static variable "async" defined
 ** as the following structure.
 **
-** Both async.ioError and async.nFile are protected by async.queueMutex.
+** The async.pQueue list and all the AsyncQueue structures it contains,
+** async.iSeq, async.nPending, async.nQueueByte, async.nWriter, 
+** async.ioError and async.nFile are protected by async.queueMutex.
 */
 static struct TestAsyncStaticData {
-  AsyncWrite *pQueueFirst;     /* Next write operation to be processed */
-  AsyncWrite *pQueueLast;      /* Last write operation on the list */
+  AsyncQueue *pQueue;          /* Linked list of all AsyncQueue structures */
   AsyncLock *pLock;            /* Linked list of all AsyncLock structures */
+  sqlite3_int64 iSeq;          /* Sequence number of last queued operation */
+  sqlite3_int64 nQueueByte;    /* Bytes of data queued by ASYNC_WRITE ops */
+  int nPending;                /* Number of queued operations */
+  int nWriter;                 /* Number of sqlite3async_run() calls running */
   volatile int ioDelay;        /* Extra delay between write operations */
   volatile int eHalt;          /* One of the SQLITEASYNC_HALT_XXX values */
   volatile int bLockFiles;     /* Current value of "lockfiles" parameter */
+  volatile int mxQueueByte;    /* Current value of "maxqueue" parameter */
   int ioError;                 /* True if an IO error has occurred */
   int nFile;                   /* Number of open files (from sqlite pov) */
-} async = { 0,0,0,0,0,1,0,0 };
+} async = { &asyncMiscQueue,0,0,0,0,0,0,0,1,0,0,0 };
 
 /* Possible values of AsyncWrite.op */
 #define ASYNC_NOOP          0
@@ -456,9 +521,10 @@ struct AsyncWrite {
   AsyncFileData *pFileData;    /* File to write data to or sync */
   int op;                      /* One of ASYNC_xxx etc. */
   sqlite_int64 iOffset;        /* See above */
+  sqlite_int64 iSeq;           /* Order in which operations were queued */
   int nByte;          /* See above */
   char *zBuf;         /* Data to write to file (or NULL if op!=ASYNC_WRITE) */
-  AsyncWrite *pNext;  /* Next write operation (to any file) */
+  AsyncWrite *pNext;  /* Next write operation on the same queue */
 };
 
 /*
@@ -522,34 +588,168 @@ struct AsyncFileData {
   sqlite3_file *pBaseWrite;  /* Write handle to the underlying Os file */
   AsyncFileLock lock;        /* Lock state for this handle */
   AsyncLock *pLock;          /* AsyncLock object for this file system entry */
+  AsyncQueue *pQueue;        /* Write-op queue for this file */
   AsyncWrite closeOp;        /* Preallocated close operation */
 };
 
 /*
-** Add an entry to the end of the global write-op list. pWrite should point 
+** Return the number of bytes at the start of file name zName that make
+** up the key of the write-op queue used by the file. This is the name of
+** the file, less any "-journal" or "-wal" suffix, so that a database and
+** its journal files share a single queue.
+*/
+static int asyncQueueKey(const char *zName){
+  int n = (int)strlen(zName);
+  if( n>8 && memcmp(&zName[n-8], "-journal", 8)==0 ) return n-8;
+  if( n>4 && memcmp(&zName[n-4], "-wal", 4)==0 ) return n-4;
+  return n;
+}
+
+/*
+** Return the write-op queue used by files named zName, or NULL if there
+** is no such queue. The queue mutex must be held.
+*/
+static AsyncQueue *findQueue(const char *zName){
+  int nKey = asyncQueueKey(zName);
+  AsyncQueue *p;
+  assert_mutex_is_held(ASYNC_MUTEX_QUEUE);
+  for(p=async.pQueue; p; p=p->pNext){
+    if( p->zKey && p->nKey==nKey && memcmp(p->zKey, zName, nKey)==0 ) break;
+  }
+  return p;
+}
+
+/*
+** Set AsyncFileData.pQueue to point to the write-op queue that should be
+** used by file pData, creating it if necessary, and increment the queues
+** reference count. The flags argument is the flags passed to xOpen().
+** Return SQLITE_OK if successful, or SQLITE_NOMEM if a malloc fails.
+*/
+static int asyncQueueAcquire(AsyncFileData *pData, int flags){
+  AsyncQueue *pQueue = 0;
+  int rc = SQLITE_OK;
+
+  async_mutex_enter(ASYNC_MUTEX_QUEUE);
+  if( pData->zName ){
+    pQueue = findQueue(pData->zName);
+  }
+  if( !pQueue ){
+    int nKey = pData->zName ? asyncQueueKey(pData->zName) : 0;
+    pQueue = (AsyncQueue *)sqlite3_malloc(sizeof(AsyncQueue) + nKey);
+    if( pQueue ){
+      memset(pQueue, 0, sizeof(AsyncQueue));
+      if( pData->zName ){
+        pQueue->zKey = (char *)&pQueue[1];
+        pQueue->nKey = nKey;
+        memcpy(pQueue->zKey, pData->zName, nKey);
+      }
+      pQueue->pNext = async.pQueue;
+      async.pQueue = pQueue;
+    }else{
+      rc = SQLITE_NOMEM;
+    }
+  }
+  if( pQueue ){
+    pQueue->nRef++;
+    if( flags&SQLITE_OPEN_MASTER_JOURNAL ){
+      pQueue->isBarrier = 1;
+    }
+    pData->pQueue = pQueue;
+  }
+  async_mutex_leave(ASYNC_MUTEX_QUEUE);
+  return rc;
+}
+
+/*
+** Free write-op queue pQueue if it is empty, not in use by a writer 
+** thread and not referred to by any file handle. The queue mutex must 
+** be held.
+*/
+static void asyncQueueFreeIfUnused(AsyncQueue *pQueue){
+  assert_mutex_is_held(ASYNC_MUTEX_QUEUE);
+  if( pQueue->nRef==0 && pQueue->pFirst==0 && !pQueue->isBusy 
+   && pQueue!=&asyncMiscQueue
+  ){
+    AsyncQueue **pp;
+    for(pp=&async.pQueue; *pp!=pQueue; pp=&((*pp)->pNext));
+    *pp = pQueue->pNext;
+    sqlite3_free(pQueue);
+  }
+}
+
+/*
+** Decrement the reference count of the write-op queue used by file pData.
+** This is called if an error occurs after asyncQueueAcquire() has been
+** called within asyncOpen().
+*/
+static void asyncQueueRelease(AsyncFileData *pData){
+  async_mutex_enter(ASYNC_MUTEX_QUEUE);
+  pData->pQueue->nRef--;
+  asyncQueueFreeIfUnused(pData->pQueue);
+  async_mutex_leave(ASYNC_MUTEX_QUEUE);
+}
+
+/*
+** Add an entry to the end of a write-op queue. pWrite should point 
 ** to an AsyncWrite structure allocated using sqlite3_malloc().  The writer
 ** thread will call sqlite3_free() to free the structure after the specified
 ** operation has been completed.
 **
-** Once an AsyncWrite structure has been added to the list, it becomes the
+** Once an AsyncWrite structure has been added to the queue, it becomes the
 ** property of the writer thread and must not be read or modified by the
 ** caller.  
+**
+** Operations on a file are added to the queue of that file (see 
+** AsyncFileData.pQueue). An ASYNC_DELETE operation is added to the queue
+** used by files with the name being deleted, if there is one, or to
+** asyncMiscQueue otherwise.
+**
+** If pWrite is an ASYNC_WRITE operation, the "maxqueue" parameter is 
+** non-zero and adding pWrite would make the total size of the data in
+** queued ASYNC_WRITE operations exceed it, then this function blocks 
+** until the writer threads have made enough room. It does not block if
+** no writer thread is running, or if the queues are empty.
 */
 static void addAsyncWrite(AsyncWrite *pWrite){
+  AsyncQueue *pQueue;
+
   /* We must hold the queue mutex in order to modify the queue pointers */
   if( pWrite->op!=ASYNC_UNLOCK ){
     async_mutex_enter(ASYNC_MUTEX_QUEUE);
   }
 
+  if( pWrite->op==ASYNC_WRITE ){
+    while( async.mxQueueByte>0 
+        && async.nQueueByte>0
+        && async.nQueueByte+pWrite->nByte>async.mxQueueByte
+        && async.nWriter>0
+        && async.eHalt!=SQLITEASYNC_HALT_NOW
+    ){
+      ASYNC_TRACE(("FULL %d bytes\n", (int)async.nQueueByte));
+      async_cond_wait(ASYNC_COND_SPACE, ASYNC_MUTEX_QUEUE);
+    }
+    async.nQueueByte += pWrite->nByte;
+  }
+
+  if( pWrite->pFileData ){
+    pQueue = pWrite->pFileData->pQueue;
+  }else{
+    assert( pWrite->op==ASYNC_DELETE );
+    pQueue = findQueue(pWrite->zBuf);
+    if( !pQueue ) pQueue = &asyncMiscQueue;
+  }
+
   /* Add the record to the end of the write-op queue */
   assert( !pWrite->pNext );
-  if( async.pQueueLast ){
-    assert( async.pQueueFirst );
-    async.pQueueLast->pNext = pWrite;
+  if( pQueue->pLast ){
+    assert( pQueue->pFirst );
+    pQueue->pLast->pNext = pWrite;
   }else{
-    async.pQueueFirst = pWrite;
+    pQueue->pFirst = pWrite;
   }
-  async.pQueueLast = pWrite;
+  pQueue->pLast = pWrite;
+  pWrite->iSeq = ++async.iSeq;
+  async.nPending++;
   ASYNC_TRACE(("PUSH %p (%s %s %d)\n", pWrite, azOpcodeName[pWrite->op],
          pWrite->pFileData ? pWrite->pFileData->zName : "-", pWrite->iOffset));
 
@@ -557,8 +757,8 @@ static void addAsyncWrite(AsyncWrite *pWrite){
     async.nFile--;
   }
 
-  /* The writer thread might have been idle because there was nothing
-  ** on the write-op queue for it to do.  So wake it up. */
+  /* The writer threads might have been idle because there was nothing
+  ** on the write-op queues for them to do.  So wake them up. */
   async_cond_signal(ASYNC_COND_QUEUE);
 
   /* Drop the queue mutex */
@@ -655,7 +855,7 @@ static int asyncWrite(
 /*
 ** Read data from the file. First we read from the filesystem, then adjust 
 ** the contents of the buffer based on ASYNC_WRITE operations in the 
-** write-op queue.
+** file's write-op queue.
 **
 ** This method holds the mutex from start to finish.
 */
@@ -699,7 +899,7 @@ static int asyncRead(
     AsyncWrite *pWrite;
     char *zName = p->zName;
 
-    for(pWrite=async.pQueueFirst; pWrite; pWrite = pWrite->pNext){
+    for(pWrite=p->pQueue->pFirst; pWrite; pWrite = pWrite->pNext){
       if( pWrite->op==ASYNC_WRITE && (
         (pWrite->pFileData==p) ||
         (zName && pWrite->pFileData->zName==zName)
@@ -756,8 +956,8 @@ static int asyncSync(sqlite3_file *pFile, int flags){
 
 /*
 ** Read the size of the file. First we read the size of the file system 
-** entry, then adjust for any ASYNC_WRITE or ASYNC_TRUNCATE operations 
-** currently in the write-op list. 
+** entry, then adjust for any ASYNC_DELETE, ASYNC_WRITE or ASYNC_TRUNCATE
+** operations currently in the write-op queues. 
 **
 ** This method holds the mutex from start to finish.
 */
@@ -781,7 +981,16 @@ int asyncFileSize(sqlite3_file *pFile, sqlite3_int64 *piSize){
 
   if( rc==SQLITE_OK ){
     AsyncWrite *pWrite;
-    for(pWrite=async.pQueueFirst; pWrite; pWrite = pWrite->pNext){
+
+    /* An ASYNC_DELETE on asyncMiscQueue was queued before any of the 
+    ** operations on the file's own queue. */
+    for(pWrite=asyncMiscQueue.pFirst; pWrite; pWrite = pWrite->pNext){
+      if( p->zName && strcmp(p->zName, pWrite->zBuf)==0 ){
+        s = 0;
+      }
+    }
+
+    for(pWrite=p->pQueue->pFirst; pWrite; pWrite = pWrite->pNext){
       if( pWrite->op==ASYNC_DELETE 
        && p->zName 
        && strcmp(p->zName, pWrite->zBuf)==0 
@@ -1144,6 +1353,19 @@ static int asyncOpen(
 
   if( rc==SQLITE_OK ){
     pData->pLock = pLock;
+    rc = asyncQueueAcquire(pData, flags);
+    if( rc!=SQLITE_OK ){
+      async_mutex_enter(ASYNC_MUTEX_LOCK);
+      unlinkAsyncFile(pData);
+      async_mutex_leave(ASYNC_MUTEX_LOCK);
+      if( pData->pBaseRead->pMethods ){
+        pData->pBaseRead->pMethods->xClose(pData->pBaseRead);
+      }
+      if( pData->pBaseWrite->pMethods ){
+        pData->pBaseWrite->pMethods->xClose(pData->pBaseWrite);
+      }
+      sqlite3_free(pData);
+    }
   }
 
   if( rc==SQLITE_OK && isAsyncOpen ){
@@ -1154,6 +1376,7 @@ static int asyncOpen(
       async_mutex_enter(ASYNC_MUTEX_LOCK);
       unlinkAsyncFile(pData);
       async_mutex_leave(ASYNC_MUTEX_LOCK);
+      asyncQueueRelease(pData);
       sqlite3_free(pData);
     }
   }
@@ -1187,7 +1410,6 @@ static int asyncAccess(
 ){
   int rc;
   int ret;
-  AsyncWrite *p;
   sqlite3_vfs *pVfs = (sqlite3_vfs *)pAsyncVfs->pAppData;
 
   assert(flags==SQLITE_ACCESS_READWRITE 
@@ -1198,14 +1420,23 @@ static int asyncAccess(
   async_mutex_enter(ASYNC_MUTEX_QUEUE);
   rc = pVfs->xAccess(pVfs, zName, flags, &ret);
   if( rc==SQLITE_OK && flags==SQLITE_ACCESS_EXISTS ){
-    for(p=async.pQueueFirst; p; p = p->pNext){
-      if( p->op==ASYNC_DELETE && 0==strcmp(p->zBuf, zName) ){
-        ret = 0;
-      }else if( p->op==ASYNC_OPENEXCLUSIVE 
-             && p->pFileData->zName
-             && 0==strcmp(p->pFileData->zName, zName) 
-      ){
-        ret = 1;
+    /* Operations on asyncMiscQueue were all queued before those on the
+    ** queue used by files named zName, if any. */
+    AsyncQueue *aQueue[2];
+    int i;
+    aQueue[0] = &asyncMiscQueue;
+    aQueue[1] = findQueue(zName);
+    for(i=0; i<2 && aQueue[i]; i++){
+      AsyncWrite *p;
+      for(p=aQueue[i]->pFirst; p; p = p->pNext){
+        if( p->op==ASYNC_DELETE && 0==strcmp(p->zBuf, zName) ){
+          ret = 0;
+        }else if( p->op==ASYNC_OPENEXCLUSIVE 
+               && p->pFileData->zName
+               && 0==strcmp(p->pFileData->zName, zName) 
+        ){
+          ret = 1;
+        }
       }
     }
   }
@@ -1315,62 +1546,124 @@ static sqlite3_vfs async_vfs = {
   asyncCurrentTime      /* xDlClose */
 };
 
+/*
+** Return the write-op queue from which the next operation should be
+** processed, or NULL if no queued operation may be started at this time.
+** The queue mutex must be held.
+**
+** Operations on a single queue are always processed in the order in 
+** which they were queued, and never by two writer threads at once. 
+** Operations on different queues may be processed in any order, subject
+** to the following rule: an operation on a barrier queue (one for which
+** AsyncQueue.isBarrier is set) is only started after all operations 
+** queued before it have been completed, and no operation queued after it
+** is started until it has been completed. This preserves the ordering 
+** required by multi-file transactions: the master journal is written and
+** synced before any of the child journals are modified to point to it, 
+** and it is deleted (committing the transaction) only after all databases
+** have been synced and before any of the child journals are deleted.
+**
+** Of the queues from which an operation may be started, the one with the
+** oldest operation at its head is returned.
+*/
+static AsyncQueue *asyncNextQueue(void){
+  AsyncQueue *pQueue;
+  AsyncQueue *pRet = 0;
+  sqlite3_int64 iMin = 0;          /* Oldest operation on any queue */
+  sqlite3_int64 iBarrier = 0;      /* Oldest operation on a barrier queue */
+
+  assert_mutex_is_held(ASYNC_MUTEX_QUEUE);
+  for(pQueue=async.pQueue; pQueue; pQueue=pQueue->pNext){
+    AsyncWrite *p = pQueue->pFirst;
+    if( p ){
+      if( iMin==0 || p->iSeq<iMin ) iMin = p->iSeq;
+      if( pQueue->isBarrier && (iBarrier==0 || p->iSeq<iBarrier) ){
+        iBarrier = p->iSeq;
+      }
+    }
+  }
+
+  for(pQueue=async.pQueue; pQueue; pQueue=pQueue->pNext){
+    AsyncWrite *p = pQueue->pFirst;
+    if( p && !pQueue->isBusy
+     && (pQueue->isBarrier ? p->iSeq==iMin : (iBarrier==0 || p->iSeq<iBarrier))
+     && (pRet==0 || p->iSeq<pRet->pFirst->iSeq)
+    ){
+      pRet = pQueue;
+    }
+  }
+  return pRet;
+}
+
 /* 
 ** This procedure runs in a separate thread, reading messages off of the
-** write queue and processing them one by one.  
+** write queues and processing them one by one.  
 **
 ** If async.writerHaltNow is true, then this procedure exits
 ** after processing a single message.
 **
 ** If async.writerHaltWhenIdle is true, then this procedure exits when
-** the write queue is empty.
+** the write queues are empty.
 **
 ** If both of the above variables are false, this procedure runs
-** indefinately, waiting for operations to be added to the write queue
+** indefinately, waiting for operations to be added to the write queues
 ** and processing them in the order in which they arrive.
 **
 ** An artifical delay of async.ioDelay milliseconds is inserted before
 ** each write operation in order to simulate the effect of a slow disk.
 **
-** Only one instance of this procedure may be running at a time.
+** Any number of instances of this procedure may be running at a time. 
+** Each processes operations from queues that are not being used by any
+** other instance.
 */
 static void asyncWriterThread(void){
   sqlite3_vfs *pVfs = (sqlite3_vfs *)(async_vfs.pAppData);
-  AsyncWrite *p = 0;
-  int rc = SQLITE_OK;
-  int holdingMutex = 0;
+  char *aBuf = 0;              /* Buffer used to gather ASYNC_WRITE data */
+  int nBuf = 0;                /* Allocated size of aBuf[] in bytes */
 
-  async_mutex_enter(ASYNC_MUTEX_WRITER);
+  async_mutex_enter(ASYNC_MUTEX_QUEUE);
+  async.nWriter++;
 
   while( async.eHalt!=SQLITEASYNC_HALT_NOW ){
-    int doNotFree = 0;
+    AsyncQueue *pQueue;        /* Queue to process an operation from */
+    AsyncWrite *p;             /* First operation to process */
+    AsyncWrite *pLast;         /* Last operation to process */
+    AsyncFileData *pClose = 0; /* File closed by an ASYNC_CLOSE */
     sqlite3_file *pBase = 0;
-
-    if( !holdingMutex ){
-      async_mutex_enter(ASYNC_MUTEX_QUEUE);
-    }
-    while( (p = async.pQueueFirst)==0 ){
-      if( async.eHalt!=SQLITEASYNC_HALT_NEVER ){
-        async_mutex_leave(ASYNC_MUTEX_QUEUE);
+    int op;                    /* Operation to perform (an ASYNC_XXX value) */
+    char *zBuf;                /* Data to write, for ASYNC_WRITE */
+    int nByte;                 /* Size of zBuf[] in bytes */
+    int holdingMutex = 1;
+    int rc = SQLITE_OK;
+
+    assert_mutex_is_held(ASYNC_MUTEX_QUEUE);
+    pQueue = asyncNextQueue();
+    if( pQueue==0 ){
+      if( async.nPending==0 && async.eHalt!=SQLITEASYNC_HALT_NEVER ){
         break;
-      }else{
-        ASYNC_TRACE(("IDLE\n"));
-        async_cond_wait(ASYNC_COND_QUEUE, ASYNC_MUTEX_QUEUE);
-        ASYNC_TRACE(("WAKEUP\n"));
       }
+      ASYNC_TRACE(("IDLE\n"));
+      async_cond_wait(ASYNC_COND_QUEUE, ASYNC_MUTEX_QUEUE);
+      ASYNC_TRACE(("WAKEUP\n"));
+      continue;
     }
-    if( p==0 ) break;
-    holdingMutex = 1;
-
-    /* Right now this thread is holding the mutex on the write-op queue.
-    ** Variable 'p' points to the first entry in the write-op queue. In
-    ** the general case, we hold on to the mutex for the entire body of
-    ** the loop. 
+    pQueue->isBusy = 1;
+    p = pLast = pQueue->pFirst;
+    op = p->op;
+    zBuf = p->zBuf;
+    nByte = p->nByte;
+
+    /* Right now this thread is holding the mutex on the write-op queues.
+    ** Variable 'p' points to the first entry in queue pQueue. In the 
+    ** general case, we hold on to the mutex for the entire body of the
+    ** loop. 
     **
     ** However in the cases enumerated below, we relinquish the mutex,
     ** perform the IO, and then re-request the mutex before removing 'p' from
     ** the head of the write-op queue. The idea is to increase concurrency with
-    ** sqlite threads.
+    ** sqlite threads and with other writer threads. No other writer thread
+    ** processes operations from pQueue in the meantime, as it is marked
+    ** as busy.
     **
     **     * An ASYNC_CLOSE operation.
     **     * An ASYNC_OPENEXCLUSIVE operation. For this one, we relinquish 
@@ -1381,15 +1674,54 @@ static void asyncWriterThread(void){
     **       SQLITE_ASYNC_TWO_FILEHANDLES was set at compile time and two
     **       file-handles are open for the particular file being "synced".
     */
-    if( async.ioError!=SQLITE_OK && p->op!=ASYNC_CLOSE ){
-      p->op = ASYNC_NOOP;
+    if( async.ioError!=SQLITE_OK && op!=ASYNC_CLOSE ){
+      op = ASYNC_NOOP;
+    }
+    if( op==ASYNC_WRITE ){
+      /* Gather the data for any ASYNC_WRITE operations on the same file 
+      ** handle that immediately follow p on the queue and that write to
+      ** the part of the file immediately following the data written by
+      ** the previous operation into buffer aBuf[], so that it can all be
+      ** written with a single call to xWrite(). If a buffer large enough 
+      ** cannot be allocated, write the data for p only.
+      */
+      AsyncWrite *pNext;
+      int n = p->nByte;
+      for(pNext=p->pNext; pNext 
+       && pNext->op==ASYNC_WRITE 
+       && pNext->pFileData==p->pFileData
+       && pNext->iOffset==p->iOffset+n
+       && n+pNext->nByte<=SQLITE_ASYNC_MAX_COALESCE; pNext=pNext->pNext
+      ){
+        n += pNext->nByte;
+        pLast = pNext;
+      }
+      if( pLast!=p ){
+        if( n>nBuf ){
+          char *aNew = (char *)sqlite3_realloc(aBuf, n);
+          if( aNew ){
+            aBuf = aNew;
+            nBuf = n;
+          }
+        }
+        if( n<=nBuf ){
+          nByte = 0;
+          for(pNext=p; pNext!=pLast->pNext; pNext=pNext->pNext){
+            memcpy(&aBuf[nByte], pNext->zBuf, pNext->nByte);
+            nByte += pNext->nByte;
+          }
+          zBuf = aBuf;
+        }else{
+          pLast = p;
+        }
+      }
     }
     if( p->pFileData ){
       pBase = p->pFileData->pBaseWrite;
       if( 
-        p->op==ASYNC_CLOSE || 
-        p->op==ASYNC_OPENEXCLUSIVE ||
-        (pBase->pMethods && (p->op==ASYNC_SYNC || p->op==ASYNC_WRITE) ) 
+        op==ASYNC_CLOSE || 
+        op==ASYNC_OPENEXCLUSIVE ||
+        (pBase->pMethods && (op==ASYNC_SYNC || op==ASYNC_WRITE) ) 
       ){
         async_mutex_leave(ASYNC_MUTEX_QUEUE);
         holdingMutex = 0;
@@ -1399,15 +1731,15 @@ static void asyncWriterThread(void){
       }
     }
 
-    switch( p->op ){
+    switch( op ){
       case ASYNC_NOOP:
         break;
 
       case ASYNC_WRITE:
         assert( pBase );
         ASYNC_TRACE(("WRITE %s %d bytes at %d\n",
-                p->pFileData->zName, p->nByte, p->iOffset));
-        rc = pBase->pMethods->xWrite(pBase, (void *)(p->zBuf), p->nByte, p->iOffset);
+                p->pFileData->zName, nByte, p->iOffset));
+        rc = pBase->pMethods->xWrite(pBase, (void *)zBuf, nByte, p->iOffset);
         break;
 
       case ASYNC_SYNC:
@@ -1441,14 +1773,9 @@ static void asyncWriterThread(void){
         rc = unlinkAsyncFile(pData);
         async_mutex_leave(ASYNC_MUTEX_LOCK);
 
-        if( !holdingMutex ){
-          async_mutex_enter(ASYNC_MUTEX_QUEUE);
-          holdingMutex = 1;
-        }
-        assert_mutex_is_held(ASYNC_MUTEX_QUEUE);
-        async.pQueueFirst = p->pNext;
-        sqlite3_free(pData);
-        doNotFree = 1;
+        /* The AsyncFileData structure (which contains the AsyncWrite 
+        ** structure p) is freed once p has been removed from the queue. */
+        pClose = pData;
         break;
       }
 
@@ -1486,10 +1813,13 @@ static void asyncWriterThread(void){
         **
         **   2) Only unlocks the file at all if this event is the last
         **      ASYNC_UNLOCK event on this file in the write-queue.
+        **
+        ** All operations on a file are added to the same queue, so only
+        ** pQueue need be searched for later ASYNC_UNLOCK events.
         */ 
         assert( holdingMutex==1 );
-        assert( async.pQueueFirst==p );
-        for(pIter=async.pQueueFirst->pNext; pIter; pIter=pIter->pNext){
+        assert( pQueue->pFirst==p );
+        for(pIter=p->pNext; pIter; pIter=pIter->pNext){
           if( pIter->pFileData==pData && pIter->op==ASYNC_UNLOCK ) break;
         }
         if( !pIter ){
@@ -1525,23 +1855,37 @@ static void asyncWriterThread(void){
     }
 
     /* If we didn't hang on to the mutex during the IO op, obtain it now
-    ** so that the AsyncWrite structure can be safely removed from the 
-    ** global write-op queue.
+    ** so that the AsyncWrite structures can be safely removed from the 
+    ** write-op queue.
     */
     if( !holdingMutex ){
       async_mutex_enter(ASYNC_MUTEX_QUEUE);
       holdingMutex = 1;
     }
-    /* ASYNC_TRACE(("UNLINK %p\n", p)); */
-    if( p==async.pQueueLast ){
-      async.pQueueLast = 0;
+    assert_mutex_is_held(ASYNC_MUTEX_QUEUE);
+    assert( pQueue->pFirst==p && pQueue->isBusy );
+    pQueue->pFirst = pLast->pNext;
+    if( pQueue->pFirst==0 ){
+      pQueue->pLast = 0;
+    }
+    pQueue->isBusy = 0;
+    while( p ){
+      AsyncWrite *pNext = (p==pLast ? 0 : p->pNext);
+      /* ASYNC_TRACE(("UNLINK %p\n", p)); */
+      async.nPending--;
+      if( p->op==ASYNC_WRITE ){
+        async.nQueueByte -= p->nByte;
+      }
+      if( p->op!=ASYNC_CLOSE ){
+        sqlite3_free(p);
+      }
+      p = pNext;
     }
-    if( !doNotFree ){
-      assert_mutex_is_held(ASYNC_MUTEX_QUEUE);
-      async.pQueueFirst = p->pNext;
-      sqlite3_free(p);
+    if( pClose ){
+      pQueue->nRef--;
+      sqlite3_free(pClose);
     }
-    assert( holdingMutex );
+    asyncQueueFreeIfUnused(pQueue);
 
     /* An IO error has occurred. We cannot report the error back to the
     ** connection that requested the I/O since the error happened 
@@ -1565,7 +1909,7 @@ static void asyncWriterThread(void){
       async.ioError = rc;
     }
 
-    if( async.ioError && !async.pQueueFirst ){
+    if( async.ioError && !async.nPending ){
       async_mutex_enter(ASYNC_MUTEX_LOCK);
       if( 0==async.pLock ){
         async.ioError = SQLITE_OK;
@@ -1573,21 +1917,33 @@ static void asyncWriterThread(void){
       async_mutex_leave(ASYNC_MUTEX_LOCK);
     }
 
+    /* Other writer threads may be waiting for the operation just completed
+    ** before starting an operation on a different queue. And SQLite 
+    ** threads may be waiting for the space just freed.
+    */
+    async_cond_signal(ASYNC_COND_QUEUE);
+    async_cond_signal(ASYNC_COND_SPACE);
+
     /* Drop the queue mutex before continuing to the next write operation
     ** in order to give other threads a chance to work with the write queue.
     */
-    if( !async.pQueueFirst || !async.ioError ){
+    if( !async.nPending || !async.ioError ){
       async_mutex_leave(ASYNC_MUTEX_QUEUE);
-      holdingMutex = 0;
       if( async.ioDelay>0 ){
         pVfs->xSleep(pVfs, async.ioDelay*1000);
       }else{
         async_sched_yield();
       }
+      async_mutex_enter(ASYNC_MUTEX_QUEUE);
     }
   }
-  
-  async_mutex_leave(ASYNC_MUTEX_WRITER);
+
+  /* SQLite threads waiting for space on the queues do not wait once there
+  ** are no writer threads running. */
+  async.nWriter--;
+  async_cond_signal(ASYNC_COND_SPACE);
+  async_mutex_leave(ASYNC_MUTEX_QUEUE);
+  sqlite3_free(aBuf);
   return;
 }
 
@@ -1646,6 +2002,7 @@ int sqlite3async_control(int op, ...){
       async.eHalt = eWhen;
       async_mutex_enter(ASYNC_MUTEX_QUEUE);
       async_cond_signal(ASYNC_COND_QUEUE);
+      async_cond_signal(ASYNC_COND_SPACE);
       async_mutex_leave(ASYNC_MUTEX_QUEUE);
       break;
     }
@@ -1662,7 +2019,7 @@ int sqlite3async_control(int op, ...){
     case SQLITEASYNC_LOCKFILES: {
       int bLock = va_arg(ap, int);
       async_mutex_enter(ASYNC_MUTEX_QUEUE);
-      if( async.nFile || async.pQueueFirst ){
+      if( async.nFile || async.nPending ){
         async_mutex_leave(ASYNC_MUTEX_QUEUE);
         return SQLITE_MISUSE;
       }
@@ -1670,6 +2027,18 @@ int sqlite3async_control(int op, ...){
       async_mutex_leave(ASYNC_MUTEX_QUEUE);
       break;
     }
+
+    case SQLITEASYNC_MAXQUEUE: {
+      int nMax = va_arg(ap, int);
+      if( nMax<0 ){
+        return SQLITE_MISUSE;
+      }
+      async_mutex_enter(ASYNC_MUTEX_QUEUE);
+      async.mxQueueByte = nMax;
+      async_cond_signal(ASYNC_COND_SPACE);
+      async_mutex_leave(ASYNC_MUTEX_QUEUE);
+      break;
+    }
       
     case SQLITEASYNC_GET_HALT: {
       int *peWhen = va_arg(ap, int *);
@@ -1686,6 +2055,11 @@ int sqlite3async_control(int op, ...){
       *piDelay = async.bLockFiles;
       break;
     }
+    case SQLITEASYNC_GET_MAXQUEUE: {
+      int *pnMax = va_arg(ap, int *);
+      *pnMax = async.mxQueueByte;
+      break;
+    }
 
     default:
       return SQLITE_ERROR;
@@ -92,7 +92,12 @@ void sqlite3async_shutdown();
 ** then blocks waiting for new ones.
 **
 ** If multiple simultaneous calls are made to sqlite3async_run() from two
-** or more threads, then the calls are serialized internally.
+** or more threads, then the calls share the work. Each database (together
+** with its journal files) has its own queue of pending write operations,
+** and each queue is processed by at most one thread at a time, so using
+** more than one thread only helps if more than one database is being
+** written. Operations on a single queue are always performed in the
+** order in which SQLite requested them.
 */
 void sqlite3async_run();
 
@@ -100,7 +105,7 @@ void sqlite3async_run();
 ** This function may only be called when the asynchronous IO VFS is 
 ** installed (after a call to sqlite3async_initialize()). It is used 
 ** to query or configure various parameters that affect the operation 
-** of the asynchronous IO VFS. At present there are three parameters 
+** of the asynchronous IO VFS. At present there are four parameters 
 ** supported:
 **
 **   * The "halt" parameter, which configures the circumstances under
@@ -115,13 +120,18 @@ void sqlite3async_run();
 **     not the asynchronous IO VFS locks the database files it operates
 **     on. Disabling file locking can improve throughput.
 **
+**   * The "maxqueue" parameter, which limits the amount of data that may 
+**     be waiting to be written by sqlite3async_run().
+**
 ** This function is always passed two arguments. When setting the value
 ** of a parameter, the first argument must be one of SQLITEASYNC_HALT,
-** SQLITEASYNC_DELAY or SQLITEASYNC_LOCKFILES. The second argument must
-** be passed the new value for the parameter as type "int".
+** SQLITEASYNC_DELAY, SQLITEASYNC_LOCKFILES or SQLITEASYNC_MAXQUEUE. The
+** second argument must be passed the new value for the parameter as type
+** "int".
 **
 ** When querying the current value of a paramter, the first argument must
-** be one of SQLITEASYNC_GET_HALT, GET_DELAY or GET_LOCKFILES. The second 
+** be one of SQLITEASYNC_GET_HALT, GET_DELAY, GET_LOCKFILES or GET_MAXQUEUE.
+** The second 
 ** argument to this function must be of type (int *). The current value
 ** of the queried parameter is copied to the memory pointed to by the
 ** second argument. For example:
@@ -195,6 +205,21 @@ void sqlite3async_run();
 **   Alternatively, if this parameter is set to 1, then it is safe to access
 **   the database from multiple connections within multiple processes using
 **   either the asynchronous IO VFS or the parent VFS directly.
+**
+** SQLITEASYNC_MAXQUEUE:
+**
+**   This is used to set the value of the "maxqueue" parameter, in bytes.
+**   If set to a non-zero value, then a thread that writes to a file using
+**   the asynchronous IO VFS blocks if the write would cause the total 
+**   size of the data waiting to be written to exceed the configured 
+**   value, until sqlite3async_run() has written enough of it. A write is
+**   never blocked if no call to sqlite3async_run() is in progress, if
+**   the "halt" parameter is set to NOW, or if no other data is waiting 
+**   to be written. The default value is 0 (no limit).
+**
+**   If an attempt is made to set this parameter to a negative value,
+**   sqlite3async_control() returns SQLITE_MISUSE and the current value
+**   of the parameter is not modified.
 */
 int sqlite3async_control(int op, ...);
 
@@ -207,6 +232,8 @@ int sqlite3async_control(int op, ...);
 #define SQLITEASYNC_GET_DELAY     4
 #define SQLITEASYNC_LOCKFILES     5
 #define SQLITEASYNC_GET_LOCKFILES 6
+#define SQLITEASYNC_MAXQUEUE      7
+#define SQLITEASYNC_GET_MAXQUEUE  8
 
 /*
 ** If the first argument to sqlite3async_control() is SQLITEASYNC_HALT,
@@ -314,6 +314,21 @@
   SQLITE_EXTENSION_INIT1
 #endif
 
+/*
+** Bare doclists (see fts3DoclistMerge()) are scanned a block of bytes at a
+** time where possible. Blocks are 16 bytes if SSE2 is available, or 8 bytes
+** processed as a single 64-bit integer otherwise. Define 
+** SQLITE_FTS3_NO_SIMD to always use the latter.
+*/
+#if defined(__SSE2__) && !defined(SQLITE_FTS3_NO_SIMD)
+# include <emmintrin.h>
+# define FTS3_SIMD_SSE2 1
+# define FTS3_DOCID_BLOCK 16
+#else
+# define FTS3_SIMD_SSE2 0
+# define FTS3_DOCID_BLOCK 8
+#endif
+
 /* 
 ** Write a 64-bit variable-length integer to memory starting at p[0].
 ** The length of data written will be between 1 and FTS3_VARINT_MAX bytes.
@@ -434,6 +449,94 @@ static void fts3GetDeltaVarint2(char **pp, char *pEnd, sqlite3_int64 *pVal){
   }
 }
 
+/*
+** If the FTS3_DOCID_BLOCK bytes at p[] are all single byte varints (none 
+** have the 0x80 bit set), return their sum. Otherwise return -1.
+**
+** In a bare doclist, a run of single byte varints is a run of docids
+** that are each less than 128 greater than the previous one. This is the
+** usual case for common terms, so skipping a block of them at once is
+** much faster than decoding them one at a time.
+*/
+static int fts3DocidBlockSum(const char *p){
+#if FTS3_SIMD_SSE2
+  __m128i v = _mm_loadu_si128((const __m128i *)p);
+  if( _mm_movemask_epi8(v) ) return -1;
+  v = _mm_sad_epu8(v, _mm_setzero_si128());
+  return _mm_cvtsi128_si32(v) + _mm_cvtsi128_si32(_mm_srli_si128(v, 8));
+#else
+  u64 v;
+  memcpy(&v, p, 8);
+  if( v & (u64)0x8080808080808080LL ) return -1;
+  v = (v & (u64)0x00FF00FF00FF00FFLL) + ((v>>8) & (u64)0x00FF00FF00FF00FFLL);
+  return (int)((v * (u64)0x0001000100010001LL) >> 48);
+#endif
+}
+
+/*
+** Return the number of varints that end within the FTS3_DOCID_BLOCK 
+** bytes at p[]. This is the number of bytes with the 0x80 bit clear.
+*/
+static int fts3DocidBlockCount(const char *p){
+#if FTS3_SIMD_SSE2
+  int m = _mm_movemask_epi8(_mm_loadu_si128((const __m128i *)p)) ^ 0xFFFF;
+  m = (m & 0x5555) + ((m>>1) & 0x5555);
+  m = (m & 0x3333) + ((m>>2) & 0x3333);
+  m = (m & 0x0F0F) + ((m>>4) & 0x0F0F);
+  return (m & 0xFF) + (m>>8);
+#else
+  u64 v;
+  memcpy(&v, p, 8);
+  v = (~v & (u64)0x8080808080808080LL) >> 7;
+  return (int)((v * (u64)0x0101010101010101LL) >> 56);
+#endif
+}
+
+/*
+** Advance a bare doclist iterator until it points to a docid that is 
+** greater than or equal to iTarget. When called, *piDocid is the current
+** docid and *pp points to the varint that follows it. As for 
+** fts3GetDeltaVarint2(), *pp is set to 0 if the end of the doclist (pEnd) 
+** is reached before such a docid is found.
+**
+** Whole blocks of single byte varints that end before iTarget are skipped 
+** without decoding them. This allows a short doclist to be intersected 
+** with a long one in much less time than it takes to decode the long one.
+*/
+static void fts3DocidSeek(
+  char **pp,                      /* IN/OUT: Iterator */
+  char *pEnd,                     /* End of doclist */
+  sqlite3_int64 *piDocid,         /* IN/OUT: Current docid */
+  sqlite3_int64 iTarget           /* Docid to search for */
+){
+  char *p = *pp;
+  sqlite3_int64 iDocid = *piDocid;
+  while( iDocid<iTarget ){
+    if( p>=pEnd ){
+      p = 0;
+      break;
+    }
+    if( (pEnd-p)>=FTS3_DOCID_BLOCK ){
+      int nSum = fts3DocidBlockSum(p);
+      if( nSum>=0 ){
+        if( iDocid+nSum<iTarget ){
+          iDocid += nSum;
+          p += FTS3_DOCID_BLOCK;
+          continue;
+        }
+        /* The docid sought is within this block of single byte varints */
+        do{
+          iDocid += *p++;
+        }while( iDocid<iTarget );
+        break;
+      }
+    }
+    fts3GetDeltaVarint(&p, &iDocid);
+  }
+  *pp = p;
+  *piDocid = iDocid;
+}
+
 /*
 ** The xDisconnect() virtual table method.
 */
@@ -1848,9 +1951,9 @@ static int fts3DoclistMerge(
           fts3GetDeltaVarint2(&p2, pEnd2, &i2);
           nDoc++;
         }else if( i1<i2 ){
-          fts3GetDeltaVarint2(&p1, pEnd1, &i1);
+          fts3DocidSeek(&p1, pEnd1, &i1, i2);
         }else{
-          fts3GetDeltaVarint2(&p2, pEnd2, &i2);
+          fts3DocidSeek(&p2, pEnd2, &i2, i1);
         }
       }
       break;
@@ -1864,7 +1967,7 @@ static int fts3DoclistMerge(
           fts3PutDeltaVarint(&p, &iPrev, i1);
           fts3GetDeltaVarint2(&p1, pEnd1, &i1);
         }else{
-          fts3GetDeltaVarint2(&p2, pEnd2, &i2);
+          fts3DocidSeek(&p2, pEnd2, &i2, i1);
         }
       }
       break;
@@ -2122,14 +2225,16 @@ int sqlite3Fts3SegReaderCursor(
   );
   assert( FTS3_SEGCURSOR_PENDING<0 );
   assert( FTS3_SEGCURSOR_ALL<0 );
-  assert( iLevel==FTS3_SEGCURSOR_ALL || (zTerm==0 && isPrefix==1) );
+  assert( iLevel==FTS3_SEGCURSOR_ALL || (zTerm==0 && isPrefix==1) 
+       || (iLevel>=0 && isScan)
+  );
   assert( isPrefix==0 || isScan==0 );
 
 
   memset(pCsr, 0, sizeof(Fts3SegReaderCursor));
 
   /* If iLevel is less than 0, include a seg-reader for the pending-terms. */
-  assert( isScan==0 || fts3HashCount(&p->pendingTerms)==0 );
+  assert( isScan==0 || iLevel>=0 || fts3HashCount(&p->pendingTerms)==0 );
   if( iLevel<0 && isScan==0 ){
     rc = sqlite3Fts3SegReaderPending(p, zTerm, nTerm, isPrefix, &pPending);
     if( rc==SQLITE_OK && pPending ){
@@ -2313,6 +2418,10 @@ static int fts3DoclistCountDocids(int isPoslist, char *aList, int nList){
       ** bit cleared and zero or more bytes with the 0x80 bit set. So to
       ** count the varints in the buffer, just count the number of bytes
       ** with the 0x80 bit clear.  */
+      while( (aEnd-p)>=FTS3_DOCID_BLOCK ){
+        nDoc += fts3DocidBlockCount(p);
+        p += FTS3_DOCID_BLOCK;
+      }
       while( p<aEnd ) nDoc += (((*p++)&0x80)==0);
     }else{
       while( p<aEnd ){
@@ -3200,11 +3309,16 @@ static int fts3UpdateMethod(
 
 /*
 ** Implementation of xSync() method. Flush the contents of the pending-terms
-** hash-table to the database.
+** hash-table to the database. Then, if "automerge" is enabled, do a
+** bounded amount of incremental merge work.
 */
 static int fts3SyncMethod(sqlite3_vtab *pVtab){
-  int rc = sqlite3Fts3PendingTermsFlush((Fts3Table *)pVtab);
-  sqlite3Fts3SegmentsClose((Fts3Table *)pVtab);
+  Fts3Table *p = (Fts3Table *)pVtab;
+  int rc = sqlite3Fts3PendingTermsFlush(p);
+  if( rc==SQLITE_OK && p->nAutoMerge>0 ){
+    rc = sqlite3Fts3Incrmerge(p, p->nAutoMerge);
+  }
+  sqlite3Fts3SegmentsClose(p);
   return rc;
 }
 
@@ -30,6 +30,15 @@
 */
 #define FTS3_MERGE_COUNT 16
 
+/*
+** Once FTS3_MERGE_COUNT segments of level N exist, the merge may instead
+** be done incrementally, a few leaf blocks at a time (see the "merge=N"
+** and "automerge=N" commands in fts3_write.c). The partially merged
+** segment is built in a range of blocks reserved in advance, with room
+** for interior nodes up to this height.
+*/
+#define FTS3_MERGE_MAX_HEIGHT 16
+
 /*
 ** This is the maximum amount of data (in bytes) to store in the 
 ** Fts3Table.pendingTerms hash table. Normally, the hash table is
@@ -128,12 +137,13 @@ struct Fts3Table {
   /* Precompiled statements used by the implementation. Each of these 
   ** statements is run and reset within a single virtual table API call. 
   */
-  sqlite3_stmt *aStmt[24];
+  sqlite3_stmt *aStmt[29];
 
   char *zReadExprlist;
   char *zWriteExprlist;
 
   int nNodeSize;                  /* Soft limit for node size */
+  int nAutoMerge;                 /* Leaf blocks to merge per transaction */
   u8 bHasStat;                    /* True if %_stat table exists */
   u8 bHasDocsize;                 /* True if %_docsize table exists */
   int nPgsz;                      /* Page size for host database */
@@ -284,6 +294,7 @@ int sqlite3Fts3UpdateMethod(sqlite3_vtab*,int,sqlite3_value**,sqlite3_int64*);
 int sqlite3Fts3PendingTermsFlush(Fts3Table *);
 void sqlite3Fts3PendingTermsClear(Fts3Table *);
 int sqlite3Fts3Optimize(Fts3Table *);
+int sqlite3Fts3Incrmerge(Fts3Table *, int);
 int sqlite3Fts3SegReaderNew(int, sqlite3_int64,
   sqlite3_int64, sqlite3_int64, const char *, int, Fts3SegReader**);
 int sqlite3Fts3SegReaderPending(Fts3Table*,const char*,int,int,Fts3SegReader**);
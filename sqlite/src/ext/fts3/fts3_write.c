@@ -186,6 +186,11 @@ struct SegmentNode {
 #define SQL_SELECT_DOCSIZE            21
 #define SQL_SELECT_DOCTOTAL           22
 #define SQL_REPLACE_DOCTOTAL          23
+#define SQL_REPLACE_SEGMENTS          24
+#define SQL_REPLACE_SEGDIR            25
+#define SQL_SELECT_INCRMERGE          26
+#define SQL_SELECT_FULL_LEVEL         27
+#define SQL_DELETE_SEGDIR_ENTRY       28
 
 /*
 ** This function is used to obtain an SQLite prepared statement handle
@@ -235,6 +240,15 @@ static int fts3SqlStmt(
 /* 21 */  "SELECT size FROM %Q.'%q_docsize' WHERE docid=?",
 /* 22 */  "SELECT value FROM %Q.'%q_stat' WHERE id=0",
 /* 23 */  "REPLACE INTO %Q.'%q_stat' VALUES(0,?)",
+/* 24 */  "REPLACE INTO %Q.'%q_segments'(blockid, block) VALUES(?, ?)",
+/* 25 */  "REPLACE INTO %Q.'%q_segdir' VALUES(?,?,?,?,?,?)",
+
+          /* An incremental merge in progress has a negative end_block. */
+/* 26 */  "SELECT level, idx, start_block, leaves_end_block, end_block, root "
+            "FROM %Q.'%q_segdir' WHERE end_block < 0",
+/* 27 */  "SELECT level FROM %Q.'%q_segdir' "
+            "GROUP BY level HAVING count(*) >= ? ORDER BY level LIMIT 1",
+/* 28 */  "DELETE FROM %Q.'%q_segdir' WHERE level = ? AND idx = ?",
   };
   int rc = SQLITE_OK;
   sqlite3_stmt *pStmt;
@@ -775,6 +789,8 @@ static void fts3DeleteTerms(
 ** functions fts3SegmentMerge() and fts3AllocateSegdirIdx().
 */
 static int fts3SegmentMerge(Fts3Table *, int);
+static int fts3Incrmerge(Fts3Table *, int, int);
+static int fts3IncrmergeDiscard(Fts3Table *);
 
 /* 
 ** This function allocates a new level iLevel index in the segdir table.
@@ -786,7 +802,8 @@ static int fts3SegmentMerge(Fts3Table *, int);
 **
 ** However, if there are already FTS3_MERGE_COUNT indexes at the requested
 ** level, they are merged into a single level (iLevel+1) segment and the 
-** allocated index is 0.
+** allocated index is 0. Unless "automerge" is enabled, in which case the
+** level is left to be merged incrementally.
 **
 ** If successful, *piIdx is set to the allocated index slot and SQLITE_OK
 ** returned. Otherwise, an SQLite error code is returned.
@@ -812,8 +829,13 @@ static int fts3AllocateSegdirIdx(Fts3Table *p, int iLevel, int *piIdx){
     ** segment and allocate (newly freed) index 0 at level iLevel. Otherwise,
     ** if iNext is less than FTS3_MERGE_COUNT, allocate index iNext.
     */
-    if( iNext>=FTS3_MERGE_COUNT ){
-      rc = fts3SegmentMerge(p, iLevel);
+    if( iNext>=FTS3_MERGE_COUNT && p->nAutoMerge==0 ){
+      /* Finish any incremental merge before merging the level, so that 
+      ** the output segments keep the order required of them. */
+      rc = fts3Incrmerge(p, 0x7FFFFFFF, 1);
+      if( rc==SQLITE_OK ){
+        rc = fts3SegmentMerge(p, iLevel);
+      }
       *piIdx = 0;
     }else{
       *piIdx = iNext;
@@ -2125,6 +2147,42 @@ int sqlite3Fts3SegReaderStep(
       pCsr->aDoclist = apSegment[0]->aDoclist;
       pCsr->nDoclist = apSegment[0]->nDoclist;
       rc = SQLITE_ROW;
+    }else if( nMerge==1 && !isRequirePos && !isColFilter ){
+      /* A single doclist is required without position lists. Copy the
+      ** docids with non-empty position lists to the output buffer. This
+      ** is the common case for queries on an optimized table.
+      */
+      char *a = apSegment[0]->aDoclist;
+      char *aEnd = &a[apSegment[0]->nDoclist];
+      int nDoclist = 0;
+      sqlite3_int64 iDocid = 0;
+      sqlite3_int64 iPrev = 0;
+
+      if( apSegment[0]->nDoclist>pCsr->nBuffer ){
+        char *aNew = sqlite3_realloc(pCsr->aBuffer, apSegment[0]->nDoclist);
+        if( !aNew ) return SQLITE_NOMEM;
+        pCsr->aBuffer = aNew;
+        pCsr->nBuffer = apSegment[0]->nDoclist;
+      }
+      while( a<aEnd ){
+        sqlite3_int64 iDelta;
+        char c = 0;
+        a += sqlite3Fts3GetVarint(a, &iDelta);
+        iDocid += iDelta;
+        if( *a ){
+          nDoclist += sqlite3Fts3PutVarint(
+              &pCsr->aBuffer[nDoclist], iDocid-iPrev
+          );
+          iPrev = iDocid;
+          while( *a | c ) c = *a++ & 0x80;
+        }
+        a++;
+      }
+      if( nDoclist>0 ){
+        pCsr->aDoclist = pCsr->aBuffer;
+        pCsr->nDoclist = nDoclist;
+        rc = SQLITE_ROW;
+      }
     }else{
       int nDoclist = 0;           /* Size of doclist */
       sqlite3_int64 iPrev = 0;    /* Previous docid stored in doclist */
@@ -2230,6 +2288,20 @@ static int fts3SegmentMerge(Fts3Table *p, int iLevel){
   Fts3SegReaderCursor csr;        /* Cursor to iterate through level(s) */
 
   rc = sqlite3Fts3SegReaderCursor(p, iLevel, 0, 0, 1, 0, &csr);
+  if( rc==SQLITE_OK && iLevel==FTS3_SEGCURSOR_ALL ){
+    /* Any partially merged segment is superseded by this merge. It is
+    ** the one with a negative end_block. If there is one, discard it and
+    ** open the cursor again without it.  */
+    int i;
+    for(i=0; i<csr.nSegment && csr.apSegment[i]->iEndBlock>=0; i++);
+    if( i<csr.nSegment ){
+      sqlite3Fts3SegReaderFinish(&csr);
+      rc = fts3IncrmergeDiscard(p);
+      if( rc==SQLITE_OK ){
+        rc = sqlite3Fts3SegReaderCursor(p, iLevel, 0, 0, 1, 0, &csr);
+      }
+    }
+  }
   if( rc!=SQLITE_OK || csr.nSegment==0 ) goto finished;
 
   if( iLevel==FTS3_SEGCURSOR_ALL ){
@@ -2287,6 +2359,851 @@ int sqlite3Fts3PendingTermsFlush(Fts3Table *p){
   return fts3SegmentMerge(p, FTS3_SEGCURSOR_PENDING);
 }
 
+/*
+** The following functions implement incremental merging.
+**
+** Normally, once a level holds FTS3_MERGE_COUNT segments, the next segment
+** written to it causes all of them to be merged into a single segment of
+** the next level (see fts3AllocateSegdirIdx()). The time this takes grows
+** with the size of the level, so the INSERT that happens to fill a large
+** level may run for a long time.
+**
+** If "automerge=N" has been set (see fts3SpecialInsert()), full levels are
+** left as they are when new segments are added. Instead, each transaction
+** that writes to the table does up to N leaf blocks of merge work as it
+** is committed. The same work may be requested explicitly using "merge=N".
+** Each merge combines the FTS3_MERGE_COUNT oldest segments of the lowest
+** full level, and only one merge is in progress at any time.
+**
+** While level L is being merged, the output is stored as a well-formed
+** segment of level L+1 that contains the merged data for every term up to
+** and including the last one written so far. The input segments are left
+** untouched until the merge is finished. As the output segment is older
+** than all level L segments and holds the same data as them for the terms
+** it contains, queries return the same results whether or not they read it.
+**
+** The blocks of the output segment are allocated from a range reserved
+** when the merge starts. The range is divided into FTS3_MERGE_MAX_HEIGHT
+** equal parts, one for each height of the segment b-tree, so that the nodes
+** of each height are stored contiguously as the format requires even though
+** they are not written in order. Until the merge is finished, the end_block
+** field of the output segment holds the negative of the last block of the
+** reserved range. The state needed to continue the merge is read back from
+** the output segment itself: the right-most node of each height and the
+** last term written.
+*/
+typedef struct MergeBuf MergeBuf;
+typedef struct MergeNode MergeNode;
+typedef struct IncrmergeWriter IncrmergeWriter;
+
+/*
+** A growable buffer.
+*/
+struct MergeBuf {
+  char *a;                        /* Pointer to allocation */
+  int n;                          /* Bytes of valid data in a[] */
+  int nAlloc;                     /* Size of allocation at a[] */
+};
+
+/*
+** The right-most node of one height of the segment b-tree being built by
+** an incremental merge. For interior nodes, block.a[] begins with the
+** height of the node and the blockid of its left-most child.
+*/
+struct MergeNode {
+  sqlite3_int64 iBlock;           /* Block id the node is written to */
+  MergeBuf key;                   /* Last term added to the node */
+  MergeBuf block;                 /* Node data */
+};
+
+/*
+** An incremental merge of the FTS3_MERGE_COUNT oldest segments of level
+** iLevel into a single segment of level iLevel+1.
+*/
+struct IncrmergeWriter {
+  int iLevel;                     /* Level being merged */
+  int iIdx;                       /* Index of output segment at iLevel+1 */
+  sqlite3_int64 iStart;           /* First block of the reserved range */
+  sqlite3_int64 nLeafEst;         /* Blocks reserved for each height */
+  int nHeight;                    /* Height of the root node (at least 1) */
+  int nWork;                      /* Leaf blocks written by this call */
+  int bOverflow;                  /* True if the reserved range is too small */
+  MergeNode aNode[FTS3_MERGE_MAX_HEIGHT];  /* aNode[0] is the leaf */
+};
+
+/*
+** Return the last block of the range reserved by pWriter.
+*/
+static sqlite3_int64 fts3IncrmergeEnd(IncrmergeWriter *pWriter){
+  return pWriter->iStart + pWriter->nLeafEst*FTS3_MERGE_MAX_HEIGHT - 1;
+}
+
+/*
+** Make sure buffer pBuf has space for at least nMin bytes.
+*/
+static int fts3MergeBufGrow(MergeBuf *pBuf, int nMin){
+  if( pBuf->nAlloc<nMin ){
+    char *aNew = (char *)sqlite3_realloc(pBuf->a, nMin*2);
+    if( !aNew ) return SQLITE_NOMEM;
+    pBuf->a = aNew;
+    pBuf->nAlloc = nMin*2;
+  }
+  return SQLITE_OK;
+}
+
+/*
+** Set the contents of buffer pBuf to a copy of the n bytes at a.
+*/
+static int fts3MergeBufSet(MergeBuf *pBuf, const char *a, int n){
+  int rc = fts3MergeBufGrow(pBuf, n);
+  if( rc==SQLITE_OK ){
+    memcpy(pBuf->a, a, n);
+    pBuf->n = n;
+  }
+  return rc;
+}
+
+/*
+** Free an IncrmergeWriter object.
+*/
+static void fts3IncrmergeFree(IncrmergeWriter *pWriter){
+  if( pWriter ){
+    int i;
+    for(i=0; i<FTS3_MERGE_MAX_HEIGHT; i++){
+      sqlite3_free(pWriter->aNode[i].key.a);
+      sqlite3_free(pWriter->aNode[i].block.a);
+    }
+    sqlite3_free(pWriter);
+  }
+}
+
+/*
+** Write block iBlock of the %_segments table, replacing any existing 
+** content.
+*/
+static int fts3IncrmergeWriteBlock(
+  Fts3Table *p,                   /* Virtual table handle */
+  sqlite3_int64 iBlock,           /* Block id to write */
+  MergeBuf *pBuf                  /* Block data */
+){
+  sqlite3_stmt *pStmt;
+  int rc = fts3SqlStmt(p, SQL_REPLACE_SEGMENTS, &pStmt, 0);
+  if( rc==SQLITE_OK ){
+    sqlite3_bind_int64(pStmt, 1, iBlock);
+    sqlite3_bind_blob(pStmt, 2, pBuf->a, pBuf->n, SQLITE_STATIC);
+    sqlite3_step(pStmt);
+    rc = sqlite3_reset(pStmt);
+  }
+  return rc;
+}
+
+/*
+** Write the %_segdir entry for the output segment of pWriter, replacing
+** any existing entry.
+*/
+static int fts3IncrmergeWriteSegdir(
+  Fts3Table *p,                   /* Virtual table handle */
+  IncrmergeWriter *pWriter,       /* Incremental merge */
+  sqlite3_int64 iStartBlock,      /* Value for "start_block" field */
+  sqlite3_int64 iLeafEndBlock,    /* Value for "leaves_end_block" field */
+  sqlite3_int64 iEndBlock,        /* Value for "end_block" field */
+  MergeBuf *pRoot                 /* Value for "root" field */
+){
+  sqlite3_stmt *pStmt;
+  int rc = fts3SqlStmt(p, SQL_REPLACE_SEGDIR, &pStmt, 0);
+  if( rc==SQLITE_OK ){
+    sqlite3_bind_int(pStmt, 1, pWriter->iLevel+1);
+    sqlite3_bind_int(pStmt, 2, pWriter->iIdx);
+    sqlite3_bind_int64(pStmt, 3, iStartBlock);
+    sqlite3_bind_int64(pStmt, 4, iLeafEndBlock);
+    sqlite3_bind_int64(pStmt, 5, iEndBlock);
+    sqlite3_bind_blob(pStmt, 6, pRoot->a, pRoot->n, SQLITE_STATIC);
+    sqlite3_step(pStmt);
+    rc = sqlite3_reset(pStmt);
+  }
+  return rc;
+}
+
+/*
+** Delete the %_segdir entry for level iLevel, index iIdx, and all blocks
+** between iStart and iEnd inclusive.
+*/
+static int fts3IncrmergeDelete(
+  Fts3Table *p,                   /* Virtual table handle */
+  int iLevel,                     /* Level of segment to delete */
+  int iIdx,                       /* Index of segment to delete */
+  sqlite3_int64 iStart,           /* First block to delete */
+  sqlite3_int64 iEnd              /* Last block to delete */
+){
+  sqlite3_stmt *pStmt;
+  int rc = fts3SqlStmt(p, SQL_DELETE_SEGMENTS_RANGE, &pStmt, 0);
+  if( rc==SQLITE_OK ){
+    sqlite3_bind_int64(pStmt, 1, iStart);
+    sqlite3_bind_int64(pStmt, 2, iEnd);
+    sqlite3_step(pStmt);
+    rc = sqlite3_reset(pStmt);
+  }
+  if( rc==SQLITE_OK ){
+    rc = fts3SqlStmt(p, SQL_DELETE_SEGDIR_ENTRY, &pStmt, 0);
+  }
+  if( rc==SQLITE_OK ){
+    sqlite3_bind_int(pStmt, 1, iLevel);
+    sqlite3_bind_int(pStmt, 2, iIdx);
+    sqlite3_step(pStmt);
+    rc = sqlite3_reset(pStmt);
+  }
+  return rc;
+}
+
+/*
+** Initialize pNode as an empty interior node of height iHeight, to be
+** written to block iBlock, with left-most child iLeftChild.
+*/
+static int fts3IncrmergeNodeInit(
+  MergeNode *pNode,               /* Node to initialize */
+  int iHeight,                    /* Height of node */
+  sqlite3_int64 iBlock,           /* Block id node is written to */
+  sqlite3_int64 iLeftChild        /* Block id of left-most child */
+){
+  int rc = fts3MergeBufGrow(&pNode->block, 1 + FTS3_VARINT_MAX);
+  if( rc==SQLITE_OK ){
+    assert( iHeight>=1 && iHeight<128 );
+    pNode->iBlock = iBlock;
+    pNode->key.n = 0;
+    pNode->block.a[0] = (char)iHeight;
+    pNode->block.n = 1 + sqlite3Fts3PutVarint(&pNode->block.a[1], iLeftChild);
+  }
+  return rc;
+}
+
+/*
+** Add term zTerm to the right-most interior node of height iHeight. If 
+** that node is full, it is written to the database and replaced by a new, 
+** empty, node. In this case the term is added to the parent node instead,
+** creating the parent if required.
+**
+** The caller is about to create a new right-most node of height iHeight-1.
+** zTerm is larger than all terms in the current right-most node of that
+** height and no larger than any term that will be added to the new one.
+*/
+static int fts3IncrmergePush(
+  Fts3Table *p,                   /* Virtual table handle */
+  IncrmergeWriter *pWriter,       /* Incremental merge */
+  int iHeight,                    /* Height of node to add term to */
+  const char *zTerm,              /* Term to add */
+  int nTerm                       /* Size of zTerm in bytes */
+){
+  MergeNode *pNode = &pWriter->aNode[iHeight];
+  int nPrefix;                    /* Bytes of prefix compression */
+  int nSuffix;                    /* Bytes of term suffix */
+  int nSpace;                     /* Bytes required on node */
+  int rc;
+
+  assert( iHeight>=1 && iHeight<=pWriter->nHeight );
+  nPrefix = fts3PrefixCompress(pNode->key.a, pNode->key.n, zTerm, nTerm);
+  nSuffix = nTerm - nPrefix;
+  nSpace = sqlite3Fts3VarintLen(nSuffix) + nSuffix;
+
+  if( pNode->key.n>0 ){
+    /* There is no prefix-length field for the first term on a node */
+    nSpace += sqlite3Fts3VarintLen(nPrefix);
+    if( pNode->block.n+nSpace>p->nNodeSize ){
+      sqlite3_int64 iBase = pWriter->iStart + iHeight*pWriter->nLeafEst;
+      if( iHeight+1>=FTS3_MERGE_MAX_HEIGHT 
+       || pNode->iBlock+1>=iBase+pWriter->nLeafEst
+      ){
+        pWriter->bOverflow = 1;
+        return SQLITE_OK;
+      }
+      rc = fts3IncrmergeWriteBlock(p, pNode->iBlock, &pNode->block);
+      if( rc==SQLITE_OK && iHeight==pWriter->nHeight ){
+        pWriter->nHeight++;
+        rc = fts3IncrmergeNodeInit(&pWriter->aNode[iHeight+1], iHeight+1,
+            iBase+pWriter->nLeafEst, pNode->iBlock
+        );
+      }
+      if( rc==SQLITE_OK ){
+        rc = fts3IncrmergePush(p, pWriter, iHeight+1, zTerm, nTerm);
+      }
+      if( rc==SQLITE_OK ){
+        rc = fts3IncrmergeNodeInit(pNode, iHeight, 
+            pNode->iBlock+1, pWriter->aNode[iHeight-1].iBlock+1
+        );
+      }
+      return rc;
+    }
+  }
+
+  rc = fts3MergeBufGrow(&pNode->block, pNode->block.n + nSpace);
+  if( rc==SQLITE_OK ){
+    char *a = pNode->block.a;
+    int n = pNode->block.n;
+    if( pNode->key.n>0 ){
+      n += sqlite3Fts3PutVarint(&a[n], nPrefix);
+    }
+    n += sqlite3Fts3PutVarint(&a[n], nSuffix);
+    memcpy(&a[n], &zTerm[nPrefix], nSuffix);
+    pNode->block.n = n + nSuffix;
+    rc = fts3MergeBufSet(&pNode->key, zTerm, nTerm);
+  }
+  return rc;
+}
+
+/*
+** Append a term and its doclist to the output segment of pWriter. Terms
+** must be appended in sorted order.
+*/
+static int fts3IncrmergeAppend(
+  Fts3Table *p,                   /* Virtual table handle */
+  IncrmergeWriter *pWriter,       /* Incremental merge */
+  const char *zTerm,              /* Term to append */
+  int nTerm,                      /* Size of zTerm in bytes */
+  const char *aDoclist,           /* Doclist for zTerm */
+  int nDoclist                    /* Size of aDoclist in bytes */
+){
+  MergeNode *pLeaf = &pWriter->aNode[0];
+  int nPrefix;                    /* Bytes of prefix compression */
+  int nSuffix;                    /* Bytes of term suffix */
+  int nSpace;                     /* Bytes required on leaf */
+  char *a;
+  int n;
+  int rc;
+
+  nPrefix = fts3PrefixCompress(pLeaf->key.a, pLeaf->key.n, zTerm, nTerm);
+  nSuffix = nTerm - nPrefix;
+  nSpace = sqlite3Fts3VarintLen(nPrefix) + sqlite3Fts3VarintLen(nSuffix)
+         + nSuffix + sqlite3Fts3VarintLen(nDoclist) + nDoclist;
+
+  if( pLeaf->block.n>0 && pLeaf->block.n+nSpace>p->nNodeSize ){
+    /* The current leaf is full. Write it to the database, then add the
+    ** shortest prefix of zTerm that is larger than the last term on the
+    ** leaf to its parent (see fts3SegWriterAdd()). */
+    if( pLeaf->iBlock+1>=pWriter->iStart+pWriter->nLeafEst ){
+      pWriter->bOverflow = 1;
+      return SQLITE_OK;
+    }
+    rc = fts3IncrmergeWriteBlock(p, pLeaf->iBlock, &pLeaf->block);
+    if( rc==SQLITE_OK ){
+      pWriter->nWork++;
+      assert( nPrefix<nTerm );
+      rc = fts3IncrmergePush(p, pWriter, 1, zTerm, nPrefix+1);
+    }
+    if( rc!=SQLITE_OK || pWriter->bOverflow ) return rc;
+    pLeaf->iBlock++;
+    pLeaf->block.n = 0;
+    pLeaf->key.n = 0;
+    nPrefix = 0;
+    nSuffix = nTerm;
+    nSpace = 1 + sqlite3Fts3VarintLen(nTerm) + nTerm
+           + sqlite3Fts3VarintLen(nDoclist) + nDoclist;
+  }
+
+  rc = fts3MergeBufGrow(&pLeaf->block, pLeaf->block.n + nSpace);
+  if( rc!=SQLITE_OK ) return rc;
+  a = pLeaf->block.a;
+  n = pLeaf->block.n;
+  n += sqlite3Fts3PutVarint(&a[n], nPrefix);
+  n += sqlite3Fts3PutVarint(&a[n], nSuffix);
+  memcpy(&a[n], &zTerm[nPrefix], nSuffix);
+  n += nSuffix;
+  n += sqlite3Fts3PutVarint(&a[n], nDoclist);
+  memcpy(&a[n], aDoclist, nDoclist);
+  pLeaf->block.n = n + nDoclist;
+  return fts3MergeBufSet(&pLeaf->key, zTerm, nTerm);
+}
+
+/*
+** Write the right-most node of each height and the %_segdir entry of the
+** output segment of pWriter to the database. If isFinal is true, the merge
+** is finished. Otherwise, the segment is marked as still in progress.
+*/
+static int fts3IncrmergeFlush(
+  Fts3Table *p,                   /* Virtual table handle */
+  IncrmergeWriter *pWriter,       /* Incremental merge */
+  int isFinal                     /* True if the merge is finished */
+){
+  MergeNode *pLeaf = &pWriter->aNode[0];
+  sqlite3_int64 iEnd = fts3IncrmergeEnd(pWriter);
+  int rc = SQLITE_OK;
+  int i;
+
+  if( isFinal && pLeaf->iBlock==pWriter->iStart ){
+    /* The entire segment fits on the root node. Release the reserved 
+    ** blocks and store the leaf in the %_segdir table. */
+    rc = fts3IncrmergeDelete(p, 
+        pWriter->iLevel+1, pWriter->iIdx, pWriter->iStart, iEnd
+    );
+    if( rc==SQLITE_OK && pLeaf->block.n>0 ){
+      rc = fts3IncrmergeWriteSegdir(p, pWriter, 0, 0, 0, &pLeaf->block);
+    }
+    return rc;
+  }
+
+  for(i=0; rc==SQLITE_OK && i<pWriter->nHeight; i++){
+    rc = fts3IncrmergeWriteBlock(
+        p, pWriter->aNode[i].iBlock, &pWriter->aNode[i].block
+    );
+  }
+  if( rc==SQLITE_OK && isFinal ){
+    /* The last block written is the right-most node below the root. 
+    ** Release the rest of the reserved range, including the empty block 
+    ** that marked its end, so that it may be reused by other segments. */
+    sqlite3_stmt *pStmt;
+    sqlite3_int64 iLast = pWriter->aNode[pWriter->nHeight-1].iBlock;
+    rc = fts3SqlStmt(p, SQL_DELETE_SEGMENTS_RANGE, &pStmt, 0);
+    if( rc==SQLITE_OK ){
+      sqlite3_bind_int64(pStmt, 1, iLast+1);
+      sqlite3_bind_int64(pStmt, 2, iEnd);
+      sqlite3_step(pStmt);
+      rc = sqlite3_reset(pStmt);
+    }
+    iEnd = iLast;
+  }
+  if( rc==SQLITE_OK ){
+    rc = fts3IncrmergeWriteSegdir(p, pWriter, pWriter->iStart, pLeaf->iBlock,
+        (isFinal ? iEnd : -iEnd), &pWriter->aNode[pWriter->nHeight].block
+    );
+  }
+  return rc;
+}
+
+/*
+** Load the contents of node pNode, which has height iHeight, from buffer
+** pNode->block. Set pNode->key to the last term on the node. If iHeight is
+** greater than zero, also set *piChild to the blockid of the right-most
+** child of the node.
+**
+** Return SQLITE_CORRUPT if the node is not well-formed.
+*/
+static int fts3IncrmergeNodeLoad(
+  MergeNode *pNode,               /* Node to load */
+  int iHeight,                    /* Expected height of node */
+  sqlite3_int64 *piChild          /* OUT: Right-most child */
+){
+  const char *a = pNode->block.a;
+  int n = pNode->block.n;
+  sqlite3_int64 iChild = 0;
+  int i = 0;
+  int rc = SQLITE_OK;
+
+  pNode->key.n = 0;
+  if( iHeight>0 ){
+    if( n<2 || a[0]!=(char)iHeight ) return SQLITE_CORRUPT;
+    i = 1 + sqlite3Fts3GetVarint(&a[1], &iChild);
+    iChild--;
+  }
+  while( rc==SQLITE_OK && i<n ){
+    int nPrefix = 0;
+    int nSuffix;
+    if( iHeight==0 || pNode->key.n>0 ){
+      i += sqlite3Fts3GetVarint32(&a[i], &nPrefix);
+    }
+    i += sqlite3Fts3GetVarint32(&a[i], &nSuffix);
+    if( nPrefix<0 || nSuffix<0 || nPrefix>pNode->key.n || i+nSuffix>n ){
+      return SQLITE_CORRUPT;
+    }
+    rc = fts3MergeBufGrow(&pNode->key, nPrefix+nSuffix);
+    if( rc==SQLITE_OK ){
+      memcpy(&pNode->key.a[nPrefix], &a[i], nSuffix);
+      pNode->key.n = nPrefix+nSuffix;
+      i += nSuffix;
+      if( iHeight==0 ){
+        int nDoclist;
+        i += sqlite3Fts3GetVarint32(&a[i], &nDoclist);
+        if( nDoclist<0 || i+nDoclist>n ) return SQLITE_CORRUPT;
+        i += nDoclist;
+      }
+      iChild++;
+    }
+  }
+  if( iHeight>0 ) *piChild = iChild+1;
+  return rc;
+}
+
+/*
+** If there is an incremental merge in progress, load its state into a new 
+** IncrmergeWriter object and set *ppWriter to point to it. Otherwise, set
+** *ppWriter to NULL.
+*/
+static int fts3IncrmergeLoad(Fts3Table *p, IncrmergeWriter **ppWriter){
+  IncrmergeWriter *pWriter = 0;
+  sqlite3_stmt *pStmt;
+  sqlite3_int64 iLeaf = 0;
+  int rc;
+  int i;
+
+  *ppWriter = 0;
+  rc = fts3SqlStmt(p, SQL_SELECT_INCRMERGE, &pStmt, 0);
+  if( rc!=SQLITE_OK ) return rc;
+  if( SQLITE_ROW==sqlite3_step(pStmt) ){
+    const char *aRoot = (const char *)sqlite3_column_blob(pStmt, 5);
+    int nRoot = sqlite3_column_bytes(pStmt, 5);
+    int iHeight = (nRoot>0 ? (u8)aRoot[0] : 0);
+    sqlite3_int64 iEnd = -sqlite3_column_int64(pStmt, 4);
+
+    pWriter = (IncrmergeWriter *)sqlite3_malloc(sizeof(IncrmergeWriter));
+    if( !pWriter ){
+      rc = SQLITE_NOMEM;
+    }else{
+      memset(pWriter, 0, sizeof(IncrmergeWriter));
+      pWriter->iLevel = sqlite3_column_int(pStmt, 0) - 1;
+      pWriter->iIdx = sqlite3_column_int(pStmt, 1);
+      pWriter->iStart = sqlite3_column_int64(pStmt, 2);
+      pWriter->nLeafEst = (iEnd - pWriter->iStart + 1)/FTS3_MERGE_MAX_HEIGHT;
+      iLeaf = sqlite3_column_int64(pStmt, 3);
+      if( pWriter->iLevel<0 || pWriter->iStart<=0 || pWriter->nLeafEst<=0
+       || nRoot<2 || iHeight<1 || iHeight>=FTS3_MERGE_MAX_HEIGHT
+      ){
+        rc = SQLITE_CORRUPT;
+      }else{
+        MergeNode *pRoot = &pWriter->aNode[iHeight];
+        pWriter->nHeight = iHeight;
+        pRoot->iBlock = pWriter->iStart + pWriter->nHeight*pWriter->nLeafEst;
+        rc = fts3MergeBufGrow(&pRoot->block, nRoot + FTS3_NODE_PADDING);
+        if( rc==SQLITE_OK ){
+          memcpy(pRoot->block.a, aRoot, nRoot);
+          memset(&pRoot->block.a[nRoot], 0, FTS3_NODE_PADDING);
+          pRoot->block.n = nRoot;
+        }
+      }
+    }
+  }
+  if( rc==SQLITE_OK ){
+    rc = sqlite3_reset(pStmt);
+  }else{
+    sqlite3_reset(pStmt);
+  }
+
+  /* Load the right-most node of each height, starting from the root. */
+  for(i=(pWriter ? pWriter->nHeight : 0); rc==SQLITE_OK && i>0; i--){
+    MergeNode *pChild = &pWriter->aNode[i-1];
+    sqlite3_int64 iBase = pWriter->iStart + (i-1)*pWriter->nLeafEst;
+    sqlite3_int64 iChild = 0;
+    rc = fts3IncrmergeNodeLoad(&pWriter->aNode[i], i, &iChild);
+    if( rc==SQLITE_OK ){
+      if( iChild<iBase || iChild>=iBase+pWriter->nLeafEst
+       || (i==1 && iChild!=iLeaf)
+      ){
+        rc = SQLITE_CORRUPT;
+      }else{
+        pChild->iBlock = iChild;
+        rc = sqlite3Fts3ReadBlock(p, iChild, &pChild->block.a, &pChild->block.n);
+        pChild->block.nAlloc = pChild->block.n;
+      }
+    }
+  }
+  if( rc==SQLITE_OK && pWriter ){
+    rc = fts3IncrmergeNodeLoad(&pWriter->aNode[0], 0, 0);
+  }
+
+  if( rc==SQLITE_OK ){
+    *ppWriter = pWriter;
+  }else{
+    fts3IncrmergeFree(pWriter);
+  }
+  return rc;
+}
+
+/*
+** Start an incremental merge of the FTS3_MERGE_COUNT oldest segments of
+** level iLevel. At least nMinLeaf blocks are reserved for each height of
+** the output segment b-tree.
+*/
+static int fts3IncrmergeStart(
+  Fts3Table *p,                   /* Virtual table handle */
+  int iLevel,                     /* Level to merge */
+  sqlite3_int64 nMinLeaf,         /* Minimum number of leaves to reserve */
+  IncrmergeWriter **ppWriter      /* OUT: New incremental merge */
+){
+  IncrmergeWriter *pWriter;
+  sqlite3_stmt *pStmt;
+  sqlite3_int64 nLeaf = 0;        /* Estimated number of output leaves */
+  sqlite3_int64 iStart = 0;       /* First block of reserved range */
+  int iIdx = 0;                   /* Index of output segment */
+  int nInput = 0;                 /* Number of input segments */
+  int rc;
+  int rc2;
+
+  /* The output segment is not expected to need more leaves than the input
+  ** segments together. Reserve twice that many to be safe. */
+  *ppWriter = 0;
+  rc = sqlite3Fts3AllSegdirs(p, iLevel, &pStmt);
+  while( rc==SQLITE_OK && nInput<FTS3_MERGE_COUNT 
+      && SQLITE_ROW==sqlite3_step(pStmt) 
+  ){
+    sqlite3_int64 iStartBlock = sqlite3_column_int64(pStmt, 1);
+    sqlite3_int64 iLeavesEndBlock = sqlite3_column_int64(pStmt, 2);
+    nLeaf += (iStartBlock ? iLeavesEndBlock - iStartBlock + 1 : 1);
+    nInput++;
+  }
+  rc2 = sqlite3_reset(pStmt);
+  if( rc==SQLITE_OK ) rc = rc2;
+  if( rc!=SQLITE_OK || nInput<FTS3_MERGE_COUNT ) return rc;
+  nLeaf = nLeaf*2 + FTS3_MERGE_COUNT;
+  if( nLeaf<nMinLeaf ) nLeaf = nMinLeaf;
+
+  /* The output is the newest segment of level iLevel+1. */
+  rc = fts3SqlStmt(p, SQL_NEXT_SEGMENT_INDEX, &pStmt, 0);
+  if( rc==SQLITE_OK ){
+    sqlite3_bind_int(pStmt, 1, iLevel+1);
+    if( SQLITE_ROW==sqlite3_step(pStmt) ){
+      iIdx = sqlite3_column_int(pStmt, 0);
+    }
+    rc = sqlite3_reset(pStmt);
+  }
+
+  /* Reserve the block range by writing an empty block at the end of it. */
+  if( rc==SQLITE_OK ){
+    rc = fts3SqlStmt(p, SQL_NEXT_SEGMENTS_ID, &pStmt, 0);
+  }
+  if( rc==SQLITE_OK ){
+    if( SQLITE_ROW==sqlite3_step(pStmt) ){
+      iStart = sqlite3_column_int64(pStmt, 0);
+    }
+    rc = sqlite3_reset(pStmt);
+  }
+  if( rc==SQLITE_OK ){
+    rc = fts3WriteSegment(p, iStart + nLeaf*FTS3_MERGE_MAX_HEIGHT - 1, 0, 0);
+  }
+  if( rc!=SQLITE_OK ) return rc;
+
+  pWriter = (IncrmergeWriter *)sqlite3_malloc(sizeof(IncrmergeWriter));
+  if( !pWriter ) return SQLITE_NOMEM;
+  memset(pWriter, 0, sizeof(IncrmergeWriter));
+  pWriter->iLevel = iLevel;
+  pWriter->iIdx = iIdx;
+  pWriter->iStart = iStart;
+  pWriter->nLeafEst = nLeaf;
+  pWriter->nHeight = 1;
+  pWriter->aNode[0].iBlock = iStart;
+  rc = fts3IncrmergeNodeInit(&pWriter->aNode[1], 1, iStart+nLeaf, iStart);
+  if( rc!=SQLITE_OK ){
+    fts3IncrmergeFree(pWriter);
+    pWriter = 0;
+  }
+  *ppWriter = pWriter;
+  return rc;
+}
+
+/*
+** Delete the FTS3_MERGE_COUNT oldest segments of level iLevel.
+*/
+static int fts3IncrmergeDeleteInputs(Fts3Table *p, int iLevel){
+  sqlite3_stmt *pStmt;
+  sqlite3_int64 aRange[FTS3_MERGE_COUNT*2];
+  int aIdx[FTS3_MERGE_COUNT];
+  int nInput = 0;
+  int rc;
+  int rc2;
+  int i;
+
+  rc = sqlite3Fts3AllSegdirs(p, iLevel, &pStmt);
+  while( rc==SQLITE_OK && nInput<FTS3_MERGE_COUNT 
+      && SQLITE_ROW==sqlite3_step(pStmt) 
+  ){
+    aIdx[nInput] = sqlite3_column_int(pStmt, 0);
+    aRange[nInput*2] = sqlite3_column_int64(pStmt, 1);
+    aRange[nInput*2+1] = sqlite3_column_int64(pStmt, 3);
+    nInput++;
+  }
+  rc2 = sqlite3_reset(pStmt);
+  if( rc==SQLITE_OK ) rc = rc2;
+
+  for(i=0; rc==SQLITE_OK && i<nInput; i++){
+    rc = fts3IncrmergeDelete(p, iLevel, aIdx[i], aRange[i*2], aRange[i*2+1]);
+  }
+  return rc;
+}
+
+/*
+** Abandon the incremental merge pWriter, deleting its output segment.
+*/
+static int fts3IncrmergeAbandon(Fts3Table *p, IncrmergeWriter *pWriter){
+  return fts3IncrmergeDelete(p, pWriter->iLevel+1, pWriter->iIdx, 
+      pWriter->iStart, fts3IncrmergeEnd(pWriter)
+  );
+}
+
+/*
+** If there is an incremental merge in progress, abandon it. This is done
+** before all segments are merged into one, as the partial output segment
+** is then no longer required.
+*/
+static int fts3IncrmergeDiscard(Fts3Table *p){
+  sqlite3_stmt *pStmt;
+  int iLevel = 0;
+  int iIdx = 0;
+  sqlite3_int64 iStart = 0;
+  sqlite3_int64 iEnd = 0;
+  int rc;
+
+  rc = fts3SqlStmt(p, SQL_SELECT_INCRMERGE, &pStmt, 0);
+  if( rc==SQLITE_OK ){
+    if( SQLITE_ROW==sqlite3_step(pStmt) ){
+      iLevel = sqlite3_column_int(pStmt, 0);
+      iIdx = sqlite3_column_int(pStmt, 1);
+      iStart = sqlite3_column_int64(pStmt, 2);
+      iEnd = -sqlite3_column_int64(pStmt, 4);
+    }
+    rc = sqlite3_reset(pStmt);
+  }
+  if( rc==SQLITE_OK && iStart>0 ){
+    rc = fts3IncrmergeDelete(p, iLevel, iIdx, iStart, iEnd);
+  }
+  return rc;
+}
+
+/*
+** Merge terms from the input segments of pWriter into its output segment
+** until either nLeaf leaf blocks have been written or the input is 
+** exhausted. In the second case, the merge is finished, the input 
+** segments are deleted and *pbDone is set to true.
+*/
+static int fts3IncrmergeWork(
+  Fts3Table *p,                   /* Virtual table handle */
+  IncrmergeWriter *pWriter,       /* Incremental merge */
+  int nLeaf,                      /* Leaf blocks to write */
+  int *pbDone                     /* OUT: True if merge is finished */
+){
+  Fts3SegReaderCursor csr;        /* Cursor on the input segments */
+  Fts3SegFilter filter;           /* Filter to start after last term */
+  char *zKey = 0;                 /* Last term already merged, if any */
+  int nKey = pWriter->aNode[0].key.n;
+  int rc;
+  int i;
+
+  *pbDone = 0;
+  if( nKey>0 ){
+    zKey = (char *)sqlite3_malloc(nKey);
+    if( !zKey ) return SQLITE_NOMEM;
+    memcpy(zKey, pWriter->aNode[0].key.a, nKey);
+  }
+
+  /* Open a cursor on the FTS3_MERGE_COUNT oldest segments of the level. If
+  ** the merge is being continued, skip the leaves before the last term
+  ** merged. If the level no longer has that many segments, because they
+  ** were merged by an older version of this module, abandon the merge. */
+  rc = sqlite3Fts3SegReaderCursor(p, pWriter->iLevel, zKey, nKey, 0, 1, &csr);
+  if( rc==SQLITE_OK && csr.nSegment<FTS3_MERGE_COUNT ){
+    rc = fts3IncrmergeAbandon(p, pWriter);
+    *pbDone = 1;
+    goto finished;
+  }
+  for(i=FTS3_MERGE_COUNT; i<csr.nSegment; i++){
+    sqlite3Fts3SegReaderFree(csr.apSegment[i]);
+  }
+  if( csr.nSegment>FTS3_MERGE_COUNT ) csr.nSegment = FTS3_MERGE_COUNT;
+
+  memset(&filter, 0, sizeof(Fts3SegFilter));
+  filter.flags = FTS3_SEGMENT_REQUIRE_POS | FTS3_SEGMENT_SCAN;
+  filter.zTerm = zKey;
+  filter.nTerm = nKey;
+
+  if( rc==SQLITE_OK ){
+    rc = sqlite3Fts3SegReaderStart(p, &csr, &filter);
+  }
+  while( rc==SQLITE_OK ){
+    rc = sqlite3Fts3SegReaderStep(p, &csr);
+    if( rc!=SQLITE_ROW ) break;
+    rc = SQLITE_OK;
+    if( csr.nTerm==nKey && 0==memcmp(csr.zTerm, zKey, nKey) ) continue;
+    rc = fts3IncrmergeAppend(
+        p, pWriter, csr.zTerm, csr.nTerm, csr.aDoclist, csr.nDoclist
+    );
+    if( pWriter->bOverflow || pWriter->nWork>=nLeaf ) goto finished;
+  }
+
+  if( rc==SQLITE_OK ){
+    rc = fts3IncrmergeFlush(p, pWriter, 1);
+    if( rc==SQLITE_OK ){
+      rc = fts3IncrmergeDeleteInputs(p, pWriter->iLevel);
+    }
+    *pbDone = 1;
+  }
+
+ finished:
+  sqlite3Fts3SegReaderFinish(&csr);
+  sqlite3_free(zKey);
+  return rc;
+}
+
+/*
+** Return in *piLevel the lowest level that contains at least
+** FTS3_MERGE_COUNT segments, or -1 if there is no such level.
+*/
+static int fts3IncrmergeLevel(Fts3Table *p, int *piLevel){
+  sqlite3_stmt *pStmt;
+  int rc = fts3SqlStmt(p, SQL_SELECT_FULL_LEVEL, &pStmt, 0);
+  *piLevel = -1;
+  if( rc==SQLITE_OK ){
+    sqlite3_bind_int(pStmt, 1, FTS3_MERGE_COUNT);
+    if( SQLITE_ROW==sqlite3_step(pStmt) ){
+      *piLevel = sqlite3_column_int(pStmt, 0);
+    }
+    rc = sqlite3_reset(pStmt);
+  }
+  return rc;
+}
+
+/*
+** Do up to nLeaf leaf blocks of incremental merge work, continuing the
+** merge in progress, if any, and then starting new merges as long as
+** there are full levels. If bCurrent is true, only the merge already in
+** progress is worked on.
+*/
+static int fts3Incrmerge(Fts3Table *p, int nLeaf, int bCurrent){
+  IncrmergeWriter *pWriter = 0;
+  int rc;
+
+  rc = fts3IncrmergeLoad(p, &pWriter);
+  while( rc==SQLITE_OK && nLeaf>0 ){
+    int bDone = 0;
+    if( pWriter==0 ){
+      int iLevel;
+      if( bCurrent ) break;
+      rc = fts3IncrmergeLevel(p, &iLevel);
+      if( rc!=SQLITE_OK || iLevel<0 ) break;
+      rc = fts3IncrmergeStart(p, iLevel, 0, &pWriter);
+      if( rc!=SQLITE_OK || pWriter==0 ) break;
+    }
+
+    rc = fts3IncrmergeWork(p, pWriter, nLeaf, &bDone);
+    nLeaf -= pWriter->nWork;
+    pWriter->nWork = 0;
+    if( rc==SQLITE_OK && pWriter->bOverflow ){
+      /* The output needs more leaves than were reserved. Start again with
+      ** a larger range. This is not expected to happen in practice. */
+      int iLevel = pWriter->iLevel;
+      sqlite3_int64 nMinLeaf = pWriter->nLeafEst*4;
+      rc = fts3IncrmergeAbandon(p, pWriter);
+      fts3IncrmergeFree(pWriter);
+      pWriter = 0;
+      if( rc==SQLITE_OK ){
+        rc = fts3IncrmergeStart(p, iLevel, nMinLeaf, &pWriter);
+      }
+    }else if( bDone ){
+      fts3IncrmergeFree(pWriter);
+      pWriter = 0;
+      if( bCurrent ) break;
+    }
+  }
+
+  if( rc==SQLITE_OK && pWriter ){
+    rc = fts3IncrmergeFlush(p, pWriter, 0);
+  }
+  fts3IncrmergeFree(pWriter);
+  return rc;
+}
+
+/*
+** Do up to nLeaf leaf blocks of incremental merge work. This is called
+** for "merge=N" commands and when a transaction is committed if 
+** "automerge=N" is set.
+*/
+int sqlite3Fts3Incrmerge(Fts3Table *p, int nLeaf){
+  return fts3Incrmerge(p, nLeaf, 0);
+}
+
 /*
 ** Encode N integers as varints into a blob.
 */
@@ -2440,8 +3357,15 @@ static void fts3UpdateDocTotals(
 **
 **   "INSERT INTO tbl(tbl) VALUES(<expr>)"
 **
-** Argument pVal contains the result of <expr>. Currently the only 
-** meaningful value to insert is the text 'optimize'.
+** Argument pVal contains the result of <expr>. The meaningful values are:
+**
+**   'optimize'     Merge all segments into one.
+**   'merge=N'      Do up to N leaf blocks of incremental merge work.
+**   'automerge=N'  Do up to N leaf blocks of incremental merge work each
+**                  time a transaction that writes to the table commits,
+**                  instead of merging full levels when they fill up. Zero
+**                  (the default) turns this off. The setting lasts for the
+**                  lifetime of the connection.
 */
 static int fts3SpecialInsert(Fts3Table *p, sqlite3_value *pVal){
   int rc;                         /* Return Code */
@@ -2457,6 +3381,11 @@ static int fts3SpecialInsert(Fts3Table *p, sqlite3_value *pVal){
     }else{
       sqlite3Fts3PendingTermsClear(p);
     }
+  }else if( nVal>6 && 0==sqlite3_strnicmp(zVal, "merge=", 6) ){
+    rc = sqlite3Fts3Incrmerge(p, atoi(&zVal[6]));
+  }else if( nVal>10 && 0==sqlite3_strnicmp(zVal, "automerge=", 10) ){
+    p->nAutoMerge = atoi(&zVal[10]);
+    rc = SQLITE_OK;
 #ifdef SQLITE_TEST
   }else if( nVal>9 && 0==sqlite3_strnicmp(zVal, "nodesize=", 9) ){
     p->nNodeSize = atoi(&zVal[9]);
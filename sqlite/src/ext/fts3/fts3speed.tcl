@@ -12,6 +12,33 @@
 #   3. Deleting documents from an FTS3 table.
 #   4. Querying FTS3 tables.
 #
+# Usage:
+#
+#   tclsh fts3speed.tcl ?ROWS? ?SELECTS?
+#   testfixture fts3speed.tcl -time DATABASE ?SCRIPT...?
+#
+# The first form writes the SQL scripts. ROWS and SELECTS default to
+# 100000 documents and 1000 queries per select script. The second form
+# runs each select script (by default all of those written by the first
+# form) against DATABASE and reports the number of queries per second.
+# It needs the "sqlite3" Tcl command, so it must be run by testfixture or
+# by a tclsh that can load the sqlite3 package. For example, to time
+# queries against a 1M document table:
+#
+#   tclsh fts3speed.tcl 1000000 1000
+#   sqlite3 test.db < fts3speed_insert.sql
+#   sqlite3 test.db < fts3speed_optimize.sql
+#   testfixture fts3speed.tcl -time test.db
+#
+# The select scripts are:
+#
+#   fts3speed_select.sql    Single term queries.
+#   fts3speed_select2.sql   Two term AND queries.
+#   fts3speed_select3.sql   AND of two of the 20 most common terms.
+#   fts3speed_select4.sql   AND of a common term and a term chosen
+#                           uniformly from the vocabulary (usually rare).
+#   fts3speed_select5.sql   A common term NOT another common term.
+#
 
 # Number of tokens in vocabulary. And number of tokens in each document.
 #
@@ -26,7 +53,8 @@ set NUM_SELECTS 1000
 expr {srand(0)}
 
 proc usage {} {
-  puts stderr "Usage: $::argv0 <rows> <selects>"
+  puts stderr "Usage: $::argv0 ?ROWS? ?SELECTS?"
+  puts stderr "       $::argv0 -time DATABASE ?SCRIPT...?"
   exit -1
 }
 
@@ -60,6 +88,13 @@ proc select_term {} {
   lindex $::vocab $t
 }
 
+# Return one of the 20 most common terms. Each of these is returned by
+# roughly 1 in 60 calls to [select_term].
+#
+proc common_term {} {
+  lindex $::vocab [expr {int(rand()*20)}]
+}
+
 proc select_doc {nTerm} {
   set ret [list]
   for {set i 0} {$i<$nTerm} {incr i} {
@@ -94,7 +129,64 @@ proc test_4 {nSelect} {
   }
 }
 
-if {[llength $argv]!=0} usage
+proc test_5 {nSelect} {
+  for {set i 0} {$i < $nSelect} {incr i} {
+    sql "SELECT count(*) FROM t1 WHERE t1 MATCH '[common_term] [common_term]';"
+  }
+}
+
+proc test_6 {nSelect} {
+  set n [llength $::vocab]
+  for {set i 0} {$i < $nSelect} {incr i} {
+    set rare [lindex $::vocab [expr {int(rand()*$n)}]]
+    sql "SELECT count(*) FROM t1 WHERE t1 MATCH '[common_term] $rare';"
+  }
+}
+
+proc test_7 {nSelect} {
+  for {set i 0} {$i < $nSelect} {incr i} {
+    set t1 [common_term]
+    set t2 [common_term]
+    while {$t2==$t1} { set t2 [common_term] }
+    sql "SELECT count(*) FROM t1 WHERE t1 MATCH '$t1 -$t2';"
+  }
+}
+
+# Run each SQL script in list $files against database $zDb, one statement
+# per line, and report the number of statements run per second.
+#
+proc time_scripts {zDb files} {
+  if {[info commands sqlite3]==""} { package require sqlite3 }
+  sqlite3 db $zDb
+  foreach f $files {
+    set fd [open $f]
+    set lSql [split [string trim [read $fd]] "\n"]
+    close $fd
+    set t [lindex [time { foreach s $lSql { db eval $s } }] 0]
+    set n [llength $lSql]
+    puts [format "%-24s %7d queries %9.3f s %10.1f queries/s" \
+        $f $n [expr {$t/1000000.0}] [expr {$t>0 ? $n*1000000.0/$t : 0}]
+    ]
+  }
+  db close
+}
+
+if {[lindex $argv 0]=="-time"} {
+  if {[llength $argv]<2} usage
+  set files [lrange $argv 2 end]
+  if {[llength $files]==0} {
+    foreach i {{} 2 3 4 5} { lappend files fts3speed_select$i.sql }
+  }
+  time_scripts [lindex $argv 1] $files
+  exit
+}
+
+if {[llength $argv]>2} usage
+foreach v {NUM_INSERTS NUM_SELECTS} a $argv {
+  if {$a==""} continue
+  if {![string is integer -strict $a] || $a<0} usage
+  set $v $a
+}
 
 set ::vocab [build_vocab $::VOCAB_SIZE]
 
@@ -110,6 +202,18 @@ set ::fd [open fts3speed_select2.sql w]
 test_4 $NUM_SELECTS
 close $::fd
 
+set ::fd [open fts3speed_select3.sql w]
+test_5 $NUM_SELECTS
+close $::fd
+
+set ::fd [open fts3speed_select4.sql w]
+test_6 $NUM_SELECTS
+close $::fd
+
+set ::fd [open fts3speed_select5.sql w]
+test_7 $NUM_SELECTS
+close $::fd
+
 set ::fd [open fts3speed_optimize.sql w]
 test_2
 close $::fd
@@ -118,5 +222,8 @@ puts "Success. Created files:"
 puts "  fts3speed_insert.sql"
 puts "  fts3speed_select.sql"
 puts "  fts3speed_select2.sql"
+puts "  fts3speed_select3.sql"
+puts "  fts3speed_select4.sql"
+puts "  fts3speed_select5.sql"
 puts "  fts3speed_optimize.sql"
 
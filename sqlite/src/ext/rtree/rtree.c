@@ -176,12 +176,44 @@ struct Rtree {
   sqlite3_stmt *pDeleteParent;
 
   int eCoordType;
+
+  /* Rows inserted while the r-tree is empty are accumulated in aPending[]
+  ** and later packed into the tree all at once. See rtreeFlushPending().
+  */
+  int eBulk;                  /* RTREE_BULK_* value */
+  int nPending;               /* Number of cells in aPending[] */
+  int nPendingAlloc;          /* Allocated size of aPending[] */
+  RtreeCell *aPending;        /* Cells not yet written to the tree */
+
+  /* While there are open cursors, nodes that are no longer referenced
+  ** are kept in aHash[], along with their decoded cells, instead of being
+  ** freed. They are linked into an LRU list via RtreeNode.pLruNext and
+  ** pLruPrev. See nodeCacheAdd().
+  */
+  int nCursor;                /* Number of open cursors */
+  int bNoCache;               /* True while nodes may not be cached */
+  int nCache;                 /* Number of nodes in LRU list */
+  RtreeNode *pLruFirst;       /* Least recently used node */
+  RtreeNode *pLruLast;        /* Most recently used node */
 };
 
 /* Possible values for eCoordType: */
 #define RTREE_COORD_REAL32 0
 #define RTREE_COORD_INT32  1
 
+/* Possible values for eBulk: */
+#define RTREE_BULK_UNKNOWN 0      /* Test if the tree is empty on insert */
+#define RTREE_BULK_ON      1      /* New rows are added to aPending[] */
+#define RTREE_BULK_OFF     2      /* New rows are inserted into the tree */
+
+/*
+** Maximum number of unreferenced nodes kept in the Rtree.aHash[] table
+** while cursors are open.
+*/
+#ifndef RTREE_CACHE_SIZE
+# define RTREE_CACHE_SIZE 128
+#endif
+
 /*
 ** The minimum number of cells allowed for a node is a third of the 
 ** maximum. In Gutman's notation:
@@ -261,6 +293,10 @@ struct RtreeNode {
   int isDirty;
   u8 *zData;
   RtreeNode *pNext;                 /* Next node in this hash chain */
+  int isReused;                     /* True if acquired more than once */
+  RtreeCell *aCell;                 /* Decoded cells, or NULL */
+  RtreeNode *pLruNext;              /* Next node in Rtree LRU list */
+  RtreeNode *pLruPrev;              /* Previous node in Rtree LRU list */
 };
 #define NCELL(pNode) readInt16(&(pNode)->zData[2])
 
@@ -384,12 +420,22 @@ static void nodeReference(RtreeNode *p){
   }
 }
 
+/*
+** Discard the decoded copy of the cells of node p, if any. This must be
+** done whenever the cells stored in p->zData are modified.
+*/
+static void nodeDecodeClear(RtreeNode *p){
+  sqlite3_free(p->aCell);
+  p->aCell = 0;
+}
+
 /*
 ** Clear the content of node p (set all bytes to 0x00).
 */
 static void nodeZero(Rtree *pRtree, RtreeNode *p){
   memset(&p->zData[2], 0, pRtree->iNodeSize-2);
   p->isDirty = 1;
+  nodeDecodeClear(p);
 }
 
 /*
@@ -437,6 +483,74 @@ static void nodeHashDelete(Rtree *pRtree, RtreeNode *pNode){
   }
 }
 
+/*
+** Remove node pNode, which must be in the LRU list, from the list.
+*/
+static void nodeCacheRemove(Rtree *pRtree, RtreeNode *pNode){
+  assert( pNode->nRef==0 && pRtree->nCache>0 );
+  if( pNode->pLruPrev ){
+    pNode->pLruPrev->pLruNext = pNode->pLruNext;
+  }else{
+    pRtree->pLruFirst = pNode->pLruNext;
+  }
+  if( pNode->pLruNext ){
+    pNode->pLruNext->pLruPrev = pNode->pLruPrev;
+  }else{
+    pRtree->pLruLast = pNode->pLruPrev;
+  }
+  pNode->pLruNext = 0;
+  pNode->pLruPrev = 0;
+  pRtree->nCache--;
+}
+
+/*
+** Remove node pNode from the LRU list and the hash table and free it.
+*/
+static void nodeCacheEvict(Rtree *pRtree, RtreeNode *pNode){
+  nodeCacheRemove(pRtree, pNode);
+  if( pNode->iNode==1 ){
+    pRtree->iDepth = -1;
+  }
+  nodeHashDelete(pRtree, pNode);
+  nodeDecodeClear(pNode);
+  sqlite3_free(pNode);
+}
+
+/*
+** Free all nodes in the LRU list.
+*/
+static void nodeCacheClear(Rtree *pRtree){
+  while( pRtree->pLruFirst ){
+    nodeCacheEvict(pRtree, pRtree->pLruFirst);
+  }
+}
+
+/*
+** Node pNode is no longer referenced, and its content matches the
+** database. Add it to the end of the LRU list, so that it may be found
+** in the hash table if it is required again while cursors remain open.
+** If this makes the list too long, free the least recently used node.
+**
+** Nodes are only cached while cursors are open, and the cache is emptied
+** before the r-tree is modified. So there is no need to check if a cached
+** node is out of date.
+*/
+static void nodeCacheAdd(Rtree *pRtree, RtreeNode *pNode){
+  assert( pNode->nRef==0 && pNode->pParent==0 && pNode->isDirty==0 );
+  pNode->pLruNext = 0;
+  pNode->pLruPrev = pRtree->pLruLast;
+  if( pRtree->pLruLast ){
+    pRtree->pLruLast->pLruNext = pNode;
+  }else{
+    pRtree->pLruFirst = pNode;
+  }
+  pRtree->pLruLast = pNode;
+  pRtree->nCache++;
+  if( pRtree->nCache>RTREE_CACHE_SIZE ){
+    nodeCacheEvict(pRtree, pRtree->pLruFirst);
+  }
+}
+
 /*
 ** Allocate and return new r-tree node. Initially, (RtreeNode.iNode==0),
 ** indicating that node has not yet been assigned a node number. It is
@@ -476,6 +590,10 @@ nodeAcquire(
   */
   if( (pNode = nodeHashLookup(pRtree, iNode)) ){
     assert( !pParent || !pNode->pParent || pNode->pParent==pParent );
+    if( pNode->nRef==0 ){
+      nodeCacheRemove(pRtree, pNode);
+    }
+    pNode->isReused = 1;
     if( pParent && !pNode->pParent ){
       nodeReference(pParent);
       pNode->pParent = pParent;
@@ -500,6 +618,10 @@ nodeAcquire(
         pNode->iNode = iNode;
         pNode->isDirty = 0;
         pNode->pNext = 0;
+        pNode->isReused = 0;
+        pNode->aCell = 0;
+        pNode->pLruNext = 0;
+        pNode->pLruPrev = 0;
         memcpy(pNode->zData, zBlob, pRtree->iNodeSize);
         nodeReference(pParent);
       }
@@ -562,6 +684,7 @@ static void nodeOverwriteCell(
     p += writeCoord(p, &pCell->aCoord[ii]);
   }
   pNode->isDirty = 1;
+  nodeDecodeClear(pNode);
 }
 
 /*
@@ -574,6 +697,7 @@ static void nodeDeleteCell(Rtree *pRtree, RtreeNode *pNode, int iCell){
   memmove(pDst, pSrc, nByte);
   writeInt16(&pNode->zData[2], NCELL(pNode)-1);
   pNode->isDirty = 1;
+  nodeDecodeClear(pNode);
 }
 
 /*
@@ -631,7 +755,9 @@ nodeWrite(Rtree *pRtree, RtreeNode *pNode){
 
 /*
 ** Release a reference to a node. If the node is dirty and the reference
-** count drops to zero, the node data is written to the database.
+** count drops to zero, the node data is written to the database. The
+** node is then either added to the LRU list (see nodeCacheAdd()) or
+** freed.
 */
 static int
 nodeRelease(Rtree *pRtree, RtreeNode *pNode){
@@ -640,17 +766,25 @@ nodeRelease(Rtree *pRtree, RtreeNode *pNode){
     assert( pNode->nRef>0 );
     pNode->nRef--;
     if( pNode->nRef==0 ){
-      if( pNode->iNode==1 ){
-        pRtree->iDepth = -1;
-      }
       if( pNode->pParent ){
         rc = nodeRelease(pRtree, pNode->pParent);
+        pNode->pParent = 0;
       }
       if( rc==SQLITE_OK ){
         rc = nodeWrite(pRtree, pNode);
       }
-      nodeHashDelete(pRtree, pNode);
-      sqlite3_free(pNode);
+      if( rc==SQLITE_OK && pRtree->nCursor>0 && !pRtree->bNoCache
+       && pNode->iNode && nodeHashLookup(pRtree, pNode->iNode)==pNode
+      ){
+        nodeCacheAdd(pRtree, pNode);
+      }else{
+        if( pNode->iNode==1 ){
+          pRtree->iDepth = -1;
+        }
+        nodeHashDelete(pRtree, pNode);
+        nodeDecodeClear(pNode);
+        sqlite3_free(pNode);
+      }
     }
   }
   return rc;
@@ -700,6 +834,41 @@ static void nodeGetCell(
   }
 }
 
+/*
+** Return a pointer to a deserialized copy of cell iCell of node pNode.
+**
+** If pNode has been acquired more than once, for example by a query
+** that is run for each row of the outer loop of a join, all of its cells
+** are deserialized into RtreeNode.aCell[], which is kept until the node
+** is modified or freed. Otherwise, or if that allocation fails, cell
+** iCell alone is deserialized into *pSpace.
+*/
+static RtreeCell *nodeCell(
+  Rtree *pRtree,
+  RtreeNode *pNode,
+  int iCell,
+  RtreeCell *pSpace
+){
+  assert( iCell<NCELL(pNode) );
+  if( pNode->aCell==0 ){
+    int nCell = NCELL(pNode);
+    if( !pNode->isReused ){
+      nodeGetCell(pRtree, pNode, iCell, pSpace);
+      return pSpace;
+    }
+    int ii;
+    pNode->aCell = (RtreeCell *)sqlite3_malloc(sizeof(RtreeCell)*nCell);
+    if( pNode->aCell==0 ){
+      nodeGetCell(pRtree, pNode, iCell, pSpace);
+      return pSpace;
+    }
+    for(ii=0; ii<nCell; ii++){
+      nodeGetCell(pRtree, pNode, ii, &pNode->aCell[ii]);
+    }
+  }
+  return &pNode->aCell[iCell];
+}
+
 
 /* Forward declaration for the function that does the work of
 ** the virtual table module xCreate() and xConnect() methods.
@@ -748,6 +917,8 @@ static void rtreeReference(Rtree *pRtree){
 static void rtreeRelease(Rtree *pRtree){
   pRtree->nBusy--;
   if( pRtree->nBusy==0 ){
+    nodeCacheClear(pRtree);
+    sqlite3_free(pRtree->aPending);
     sqlite3_finalize(pRtree->pReadNode);
     sqlite3_finalize(pRtree->pWriteNode);
     sqlite3_finalize(pRtree->pDeleteNode);
@@ -807,6 +978,7 @@ static int rtreeOpen(sqlite3_vtab *pVTab, sqlite3_vtab_cursor **ppCursor){
   if( pCsr ){
     memset(pCsr, 0, sizeof(RtreeCursor));
     pCsr->base.pVtab = pVTab;
+    ((Rtree *)pVTab)->nCursor++;
     rc = SQLITE_OK;
   }
   *ppCursor = (sqlite3_vtab_cursor *)pCsr;
@@ -843,6 +1015,10 @@ static int rtreeClose(sqlite3_vtab_cursor *cur){
   freeCursorConstraints(pCsr);
   rc = nodeRelease(pRtree, pCsr->pNode);
   sqlite3_free(pCsr);
+  pRtree->nCursor--;
+  if( pRtree->nCursor==0 ){
+    nodeCacheClear(pRtree);
+  }
   return rc;
 }
 
@@ -891,15 +1067,16 @@ static int testRtreeGeom(
 */
 static int testRtreeCell(Rtree *pRtree, RtreeCursor *pCursor, int *pbEof){
   RtreeCell cell;
+  RtreeCell *pCell;
   int ii;
   int bRes = 0;
   int rc = SQLITE_OK;
 
-  nodeGetCell(pRtree, pCursor->pNode, pCursor->iCell, &cell);
+  pCell = nodeCell(pRtree, pCursor->pNode, pCursor->iCell, &cell);
   for(ii=0; bRes==0 && ii<pCursor->nConstraint; ii++){
     RtreeConstraint *p = &pCursor->aConstraint[ii];
-    double cell_min = DCOORD(cell.aCoord[(p->iCoord>>1)*2]);
-    double cell_max = DCOORD(cell.aCoord[(p->iCoord>>1)*2+1]);
+    double cell_min = DCOORD(pCell->aCoord[(p->iCoord>>1)*2]);
+    double cell_max = DCOORD(pCell->aCoord[(p->iCoord>>1)*2+1]);
 
     assert(p->op==RTREE_LE || p->op==RTREE_LT || p->op==RTREE_GE 
         || p->op==RTREE_GT || p->op==RTREE_EQ || p->op==RTREE_MATCH
@@ -920,7 +1097,7 @@ static int testRtreeCell(Rtree *pRtree, RtreeCursor *pCursor, int *pbEof){
 
       default: {
         assert( p->op==RTREE_MATCH );
-        rc = testRtreeGeom(pRtree, p, &cell, &bRes);
+        rc = testRtreeGeom(pRtree, p, pCell, &bRes);
         bRes = !bRes;
         break;
       }
@@ -945,13 +1122,14 @@ static int testRtreeCell(Rtree *pRtree, RtreeCursor *pCursor, int *pbEof){
 */
 static int testRtreeEntry(Rtree *pRtree, RtreeCursor *pCursor, int *pbEof){
   RtreeCell cell;
+  RtreeCell *pCell;
   int ii;
   *pbEof = 0;
 
-  nodeGetCell(pRtree, pCursor->pNode, pCursor->iCell, &cell);
+  pCell = nodeCell(pRtree, pCursor->pNode, pCursor->iCell, &cell);
   for(ii=0; ii<pCursor->nConstraint; ii++){
     RtreeConstraint *p = &pCursor->aConstraint[ii];
-    double coord = DCOORD(cell.aCoord[p->iCoord]);
+    double coord = DCOORD(pCell->aCoord[p->iCoord]);
     int res;
     assert(p->op==RTREE_LE || p->op==RTREE_LT || p->op==RTREE_GE 
         || p->op==RTREE_GT || p->op==RTREE_EQ || p->op==RTREE_MATCH
@@ -965,7 +1143,7 @@ static int testRtreeEntry(Rtree *pRtree, RtreeCursor *pCursor, int *pbEof){
       default: {
         int rc;
         assert( p->op==RTREE_MATCH );
-        rc = testRtreeGeom(pRtree, p, &cell, &res);
+        rc = testRtreeGeom(pRtree, p, pCell, &res);
         if( rc!=SQLITE_OK ){
           return rc;
         }
@@ -1129,9 +1307,10 @@ static int rtreeNext(sqlite3_vtab_cursor *pVtabCursor){
 static int rtreeRowid(sqlite3_vtab_cursor *pVtabCursor, sqlite_int64 *pRowid){
   Rtree *pRtree = (Rtree *)pVtabCursor->pVtab;
   RtreeCursor *pCsr = (RtreeCursor *)pVtabCursor;
+  RtreeCell cell;
 
   assert(pCsr->pNode);
-  *pRowid = nodeGetRowid(pRtree, pCsr->pNode, pCsr->iCell);
+  *pRowid = nodeCell(pRtree, pCsr->pNode, pCsr->iCell, &cell)->iRowid;
 
   return SQLITE_OK;
 }
@@ -1142,13 +1321,13 @@ static int rtreeRowid(sqlite3_vtab_cursor *pVtabCursor, sqlite_int64 *pRowid){
 static int rtreeColumn(sqlite3_vtab_cursor *cur, sqlite3_context *ctx, int i){
   Rtree *pRtree = (Rtree *)cur->pVtab;
   RtreeCursor *pCsr = (RtreeCursor *)cur;
+  RtreeCell cell;
+  RtreeCell *pCell = nodeCell(pRtree, pCsr->pNode, pCsr->iCell, &cell);
 
   if( i==0 ){
-    i64 iRowid = nodeGetRowid(pRtree, pCsr->pNode, pCsr->iCell);
-    sqlite3_result_int64(ctx, iRowid);
+    sqlite3_result_int64(ctx, pCell->iRowid);
   }else{
-    RtreeCoord c;
-    nodeGetCoord(pRtree, pCsr->pNode, pCsr->iCell, i-1, &c);
+    RtreeCoord c = pCell->aCoord[i-1];
     if( pRtree->eCoordType==RTREE_COORD_REAL32 ){
       sqlite3_result_double(ctx, c.f);
     }else{
@@ -1227,6 +1406,8 @@ static int deserializeGeometry(sqlite3_value *pValue, RtreeConstraint *pCons){
   return SQLITE_OK;
 }
 
+static int rtreeFlushPending(Rtree *);
+
 /* 
 ** Rtree virtual table module xFilter method.
 */
@@ -1247,7 +1428,12 @@ static int rtreeFilter(
   freeCursorConstraints(pCsr);
   pCsr->iStrategy = idxNum;
 
-  if( idxNum==1 ){
+  /* Write any rows buffered by the current transaction into the tree. */
+  rc = rtreeFlushPending(pRtree);
+
+  if( rc!=SQLITE_OK ){
+    pCsr->pNode = 0;
+  }else if( idxNum==1 ){
     /* Special case - lookup by rowid. */
     RtreeNode *pLeaf;        /* Leaf on which the required cell resides */
     i64 iRowid = sqlite3_value_int64(argv[0]);
@@ -2612,6 +2798,297 @@ static int reinsertNodeContent(Rtree *pRtree, RtreeNode *pNode){
   return rc;
 }
 
+/*
+** Rows inserted into an r-tree that is empty at the start of a
+** transaction are not added to the tree one at a time. Instead, they are
+** accumulated in the Rtree.aPending[] array until the transaction is
+** committed, or until the table is queried, a row is deleted or updated
+** or the table is renamed. rtreeFlushPending() then builds the tree from
+** the pending cells using the Sort-Tile-Recursive (STR) algorithm, which
+** sorts the cells into groups of nearby cells and packs each group into
+** a single node. Every node is as full as possible, and each level of
+** the tree is built in O(N log N) time.
+**
+** Each pending cell has an entry in the %_rowid table with a negative
+** node number: -1 for aPending[0], -2 for aPending[1] and so on. These
+** entries are used to detect duplicate rowids and to assign new ones as
+** usual. If a statement that added pending cells is rolled back, so are
+** its %_rowid entries, and rtreeFlushPending() skips the corresponding
+** aPending[] cells.
+*/
+
+/*
+** Add cell pCell to the Rtree.aPending[] array.
+*/
+static int rtreePendingAdd(Rtree *pRtree, RtreeCell *pCell){
+  int rc;
+  assert( pRtree->eBulk==RTREE_BULK_ON );
+  if( pRtree->nPending==pRtree->nPendingAlloc ){
+    int nNew = pRtree->nPendingAlloc ? pRtree->nPendingAlloc*2 : 64;
+    RtreeCell *aNew = (RtreeCell *)sqlite3_realloc(
+        pRtree->aPending, nNew*sizeof(RtreeCell)
+    );
+    if( !aNew ){
+      return SQLITE_NOMEM;
+    }
+    pRtree->aPending = aNew;
+    pRtree->nPendingAlloc = nNew;
+  }
+  rc = rowidWrite(pRtree, pCell->iRowid, -1-(i64)pRtree->nPending);
+  if( rc==SQLITE_OK ){
+    memcpy(&pRtree->aPending[pRtree->nPending++], pCell, sizeof(RtreeCell));
+  }
+  return rc;
+}
+
+/*
+** Set *pnCell to the number of entries in aCell[] that still have
+** matching entries in the %_rowid table, and move them to the start of
+** the array.
+*/
+static int rtreePendingCheck(Rtree *pRtree, RtreeCell *aCell, int *pnCell){
+  int nCell = *pnCell;
+  u8 *aValid;
+  sqlite3_stmt *pStmt = 0;
+  char *zSql;
+  int rc;
+  int ii;
+  int iOut = 0;
+
+  aValid = (u8 *)sqlite3_malloc(nCell);
+  if( !aValid ){
+    return SQLITE_NOMEM;
+  }
+  memset(aValid, 0, nCell);
+
+  zSql = sqlite3_mprintf("SELECT rowid, nodeno FROM '%q'.'%q_rowid'",
+      pRtree->zDb, pRtree->zName
+  );
+  if( !zSql ){
+    rc = SQLITE_NOMEM;
+  }else{
+    rc = sqlite3_prepare_v2(pRtree->db, zSql, -1, &pStmt, 0);
+    sqlite3_free(zSql);
+  }
+  while( rc==SQLITE_OK && SQLITE_ROW==sqlite3_step(pStmt) ){
+    i64 iRowid = sqlite3_column_int64(pStmt, 0);
+    i64 iIdx = -1-sqlite3_column_int64(pStmt, 1);
+    if( iIdx>=0 && iIdx<nCell && aCell[iIdx].iRowid==iRowid ){
+      aValid[iIdx] = 1;
+    }
+  }
+  if( rc==SQLITE_OK ){
+    rc = sqlite3_finalize(pStmt);
+  }
+
+  for(ii=0; ii<nCell; ii++){
+    if( aValid[ii] ){
+      if( ii!=iOut ) memcpy(&aCell[iOut], &aCell[ii], sizeof(RtreeCell));
+      iOut++;
+    }
+  }
+  *pnCell = iOut;
+  sqlite3_free(aValid);
+  return rc;
+}
+
+/*
+** Return N raised to the power of nExp, or some value larger than iMax
+** if that is larger than iMax.
+*/
+static i64 strPow(int N, int nExp, int iMax){
+  i64 iPow = 1;
+  int ii;
+  for(ii=0; ii<nExp && iPow<=iMax; ii++){
+    iPow = iPow * N;
+  }
+  return iPow;
+}
+
+/*
+** The nCell cells in aCell[] are to be packed into nNode nodes. The
+** nodes are numbered from 0 to (nNode-1), and node k is to contain the
+** cells aCell[aIdx[B(k)]] to aCell[aIdx[B(k+1)-1]], where B(k) is
+** (k*nCell)/nNode. This function sorts the entries of aIdx[] that
+** correspond to nodes iFirst to (iFirst+nRange-1) according to the STR
+** algorithm, starting at dimension iDim.
+**
+** The entries are sorted by the centre of the cells in dimension iDim,
+** then divided into S slabs of nodes, where S is the (nDim-iDim)th root
+** of nRange, rounded up. Each slab is then sorted in the same way,
+** starting at dimension iDim+1.
+**
+** Arrays aKey[] and aSpare[] are used as working space. Each must be
+** at least nCell entries in size.
+*/
+static void strSort(
+  Rtree *pRtree,
+  RtreeCell *aCell,
+  int *aIdx,
+  int nCell,
+  int nNode,
+  int iFirst,
+  int nRange,
+  int iDim,
+  float *aKey,
+  int *aSpare
+){
+  int i1 = (int)(((i64)iFirst * nCell) / nNode);
+  int i2 = (int)(((i64)(iFirst+nRange) * nCell) / nNode);
+  int ii;
+
+  for(ii=i1; ii<i2; ii++){
+    RtreeCell *p = &aCell[aIdx[ii]];
+    aKey[aIdx[ii]] = DCOORD(p->aCoord[iDim*2]) + DCOORD(p->aCoord[iDim*2+1]);
+  }
+  SortByDistance(&aIdx[i1], i2-i1, aKey, aSpare);
+
+  if( iDim<pRtree->nDim-1 && nRange>1 ){
+    int nSlab = 1;
+    int nPer;
+    while( strPow(nSlab, pRtree->nDim-iDim, nRange)<nRange ){
+      nSlab++;
+    }
+    nPer = (nRange+nSlab-1)/nSlab;
+    for(ii=0; ii<nRange; ii+=nPer){
+      strSort(pRtree, aCell, aIdx, nCell, nNode,
+          iFirst+ii, MIN(nPer, nRange-ii), iDim+1, aKey, aSpare
+      );
+    }
+  }
+}
+
+/*
+** Build an r-tree structure containing the nCell cells in aCell[] and
+** write it to the database, replacing the current root node, which must
+** be empty. The contents of aCell[] are overwritten.
+**
+** Each level of the tree is built by packing the cells for that level
+** into as few nodes as possible, as ordered by strSort(). The bounding
+** boxes of those nodes become the cells for the next level up. When
+** the cells fit on a single node, they are written to the root node.
+*/
+static int rtreeBuild(Rtree *pRtree, RtreeCell *aCell, int nCell){
+  int nMax = (pRtree->iNodeSize-4)/pRtree->nBytesPerCell;
+  int iHeight = 0;
+  int rc = SQLITE_OK;
+  int *aIdx;                      /* Cells for the current level, in order */
+  int *aSpare;                    /* Working space for strSort() */
+  float *aKey;                    /* Working space for strSort() */
+  RtreeCell *aParent;             /* Cells for the next level up */
+  RtreeNode *pRoot = 0;
+  int ii;
+
+  aIdx = (int *)sqlite3_malloc(nCell*(sizeof(int)*2 + sizeof(float))
+      + ((nCell+nMax-1)/nMax)*sizeof(RtreeCell)
+  );
+  if( !aIdx ){
+    return SQLITE_NOMEM;
+  }
+  aSpare = &aIdx[nCell];
+  aKey = (float *)&aSpare[nCell];
+  aParent = (RtreeCell *)&aKey[nCell];
+
+  while( rc==SQLITE_OK && nCell>nMax ){
+    int nNode = (nCell+nMax-1)/nMax;
+    int iNode;
+
+    for(ii=0; ii<nCell; ii++){
+      aIdx[ii] = ii;
+    }
+    strSort(pRtree, aCell, aIdx, nCell, nNode, 0, nNode, 0, aKey, aSpare);
+
+    for(iNode=0; rc==SQLITE_OK && iNode<nNode; iNode++){
+      int i1 = (int)(((i64)iNode * nCell) / nNode);
+      int i2 = (int)(((i64)(iNode+1) * nCell) / nNode);
+      RtreeCell *pBox = &aParent[iNode];
+      RtreeNode *pNode = nodeNew(pRtree, 0);
+      int rc2;
+
+      if( !pNode ){
+        rc = SQLITE_NOMEM;
+        break;
+      }
+      memcpy(pBox, &aCell[aIdx[i1]], sizeof(RtreeCell));
+      for(ii=i1; ii<i2; ii++){
+        nodeInsertCell(pRtree, pNode, &aCell[aIdx[ii]]);
+        cellUnion(pRtree, pBox, &aCell[aIdx[ii]]);
+      }
+      rc = nodeWrite(pRtree, pNode);
+      for(ii=i1; rc==SQLITE_OK && ii<i2; ii++){
+        if( iHeight==0 ){
+          rc = rowidWrite(pRtree, aCell[aIdx[ii]].iRowid, pNode->iNode);
+        }else{
+          rc = parentWrite(pRtree, aCell[aIdx[ii]].iRowid, pNode->iNode);
+        }
+      }
+      pBox->iRowid = pNode->iNode;
+      rc2 = nodeRelease(pRtree, pNode);
+      if( rc==SQLITE_OK ){
+        rc = rc2;
+      }
+    }
+
+    memcpy(aCell, aParent, nNode*sizeof(RtreeCell));
+    nCell = nNode;
+    iHeight++;
+  }
+
+  if( rc==SQLITE_OK ){
+    rc = nodeAcquire(pRtree, 1, 0, &pRoot);
+  }
+  if( rc==SQLITE_OK ){
+    assert( NCELL(pRoot)==0 );
+    nodeZero(pRtree, pRoot);
+    writeInt16(pRoot->zData, iHeight);
+    pRtree->iDepth = iHeight;
+    for(ii=0; ii<nCell; ii++){
+      nodeInsertCell(pRtree, pRoot, &aCell[ii]);
+    }
+    for(ii=0; rc==SQLITE_OK && ii<nCell; ii++){
+      if( iHeight==0 ){
+        rc = rowidWrite(pRtree, aCell[ii].iRowid, 1);
+      }else{
+        rc = parentWrite(pRtree, aCell[ii].iRowid, 1);
+      }
+    }
+    if( rc==SQLITE_OK ){
+      rc = nodeRelease(pRtree, pRoot);
+    }else{
+      nodeRelease(pRtree, pRoot);
+    }
+  }
+
+  sqlite3_free(aIdx);
+  return rc;
+}
+
+/*
+** Write the contents of the Rtree.aPending[] array, if any, to the
+** database.
+*/
+static int rtreeFlushPending(Rtree *pRtree){
+  int rc = SQLITE_OK;
+  int nCell = pRtree->nPending;
+
+  /* Clear Rtree.nPending before starting, in case the transaction is
+  ** rolled back (and xRollback invoked) by an error while writing the
+  ** tree. While the tree is written, no nodes are cached. */
+  pRtree->nPending = 0;
+  pRtree->eBulk = RTREE_BULK_UNKNOWN;
+  if( nCell>0 ){
+    int bNoCache = pRtree->bNoCache;
+    pRtree->bNoCache = 1;
+    nodeCacheClear(pRtree);
+    rc = rtreePendingCheck(pRtree, pRtree->aPending, &nCell);
+    if( rc==SQLITE_OK && nCell>0 ){
+      rc = rtreeBuild(pRtree, pRtree->aPending, nCell);
+    }
+    pRtree->bNoCache = bNoCache;
+  }
+  return rc;
+}
+
 /*
 ** Select a currently unused rowid for a new r-tree record.
 */
@@ -2639,6 +3116,10 @@ static int rtreeUpdate(
 
   rtreeReference(pRtree);
 
+  /* Nodes are not cached while the tree is being modified. */
+  pRtree->bNoCache = 1;
+  nodeCacheClear(pRtree);
+
   assert(nData>=1);
 
   /* If azData[0] is not an SQL NULL value, it is the rowid of a
@@ -2649,10 +3130,15 @@ static int rtreeUpdate(
     i64 iDelete;                /* The rowid to delete */
     RtreeNode *pLeaf;           /* Leaf node containing record iDelete */
     int iCell;                  /* Index of iDelete cell in pLeaf */
-    RtreeNode *pRoot;
+    RtreeNode *pRoot = 0;
+
+    /* The record may still be in the aPending[] array. */
+    rc = rtreeFlushPending(pRtree);
 
     /* Obtain a reference to the root node to initialise Rtree.iDepth */
-    rc = nodeAcquire(pRtree, 1, 0, &pRoot);
+    if( rc==SQLITE_OK ){
+      rc = nodeAcquire(pRtree, 1, 0, &pRoot);
+    }
 
     /* Obtain a reference to the leaf node that contains the entry 
     ** about to be deleted. 
@@ -2713,6 +3199,7 @@ static int rtreeUpdate(
         rc = reinsertNodeContent(pRtree, pLeaf);
       }
       pRtree->pDeleted = pLeaf->pNext;
+      nodeDecodeClear(pLeaf);
       sqlite3_free(pLeaf);
     }
 
@@ -2771,32 +3258,104 @@ static int rtreeUpdate(
     }
     *pRowid = cell.iRowid;
 
-    if( rc==SQLITE_OK ){
-      rc = ChooseLeaf(pRtree, &cell, 0, &pLeaf);
+    /* If this is the first row inserted by the current transaction, check
+    ** whether or not the r-tree is empty. If it is, this row and any
+    ** others inserted before the table is next read are bulk-loaded. */
+    if( rc==SQLITE_OK && pRtree->eBulk==RTREE_BULK_UNKNOWN ){
+      RtreeNode *pRoot;
+      rc = nodeAcquire(pRtree, 1, 0, &pRoot);
+      if( rc==SQLITE_OK ){
+        if( NCELL(pRoot)==0 && pRtree->iDepth==0 ){
+          pRtree->eBulk = RTREE_BULK_ON;
+        }else{
+          pRtree->eBulk = RTREE_BULK_OFF;
+        }
+        rc = nodeRelease(pRtree, pRoot);
+      }
     }
-    if( rc==SQLITE_OK ){
-      int rc2;
-      pRtree->iReinsertHeight = -1;
-      rc = rtreeInsertCell(pRtree, pLeaf, &cell, 0);
-      rc2 = nodeRelease(pRtree, pLeaf);
+
+    if( rc==SQLITE_OK && pRtree->eBulk==RTREE_BULK_ON ){
+      rc = rtreePendingAdd(pRtree, &cell);
+    }else{
       if( rc==SQLITE_OK ){
-        rc = rc2;
+        rc = ChooseLeaf(pRtree, &cell, 0, &pLeaf);
+      }
+      if( rc==SQLITE_OK ){
+        int rc2;
+        pRtree->iReinsertHeight = -1;
+        rc = rtreeInsertCell(pRtree, pLeaf, &cell, 0);
+        rc2 = nodeRelease(pRtree, pLeaf);
+        if( rc==SQLITE_OK ){
+          rc = rc2;
+        }
       }
     }
   }
 
 constraint:
+  pRtree->bNoCache = 0;
   rtreeRelease(pRtree);
   return rc;
 }
 
+/*
+** The xBegin method for rtree module virtual tables.
+*/
+static int rtreeBegin(sqlite3_vtab *pVtab){
+  Rtree *pRtree = (Rtree *)pVtab;
+  assert( pRtree->nPending==0 );
+  pRtree->eBulk = RTREE_BULK_UNKNOWN;
+  return SQLITE_OK;
+}
+
+/*
+** The xSync method for rtree module virtual tables. Write any rows
+** buffered in the aPending[] array to the database.
+*/
+static int rtreeSync(sqlite3_vtab *pVtab){
+  return rtreeFlushPending((Rtree *)pVtab);
+}
+
+/*
+** The xCommit method for rtree module virtual tables.
+*/
+static int rtreeCommit(sqlite3_vtab *pVtab){
+  Rtree *pRtree = (Rtree *)pVtab;
+  assert( pRtree->nPending==0 );
+  pRtree->eBulk = RTREE_BULK_UNKNOWN;
+  return SQLITE_OK;
+}
+
+/*
+** The xRollback method for rtree module virtual tables. Discard any
+** buffered rows and cached nodes.
+**
+** The aPending[] array itself is not freed here. This method may be
+** invoked while rtreeFlushPending() is running, if writing the tree
+** fails.
+*/
+static int rtreeRollback(sqlite3_vtab *pVtab){
+  Rtree *pRtree = (Rtree *)pVtab;
+  pRtree->nPending = 0;
+  pRtree->eBulk = RTREE_BULK_UNKNOWN;
+  nodeCacheClear(pRtree);
+  return SQLITE_OK;
+}
+
 /*
 ** The xRename method for rtree module virtual tables.
 */
 static int rtreeRename(sqlite3_vtab *pVtab, const char *zNewName){
   Rtree *pRtree = (Rtree *)pVtab;
   int rc = SQLITE_NOMEM;
-  char *zSql = sqlite3_mprintf(
+  char *zSql;
+
+  /* Write any buffered rows using the current shadow table names. */
+  rc = rtreeFlushPending(pRtree);
+  if( rc!=SQLITE_OK ) return rc;
+  rc = SQLITE_NOMEM;
+
+  zSql = sqlite3_mprintf(
     "ALTER TABLE %Q.'%q_node'   RENAME TO \"%w_node\";"
     "ALTER TABLE %Q.'%q_parent' RENAME TO \"%w_parent\";"
     "ALTER TABLE %Q.'%q_rowid'  RENAME TO \"%w_rowid\";"
@@ -2826,10 +3385,10 @@ static sqlite3_module rtreeModule = {
   rtreeColumn,                /* xColumn - read data */
   rtreeRowid,                 /* xRowid - read data */
   rtreeUpdate,                /* xUpdate - write data */
-  0,                          /* xBegin - begin transaction */
-  0,                          /* xSync - sync transaction */
-  0,                          /* xCommit - commit transaction */
-  0,                          /* xRollback - rollback transaction */
+  rtreeBegin,                 /* xBegin - begin transaction */
+  rtreeSync,                  /* xSync - sync transaction */
+  rtreeCommit,                /* xCommit - commit transaction */
+  rtreeRollback,              /* xRollback - rollback transaction */
   0,                          /* xFindFunction - function overloading */
   rtreeRename                 /* xRename - rename the table */
 };
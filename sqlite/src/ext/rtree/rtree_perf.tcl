@@ -24,11 +24,14 @@ puts "Finished generating data"
 
 set sql1 {CREATE TABLE btree(ii INTEGER PRIMARY KEY, x1, x2, y1, y2)}
 set sql2 {CREATE VIRTUAL TABLE rtree USING rtree(ii, x1, x2, y1, y2)}
+set sql3 {CREATE VIRTUAL TABLE rtree2 USING rtree(ii, x1, x2, y1, y2)}
 puts "Creating tables:"
 puts "  $sql1"
 puts "  $sql2"
+puts "  $sql3"
 db eval $sql1
 db eval $sql2
+db eval $sql3
 
 db eval "pragma cache_size=100"
 
@@ -54,6 +57,19 @@ set rtree_time [time {db transaction {
 }}]
 puts "$rtree_time"
 
+# Table rtree is empty when the transaction starts, so it is bulk-loaded.
+# Table rtree2 is not, so its rows are inserted one at a time.
+puts -nonewline "Inserting into non-empty rtree... "
+flush stdout
+db eval {INSERT INTO rtree2 VALUES(1, 0, 0, 0, 0)}
+set rtree2_time [time {db transaction {
+  set ii 1
+  foreach {x1 x2 y1 y2} $data {
+    incr ii
+    db eval {INSERT INTO rtree2 VALUES($ii, $x1, $x2, $y1, $y2)}
+  }
+}}]
+puts "$rtree2_time"
 
 puts -nonewline "Selecting from btree... "
 flush stdout
@@ -72,3 +88,23 @@ set rtree_select_time [time {
   }
 }]
 puts "$rtree_select_time"
+
+puts -nonewline "Selecting from rtree2... "
+flush stdout
+set rtree2_select_time [time {
+  foreach {x1 x2 y1 y2} [lrange $data 0 [expr $NQUERY*4-1]] {
+    db eval {SELECT * FROM rtree2 WHERE x1<$x1 AND x2>$x2 AND y1<$y1 AND y2>$y2}
+  }
+}]
+puts "$rtree2_select_time"
+
+puts -nonewline "Joining btree and rtree... "
+flush stdout
+set rtree_join_time [time {
+  db eval {
+    SELECT count(*) FROM btree, rtree
+    WHERE btree.ii<=$NQUERY AND rtree.x1<btree.x2 AND rtree.x2>btree.x1
+      AND rtree.y1<btree.y2 AND rtree.y2>btree.y1
+  }
+}]
+puts "$rtree_join_time"
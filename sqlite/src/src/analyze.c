@@ -17,18 +17,20 @@
 /*
 ** This routine generates code that opens the sqlite_stat1 table for
 ** writing with cursor iStatCur. If the library was built with the
-** SQLITE_ENABLE_STAT2 macro defined, then the sqlite_stat2 table is
-** opened for writing using cursor (iStatCur+1)
+** SQLITE_ENABLE_STAT2 or SQLITE_ENABLE_STAT3 macro defined, then the
+** sqlite_stat2 or sqlite_stat3 table is opened for writing using cursor
+** (iStatCur+1).
 **
 ** If the sqlite_stat1 tables does not previously exist, it is created.
-** Similarly, if the sqlite_stat2 table does not exist and the library
-** is compiled with SQLITE_ENABLE_STAT2 defined, it is created. 
+** Similarly, if the sqlite_stat2 (or sqlite_stat3) table does not exist 
+** and the library is compiled with SQLITE_ENABLE_STAT2 (or STAT3) defined,
+** it is created. 
 **
 ** Argument zWhere may be a pointer to a buffer containing a table name,
 ** or it may be a NULL pointer. If it is not NULL, then all entries in
-** the sqlite_stat1 and (if applicable) sqlite_stat2 tables associated
-** with the named table are deleted. If zWhere==0, then code is generated
-** to delete all stat table entries.
+** the sqlite_stat1 and (if applicable) sqlite_stat2 or sqlite_stat3 tables
+** associated with the named table are deleted. If zWhere==0, then code is
+** generated to delete all stat table entries.
 */
 static void openStatTable(
   Parse *pParse,          /* Parsing context */
@@ -44,6 +46,9 @@ static void openStatTable(
     { "sqlite_stat1", "tbl,idx,stat" },
 #ifdef SQLITE_ENABLE_STAT2
     { "sqlite_stat2", "tbl,idx,sampleno,sample" },
+#endif
+#ifdef SQLITE_ENABLE_STAT3
+    { "sqlite_stat3", "tbl,idx,neq,nlt,ndlt,sample" },
 #endif
   };
 
@@ -63,7 +68,7 @@ static void openStatTable(
     const char *zTab = aTable[i].zName;
     Table *pStat;
     if( (pStat = sqlite3FindTable(db, zTab, pDb->zName))==0 ){
-      /* The sqlite_stat[12] table does not exist. Create it. Note that a 
+      /* The sqlite_stat[123] table does not exist. Create it. Note that a 
       ** side-effect of the CREATE TABLE statement is to leave the rootpage 
       ** of the new table in register pParse->regRoot. This is important 
       ** because the OpenWrite opcode below will be needing it. */
@@ -83,13 +88,13 @@ static void openStatTable(
            "DELETE FROM %Q.%s WHERE %s=%Q", pDb->zName, zTab, zWhereType, zWhere
         );
       }else{
-        /* The sqlite_stat[12] table already exists.  Delete all rows. */
+        /* The sqlite_stat[123] table already exists.  Delete all rows. */
         sqlite3VdbeAddOp2(v, OP_Clear, aRoot[i], iDb);
       }
     }
   }
 
-  /* Open the sqlite_stat[12] tables for writing. */
+  /* Open the sqlite_stat[123] tables for writing. */
   for(i=0; i<ArraySize(aTable); i++){
     sqlite3VdbeAddOp3(v, OP_OpenWrite, iStatCur+i, aRoot[i], iDb);
     sqlite3VdbeChangeP4(v, -1, (char *)3, P4_INT32);
@@ -97,6 +102,228 @@ static void openStatTable(
   }
 }
 
+#ifdef SQLITE_ENABLE_STAT3
+/*
+** Three SQL functions - stat3_init(), stat3_push(), and stat3_get() -
+** share an instance of the following structure to hold their state
+** information. ANALYZE uses them to choose which keys of the left-most
+** column of an index to record in the sqlite_stat3 table.
+**
+** Each distinct key is passed to stat3_push() along with nEq, the number
+** of index entries with that key, nLt, the number of entries with smaller
+** keys, and nDLt, the number of distinct smaller keys. The accumulator
+** retains up to mxSample of them. Roughly one third are "periodic" samples
+** taken at evenly spaced positions in the index, so that the range of
+** keys is covered. The rest are the keys with the largest nEq values seen,
+** so that a few very common keys in a skewed distribution are always
+** recorded. Ties between candidates of equal nEq are broken using a
+** pseudo-random number, seeded from the size of the index so that the
+** result of ANALYZE is repeatable.
+*/
+typedef struct Stat3Accum Stat3Accum;
+struct Stat3Accum {
+  i64 nRow;                 /* Number of rows in the entire index */
+  i64 nPSample;             /* How often to do a periodic sample */
+  int iMin;                 /* Index of entry with minimum nEq and hash */
+  int mxSample;             /* Maximum number of samples to accumulate */
+  int nSample;              /* Current number of samples */
+  u32 iPrn;                 /* Pseudo-random number used for sampling */
+  struct Stat3Sample {
+    i64 iRowid;                /* Rowid in main table of the key */
+    i64 nEq;                   /* sqlite_stat3.nEq */
+    i64 nLt;                   /* sqlite_stat3.nLt */
+    i64 nDLt;                  /* sqlite_stat3.nDLt */
+    u8 isPSample;              /* True if a periodic sample */
+    u32 iHash;                 /* Tiebreaker hash */
+  } *a;                     /* An array of samples */
+};
+
+/*
+** Implementation of the stat3_init(C,S) SQL function. The two parameters
+** are the number of rows in the index and the number of samples to
+** accumulate. The return value is the Stat3Accum object, as a blob.
+*/
+static void stat3Init(
+  sqlite3_context *context,
+  int argc,
+  sqlite3_value **argv
+){
+  Stat3Accum *p;
+  i64 nRow;
+  int mxSample;
+  int n;
+
+  UNUSED_PARAMETER(argc);
+  nRow = sqlite3_value_int64(argv[0]);
+  mxSample = sqlite3_value_int(argv[1]);
+  n = sizeof(*p) + sizeof(p->a[0])*mxSample;
+  p = sqlite3_malloc( n );
+  if( p==0 ){
+    sqlite3_result_error_nomem(context);
+    return;
+  }
+  memset(p, 0, n);
+  p->a = (struct Stat3Sample*)&p[1];
+  p->nRow = nRow;
+  p->mxSample = mxSample;
+  p->nPSample = p->nRow/(mxSample/3+1) + 1;
+  p->iPrn = 0xd0944565*(u32)nRow;
+  sqlite3_result_blob(context, p, sizeof(p), sqlite3_free);
+}
+static const FuncDef stat3InitFuncdef = {
+  2,                /* nArg */
+  SQLITE_UTF8,      /* iPrefEnc */
+  0,                /* flags */
+  0,                /* pUserData */
+  0,                /* pNext */
+  stat3Init,        /* xFunc */
+  0,                /* xStep */
+  0,                /* xFinalize */
+  "stat3_init",     /* zName */
+  0,                /* pHash */
+  0                 /* pDestructor */
+};
+
+
+/*
+** Implementation of the stat3_push(nEq,nLt,nDLt,rowid,P) SQL function. The
+** arguments describe a single key instance. This routine makes the 
+** decision about whether or not to retain this key for the sqlite_stat3
+** table.
+**
+** The return value is NULL.
+*/
+static void stat3Push(
+  sqlite3_context *context,
+  int argc,
+  sqlite3_value **argv
+){
+  Stat3Accum *p = (Stat3Accum*)sqlite3_value_blob(argv[4]);
+  i64 nEq = sqlite3_value_int64(argv[0]);
+  i64 nLt = sqlite3_value_int64(argv[1]);
+  i64 nDLt = sqlite3_value_int64(argv[2]);
+  i64 rowid = sqlite3_value_int64(argv[3]);
+  u8 isPSample = 0;
+  u8 doInsert = 0;
+  int iMin = p->iMin;
+  struct Stat3Sample *pSample;
+  int i;
+  u32 h;
+
+  UNUSED_PARAMETER(context);
+  UNUSED_PARAMETER(argc);
+  if( nEq==0 ) return;
+  h = p->iPrn = p->iPrn*1103515245 + 12345;
+  if( (nLt/p->nPSample)!=((nEq+nLt)/p->nPSample) ){
+    doInsert = isPSample = 1;
+  }else if( p->nSample<p->mxSample ){
+    doInsert = 1;
+  }else{
+    if( nEq>p->a[iMin].nEq || (nEq==p->a[iMin].nEq && h>p->a[iMin].iHash) ){
+      doInsert = 1;
+    }
+  }
+  if( !doInsert ) return;
+  if( p->nSample==p->mxSample ){
+    assert( p->nSample - iMin - 1 >= 0 );
+    memmove(&p->a[iMin], &p->a[iMin+1], sizeof(p->a[0])*(p->nSample-iMin-1));
+    pSample = &p->a[p->nSample-1];
+  }else{
+    pSample = &p->a[p->nSample++];
+  }
+  pSample->iRowid = rowid;
+  pSample->nEq = nEq;
+  pSample->nLt = nLt;
+  pSample->nDLt = nDLt;
+  pSample->iHash = h;
+  pSample->isPSample = isPSample;
+
+  /* Find the new minimum */
+  if( p->nSample==p->mxSample ){
+    pSample = p->a;
+    i = 0;
+    while( pSample->isPSample ){
+      i++;
+      pSample++;
+      assert( i<p->nSample );
+    }
+    nEq = pSample->nEq;
+    h = pSample->iHash;
+    iMin = i;
+    for(i++, pSample++; i<p->nSample; i++, pSample++){
+      if( pSample->isPSample ) continue;
+      if( pSample->nEq<nEq
+       || (pSample->nEq==nEq && pSample->iHash<h)
+      ){
+        iMin = i;
+        nEq = pSample->nEq;
+        h = pSample->iHash;
+      }
+    }
+    p->iMin = iMin;
+  }
+}
+static const FuncDef stat3PushFuncdef = {
+  5,                /* nArg */
+  SQLITE_UTF8,      /* iPrefEnc */
+  0,                /* flags */
+  0,                /* pUserData */
+  0,                /* pNext */
+  stat3Push,        /* xFunc */
+  0,                /* xStep */
+  0,                /* xFinalize */
+  "stat3_push",     /* zName */
+  0,                /* pHash */
+  0                 /* pDestructor */
+};
+
+/*
+** Implementation of the stat3_get(P,N,...) SQL function. This routine is
+** used to query the results. Content is returned for the Nth sqlite_stat3
+** row where N is between 0 and S-1 and S is the number of samples. The
+** value returned depends on the number of arguments.
+**
+**   argc==2    result:  rowid
+**   argc==3    result:  nEq
+**   argc==4    result:  nLt
+**   argc==5    result:  nDLt
+**
+** NULL is returned once N reaches the number of samples. The samples are
+** kept in index order, so the rows are written in order of increasing key.
+*/
+static void stat3Get(
+  sqlite3_context *context,
+  int argc,
+  sqlite3_value **argv
+){
+  int n = sqlite3_value_int(argv[1]);
+  Stat3Accum *p = (Stat3Accum*)sqlite3_value_blob(argv[0]);
+
+  assert( p!=0 );
+  if( p->nSample<=n ) return;
+  switch( argc ){
+    case 2:  sqlite3_result_int64(context, p->a[n].iRowid); break;
+    case 3:  sqlite3_result_int64(context, p->a[n].nEq);    break;
+    case 4:  sqlite3_result_int64(context, p->a[n].nLt);    break;
+    default: sqlite3_result_int64(context, p->a[n].nDLt);   break;
+  }
+}
+static const FuncDef stat3GetFuncdef = {
+  -1,               /* nArg */
+  SQLITE_UTF8,      /* iPrefEnc */
+  0,                /* flags */
+  0,                /* pUserData */
+  0,                /* pNext */
+  stat3Get,         /* xFunc */
+  0,                /* xStep */
+  0,                /* xFinalize */
+  "stat3_get",      /* zName */
+  0,                /* pHash */
+  0                 /* pDestructor */
+};
+#endif /* SQLITE_ENABLE_STAT3 */
+
+
 /*
 ** Generate code to do an analysis of all indices associated with
 ** a single table.
@@ -120,6 +347,22 @@ static void analyzeOneTable(
   int regTabname = iMem++;     /* Register containing table name */
   int regIdxname = iMem++;     /* Register containing index name */
   int regSampleno = iMem++;    /* Register containing next sample number */
+#ifdef SQLITE_ENABLE_STAT3
+  int regNumEq = regSampleno;  /* Number of instances.  Same as regSampleno */
+  int regNumLt = iMem++;       /* Number of keys less than regSample */
+  int regNumDLt = iMem++;      /* Number of distinct keys less than regSample */
+  int regSample = iMem++;      /* The next sample value */
+  int regSampleRowid = regSample; /* Rowid of first row with a key */
+  int regAccum = iMem++;       /* Register to hold Stat3Accum object */
+  int regLoop = iMem++;        /* Loop counter */
+  int regCount = iMem++;       /* Number of rows in the index */
+  int regTemp1 = iMem++;       /* Intermediate register */
+  int regTemp2 = iMem++;       /* Intermediate register */
+  int iTabCur = -1;            /* Cursor open on pTab to read sample values */
+  int addrLoop;                /* Top of the loop that writes sqlite_stat3 */
+  int addrDone;                /* Jump out of the sqlite_stat3 loop */
+#endif
+  int *aChngAddr;              /* Array of jump instruction addresses */
   int regCol = iMem++;         /* Content of a column analyzed table */
   int regRec = iMem++;         /* Register holding completed record */
   int regTemp = iMem++;        /* Temporary use register */
@@ -163,11 +406,14 @@ static void analyzeOneTable(
   iIdxCur = pParse->nTab++;
   sqlite3VdbeAddOp4(v, OP_String8, 0, regTabname, 0, pTab->zName, 0);
   for(pIdx=pTab->pIndex; pIdx; pIdx=pIdx->pNext){
-    int nCol;
-    KeyInfo *pKey;
+    int nCol;                  /* Number of columns indexed by pIdx */
+    KeyInfo *pKey;             /* KeyInfo structure for pIdx */
+    int addrIfNot = 0;         /* address of OP_IfNot */
 
     if( pOnlyIdx && pOnlyIdx!=pIdx ) continue;
     nCol = pIdx->nColumn;
+    aChngAddr = sqlite3DbMallocRaw(db, sizeof(int)*nCol);
+    if( aChngAddr==0 ) return;
     pKey = sqlite3IndexKeyinfo(pParse, pIdx);
     if( iMem+1+(nCol*2)>pParse->nMem ){
       pParse->nMem = iMem+1+(nCol*2);
@@ -182,6 +428,26 @@ static void analyzeOneTable(
     /* Populate the register containing the index name. */
     sqlite3VdbeAddOp4(v, OP_String8, 0, regIdxname, 0, pIdx->zName, 0);
 
+#ifdef SQLITE_ENABLE_STAT3
+    /* Create the Stat3Accum object that chooses the samples and zero the
+    ** counters passed to it with each distinct key. The table itself is
+    ** opened the first time through, as the sample values are read from
+    ** the table row that each selected index entry refers to.  */
+    if( iTabCur<0 ){
+      iTabCur = pParse->nTab++;
+      sqlite3OpenTable(pParse, iTabCur, iDb, pTab, OP_OpenRead);
+    }
+    sqlite3VdbeAddOp2(v, OP_Count, iIdxCur, regCount);
+    sqlite3VdbeAddOp2(v, OP_Integer, SQLITE_STAT3_SAMPLES, regTemp1);
+    sqlite3VdbeAddOp2(v, OP_Integer, 0, regNumEq);
+    sqlite3VdbeAddOp2(v, OP_Integer, 0, regNumLt);
+    sqlite3VdbeAddOp2(v, OP_Integer, -1, regNumDLt);
+    sqlite3VdbeAddOp2(v, OP_Null, 0, regSampleRowid);
+    sqlite3VdbeAddOp4(v, OP_Function, 0, regCount, regAccum,
+                      (char*)&stat3InitFuncdef, P4_FUNCDEF);
+    sqlite3VdbeChangeP5(v, 2);
+#endif
+
 #ifdef SQLITE_ENABLE_STAT2
 
     /* If this iteration of the loop is generating code to analyze the
@@ -274,38 +540,103 @@ static void analyzeOneTable(
 #endif
 
         /* Always record the very first row */
-        sqlite3VdbeAddOp1(v, OP_IfNot, iMem+1);
+        addrIfNot = sqlite3VdbeAddOp1(v, OP_IfNot, iMem+1);
       }
       assert( pIdx->azColl!=0 );
       assert( pIdx->azColl[i]!=0 );
       pColl = sqlite3LocateCollSeq(pParse, pIdx->azColl[i]);
-      sqlite3VdbeAddOp4(v, OP_Ne, regCol, 0, iMem+nCol+i+1,
-                       (char*)pColl, P4_COLLSEQ);
+      aChngAddr[i] = sqlite3VdbeAddOp4(v, OP_Ne, regCol, 0, iMem+nCol+i+1,
+                                      (char*)pColl, P4_COLLSEQ);
       sqlite3VdbeChangeP5(v, SQLITE_NULLEQ);
+#ifdef SQLITE_ENABLE_STAT3
+      if( i==0 ){
+        /* Same left-most key as the previous row. Count it. */
+        sqlite3VdbeAddOp2(v, OP_AddImm, regNumEq, 1);
+      }
+#endif
     }
     if( db->mallocFailed ){
-      /* If a malloc failure has occurred, then the result of the expression 
-      ** passed as the second argument to the call to sqlite3VdbeJumpHere() 
-      ** below may be negative. Which causes an assert() to fail (or an
-      ** out-of-bounds write if SQLITE_DEBUG is not defined).  */
+      /* If a malloc failure has occurred, then the addresses stored in
+      ** aChngAddr[] may not be valid jump destinations. Which causes an
+      ** assert() to fail (or an out-of-bounds write if SQLITE_DEBUG is not
+      ** defined) in sqlite3VdbeJumpHere() below.  */
+      sqlite3DbFree(db, aChngAddr);
       return;
     }
     sqlite3VdbeAddOp2(v, OP_Goto, 0, endOfLoop);
     for(i=0; i<nCol; i++){
-      int addr2 = sqlite3VdbeCurrentAddr(v) - (nCol*2);
+      sqlite3VdbeJumpHere(v, aChngAddr[i]);   /* Set jump dest for the OP_Ne */
       if( i==0 ){
-        sqlite3VdbeJumpHere(v, addr2-1);  /* Set jump dest for the OP_IfNot */
+        sqlite3VdbeJumpHere(v, addrIfNot);    /* Jump dest for the OP_IfNot */
+#ifdef SQLITE_ENABLE_STAT3
+        /* A new left-most key. Pass the counts for the previous key (if
+        ** any) to the accumulator, then start counting the new one.  */
+        sqlite3VdbeAddOp4(v, OP_Function, 0, regNumEq, regTemp2,
+                          (char*)&stat3PushFuncdef, P4_FUNCDEF);
+        sqlite3VdbeChangeP5(v, 5);
+        sqlite3VdbeAddOp2(v, OP_IdxRowid, iIdxCur, regSampleRowid);
+        sqlite3VdbeAddOp3(v, OP_Add, regNumEq, regNumLt, regNumLt);
+        sqlite3VdbeAddOp2(v, OP_AddImm, regNumDLt, 1);
+        sqlite3VdbeAddOp2(v, OP_Integer, 1, regNumEq);
+#endif
       }
-      sqlite3VdbeJumpHere(v, addr2);      /* Set jump dest for the OP_Ne */
       sqlite3VdbeAddOp2(v, OP_AddImm, iMem+i+1, 1);
       sqlite3VdbeAddOp3(v, OP_Column, iIdxCur, i, iMem+nCol+i+1);
     }
+    sqlite3DbFree(db, aChngAddr);
 
     /* End of the analysis loop. */
     sqlite3VdbeResolveLabel(v, endOfLoop);
     sqlite3VdbeAddOp2(v, OP_Next, iIdxCur, topOfLoop);
     sqlite3VdbeAddOp1(v, OP_Close, iIdxCur);
 
+#ifdef SQLITE_ENABLE_STAT3
+    /* Pass the counts for the last key to the accumulator. Then write one
+    ** row to the sqlite_stat3 table for each sample it retained:
+    **
+    **   regLoop = 0
+    **   while( (regTemp1 = stat3_get(regAccum, regLoop))!=NULL ){
+    **     move the table cursor to the row with rowid regTemp1
+    **     regSample = value of the left-most column of the index
+    **     regNumEq, regNumLt, regNumDLt = counts for the sample
+    **     insert (regTabname, regIdxname, regNumEq .. regSample)
+    **     regLoop++
+    **   }
+    */
+    sqlite3VdbeAddOp4(v, OP_Function, 0, regNumEq, regTemp2,
+                      (char*)&stat3PushFuncdef, P4_FUNCDEF);
+    sqlite3VdbeChangeP5(v, 5);
+    sqlite3VdbeAddOp2(v, OP_Integer, -1, regLoop);
+    addrLoop = sqlite3VdbeAddOp2(v, OP_AddImm, regLoop, 1);
+    sqlite3VdbeAddOp4(v, OP_Function, 0, regAccum, regTemp1,
+                      (char*)&stat3GetFuncdef, P4_FUNCDEF);
+    sqlite3VdbeChangeP5(v, 2);
+    addrDone = sqlite3VdbeAddOp1(v, OP_IsNull, regTemp1);
+    sqlite3VdbeAddOp3(v, OP_NotExists, iTabCur, addrLoop, regTemp1);
+    sqlite3ExprCodeGetColumnOfTable(v, pTab, iTabCur, pIdx->aiColumn[0],
+                                    regSample);
+    for(i=0; i<3; i++){
+      sqlite3VdbeAddOp4(v, OP_Function, 0, regAccum, regNumEq+i,
+                        (char*)&stat3GetFuncdef, P4_FUNCDEF);
+      sqlite3VdbeChangeP5(v, 3+i);
+    }
+    assert( regTabname+1==regIdxname
+         && regTabname+2==regNumEq
+         && regTabname+3==regNumLt
+         && regTabname+4==regNumDLt
+         && regTabname+5==regSample
+         && regAccum+1==regLoop
+         && regAccum+2==regCount
+         && regAccum+3==regTemp1
+         && regAccum+4==regTemp2
+    );
+    sqlite3VdbeAddOp4(v, OP_MakeRecord, regTabname, 6, regRec, "aabbbb", 0);
+    sqlite3VdbeAddOp2(v, OP_NewRowid, iStatCur+1, regRowid);
+    sqlite3VdbeAddOp3(v, OP_Insert, iStatCur+1, regRec, regRowid);
+    sqlite3VdbeAddOp2(v, OP_Goto, 0, addrLoop);
+    sqlite3VdbeJumpHere(v, addrDone);
+#endif
+
     /* Store the results in sqlite_stat1.
     **
     ** The result is a single row of the sqlite_stat1 table.  The first
@@ -561,10 +892,15 @@ static int analysisLoader(void *pData, int argc, char **argv, char **NotUsed){
 ** and its contents.
 */
 void sqlite3DeleteIndexSamples(sqlite3 *db, Index *pIdx){
-#ifdef SQLITE_ENABLE_STAT2
+#if defined(SQLITE_ENABLE_STAT2) || defined(SQLITE_ENABLE_STAT3)
   if( pIdx->aSample ){
     int j;
-    for(j=0; j<SQLITE_INDEX_SAMPLES; j++){
+#ifdef SQLITE_ENABLE_STAT3
+    int nSample = pIdx->nSample;
+#else
+    int nSample = SQLITE_INDEX_SAMPLES;
+#endif
+    for(j=0; j<nSample; j++){
       IndexSample *p = &pIdx->aSample[j];
       if( p->eType==SQLITE_TEXT || p->eType==SQLITE_BLOB ){
         sqlite3DbFree(db, p->u.z);
@@ -578,21 +914,164 @@ void sqlite3DeleteIndexSamples(sqlite3 *db, Index *pIdx){
 #endif
 }
 
+#ifdef SQLITE_ENABLE_STAT3
+/*
+** Load the content from the sqlite_stat3 table into the Index.aSample[]
+** arrays of all indices. Each index is given an array of pIdx->nSample
+** samples in order of increasing key, and pIdx->avgEq is set to the
+** average number of rows per key among the keys that are not samples.
+**
+** The table is read in two passes. The first counts the samples for each
+** index so that the aSample[] array may be allocated. The second fills
+** it in. Index names are compared without regard to case in both passes,
+** as they are by sqlite3FindIndex(). Memory is allocated with a NULL database handle, as the samples
+** are part of the schema, which may be shared between connections.
+*/
+static int loadStat3(sqlite3 *db, const char *zDb){
+  int rc;                       /* Result codes from subroutines */
+  sqlite3_stmt *pStmt = 0;      /* An SQL statement being run */
+  char *zSql;                   /* Text of the SQL statement */
+  Index *pPrevIdx = 0;          /* Previous index in the loop */
+  int idx = 0;                  /* slot in pIdx->aSample[] for next sample */
+  int eType;                    /* Datatype of a sample */
+  IndexSample *pSample;         /* A slot in pIdx->aSample[] */
+
+  if( !sqlite3FindTable(db, "sqlite_stat3", zDb) ){
+    return SQLITE_OK;
+  }
+
+  zSql = sqlite3MPrintf(db, 
+      "SELECT idx,count(*) FROM %Q.sqlite_stat3"
+      " GROUP BY idx COLLATE nocase", zDb);
+  if( !zSql ){
+    return SQLITE_NOMEM;
+  }
+  rc = sqlite3_prepare(db, zSql, -1, &pStmt, 0);
+  sqlite3DbFree(db, zSql);
+  if( rc ) return rc;
+
+  while( sqlite3_step(pStmt)==SQLITE_ROW ){
+    char *zIndex;   /* Index name */
+    Index *pIdx;    /* Pointer to the index object */
+    int nSample;    /* Number of samples */
+
+    zIndex = (char *)sqlite3_column_text(pStmt, 0);
+    if( zIndex==0 ) continue;
+    nSample = sqlite3_column_int(pStmt, 1);
+    pIdx = sqlite3FindIndex(db, zIndex, zDb);
+    if( pIdx==0 || pIdx->nSample>0 || nSample<=0 ) continue;
+    pIdx->nSample = nSample;
+    pIdx->aSample = sqlite3DbMallocRaw(0, nSample*sizeof(IndexSample));
+    pIdx->avgEq = pIdx->aiRowEst[1];
+    if( pIdx->aSample==0 ){
+      pIdx->nSample = 0;
+      db->mallocFailed = 1;
+      sqlite3_finalize(pStmt);
+      return SQLITE_NOMEM;
+    }
+    memset(pIdx->aSample, 0, nSample*sizeof(IndexSample));
+  }
+  rc = sqlite3_finalize(pStmt);
+  if( rc ) return rc;
+
+  zSql = sqlite3MPrintf(db, 
+      "SELECT idx,neq,nlt,ndlt,sample FROM %Q.sqlite_stat3"
+      " ORDER BY idx COLLATE nocase, nlt", zDb);
+  if( !zSql ){
+    return SQLITE_NOMEM;
+  }
+  rc = sqlite3_prepare(db, zSql, -1, &pStmt, 0);
+  sqlite3DbFree(db, zSql);
+  if( rc ) return rc;
+
+  while( sqlite3_step(pStmt)==SQLITE_ROW ){
+    char *zIndex;   /* Index name */
+    Index *pIdx;    /* Pointer to the index object */
+    int i;          /* Loop counter */
+    i64 sumEq;      /* Sum of the nEq values */
+
+    zIndex = (char *)sqlite3_column_text(pStmt, 0);
+    if( zIndex==0 ) continue;
+    pIdx = sqlite3FindIndex(db, zIndex, zDb);
+    if( pIdx==0 ) continue;
+    if( pIdx==pPrevIdx ){
+      idx++;
+    }else{
+      pPrevIdx = pIdx;
+      idx = 0;
+    }
+    if( idx>=pIdx->nSample ) continue;
+    pSample = &pIdx->aSample[idx];
+    pSample->nEq = (unsigned)sqlite3_column_int64(pStmt, 1);
+    pSample->nLt = (unsigned)sqlite3_column_int64(pStmt, 2);
+    pSample->nDLt = (unsigned)sqlite3_column_int64(pStmt, 3);
+    if( idx==pIdx->nSample-1 ){
+      /* The last sample of this index. Use the counts of all samples to
+      ** estimate the average number of rows for keys that are not one of
+      ** the samples.  */
+      for(i=0, sumEq=0; i<idx; i++) sumEq += pIdx->aSample[i].nEq;
+      if( pSample->nDLt>(unsigned)idx && pSample->nLt>sumEq ){
+        pIdx->avgEq = (unsigned)((pSample->nLt - sumEq)/(pSample->nDLt - idx));
+      }
+      if( pIdx->avgEq==0 ) pIdx->avgEq = 1;
+    }
+    eType = sqlite3_column_type(pStmt, 4);
+    pSample->eType = (u8)eType;
+    switch( eType ){
+      case SQLITE_INTEGER: {
+        pSample->u.i = sqlite3_column_int64(pStmt, 4);
+        break;
+      }
+      case SQLITE_FLOAT: {
+        pSample->u.r = sqlite3_column_double(pStmt, 4);
+        break;
+      }
+      case SQLITE_NULL: {
+        break;
+      }
+      default: {
+        const char *z = (const char *)(
+              (eType==SQLITE_BLOB) ?
+              sqlite3_column_blob(pStmt, 4):
+              sqlite3_column_text(pStmt, 4)
+           );
+        int n = z ? sqlite3_column_bytes(pStmt, 4) : 0;
+        assert( eType==SQLITE_TEXT || eType==SQLITE_BLOB );
+        pSample->nByte = n;
+        if( n < 1){
+          pSample->u.z = 0;
+        }else{
+          pSample->u.z = sqlite3DbMallocRaw(0, n);
+          if( pSample->u.z==0 ){
+            db->mallocFailed = 1;
+            sqlite3_finalize(pStmt);
+            return SQLITE_NOMEM;
+          }
+          memcpy(pSample->u.z, z, n);
+        }
+      }
+    }
+  }
+  return sqlite3_finalize(pStmt);
+}
+#endif /* SQLITE_ENABLE_STAT3 */
+
 /*
-** Load the content of the sqlite_stat1 and sqlite_stat2 tables. The
-** contents of sqlite_stat1 are used to populate the Index.aiRowEst[]
-** arrays. The contents of sqlite_stat2 are used to populate the
-** Index.aSample[] arrays.
+** Load the content of the sqlite_stat1 and sqlite_stat2 (or sqlite_stat3)
+** tables. The contents of sqlite_stat1 are used to populate the
+** Index.aiRowEst[] arrays. The contents of sqlite_stat2 or sqlite_stat3
+** are used to populate the Index.aSample[] arrays.
 **
 ** If the sqlite_stat1 table is not present in the database, SQLITE_ERROR
-** is returned. In this case, even if SQLITE_ENABLE_STAT2 was defined 
-** during compilation and the sqlite_stat2 table is present, no data is 
-** read from it.
+** is returned. In this case, even if SQLITE_ENABLE_STAT2 or STAT3 was 
+** defined during compilation and the sqlite_stat2 or sqlite_stat3 table 
+** is present, no data is read from it.
 **
 ** If SQLITE_ENABLE_STAT2 was defined during compilation and the 
 ** sqlite_stat2 table is not present in the database, SQLITE_ERROR is
 ** returned. However, in this case, data is read from the sqlite_stat1
-** table (if it is present) before returning.
+** table (if it is present) before returning. A missing sqlite_stat3 table
+** is not an error: the indices are simply left without samples.
 **
 ** If an OOM error occurs, this function always sets db->mallocFailed.
 ** This means if the caller does not care about other errors, the return
@@ -614,6 +1093,9 @@ int sqlite3AnalysisLoad(sqlite3 *db, int iDb){
     sqlite3DefaultRowEst(pIdx);
     sqlite3DeleteIndexSamples(db, pIdx);
     pIdx->aSample = 0;
+#ifdef SQLITE_ENABLE_STAT3
+    pIdx->nSample = 0;
+#endif
   }
 
   /* Check to make sure the sqlite_stat1 table exists */
@@ -633,6 +1115,12 @@ int sqlite3AnalysisLoad(sqlite3 *db, int iDb){
     sqlite3DbFree(db, zSql);
   }
 
+  /* Load the statistics from the sqlite_stat3 table. */
+#ifdef SQLITE_ENABLE_STAT3
+  if( rc==SQLITE_OK ){
+    rc = loadStat3(db, sInfo.zDatabase);
+  }
+#endif
 
   /* Load the statistics from the sqlite_stat2 table. */
 #ifdef SQLITE_ENABLE_STAT2
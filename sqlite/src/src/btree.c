@@ -2087,6 +2087,19 @@ int sqlite3BtreeSetCacheSize(Btree *p, int mxPage){
   return SQLITE_OK;
 }
 
+/*
+** Change the limit on the amount of the database file that may be
+** memory mapped.
+*/
+int sqlite3BtreeSetMmapLimit(Btree *p, sqlite3_int64 szMmap){
+  BtShared *pBt = p->pBt;
+  assert( sqlite3_mutex_held(p->db->mutex) );
+  sqlite3BtreeEnter(p);
+  sqlite3PagerSetMmapLimit(pBt->pPager, szMmap);
+  sqlite3BtreeLeave(p);
+  return SQLITE_OK;
+}
+
 /*
 ** Change the way data is synced to disk in order to increase or decrease
 ** how well the database resists damage due to OS crashes and power
@@ -2590,6 +2603,14 @@ int sqlite3BtreeBeginTrans(Btree *p, int wrflag){
         rc = SQLITE_READONLY;
       }else{
         rc = sqlite3PagerBegin(pBt->pPager,wrflag>1,sqlite3TempInMemory(p->db));
+        if( rc==SQLITE_OK && sqlite3PagerMmapRefcount(pBt->pPager)>0 ){
+          /* Pages read through a memory mapping are not part of the page
+          ** cache, so a cursor holding one would not see changes made by
+          ** this transaction, nor follow the page if autovacuum moves it.
+          ** Save all cursors now so that they reload their pages from the
+          ** cache. No new mapped pages are handed out while writing. */
+          rc = saveAllCursors(pBt, 0, 0);
+        }
         if( rc==SQLITE_OK ){
           rc = newDatabase(pBt);
         }
@@ -3758,6 +3779,20 @@ static int getOverflowPage(
   return (rc==SQLITE_DONE ? SQLITE_OK : rc);
 }
 
+#ifndef SQLITE_OMIT_INCRBLOB
+/*
+** When accessPayload() is called with eOp==2, its pBuf argument points
+** to an instance of this structure instead of to a buffer. Each piece of
+** the payload is passed to the xChunk callback straight from the page
+** that holds it.
+*/
+typedef struct PayloadStream PayloadStream;
+struct PayloadStream {
+  int (*xChunk)(void*, const void*, int);  /* Callback for each piece */
+  void *pArg;                              /* First argument to xChunk */
+};
+#endif
+
 /*
 ** Copy data from a buffer to a page, or from a page to a buffer.
 **
@@ -3765,7 +3800,9 @@ static int getOverflowPage(
 ** If argument eOp is false, then nByte bytes of data are copied
 ** from pPayload to the buffer pointed at by pBuf. If eOp is true,
 ** then sqlite3PagerWrite() is called on pDbPage and nByte bytes
-** of data are copied from the buffer pBuf to pPayload.
+** of data are copied from the buffer pBuf to pPayload. If eOp is 2,
+** pBuf is a PayloadStream object and pPayload is passed to its
+** callback without being copied.
 **
 ** SQLITE_OK is returned on success, otherwise an error code.
 */
@@ -3776,6 +3813,13 @@ static int copyPayload(
   int eOp,                  /* 0 -> copy from page, 1 -> copy to page */
   DbPage *pDbPage           /* Page containing pPayload */
 ){
+#ifndef SQLITE_OMIT_INCRBLOB
+  if( eOp==2 ){
+    /* Hand the page data to the callback (a zero-copy read) */
+    PayloadStream *pStream = (PayloadStream *)pBuf;
+    return pStream->xChunk(pStream->pArg, pPayload, nByte);
+  }
+#endif
   if( eOp ){
     /* Copy data from buffer to page (a write operation) */
     int rc = sqlite3PagerWrite(pDbPage);
@@ -3794,8 +3838,9 @@ static int copyPayload(
 ** This function is used to read or overwrite payload information
 ** for the entry that the pCur cursor is pointing to. If the eOp
 ** parameter is 0, this is a read operation (data copied into
-** buffer pBuf). If it is non-zero, a write (data copied from
-** buffer pBuf).
+** buffer pBuf). If it is 1, a write (data copied from buffer pBuf).
+** If it is 2, a read in which pBuf is a PayloadStream object and the
+** data is passed to its callback one page at a time.
 **
 ** A total of "amt" bytes are read or written beginning at "offset".
 ** Data is read to or from the buffer pBuf.
@@ -3856,7 +3901,7 @@ static int accessPayload(
     }
     rc = copyPayload(&aPayload[offset], pBuf, a, eOp, pPage->pDbPage);
     offset = 0;
-    pBuf += a;
+    if( eOp!=2 ) pBuf += a;
     amt -= a;
   }else{
     offset -= pCur->info.nLocal;
@@ -3886,14 +3931,22 @@ static int accessPayload(
       }
     }
 
-    /* If the overflow page-list cache has been allocated and the
-    ** entry for the first required overflow page is valid, skip
-    ** directly to it.
+    /* If the overflow page-list cache has been allocated, skip directly
+    ** to the first required overflow page if its entry is valid, or
+    ** else to the last valid entry before it. The cache is populated
+    ** in order from the start of the chain, so when a read seeks deep
+    ** into a large blob only the part of the chain that has not been
+    ** visited before needs to be followed.
     */
-    if( pCur->aOverflow && pCur->aOverflow[offset/ovflSize] ){
+    if( pCur->aOverflow ){
       iIdx = (offset/ovflSize);
-      nextPage = pCur->aOverflow[iIdx];
-      offset = (offset%ovflSize);
+      while( iIdx>0 && pCur->aOverflow[iIdx]==0 ) iIdx--;
+      if( pCur->aOverflow[iIdx] ){
+        nextPage = pCur->aOverflow[iIdx];
+        offset -= iIdx*ovflSize;
+      }else{
+        iIdx = 0;
+      }
     }
 #endif
 
@@ -3938,7 +3991,7 @@ static int accessPayload(
           sqlite3PagerUnref(pDbPage);
           offset = 0;
           amt -= a;
-          pBuf += a;
+          if( eOp!=2 ) pBuf += a;
         }
       }
     }
@@ -3999,6 +4052,45 @@ int sqlite3BtreeData(BtCursor *pCur, u32 offset, u32 amt, void *pBuf){
   return rc;
 }
 
+#ifndef SQLITE_OMIT_INCRBLOB
+/*
+** Read part of the data for the entry that cursor pCur points to without
+** copying it. Each piece of the range of amt bytes beginning at offset
+** that is stored contiguously on a single page is passed to xChunk, in
+** order, along with pArg. If pages are memory-mapped, the pointers are
+** into the mapping. They are only valid until xChunk returns.
+**
+** If xChunk returns other than SQLITE_OK, no further calls are made and
+** its return value is returned. Otherwise SQLITE_OK is returned on
+** success, or an error code if something goes wrong.
+*/
+int sqlite3BtreeStreamData(
+  BtCursor *pCur,                          /* Cursor to read from */
+  u32 offset,                              /* Offset of first byte */
+  u32 amt,                                 /* Number of bytes */
+  int (*xChunk)(void*, const void*, int),  /* Callback for each piece */
+  void *pArg                               /* First argument to xChunk */
+){
+  PayloadStream stream;
+  int rc;
+
+  if ( pCur->eState==CURSOR_INVALID ){
+    return SQLITE_ABORT;
+  }
+  assert( cursorHoldsMutex(pCur) );
+  rc = restoreCursorPosition(pCur);
+  if( rc==SQLITE_OK ){
+    assert( pCur->eState==CURSOR_VALID );
+    assert( pCur->iPage>=0 && pCur->apPage[pCur->iPage] );
+    assert( pCur->aiIdx[pCur->iPage]<pCur->apPage[pCur->iPage]->nCell );
+    stream.xChunk = xChunk;
+    stream.pArg = pArg;
+    rc = accessPayload(pCur, offset, amt, (unsigned char *)&stream, 2);
+  }
+  return rc;
+}
+#endif
+
 /*
 ** Return a pointer to payload information from the entry that the 
 ** pCur cursor is pointing to.  The pointer is to the beginning of
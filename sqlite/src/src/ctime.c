@@ -117,6 +117,9 @@ static const char * const azCompileOpt[] = {
 #ifdef SQLITE_ENABLE_STAT2
   "ENABLE_STAT2",
 #endif
+#ifdef SQLITE_ENABLE_STAT3
+  "ENABLE_STAT3",
+#endif
 #ifdef SQLITE_ENABLE_UNLOCK_NOTIFY
   "ENABLE_UNLOCK_NOTIFY",
 #endif
@@ -426,6 +426,18 @@ int sqlite3_config(int op, ...){
       break;
     }
 
+    case SQLITE_CONFIG_MMAP_SIZE: {
+      sqlite3_int64 szMmap = va_arg(ap, sqlite3_int64);
+      sqlite3_int64 mxMmap = va_arg(ap, sqlite3_int64);
+      if( mxMmap<0 ) mxMmap = sqlite3GlobalConfig.mxMmap;
+      if( mxMmap>SQLITE_MAX_MMAP_SIZE ) mxMmap = SQLITE_MAX_MMAP_SIZE;
+      if( szMmap<0 ) szMmap = sqlite3GlobalConfig.szMmap;
+      if( szMmap>mxMmap ) szMmap = mxMmap;
+      sqlite3GlobalConfig.mxMmap = mxMmap;
+      sqlite3GlobalConfig.szMmap = szMmap;
+      break;
+    }
+
     default: {
       rc = SQLITE_ERROR;
       break;
@@ -506,6 +518,157 @@ sqlite3_mutex *sqlite3_db_mutex(sqlite3 *db){
   return db->mutex;
 }
 
+#ifndef SQLITE_OMIT_WAL
+/*
+** State of the background checkpointer enabled by
+** SQLITE_DBCONFIG_WAL_BGCHECKPOINT. At most one checkpoint task runs at a
+** time for each connection. The task opens its own connection to the
+** database file, runs a passive checkpoint and closes it again, so that
+** it never touches the pager or b-tree of the connection that started it.
+**
+** The bDone and rc fields are written by the task and read by the owning
+** connection while holding the BgCheckpoint.mutex mutex. All other fields
+** belong to the owning connection and are only modified while no task is
+** running.
+*/
+struct BgCheckpoint {
+  sqlite3_mutex *mutex;           /* Mutex protecting bDone and rc */
+  SQLiteThread *pThread;          /* Running task, or NULL */
+  char *zFile;                    /* Database file being checkpointed */
+  const char *zVfs;               /* Name of the VFS used to open zFile */
+  int iSync;                      /* Value for "PRAGMA synchronous" */
+  int bDone;                      /* True once the task has finished */
+  int rc;                         /* Result of the most recent task */
+};
+
+/*
+** Allocate a new BgCheckpoint object. Return NULL if background
+** checkpoints are not possible because SQLite is running without
+** mutexes, or if a malloc fails.
+*/
+static BgCheckpoint *bgCheckpointNew(void){
+  BgCheckpoint *p = 0;
+#if SQLITE_THREADSAFE>0
+  if( sqlite3GlobalConfig.bCoreMutex ){
+    p = (BgCheckpoint*)sqlite3MallocZero(sizeof(BgCheckpoint));
+    if( p ){
+      p->mutex = sqlite3MutexAlloc(SQLITE_MUTEX_FAST);
+      if( p->mutex==0 ){
+        sqlite3_free(p);
+        p = 0;
+      }
+    }
+  }
+#endif
+  return p;
+}
+
+/*
+** The body of a background checkpoint task.
+*/
+static void *bgCheckpointMain(void *pArg){
+  BgCheckpoint *p = (BgCheckpoint*)pArg;
+  sqlite3 *pDb = 0;
+  char *zSql;
+  int rc;
+
+  rc = sqlite3_open_v2(p->zFile, &pDb,
+      SQLITE_OPEN_READWRITE|SQLITE_OPEN_PRIVATECACHE, p->zVfs
+  );
+  if( rc==SQLITE_OK ){
+    /* Reading the schema cookie opens the WAL file. The checkpoint syncs
+    ** the database file the way the owning connection would. */
+    zSql = sqlite3_mprintf(
+        "PRAGMA schema_version; PRAGMA synchronous=%d", p->iSync
+    );
+    rc = zSql ? sqlite3_exec(pDb, zSql, 0, 0, 0) : SQLITE_NOMEM;
+    sqlite3_free(zSql);
+  }
+  if( rc==SQLITE_OK ){
+    rc = sqlite3_wal_checkpoint(pDb, "main");
+  }
+  sqlite3_close(pDb);
+
+  sqlite3_mutex_enter(p->mutex);
+  p->rc = rc;
+  p->bDone = 1;
+  sqlite3_mutex_leave(p->mutex);
+  return 0;
+}
+
+/*
+** Wait for the background checkpoint task of connection db, if any, to
+** finish. Return the result of the task, or SQLITE_OK if there was no
+** task to wait for.
+*/
+static int bgCheckpointJoin(sqlite3 *db){
+  BgCheckpoint *p = db->pBgCkpt;
+  int rc = SQLITE_OK;
+  if( p && p->pThread ){
+    sqlite3ThreadJoin(p->pThread, 0);
+    p->pThread = 0;
+    rc = p->rc;
+  }
+  return rc;
+}
+
+/*
+** Start a background checkpoint of database zDb of connection db.
+**
+** SQLITE_OK is returned if a task was started, or if one was already
+** running. Otherwise, an error code is returned and the caller should
+** run the checkpoint inline. This happens for databases that have no
+** file name, if a malloc fails, or if the previous task failed.
+*/
+static int bgCheckpointStart(sqlite3 *db, const char *zDb){
+  BgCheckpoint *p = db->pBgCkpt;
+  const char *zFile;
+  int iDb;
+  int rc;
+
+  assert( sqlite3_mutex_held(db->mutex) );
+  if( p->pThread ){
+    int bDone;
+    sqlite3_mutex_enter(p->mutex);
+    bDone = p->bDone;
+    sqlite3_mutex_leave(p->mutex);
+    if( !bDone ) return SQLITE_OK;
+    rc = bgCheckpointJoin(db);
+    if( rc!=SQLITE_OK ) return rc;
+  }
+
+  iDb = sqlite3FindDbName(db, zDb);
+  if( iDb<0 ) return SQLITE_ERROR;
+  zFile = sqlite3BtreeGetFilename(db->aDb[iDb].pBt);
+  if( zFile==0 || zFile[0]==0 ) return SQLITE_ERROR;
+  if( p->zFile==0 || strcmp(p->zFile, zFile) ){
+    sqlite3_free(p->zFile);
+    p->zFile = sqlite3_mprintf("%s", zFile);
+    if( p->zFile==0 ) return SQLITE_NOMEM;
+  }
+  p->zVfs = db->pVfs->zName;
+  p->iSync = db->aDb[iDb].safety_level - 1;
+  p->bDone = 0;
+  p->rc = SQLITE_OK;
+  return sqlite3ThreadCreate(&p->pThread, bgCheckpointMain, (void*)p);
+}
+
+/*
+** Wait for any background checkpoint started by connection db to finish
+** and disable background checkpoints for the connection.
+*/
+void sqlite3BgCheckpointFinish(sqlite3 *db){
+  BgCheckpoint *p = db->pBgCkpt;
+  if( p ){
+    bgCheckpointJoin(db);
+    sqlite3_mutex_free(p->mutex);
+    sqlite3_free(p->zFile);
+    sqlite3_free(p);
+    db->pBgCkpt = 0;
+  }
+}
+#endif /* SQLITE_OMIT_WAL */
+
 /*
 ** Configuration settings for an individual database connection
 */
@@ -521,6 +684,42 @@ int sqlite3_db_config(sqlite3 *db, int op, ...){
       rc = setupLookaside(db, pBuf, sz, cnt);
       break;
     }
+    case SQLITE_DBCONFIG_STMT_CACHE: {
+      int mxStmt = va_arg(ap, int);
+      int *pRes = va_arg(ap, int*);
+      sqlite3_mutex_enter(db->mutex);
+      if( mxStmt>=0 ){
+        sqlite3VdbeCacheSize(db, mxStmt);
+      }
+      if( pRes ){
+        *pRes = db->mxStmtCache;
+      }
+      sqlite3_mutex_leave(db->mutex);
+      rc = SQLITE_OK;
+      break;
+    }
+    case SQLITE_DBCONFIG_WAL_BGCHECKPOINT: {
+      int onoff = va_arg(ap, int);
+      int *pRes = va_arg(ap, int*);
+      int bEnabled = 0;
+      sqlite3_mutex_enter(db->mutex);
+#ifndef SQLITE_OMIT_WAL
+      if( onoff==0 ){
+        sqlite3BgCheckpointFinish(db);
+      }else if( onoff>0 && db->pBgCkpt==0 ){
+        db->pBgCkpt = bgCheckpointNew();
+      }
+      bEnabled = db->pBgCkpt!=0;
+#else
+      UNUSED_PARAMETER(onoff);
+#endif
+      if( pRes ){
+        *pRes = bEnabled;
+      }
+      sqlite3_mutex_leave(db->mutex);
+      rc = SQLITE_OK;
+      break;
+    }
     default: {
       static const struct {
         int op;      /* The opcode */
@@ -718,6 +917,10 @@ int sqlite3_close(sqlite3 *db){
     }
   }
 
+  /* Wait for any background checkpoint to finish before closing the
+  ** database files. */
+  sqlite3BgCheckpointFinish(db);
+
   /* Free any outstanding Savepoint structures. */
   sqlite3CloseSavepoints(db);
 
@@ -1312,7 +1515,8 @@ void *sqlite3_rollback_hook(
 ** The sqlite3_wal_hook() callback registered by sqlite3_wal_autocheckpoint().
 ** Invoke sqlite3_wal_checkpoint if the number of frames in the log file
 ** is greater than sqlite3.pWalArg cast to an integer (the value configured by
-** wal_autocheckpoint()).
+** wal_autocheckpoint()). If background checkpoints are enabled, the
+** checkpoint is handed to a background task instead where possible.
 */ 
 int sqlite3WalDefaultHook(
   void *pClientData,     /* Argument */
@@ -1322,7 +1526,9 @@ int sqlite3WalDefaultHook(
 ){
   if( nFrame>=SQLITE_PTR_TO_INT(pClientData) ){
     sqlite3BeginBenignMalloc();
-    sqlite3_wal_checkpoint(db, zDb);
+    if( db->pBgCkpt==0 || bgCheckpointStart(db, zDb)!=SQLITE_OK ){
+      sqlite3_wal_checkpoint(db, zDb);
+    }
     sqlite3EndBenignMalloc();
   }
   return SQLITE_OK;
@@ -1404,6 +1610,7 @@ int sqlite3_wal_checkpoint_v2(
   }
 
   sqlite3_mutex_enter(db->mutex);
+  bgCheckpointJoin(db);
   if( zDb && zDb[0] ){
     iDb = sqlite3FindDbName(db, zDb);
   }
@@ -1701,6 +1908,7 @@ static const int aHardLimit[] = {
   SQLITE_MAX_LIKE_PATTERN_LENGTH,
   SQLITE_MAX_VARIABLE_NUMBER,
   SQLITE_MAX_TRIGGER_DEPTH,
+  SQLITE_MAX_WORKER_THREADS,
 };
 
 /*
@@ -1736,6 +1944,9 @@ static const int aHardLimit[] = {
 #if SQLITE_MAX_TRIGGER_DEPTH<1
 # error SQLITE_MAX_TRIGGER_DEPTH must be at least 1
 #endif
+#if SQLITE_MAX_WORKER_THREADS<0 || SQLITE_MAX_WORKER_THREADS>50
+# error SQLITE_MAX_WORKER_THREADS must be between 0 and 50
+#endif
 
 
 /*
@@ -1769,7 +1980,8 @@ int sqlite3_limit(sqlite3 *db, int limitId, int newLimit){
                                                SQLITE_MAX_LIKE_PATTERN_LENGTH );
   assert( aHardLimit[SQLITE_LIMIT_VARIABLE_NUMBER]==SQLITE_MAX_VARIABLE_NUMBER);
   assert( aHardLimit[SQLITE_LIMIT_TRIGGER_DEPTH]==SQLITE_MAX_TRIGGER_DEPTH );
-  assert( SQLITE_LIMIT_TRIGGER_DEPTH==(SQLITE_N_LIMIT-1) );
+  assert( aHardLimit[SQLITE_LIMIT_WORKER_THREADS]==SQLITE_MAX_WORKER_THREADS );
+  assert( SQLITE_LIMIT_WORKER_THREADS==(SQLITE_N_LIMIT-1) );
 
 
   if( limitId<0 || limitId>=SQLITE_N_LIMIT ){
@@ -1881,9 +2093,11 @@ static int openDatabase(
 
   assert( sizeof(db->aLimit)==sizeof(aHardLimit) );
   memcpy(db->aLimit, aHardLimit, sizeof(db->aLimit));
+  db->aLimit[SQLITE_LIMIT_WORKER_THREADS] = SQLITE_DEFAULT_WORKER_THREADS;
   db->autoCommit = 1;
   db->nextAutovac = -1;
   db->nextPagesize = 0;
+  db->szMmap = sqlite3GlobalConfig.szMmap;
   db->flags |= SQLITE_ShortColNames | SQLITE_AutoIndex | SQLITE_EnableTrigger
 #if SQLITE_DEFAULT_FILE_FORMAT<4
                  | SQLITE_LegacyFileFmt
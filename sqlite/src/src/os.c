@@ -119,6 +119,24 @@ int sqlite3OsShmMap(
   return id->pMethods->xShmMap(id, iPage, pgsz, bExtend, pp);
 }
 
+/*
+** Memory-mapped reads of the database file. A VFS older than version 3
+** cannot map anything, so *pp is set to NULL and the caller falls back
+** to sqlite3OsRead().
+*/
+int sqlite3OsFetch(sqlite3_file *id, i64 iOff, int iAmt, void **pp){
+  if( id->pMethods->iVersion<3 ){
+    *pp = 0;
+    return SQLITE_OK;
+  }
+  DO_OS_MALLOC_TEST(id);
+  return id->pMethods->xFetch(id, iOff, iAmt, pp);
+}
+int sqlite3OsUnfetch(sqlite3_file *id, i64 iOff, void *p){
+  if( id->pMethods->iVersion<3 ) return SQLITE_OK;
+  return id->pMethods->xUnfetch(id, iOff, p);
+}
+
 /*
 ** The next group of routines are convenience wrappers around the
 ** VFS methods.
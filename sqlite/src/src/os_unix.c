@@ -119,7 +119,7 @@
 #include <time.h>
 #include <sys/time.h>
 #include <errno.h>
-#ifndef SQLITE_OMIT_WAL
+#if !defined(SQLITE_OMIT_WAL) || SQLITE_MAX_MMAP_SIZE>0
 #include <sys/mman.h>
 #endif
 
@@ -212,6 +212,13 @@ struct unixFile {
   const char *zPath;                  /* Name of the file */
   unixShm *pShm;                      /* Shared memory segment information */
   int szChunk;                        /* Configured by FCNTL_CHUNK_SIZE */
+#if SQLITE_MAX_MMAP_SIZE>0
+  int nFetchOut;                      /* Number of outstanding xFetch refs */
+  sqlite3_int64 mmapSize;             /* Usable size of mapping at pMapRegion */
+  sqlite3_int64 mmapSizeActual;       /* Actual size of mapping at pMapRegion */
+  sqlite3_int64 mmapSizeMax;          /* Configured FCNTL_MMAP_SIZE value */
+  void *pMapRegion;                   /* Memory mapped region */
+#endif
 #if SQLITE_ENABLE_LOCKING_STYLE
   int openFlags;                      /* The flags specified at open() */
 #endif
@@ -254,6 +261,11 @@ struct unixFile {
 */
 #include "os_common.h"
 
+#if SQLITE_MAX_MMAP_SIZE>0
+/* Forward reference */
+static void unixUnmapfile(unixFile *pFd);
+#endif
+
 /*
 ** Define various macros that are missing from some systems.
 */
@@ -1740,6 +1752,9 @@ static int unixUnlock(sqlite3_file *id, int eFileLock){
 */
 static int closeUnixFile(sqlite3_file *id){
   unixFile *pFile = (unixFile*)id;
+#if SQLITE_MAX_MMAP_SIZE>0
+  unixUnmapfile(pFile);
+#endif
   if( pFile->h>=0 ){
     robust_close(pFile, pFile->h, __LINE__);
     pFile->h = -1;
@@ -3358,6 +3373,15 @@ static int unixTruncate(sqlite3_file *id, i64 nByte){
     pFile->lastErrno = errno;
     return unixLogError(SQLITE_IOERR_TRUNCATE, "ftruncate", pFile->zPath);
   }else{
+#if SQLITE_MAX_MMAP_SIZE>0
+    /* Pages beyond the new end of file must not be handed out by xFetch()
+    ** again, as touching them through the mapping would raise SIGBUS.
+    ** Shrink the usable part of the mapping; it is grown again by a
+    ** remap once the file is extended and no fetched pages are out. */
+    if( nByte<pFile->mmapSize ){
+      pFile->mmapSize = nByte;
+    }
+#endif
 #ifndef NDEBUG
     /* If we are doing a normal write to a database file (as opposed to
     ** doing a hot-journal rollback or a write to some file other than a
@@ -3504,6 +3528,21 @@ static int unixFileControl(sqlite3_file *id, int op, void *pArg){
     case SQLITE_FCNTL_SYNC_OMITTED: {
       return SQLITE_OK;  /* A no-op */
     }
+#if SQLITE_MAX_MMAP_SIZE>0
+    case SQLITE_FCNTL_MMAP_SIZE: {
+      unixFile *pFile = (unixFile*)id;
+      i64 newLimit = *(i64*)pArg;
+      if( newLimit>sqlite3GlobalConfig.mxMmap ){
+        newLimit = sqlite3GlobalConfig.mxMmap;
+      }
+      *(i64*)pArg = pFile->mmapSizeMax;
+      if( newLimit>=0 && newLimit!=pFile->mmapSizeMax && pFile->nFetchOut==0 ){
+        pFile->mmapSizeMax = newLimit;
+        unixUnmapfile(pFile);
+      }
+      return SQLITE_OK;
+    }
+#endif
   }
   return SQLITE_NOTFOUND;
 }
@@ -4170,6 +4209,136 @@ static int unixShmUnmap(
 # define unixShmUnmap   0
 #endif /* #ifndef SQLITE_OMIT_WAL */
 
+#if SQLITE_MAX_MMAP_SIZE>0
+/*
+** If it is currently memory mapped, unmap file pFd.
+*/
+static void unixUnmapfile(unixFile *pFd){
+  assert( pFd->nFetchOut==0 );
+  if( pFd->pMapRegion ){
+    munmap(pFd->pMapRegion, pFd->mmapSizeActual);
+    pFd->pMapRegion = 0;
+    pFd->mmapSize = 0;
+    pFd->mmapSizeActual = 0;
+  }
+}
+
+/*
+** Memory map the first min(file-size, unixFile.mmapSizeMax) bytes of
+** file pFd, replacing any existing mapping that is too small. There must
+** be no outstanding xFetch() references when this is called.
+**
+** A failure to map the file is not an error: the mapping is simply left
+** empty and the pager reads pages with read() instead. SQLITE_OK is
+** returned in that case too. An error code is returned only if fstat()
+** fails.
+*/
+static int unixMapfile(unixFile *pFd){
+  struct stat statbuf;            /* Low-level file information */
+  i64 nMap;                       /* Number of bytes to map */
+  void *pNew;                     /* New mapping */
+
+  assert( pFd->nFetchOut==0 );
+  if( osFstat(pFd->h, &statbuf) ){
+    pFd->lastErrno = errno;
+    return SQLITE_IOERR_FSTAT;
+  }
+  nMap = statbuf.st_size;
+  if( nMap>pFd->mmapSizeMax ){
+    nMap = pFd->mmapSizeMax;
+  }
+
+  /* If the file was truncated and then extended back to no more than the
+  ** size of the existing mapping, that mapping is still good. */
+  if( pFd->pMapRegion && nMap<=pFd->mmapSizeActual ){
+    pFd->mmapSize = nMap;
+    return SQLITE_OK;
+  }
+
+  unixUnmapfile(pFd);
+  if( nMap<=0 ) return SQLITE_OK;
+  pNew = mmap(0, (size_t)nMap, PROT_READ, MAP_SHARED, pFd->h, 0);
+  if( pNew==MAP_FAILED ){
+    /* Most likely the address space is exhausted. Disable memory-mapped
+    ** I/O for this file rather than retrying on every page fetch. */
+    pFd->lastErrno = errno;
+    pFd->mmapSizeMax = 0;
+    return SQLITE_OK;
+  }
+  pFd->pMapRegion = pNew;
+  pFd->mmapSize = pFd->mmapSizeActual = nMap;
+  return SQLITE_OK;
+}
+
+/*
+** If possible, return a pointer to a mapping of file fd starting at offset
+** iOff. The mapping must be valid for at least nAmt bytes.
+**
+** If such a pointer can be obtained, store it in *pp and return SQLITE_OK.
+** Or, if one cannot but no error occurs, set *pp to 0 and return SQLITE_OK.
+** Finally, if an error does occur, return an SQLite error code. The final
+** value of *pp is undefined in this case.
+**
+** If this function does return a pointer, the caller must eventually
+** release the reference by calling unixUnfetch().
+*/
+static int unixFetch(sqlite3_file *fd, i64 iOff, int nAmt, void **pp){
+  unixFile *pFd = (unixFile *)fd;   /* The underlying database file */
+  *pp = 0;
+
+  if( pFd->mmapSizeMax>0 ){
+    /* The file may have grown since it was last mapped. The mapping can
+    ** only be replaced while no page of the old one is in use. */
+    if( pFd->mmapSize<iOff+nAmt && pFd->nFetchOut==0
+     && pFd->mmapSize<pFd->mmapSizeMax
+    ){
+      int rc = unixMapfile(pFd);
+      if( rc!=SQLITE_OK ) return rc;
+    }
+    if( pFd->mmapSize>=iOff+nAmt ){
+      *pp = &((u8 *)pFd->pMapRegion)[iOff];
+      pFd->nFetchOut++;
+    }
+  }
+  return SQLITE_OK;
+}
+
+/*
+** If the third argument is non-NULL, then this function releases a 
+** reference obtained by an earlier call to unixFetch(). The second
+** argument passed to this function must be the same as the corresponding
+** argument that was passed to the unixFetch() invocation. 
+**
+** Or, if the third argument is NULL, then this function is being called 
+** to inform the VFS layer that, according to POSIX, any existing mapping 
+** may now be invalid and should be unmapped.
+*/
+static int unixUnfetch(sqlite3_file *fd, i64 iOff, void *p){
+  unixFile *pFd = (unixFile *)fd;   /* The underlying database file */
+  UNUSED_PARAMETER(iOff);
+
+  /* If p==0 (unmap the entire file) then there must be no outstanding 
+  ** xFetch references. Or, if p!=0 (meaning it is an xFetch reference),
+  ** then there must be at least one outstanding.  */
+  assert( (p==0)==(pFd->nFetchOut==0) );
+
+  /* If p!=0, it must match the iOff value. */
+  assert( p==0 || p==&((u8 *)pFd->pMapRegion)[iOff] );
+
+  if( p ){
+    pFd->nFetchOut--;
+  }else{
+    unixUnmapfile(pFd);
+  }
+
+  assert( pFd->nFetchOut>=0 );
+  return SQLITE_OK;
+}
+#else
+# define unixFetch   0
+# define unixUnfetch 0
+#endif /* SQLITE_MAX_MMAP_SIZE>0 */
+
 /*
 ** Here ends the implementation of all sqlite3_file methods.
 **
@@ -4228,7 +4397,9 @@ static const sqlite3_io_methods METHOD = {                                   \
    unixShmMap,                 /* xShmMap */                                 \
    unixShmLock,                /* xShmLock */                                \
    unixShmBarrier,             /* xShmBarrier */                             \
-   unixShmUnmap                /* xShmUnmap */                               \
+   unixShmUnmap,               /* xShmUnmap */                               \
+   unixFetch,                  /* xFetch */                                  \
+   unixUnfetch                 /* xUnfetch */                                \
 };                                                                           \
 static const sqlite3_io_methods *FINDER##Impl(const char *z, unixFile *p){   \
   UNUSED_PARAMETER(z); UNUSED_PARAMETER(p);                                  \
@@ -4245,7 +4416,7 @@ static const sqlite3_io_methods *(*const FINDER)(const char*,unixFile *p)    \
 IOMETHODS(
   posixIoFinder,            /* Finder function name */
   posixIoMethods,           /* sqlite3_io_methods object name */
-  2,                        /* shared memory is enabled */
+  3,                        /* shared memory and mmap are enabled */
   unixClose,                /* xClose method */
   unixLock,                 /* xLock method */
   unixUnlock,               /* xUnlock method */
@@ -620,6 +620,7 @@ struct Pager {
   u8 tempFile;                /* zFilename is a temporary file */
   u8 readOnly;                /* True for a read-only database */
   u8 memDb;                   /* True to inhibit all file I/O */
+  u8 bUseFetch;               /* True to use xFetch() */
 
   /**************************************************************************
   ** The following block contains those class members that change during
@@ -655,6 +656,10 @@ struct Pager {
   PagerSavepoint *aSavepoint; /* Array of active savepoints */
   int nSavepoint;             /* Number of elements in aSavepoint[] */
   char dbFileVers[16];        /* Changes whenever database file changes */
+
+  int nMmapOut;               /* Number of mmap pages currently outstanding */
+  sqlite3_int64 szMmap;       /* Desired maximum mmap size */
+  PgHdr *pMmapFreelist;       /* List of free mmap page headers (pDirty) */
   /*
   ** End of the routinely-changing class members
   ***************************************************************************/
@@ -703,8 +708,6 @@ int sqlite3_pager_writej_count = 0;    /* Number of pages written to journal */
 # define PAGER_INCR(v)
 #endif
 
-
-
 /*
 ** Journal files begin with the following magic string.  The data
 ** was obtained from /dev/random.  It is used only as a sanity check.
@@ -756,6 +759,16 @@ static const unsigned char aJournalMagic[] = {
 # define MEMDB pPager->memDb
 #endif
 
+/*
+** The macro USEFETCH is true if we are allowed to use the xFetch and xUnfetch
+** interfaces to access the database using memory-mapped I/O.
+*/
+#if SQLITE_MAX_MMAP_SIZE>0
+# define USEFETCH(x) ((x)->bUseFetch)
+#else
+# define USEFETCH(x) 0
+#endif
+
 /*
 ** The maximum legal page number is (2^31 - 1).
 */
@@ -2789,14 +2802,17 @@ end_playback:
 ** If page 1 is read, then the value of Pager.dbFileVers[] is set to
 ** the value read from the database file.
 **
+** Argument iFrame is the WAL frame holding the most recent copy of the
+** page, as returned by sqlite3WalFindFrame(), or zero to read the page
+** from the database file.
+**
 ** If an IO error occurs, then the IO error is returned to the caller.
 ** Otherwise, SQLITE_OK is returned.
 */
-static int readDbPage(PgHdr *pPg){
+static int readDbPage(PgHdr *pPg, u32 iFrame){
   Pager *pPager = pPg->pPager; /* Pager object associated with page pPg */
   Pgno pgno = pPg->pgno;       /* Page number to read */
   int rc = SQLITE_OK;          /* Return code */
-  int isInWal = 0;             /* True if page is in log file */
   int pgsz = pPager->pageSize; /* Number of bytes to read */
 
   assert( pPager->eState>=PAGER_READER && !MEMDB );
@@ -2808,11 +2824,10 @@ static int readDbPage(PgHdr *pPg){
     return SQLITE_OK;
   }
 
-  if( pagerUseWal(pPager) ){
+  if( iFrame ){
     /* Try to pull the page from the write-ahead log. */
-    rc = sqlite3WalRead(pPager->pWal, pgno, &isInWal, pgsz, pPg->pData);
-  }
-  if( rc==SQLITE_OK && !isInWal ){
+    rc = sqlite3WalReadFrame(pPager->pWal, iFrame, pgsz, pPg->pData);
+  }else{
     i64 iOffset = (pgno-1)*(i64)pPager->pageSize;
     rc = sqlite3OsRead(pPager->fd, pPg->pData, pgsz, iOffset);
     if( rc==SQLITE_IOERR_SHORT_READ ){
@@ -2896,7 +2911,11 @@ static int pagerUndoCallback(void *pCtx, Pgno iPg){
     if( sqlite3PcachePageRefcount(pPg)==1 ){
       sqlite3PcacheDrop(pPg);
     }else{
-      rc = readDbPage(pPg);
+      u32 iFrame = 0;
+      rc = sqlite3WalFindFrame(pPager->pWal, pPg->pgno, &iFrame);
+      if( rc==SQLITE_OK ){
+        rc = readDbPage(pPg, iFrame);
+      }
       if( rc==SQLITE_OK ){
         pPager->xReiniter(pPg);
       }
@@ -3031,6 +3050,7 @@ static int pagerBeginReadTransaction(Pager *pPager){
   rc = sqlite3WalBeginReadTransaction(pPager->pWal, &changed);
   if( rc!=SQLITE_OK || changed ){
     pager_reset(pPager);
+    if( USEFETCH(pPager) ) sqlite3OsUnfetch(pPager->fd, 0, 0);
   }
 
   return rc;
@@ -3294,6 +3314,38 @@ void sqlite3PagerSetCachesize(Pager *pPager, int mxPage){
   sqlite3PcacheSetCachesize(pPager->pPCache, mxPage);
 }
 
+/*
+** Invoke SQLITE_FCNTL_MMAP_SIZE based on the current value of szMmap,
+** and decide whether or not pages may be read through xFetch(). A VFS
+** older than version 3 has no xFetch() method, and an encrypted database
+** must go through the codec, so neither ever uses memory-mapped I/O.
+*/
+static void pagerFixMaplimit(Pager *pPager){
+#if SQLITE_MAX_MMAP_SIZE>0
+  sqlite3_file *fd = pPager->fd;
+  if( isOpen(fd) && fd->pMethods->iVersion>=3 ){
+    sqlite3_int64 sz;
+    pPager->bUseFetch = (pPager->szMmap>0);
+    /* A pager that holds no read lock relies on its cache for a stable
+    ** snapshot of the file, which a live mapping would not provide. */
+    if( pPager->noReadlock ) pPager->bUseFetch = 0;
+#ifdef SQLITE_HAS_CODEC
+    if( pPager->xCodec ) pPager->bUseFetch = 0;
+#endif
+    sz = pPager->szMmap;
+    sqlite3OsFileControl(fd, SQLITE_FCNTL_MMAP_SIZE, &sz);
+  }
+#endif
+}
+
+/*
+** Change the maximum size of any memory mapping made of the database file.
+*/
+void sqlite3PagerSetMmapLimit(Pager *pPager, sqlite3_int64 szMmap){
+  pPager->szMmap = szMmap;
+  pagerFixMaplimit(pPager);
+}
+
 /*
 ** Adjust the robustness of the database to damage due to OS crashes
 ** or power failures by changing the number of syncs()s when writing
@@ -3722,6 +3774,83 @@ static int pagerSyncHotJournal(Pager *pPager){
   return rc;
 }
 
+#if SQLITE_MAX_MMAP_SIZE>0
+/*
+** Obtain a page header for page pgno whose content is the memory-mapped
+** buffer pData, and store it in *ppPage. Mapped pages never enter the page
+** cache: their headers are kept on the Pager.pMmapFreelist list between
+** uses, and the extra space that follows each header is zeroed every
+** time one is handed out, so that the btree layer reinitializes it.
+**
+** Return SQLITE_OK on success, or SQLITE_NOMEM if a new header cannot be
+** allocated.
+*/
+static int pagerAcquireMapPage(
+  Pager *pPager,                  /* Pager object */
+  Pgno pgno,                      /* Page number */
+  void *pData,                    /* xFetch()'d data for this page */
+  PgHdr **ppPage                  /* OUT: Acquired page object */
+){
+  PgHdr *p;                       /* Memory mapped page to return */
+
+  if( pPager->pMmapFreelist ){
+    *ppPage = p = pPager->pMmapFreelist;
+    pPager->pMmapFreelist = p->pDirty;
+    p->pDirty = 0;
+    p->nRef = 1;
+    memset(p->pExtra, 0, pPager->nExtra);
+  }else{
+    *ppPage = p = (PgHdr *)sqlite3MallocZero(sizeof(PgHdr) + pPager->nExtra);
+    if( p==0 ){
+      *ppPage = 0;
+      return SQLITE_NOMEM;
+    }
+    p->pExtra = (void *)&p[1];
+    p->flags = PGHDR_MMAP;
+    p->nRef = 1;
+    p->pPager = pPager;
+  }
+
+  assert( p->pExtra==(void *)&p[1] );
+  assert( p->flags==PGHDR_MMAP );
+  assert( p->pPager==pPager );
+  assert( p->nRef==1 );
+
+  p->pgno = pgno;
+  p->pData = pData;
+  pPager->nMmapOut++;
+
+  return SQLITE_OK;
+}
+
+/*
+** Release a reference to page pPg. pPg must have been returned by an 
+** earlier call to pagerAcquireMapPage().
+*/
+static void pagerReleaseMapPage(PgHdr *pPg){
+  Pager *pPager = pPg->pPager;
+  pPager->nMmapOut--;
+  pPg->pDirty = pPager->pMmapFreelist;
+  pPager->pMmapFreelist = pPg;
+
+  assert( pPager->fd->pMethods->iVersion>=3 );
+  sqlite3OsUnfetch(pPager->fd, (i64)(pPg->pgno-1)*pPager->pageSize, pPg->pData);
+}
+
+/*
+** Free all PgHdr objects stored in the Pager.pMmapFreelist list.
+*/
+static void pagerFreeMapHdrs(Pager *pPager){
+  PgHdr *p;
+  PgHdr *pNext;
+  for(p=pPager->pMmapFreelist; p; p=pNext){
+    pNext = p->pDirty;
+    sqlite3_free(p);
+  }
+  pPager->pMmapFreelist = 0;
+}
+#endif /* SQLITE_MAX_MMAP_SIZE>0 */
+
 /*
 ** Shutdown the page cache.  Free all memory and close all files.
 **
@@ -3775,6 +3904,10 @@ int sqlite3PagerClose(Pager *pPager){
   sqlite3OsClose(pPager->fd);
   sqlite3PageFree(pTmp);
   sqlite3PcacheClose(pPager->pPCache);
+#if SQLITE_MAX_MMAP_SIZE>0
+  assert( pPager->nMmapOut==0 );
+  pagerFreeMapHdrs(pPager);
+#endif
 
 #ifdef SQLITE_HAS_CODEC
   if( pPager->xCodecFree ) pPager->xCodecFree(pPager->pCodec);
@@ -4532,13 +4665,13 @@ int sqlite3PagerOpen(
   /* pPager->pBusyHandlerArg = 0; */
   pPager->xReiniter = xReinit;
   /* memset(pPager->aHash, 0, sizeof(pPager->aHash)); */
+  pPager->szMmap = sqlite3GlobalConfig.szMmap;
+  pagerFixMaplimit(pPager);
 
   *ppPager = pPager;
   return SQLITE_OK;
 }
 
-
-
 /*
 ** This function is called after transitioning from PAGER_UNLOCK to
 ** PAGER_SHARED state. It tests if there is a hot journal present in
@@ -4858,6 +4991,16 @@ int sqlite3PagerSharedLock(Pager *pPager){
 
       if( memcmp(pPager->dbFileVers, dbFileVers, sizeof(dbFileVers))!=0 ){
         pager_reset(pPager);
+
+        /* Unmap the database file. It is possible that external processes
+        ** may have truncated the database file and then extended it back
+        ** to its original size while this process was not holding a lock.
+        ** In this case there may exist a Pager.pMap mapping that appears
+        ** to be the right size but is not actually valid. Avoid this
+        ** possibility by unmapping the db here. */
+        if( USEFETCH(pPager) ){
+          sqlite3OsUnfetch(pPager->fd, 0, 0);
+        }
       }
     }
 
@@ -4899,11 +5042,12 @@ int sqlite3PagerSharedLock(Pager *pPager){
 ** nothing to rollback, so this routine is a no-op.
 */ 
 static void pagerUnlockIfUnused(Pager *pPager){
-  if( (sqlite3PcacheRefCount(pPager->pPCache)==0) ){
+  if( pPager->nMmapOut==0 && (sqlite3PcacheRefCount(pPager->pPCache)==0) ){
     pagerUnlockAndRollback(pPager);
   }
 }
 
+
 /*
 ** Acquire a reference to page number pgno in pager pPager (a page
 ** reference has type DbPage*). If the requested reference is 
@@ -4962,6 +5106,7 @@ int sqlite3PagerAcquire(
 ){
   int rc;
   PgHdr *pPg;
+  u32 iFrame = 0;                 /* Frame to read from WAL file */
 
   assert( pPager->eState>=PAGER_READER );
   assert( assert_pager_state(pPager) );
@@ -4970,6 +5115,46 @@ int sqlite3PagerAcquire(
     return SQLITE_CORRUPT_BKPT;
   }
 
+#if SQLITE_MAX_MMAP_SIZE>0
+  /* While only a read transaction is open, pages other than page 1 that
+  ** are present in the database file (and not superseded by a frame in
+  ** the WAL) are returned straight out of the memory mapping, without a
+  ** copy and without being added to the page cache. Once a write
+  ** transaction has started, every page goes through the cache so that
+  ** it may be journalled and modified.
+  */
+  if( USEFETCH(pPager) && pgno!=1 && !noContent
+   && pPager->eState==PAGER_READER && pPager->errCode==SQLITE_OK
+   && pgno<=pPager->dbSize && pgno!=PAGER_MJ_PGNO(pPager)
+  ){
+    if( pagerUseWal(pPager) ){
+      rc = sqlite3WalFindFrame(pPager->pWal, pgno, &iFrame);
+      if( rc!=SQLITE_OK ){
+        pPg = 0;
+        goto pager_acquire_err;
+      }
+    }
+    if( iFrame==0 ){
+      void *pData = 0;
+      rc = sqlite3OsFetch(pPager->fd, 
+          (i64)(pgno-1) * pPager->pageSize, pPager->pageSize, &pData
+      );
+      if( rc==SQLITE_OK && pData ){
+        rc = pagerAcquireMapPage(pPager, pgno, pData, &pPg);
+        if( rc==SQLITE_OK ){
+          *ppPage = pPg;
+          return SQLITE_OK;
+        }
+        sqlite3OsUnfetch(pPager->fd, (i64)(pgno-1)*pPager->pageSize, pData);
+      }
+      if( rc!=SQLITE_OK ){
+        pPg = 0;
+        goto pager_acquire_err;
+      }
+    }
+  }
+#endif
+
   /* If the pager is in the error state, return an error immediately. 
   ** Otherwise, request the page from the PCache layer. */
   if( pPager->errCode!=SQLITE_OK ){
@@ -5035,7 +5220,11 @@ int sqlite3PagerAcquire(
       IOTRACE(("ZERO %p %d\n", pPager, pgno));
     }else{
       assert( pPg->pPager==pPager );
-      rc = readDbPage(pPg);
+      if( pagerUseWal(pPager) && iFrame==0 ){
+        rc = sqlite3WalFindFrame(pPager->pWal, pgno, &iFrame);
+        if( rc!=SQLITE_OK ) goto pager_acquire_err;
+      }
+      rc = readDbPage(pPg, iFrame);
       if( rc!=SQLITE_OK ){
         goto pager_acquire_err;
       }
@@ -5088,7 +5277,17 @@ DbPage *sqlite3PagerLookup(Pager *pPager, Pgno pgno){
 void sqlite3PagerUnref(DbPage *pPg){
   if( pPg ){
     Pager *pPager = pPg->pPager;
-    sqlite3PcacheRelease(pPg);
+#if SQLITE_MAX_MMAP_SIZE>0
+    if( pPg->flags & PGHDR_MMAP ){
+      assert( pPg->nRef>0 );
+      if( (--pPg->nRef)==0 ){
+        pagerReleaseMapPage(pPg);
+      }
+    }else
+#endif
+    {
+      sqlite3PcacheRelease(pPg);
+    }
     pagerUnlockIfUnused(pPager);
   }
 }
@@ -5455,6 +5654,7 @@ int sqlite3PagerWrite(DbPage *pDbPage){
   Pager *pPager = pPg->pPager;
   Pgno nPagePerSector = (pPager->sectorSize/pPager->pageSize);
 
+  assert( (pPg->flags & PGHDR_MMAP)==0 );
   assert( pPager->eState>=PAGER_WRITER_LOCKED );
   assert( pPager->eState!=PAGER_ERROR );
   assert( assert_pager_state(pPager) );
@@ -6073,6 +6273,15 @@ int sqlite3PagerMemUsed(Pager *pPager){
            + pPager->pageSize;
 }
 
+/*
+** Return the number of memory-mapped pages that currently have one or
+** more outstanding references. These are not included in the value
+** returned by sqlite3PagerRefcount().
+*/
+int sqlite3PagerMmapRefcount(Pager *pPager){
+  return pPager->nMmapOut;
+}
+
 /*
 ** Return the number of references to the specified page.
 */
@@ -6299,6 +6508,7 @@ void sqlite3PagerSetCodec(
   pPager->xCodecFree = xCodecFree;
   pPager->pCodec = pCodec;
   pagerReportSize(pPager);
+  pagerFixMaplimit(pPager);
 }
 void *sqlite3PagerGetCodec(Pager *pPager){
   return pPager->pCodec;
@@ -6338,6 +6548,7 @@ int sqlite3PagerMovepage(Pager *pPager, DbPage *pPg, Pgno pgno, int isCommit){
   Pgno origPgno;               /* The original page number */
 
   assert( pPg->nRef>0 );
+  assert( (pPg->flags & PGHDR_MMAP)==0 );
   assert( pPager->eState==PAGER_WRITER_CACHEMOD
        || pPager->eState==PAGER_WRITER_DBMOD
   );
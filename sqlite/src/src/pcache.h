@@ -51,6 +51,7 @@ struct PgHdr {
 #define PGHDR_NEED_READ         0x008  /* Content is unread */
 #define PGHDR_REUSE_UNLIKELY    0x010  /* A hint that reuse is unlikely */
 #define PGHDR_DONT_WRITE        0x020  /* Do not write content to disk */
+#define PGHDR_MMAP              0x040  /* This is an mmap page object */
 
 /* Initialize and shutdown the page cache subsystem */
 int sqlite3PcacheInitialize(void);
@@ -60,6 +61,7 @@ void sqlite3PcacheShutdown(void);
 ** These routines implement SQLITE_CONFIG_PAGECACHE.
 */
 void sqlite3PCacheBufferSetup(void *, int sz, int n);
+int sqlite3PCacheSlotStatus(int op, int *pCurrent, int *pHighwater, int);
 
 /* Create a new pager cache.
 ** Under memory stress, invoke xStress to try to make pages clean.
@@ -19,6 +19,40 @@
 
 #include "sqliteInt.h"
 
+/*
+** The number of PGroups that caches are spread across in mode (3). A value
+** less than two means that mode (2) is used instead. The value is capped
+** at PCACHE1_MAX_SHARD.
+*/
+#ifndef SQLITE_PCACHE_SHARDS
+# define SQLITE_PCACHE_SHARDS 0
+#endif
+#define PCACHE1_MAX_SHARD 16
+
+/*
+** Test builds allow the number of shards to be changed at run-time, for
+** use by the next call to sqlite3_initialize().
+*/
+#ifdef SQLITE_TEST
+int sqlite3_pcache_shards = SQLITE_PCACHE_SHARDS;
+# define PCACHE1_NSHARD sqlite3_pcache_shards
+#else
+# define PCACHE1_NSHARD SQLITE_PCACHE_SHARDS
+#endif
+
+/*
+** If the compiler provides an atomic 8-byte compare-and-swap, the list of
+** free slots in the SQLITE_CONFIG_PAGECACHE buffer is maintained as a
+** lock-free stack and pcache1.mutex is not used to allocate or free them.
+** Define SQLITE_PCACHE_NO_LOCKFREE to always use the mutex instead.
+*/
+#if SQLITE_THREADSAFE && defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_8) \
+ && !defined(SQLITE_PCACHE_NO_LOCKFREE)
+# define PCACHE1_LOCKFREE_SLOTS 1
+#else
+# define PCACHE1_LOCKFREE_SLOTS 0
+#endif
+
 typedef struct PCache1 PCache1;
 typedef struct PgHdr1 PgHdr1;
 typedef struct PgFreeslot PgFreeslot;
@@ -29,7 +63,7 @@ typedef struct PGroup PGroup;
 ** pages when they are under memory pressure.  A PGroup is an instance of
 ** the following object.
 **
-** This page cache implementation works in one of two modes:
+** This page cache implementation works in one of three modes:
 **
 **   (1)  Every PCache is the sole member of its own PGroup.  There is
 **        one PGroup per PCache.
@@ -37,14 +71,21 @@ typedef struct PGroup PGroup;
 **   (2)  There is a single global PGroup that all PCaches are a member
 **        of.
 **
+**   (3)  There is a small fixed set of global PGroups (shards) and each
+**        PCache is assigned to one of them when it is created.
+**
 ** Mode 1 uses more memory (since PCache instances are not able to rob
 ** unused pages from other PCaches) but it also operates without a mutex,
 ** and is therefore often faster.  Mode 2 requires a mutex in order to be
-** threadsafe, but is able recycle pages more efficient.
+** threadsafe, but is able recycle pages more efficient.  Mode 3 is used
+** in place of mode 2 when SQLITE_PCACHE_SHARDS is greater than one: caches
+** only recycle pages within their own shard, but connections on different
+** threads rarely contend for the same mutex.
 **
 ** For mode (1), PGroup.mutex is NULL.  For mode (2) there is only a single
 ** PGroup which is the pcache1.grp global variable and its mutex is
-** SQLITE_MUTEX_STATIC_LRU.
+** SQLITE_MUTEX_STATIC_LRU.  For mode (3) the PGroups are the elements of
+** the pcache1.aShard[] array and each has its own SQLITE_MUTEX_FAST mutex.
 */
 struct PGroup {
   sqlite3_mutex *mutex;          /* MUTEX_STATIC_LRU or NULL */
@@ -55,6 +96,17 @@ struct PGroup {
   PgHdr1 *pLruHead, *pLruTail;   /* LRU list of unpinned pages */
 };
 
+/*
+** The shards used in mode (3) are padded so that two PGroups never share
+** a cache line, which would defeat the purpose of giving them separate
+** mutexes.
+*/
+typedef union PGroupShard PGroupShard;
+union PGroupShard {
+  PGroup grp;                    /* The PGroup itself */
+  char aPad[64];                 /* Padding to a typical cache line size */
+};
+
 /* Each page cache is an instance of the following object.  Every
 ** open database file (including each in-memory database and each
 ** temporary or transient database) has a single page cache which
@@ -104,9 +156,17 @@ struct PgHdr1 {
 /*
 ** Free slots in the allocator used to divide up the buffer provided using
 ** the SQLITE_CONFIG_PAGECACHE mechanism.
+**
+** When the lock-free list is in use, slots are linked by index rather than
+** by pointer. Slot i is identified by the value i+1, so that zero can mark
+** the end of the list.
 */
 struct PgFreeslot {
+#if PCACHE1_LOCKFREE_SLOTS
+  u32 iNext;          /* Identifier of the next free slot, or 0 */
+#else
   PgFreeslot *pNext;  /* Next free slot */
+#endif
 };
 
 /*
@@ -114,6 +174,9 @@ struct PgFreeslot {
 */
 static SQLITE_WSD struct PCacheGlobal {
   PGroup grp;                    /* The global PGroup for mode (2) */
+  PGroupShard aShard[PCACHE1_MAX_SHARD];  /* The PGroups for mode (3) */
+  int nShard;                    /* Number of aShard[] in use, or zero */
+  unsigned int iNextShard;       /* Shard for the next PCache created */
 
   /* Variables related to SQLITE_CONFIG_PAGECACHE settings.  The
   ** szSlot, nSlot, pStart, pEnd, nReserve, and isInit values are all
@@ -127,6 +190,21 @@ static SQLITE_WSD struct PCacheGlobal {
   void *pStart, *pEnd;           /* Bounds of pagecache malloc range */
   /* Above requires no mutex.  Use mutex below for variable that follow. */
   sqlite3_mutex *mutex;          /* Mutex for accessing the following: */
+#if PCACHE1_LOCKFREE_SLOTS
+  /* With the lock-free list, these are only changed by atomic operations
+  ** and the mutex is not used. The low 32 bits of iFree identify the first
+  ** free slot. The high 32 bits are incremented by every change to the
+  ** list, so that a compare-and-swap based on a stale read always fails. */
+  volatile int nFreeSlot;        /* Number of unused pcache slots */
+  volatile u64 iFree;            /* Free page blocks */
+  volatile int nOverflow;        /* Bytes allocated from the heap instead */
+  /* The SQLITE_STATUS_PAGECACHE_USED and _OVERFLOW values are derived from
+  ** the counters above by sqlite3PCacheSlotStatus() when they are read.
+  ** Only the high-water marks are stored, and they only ever increase
+  ** (except on reset), so they too are updated by compare-and-swap. */
+  volatile int mxUsed;           /* Highwater mark for slots in use */
+  volatile int mxOverflow;       /* Highwater mark for nOverflow */
+#else
   int nFreeSlot;                 /* Number of unused pcache slots */
   PgFreeslot *pFree;             /* Free page blocks */
   /* The following value requires a mutex to change.  We skip the mutex on
@@ -134,6 +212,7 @@ static SQLITE_WSD struct PCacheGlobal {
   ** (2) even if an incorrect value is read, no great harm is done since this
   ** is really just an optimization. */
   int bUnderPressure;            /* True if low on PAGECACHE memory */
+#endif
 } pcache1_g;
 
 /*
@@ -184,18 +263,199 @@ void sqlite3PCacheBufferSetup(void *pBuf, int sz, int n){
     pcache1.nSlot = pcache1.nFreeSlot = n;
     pcache1.nReserve = n>90 ? 10 : (n/10 + 1);
     pcache1.pStart = pBuf;
-    pcache1.pFree = 0;
+#if PCACHE1_LOCKFREE_SLOTS
+    pcache1.iFree = n>0 ? 1 : 0;
+    pcache1.nOverflow = 0;
+    pcache1.mxUsed = 0;
+    pcache1.mxOverflow = 0;
+    while( n-- ){
+      p = (PgFreeslot*)pBuf;
+      p->iNext = n>0 ? pcache1.nSlot - n + 1 : 0;
+      pBuf = (void*)&((char*)pBuf)[sz];
+    }
+#else
     pcache1.bUnderPressure = 0;
+    pcache1.pFree = 0;
     while( n-- ){
       p = (PgFreeslot*)pBuf;
       p->pNext = pcache1.pFree;
       pcache1.pFree = p;
       pBuf = (void*)&((char*)pBuf)[sz];
     }
+#endif
     pcache1.pEnd = pBuf;
   }
 }
 
+#if PCACHE1_LOCKFREE_SLOTS
+/*
+** Return a pointer to the free slot identified by iSlot (1 or greater).
+*/
+#define pcache1SlotPtr(iSlot) \
+  ((PgFreeslot*)&((char*)pcache1.pStart)[((iSlot)-1)*pcache1.szSlot])
+
+/*
+** Atomically read the 8-byte value at *p. A plain read might be split
+** into two 4-byte loads on 32-bit platforms.
+*/
+#define pcache1AtomicRead64(p) __sync_val_compare_and_swap((p), 0, 0)
+
+/*
+** Atomically set *p to the larger of *p and v.
+*/
+static void pcache1AtomicMax(volatile int *p, int v){
+  int iOld = *p;
+  while( v>iOld ){
+    int iSeen = __sync_val_compare_and_swap(p, iOld, v);
+    if( iSeen==iOld ) break;
+    iOld = iSeen;
+  }
+}
+
+/*
+** Remove a slot from the lock-free list of free SQLITE_CONFIG_PAGECACHE
+** slots and return a pointer to it, or return NULL if the list is empty.
+**
+** The iNext value read from the head slot may be garbage if another thread
+** takes that slot in the meantime. This is harmless because the other
+** thread also increments the counter in the high bits of pcache1.iFree,
+** so the compare-and-swap below fails and the loop tries again.
+*/
+static void *pcache1SlotAlloc(void){
+  u64 iOld = pcache1AtomicRead64(&pcache1.iFree);
+  u32 iSlot;
+  while( (iSlot = (u32)iOld)!=0 ){
+    u64 iNew = ((iOld>>32)+1)<<32 | pcache1SlotPtr(iSlot)->iNext;
+    u64 iSeen = __sync_val_compare_and_swap(&pcache1.iFree, iOld, iNew);
+    if( iSeen==iOld ){
+      int nFree = __sync_sub_and_fetch(&pcache1.nFreeSlot, 1);
+      assert( nFree>=0 );
+      pcache1AtomicMax(&pcache1.mxUsed, pcache1.nSlot-nFree);
+      return (void*)pcache1SlotPtr(iSlot);
+    }
+    iOld = iSeen;
+  }
+  return 0;
+}
+
+/*
+** Return slot p to the lock-free list of free SQLITE_CONFIG_PAGECACHE
+** slots.
+*/
+static void pcache1SlotFree(void *p){
+  PgFreeslot *pSlot = (PgFreeslot*)p;
+  u32 iSlot = (u32)(((char*)p - (char*)pcache1.pStart)/pcache1.szSlot) + 1;
+  u64 iOld = pcache1AtomicRead64(&pcache1.iFree);
+  int nFree;
+  assert( pcache1SlotPtr(iSlot)==pSlot );
+  for(;;){
+    u64 iNew = ((iOld>>32)+1)<<32 | iSlot;
+    u64 iSeen;
+    pSlot->iNext = (u32)iOld;
+    iSeen = __sync_val_compare_and_swap(&pcache1.iFree, iOld, iNew);
+    if( iSeen==iOld ) break;
+    iOld = iSeen;
+  }
+  nFree = __sync_add_and_fetch(&pcache1.nFreeSlot, 1);
+  assert( nFree<=pcache1.nSlot );
+  UNUSED_PARAMETER(nFree);
+}
+
+/*
+** Record that the number of bytes of page cache memory obtained from the
+** heap has changed by nByte.
+*/
+static void pcache1OverflowAdd(int nByte){
+  int n = __sync_add_and_fetch(&pcache1.nOverflow, nByte);
+  pcache1AtomicMax(&pcache1.mxOverflow, n);
+}
+
+/*
+** Report the current value and high-water mark of the page cache status
+** verb op, resetting the high-water mark if resetFlag is true. Return 1
+** if op is a value maintained here, or 0 if sqlite3_status() should
+** report it in the usual way.
+*/
+int sqlite3PCacheSlotStatus(int op, int *pCurrent, int *pHighwater,
+                            int resetFlag){
+  volatile int *pMax;
+  int iNow, iMax;
+  if( op==SQLITE_STATUS_PAGECACHE_USED ){
+    iNow = pcache1.nSlot - pcache1.nFreeSlot;
+    pMax = &pcache1.mxUsed;
+  }else if( op==SQLITE_STATUS_PAGECACHE_OVERFLOW ){
+    iNow = pcache1.nOverflow;
+    pMax = &pcache1.mxOverflow;
+  }else{
+    return 0;
+  }
+  iMax = *pMax;
+  *pCurrent = iNow;
+  *pHighwater = iMax>iNow ? iMax : iNow;
+  if( resetFlag ){
+    __sync_val_compare_and_swap(pMax, iMax, iNow);
+  }
+  return 1;
+}
+
+#else /* !PCACHE1_LOCKFREE_SLOTS */
+
+/*
+** Remove a slot from the list of free SQLITE_CONFIG_PAGECACHE slots and
+** return a pointer to it, or return NULL if the list is empty.
+*/
+static void *pcache1SlotAlloc(void){
+  PgFreeslot *p;
+  sqlite3_mutex_enter(pcache1.mutex);
+  p = pcache1.pFree;
+  if( p ){
+    pcache1.pFree = pcache1.pFree->pNext;
+    pcache1.nFreeSlot--;
+    pcache1.bUnderPressure = pcache1.nFreeSlot<pcache1.nReserve;
+    assert( pcache1.nFreeSlot>=0 );
+    sqlite3StatusAdd(SQLITE_STATUS_PAGECACHE_USED, 1);
+  }
+  sqlite3_mutex_leave(pcache1.mutex);
+  return (void*)p;
+}
+
+/*
+** Return slot p to the list of free SQLITE_CONFIG_PAGECACHE slots.
+*/
+static void pcache1SlotFree(void *p){
+  PgFreeslot *pSlot;
+  sqlite3_mutex_enter(pcache1.mutex);
+  sqlite3StatusAdd(SQLITE_STATUS_PAGECACHE_USED, -1);
+  pSlot = (PgFreeslot*)p;
+  pSlot->pNext = pcache1.pFree;
+  pcache1.pFree = pSlot;
+  pcache1.nFreeSlot++;
+  pcache1.bUnderPressure = pcache1.nFreeSlot<pcache1.nReserve;
+  assert( pcache1.nFreeSlot<=pcache1.nSlot );
+  sqlite3_mutex_leave(pcache1.mutex);
+}
+
+/*
+** Record that the number of bytes of page cache memory obtained from the
+** heap has changed by nByte.
+*/
+static void pcache1OverflowAdd(int nByte){
+  sqlite3_mutex_enter(pcache1.mutex);
+  sqlite3StatusAdd(SQLITE_STATUS_PAGECACHE_OVERFLOW, nByte);
+  sqlite3_mutex_leave(pcache1.mutex);
+}
+
+/*
+** The page cache status values are kept by status.c in this case.
+*/
+int sqlite3PCacheSlotStatus(int op, int *pCurrent, int *pHighwater,
+                            int resetFlag){
+  UNUSED_PARAMETER2(op, pCurrent);
+  UNUSED_PARAMETER2(pHighwater, resetFlag);
+  return 0;
+}
+#endif /* !PCACHE1_LOCKFREE_SLOTS */
+
 /*
 ** Malloc function used within this file to allocate space from the buffer
 ** configured using sqlite3_config(SQLITE_CONFIG_PAGECACHE) option. If no 
@@ -210,16 +470,7 @@ static void *pcache1Alloc(int nByte){
   assert( sqlite3_mutex_notheld(pcache1.grp.mutex) );
   sqlite3StatusSet(SQLITE_STATUS_PAGECACHE_SIZE, nByte);
   if( nByte<=pcache1.szSlot ){
-    sqlite3_mutex_enter(pcache1.mutex);
-    p = (PgHdr1 *)pcache1.pFree;
-    if( p ){
-      pcache1.pFree = pcache1.pFree->pNext;
-      pcache1.nFreeSlot--;
-      pcache1.bUnderPressure = pcache1.nFreeSlot<pcache1.nReserve;
-      assert( pcache1.nFreeSlot>=0 );
-      sqlite3StatusAdd(SQLITE_STATUS_PAGECACHE_USED, 1);
-    }
-    sqlite3_mutex_leave(pcache1.mutex);
+    p = pcache1SlotAlloc();
   }
   if( p==0 ){
     /* Memory is not available in the SQLITE_CONFIG_PAGECACHE pool.  Get
@@ -227,10 +478,7 @@ static void *pcache1Alloc(int nByte){
     */
     p = sqlite3Malloc(nByte);
     if( p ){
-      int sz = sqlite3MallocSize(p);
-      sqlite3_mutex_enter(pcache1.mutex);
-      sqlite3StatusAdd(SQLITE_STATUS_PAGECACHE_OVERFLOW, sz);
-      sqlite3_mutex_leave(pcache1.mutex);
+      pcache1OverflowAdd(sqlite3MallocSize(p));
     }
     sqlite3MemdebugSetType(p, MEMTYPE_PCACHE);
   }
@@ -243,24 +491,11 @@ static void *pcache1Alloc(int nByte){
 static void pcache1Free(void *p){
   if( p==0 ) return;
   if( p>=pcache1.pStart && p<pcache1.pEnd ){
-    PgFreeslot *pSlot;
-    sqlite3_mutex_enter(pcache1.mutex);
-    sqlite3StatusAdd(SQLITE_STATUS_PAGECACHE_USED, -1);
-    pSlot = (PgFreeslot*)p;
-    pSlot->pNext = pcache1.pFree;
-    pcache1.pFree = pSlot;
-    pcache1.nFreeSlot++;
-    pcache1.bUnderPressure = pcache1.nFreeSlot<pcache1.nReserve;
-    assert( pcache1.nFreeSlot<=pcache1.nSlot );
-    sqlite3_mutex_leave(pcache1.mutex);
+    pcache1SlotFree(p);
   }else{
-    int iSize;
     assert( sqlite3MemdebugHasType(p, MEMTYPE_PCACHE) );
     sqlite3MemdebugSetType(p, MEMTYPE_HEAP);
-    iSize = sqlite3MallocSize(p);
-    sqlite3_mutex_enter(pcache1.mutex);
-    sqlite3StatusAdd(SQLITE_STATUS_PAGECACHE_OVERFLOW, -iSize);
-    sqlite3_mutex_leave(pcache1.mutex);
+    pcache1OverflowAdd(-sqlite3MallocSize(p));
     sqlite3_free(p);
   }
 }
@@ -353,7 +588,11 @@ void sqlite3PageFree(void *p){
 */
 static int pcache1UnderMemoryPressure(PCache1 *pCache){
   if( pcache1.nSlot && pCache->szPage<=pcache1.szSlot ){
+#if PCACHE1_LOCKFREE_SLOTS
+    return pcache1.nFreeSlot<pcache1.nReserve;
+#else
     return pcache1.bUnderPressure;
+#endif
   }else{
     return sqlite3HeapNearlyFull();
   }
@@ -515,29 +754,52 @@ static void pcache1TruncateUnsafe(
 ** Implementation of the sqlite3_pcache.xInit method.
 */
 static int pcache1Init(void *NotUsed){
+  int i;
   UNUSED_PARAMETER(NotUsed);
   assert( pcache1.isInit==0 );
   memset(&pcache1, 0, sizeof(pcache1));
+  if( PCACHE1_NSHARD>1 ){
+    pcache1.nShard = PCACHE1_NSHARD;
+    if( pcache1.nShard>PCACHE1_MAX_SHARD ) pcache1.nShard = PCACHE1_MAX_SHARD;
+  }
   if( sqlite3GlobalConfig.bCoreMutex ){
     pcache1.grp.mutex = sqlite3_mutex_alloc(SQLITE_MUTEX_STATIC_LRU);
     pcache1.mutex = sqlite3_mutex_alloc(SQLITE_MUTEX_STATIC_PMEM);
+    for(i=0; i<pcache1.nShard; i++){
+      PGroup *pGroup = &pcache1.aShard[i].grp;
+      pGroup->mutex = sqlite3_mutex_alloc(SQLITE_MUTEX_FAST);
+      if( pGroup->mutex==0 ){
+        while( i-- ) sqlite3_mutex_free(pcache1.aShard[i].grp.mutex);
+        memset(&pcache1, 0, sizeof(pcache1));
+        return SQLITE_NOMEM;
+      }
+    }
   }
   pcache1.grp.mxPinned = 10;
+  for(i=0; i<pcache1.nShard; i++){
+    pcache1.aShard[i].grp.mxPinned = 10;
+  }
   pcache1.isInit = 1;
   return SQLITE_OK;
 }
 
 /*
 ** Implementation of the sqlite3_pcache.xShutdown method.
-** Note that the static mutex allocated in xInit does 
-** not need to be freed.
+** Note that the static mutexes allocated in xInit do
+** not need to be freed, but the mutexes of the mode (3)
+** shards do.
 */
 static void pcache1Shutdown(void *NotUsed){
+  int i;
   UNUSED_PARAMETER(NotUsed);
   assert( pcache1.isInit!=0 );
+  for(i=0; i<pcache1.nShard; i++){
+    sqlite3_mutex_free(pcache1.aShard[i].grp.mutex);
+  }
   memset(&pcache1, 0, sizeof(pcache1));
 }
 
+
 /*
 ** Implementation of the sqlite3_pcache.xCreate method.
 **
@@ -577,6 +839,12 @@ static sqlite3_pcache *pcache1Create(int szPage, int bPurgeable){
     if( separateCache ){
       pGroup = (PGroup*)&pCache[1];
       pGroup->mxPinned = 10;
+    }else if( pcache1.nShard ){
+      /* Mode (3). Hand out shards round-robin so that connections opened
+      ** by different threads are likely to use different mutexes. The
+      ** increment is not atomic, but a lost update only means that two
+      ** caches share a shard.  */
+      pGroup = &pcache1.aShard[pcache1.iNextShard++ % pcache1.nShard].grp;
     }else{
       pGroup = &pcache1_g.grp;
     }
@@ -916,6 +1184,19 @@ void sqlite3PCacheSetDefault(void){
   sqlite3_config(SQLITE_CONFIG_PCACHE, &defaultMethods);
 }
 
+#if defined(SQLITE_ENABLE_MEMORY_MANAGEMENT) || defined(SQLITE_TEST)
+/*
+** Return the i-th PGroup that may be shared by more than one PCache, or
+** NULL if i is out of range. Group 0 is the global PGroup of mode (2) and
+** groups 1 and greater are the shards of mode (3).
+*/
+static PGroup *pcache1SharedGroup(int i){
+  if( i==0 ) return &pcache1.grp;
+  if( i<=pcache1.nShard ) return &pcache1.aShard[i-1].grp;
+  return 0;
+}
+#endif
+
 #ifdef SQLITE_ENABLE_MEMORY_MANAGEMENT
 /*
 ** This function is called to free superfluous dynamically allocated memory
@@ -931,15 +1212,19 @@ int sqlite3PcacheReleaseMemory(int nReq){
   assert( sqlite3_mutex_notheld(pcache1.grp.mutex) );
   assert( sqlite3_mutex_notheld(pcache1.mutex) );
   if( pcache1.pStart==0 ){
-    PgHdr1 *p;
-    pcache1EnterMutex(&pcache1.grp);
-    while( (nReq<0 || nFree<nReq) && ((p=pcache1.grp.pLruTail)!=0) ){
-      nFree += pcache1MemSize(PGHDR1_TO_PAGE(p));
-      pcache1PinPage(p);
-      pcache1RemoveFromHash(p);
-      pcache1FreePage(p);
+    PGroup *pGroup;
+    int i;
+    for(i=0; (nReq<0 || nFree<nReq) && (pGroup=pcache1SharedGroup(i))!=0; i++){
+      PgHdr1 *p;
+      pcache1EnterMutex(pGroup);
+      while( (nReq<0 || nFree<nReq) && ((p=pGroup->pLruTail)!=0) ){
+        nFree += pcache1MemSize(PGHDR1_TO_PAGE(p));
+        pcache1PinPage(p);
+        pcache1RemoveFromHash(p);
+        pcache1FreePage(p);
+      }
+      pcache1LeaveMutex(pGroup);
     }
-    pcache1LeaveMutex(&pcache1.grp);
   }
   return nFree;
 }
@@ -948,7 +1233,7 @@ int sqlite3PcacheReleaseMemory(int nReq){
 #ifdef SQLITE_TEST
 /*
 ** This function is used by test procedures to inspect the internal state
-** of the global cache.
+** of the global cache. In mode (3), the values are summed over all shards.
 */
 void sqlite3PcacheStats(
   int *pnCurrent,      /* OUT: Total number of pages cached */
@@ -956,14 +1241,17 @@ void sqlite3PcacheStats(
   int *pnMin,          /* OUT: Sum of PCache1.nMin for purgeable caches */
   int *pnRecyclable    /* OUT: Total number of pages available for recycling */
 ){
-  PgHdr1 *p;
-  int nRecyclable = 0;
-  for(p=pcache1.grp.pLruHead; p; p=p->pLruNext){
-    nRecyclable++;
-  }
-  *pnCurrent = pcache1.grp.nCurrentPage;
-  *pnMax = pcache1.grp.nMaxPage;
-  *pnMin = pcache1.grp.nMinPage;
-  *pnRecyclable = nRecyclable;
+  PGroup *pGroup;
+  int i;
+  *pnCurrent = *pnMax = *pnMin = *pnRecyclable = 0;
+  for(i=0; (pGroup = pcache1SharedGroup(i))!=0; i++){
+    PgHdr1 *p;
+    for(p=pGroup->pLruHead; p; p=p->pLruNext){
+      (*pnRecyclable)++;
+    }
+    *pnCurrent += pGroup->nCurrentPage;
+    *pnMax += pGroup->nMaxPage;
+    *pnMin += pGroup->nMinPage;
+  }
 }
 #endif
@@ -587,6 +587,43 @@ void sqlite3Pragma(
     returnSingleInt(pParse, "journal_size_limit", iLimit);
   }else
 
+  /*
+  **  PRAGMA [database.]mmap_size
+  **  PRAGMA [database.]mmap_size=N
+  **
+  ** Used to set or query the limit on the number of bytes of the database
+  ** file that may be memory mapped and read without copying. If N is zero,
+  ** memory-mapped I/O is not used at all. If N is negative, the default
+  ** set by sqlite3_config(SQLITE_CONFIG_MMAP_SIZE) is restored. Without a
+  ** database name the setting applies to all attached databases, and to
+  ** any that are attached later. The value returned is the limit in effect
+  ** in the VFS, which is zero if the VFS does not support memory mapping.
+  */
+  if( sqlite3StrICmp(zLeft,"mmap_size")==0 ){
+    sqlite3_int64 sz;
+#if SQLITE_MAX_MMAP_SIZE>0
+    assert( sqlite3SchemaMutexHeld(db, iDb, 0) );
+    if( zRight ){
+      int ii;
+      sqlite3Atoi64(zRight, &sz, 1000000, SQLITE_UTF8);
+      if( sz<0 ) sz = sqlite3GlobalConfig.szMmap;
+      if( pId2->n==0 ) db->szMmap = sz;
+      for(ii=db->nDb-1; ii>=0; ii--){
+        if( db->aDb[ii].pBt && (ii==iDb || pId2->n==0) ){
+          sqlite3BtreeSetMmapLimit(db->aDb[ii].pBt, sz);
+        }
+      }
+    }
+    sz = -1;
+    if( sqlite3_file_control(db, zDb, SQLITE_FCNTL_MMAP_SIZE, &sz)!=SQLITE_OK ){
+      sz = 0;
+    }
+#else
+    sz = 0;
+#endif
+    returnSingleInt(pParse, "mmap_size", sz);
+  }else
+
 #endif /* SQLITE_OMIT_PAGER_PRAGMAS */
 
   /*
@@ -695,6 +695,18 @@ static int sqlite3LockAndPrepare(
   }
   sqlite3_mutex_enter(db->mutex);
   sqlite3BtreeEnterAll(db);
+  if( saveSqlFlag && db->mxStmtCache>0 ){
+    assert( pOld==0 );
+    *ppStmt = (sqlite3_stmt*)sqlite3VdbeCacheFind(db, zSql, nBytes, pzTail);
+    if( *ppStmt ){
+      db->aStmtCacheStat[0]++;
+      sqlite3Error(db, SQLITE_OK, 0);
+      sqlite3BtreeLeaveAll(db);
+      sqlite3_mutex_leave(db->mutex);
+      return SQLITE_OK;
+    }
+    db->aStmtCacheStat[1]++;
+  }
   rc = sqlite3Prepare(db, zSql, nBytes, saveSqlFlag, pOld, ppStmt, pzTail);
   if( rc==SQLITE_SCHEMA ){
     sqlite3_finalize(*ppStmt);
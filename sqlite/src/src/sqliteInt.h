@@ -83,6 +83,19 @@
 */
 #define SQLITE_INDEX_SAMPLES 10
 
+/*
+** The maximum number of samples of the left-most column of each index
+** that ANALYZE stores in the sqlite_stat3 table when SQLite is built with
+** SQLITE_ENABLE_STAT3. SQLITE_ENABLE_STAT3 replaces SQLITE_ENABLE_STAT2:
+** if both are defined, the sqlite_stat2 table is neither written nor read.
+*/
+#ifndef SQLITE_STAT3_SAMPLES
+# define SQLITE_STAT3_SAMPLES 24
+#endif
+#ifdef SQLITE_ENABLE_STAT3
+# undef SQLITE_ENABLE_STAT2
+#endif
+
 /*
 ** The following macros are used to cast pointers to integers and
 ** integers to pointers.  The way you do this varies from one compiler
@@ -366,6 +379,32 @@
 # define SQLITE_TEMP_STORE 1
 #endif
 
+/*
+** SQLITE_MAX_MMAP_SIZE is the largest number of bytes of a database file
+** that the VFS may memory-map for reading pages (see [PRAGMA mmap_size]).
+** It defaults to zero, which compiles the feature out, on platforms where
+** the unix VFS has not been verified to support it.
+**
+** SQLITE_DEFAULT_MMAP_SIZE is the initial value of the limit for each new
+** database connection. It is zero by default, so that memory-mapped I/O
+** is strictly opt-in, and is never larger than SQLITE_MAX_MMAP_SIZE.
+*/
+#ifndef SQLITE_MAX_MMAP_SIZE
+# if defined(__linux__) || (defined(__APPLE__) && defined(__MACH__)) \
+     || defined(__FreeBSD__)
+#   define SQLITE_MAX_MMAP_SIZE 0x7fff0000  /* 2147418112 */
+# else
+#   define SQLITE_MAX_MMAP_SIZE 0
+# endif
+#endif
+#ifndef SQLITE_DEFAULT_MMAP_SIZE
+# define SQLITE_DEFAULT_MMAP_SIZE 0
+#endif
+#if SQLITE_DEFAULT_MMAP_SIZE>SQLITE_MAX_MMAP_SIZE
+# undef SQLITE_DEFAULT_MMAP_SIZE
+# define SQLITE_DEFAULT_MMAP_SIZE SQLITE_MAX_MMAP_SIZE
+#endif
+
 /*
 ** GCC does not define the offsetof() macro so we'll have to do it
 ** ourselves.
@@ -597,6 +636,7 @@ struct BusyHandler {
 typedef struct AggInfo AggInfo;
 typedef struct AuthContext AuthContext;
 typedef struct AutoincInfo AutoincInfo;
+typedef struct BgCheckpoint BgCheckpoint;
 typedef struct Bitvec Bitvec;
 typedef struct CollSeq CollSeq;
 typedef struct Column Column;
@@ -622,6 +662,7 @@ typedef struct Parse Parse;
 typedef struct RowSet RowSet;
 typedef struct Savepoint Savepoint;
 typedef struct Select Select;
+typedef struct SQLiteThread SQLiteThread;
 typedef struct SrcList SrcList;
 typedef struct StrAccum StrAccum;
 typedef struct Table Table;
@@ -724,7 +765,7 @@ struct Schema {
 ** The number of different kinds of things that can be limited
 ** using the sqlite3_limit() interface.
 */
-#define SQLITE_N_LIMIT (SQLITE_LIMIT_TRIGGER_DEPTH+1)
+#define SQLITE_N_LIMIT (SQLITE_LIMIT_WORKER_THREADS+1)
 
 /*
 ** Lookaside malloc is a set of fixed-size buffers that can be used
@@ -812,6 +853,7 @@ struct sqlite3 {
   signed char nextAutovac;      /* Autovac setting after VACUUM if >=0 */
   u8 suppressErr;               /* Do not issue error messages if true */
   int nextPagesize;             /* Pagesize after VACUUM if >0 */
+  i64 szMmap;                   /* Default mmap_size setting */
   int nTable;                   /* Number of tables in the database */
   CollSeq *pDfltColl;           /* The default collating sequence (BINARY) */
   i64 lastRowid;                /* ROWID of most recent insert (see above) */
@@ -829,6 +871,10 @@ struct sqlite3 {
   int nExtension;               /* Number of loaded extensions */
   void **aExtension;            /* Array of shared library handles */
   struct Vdbe *pVdbe;           /* List of active virtual machines */
+  struct Vdbe *pStmtCache;      /* Reusable VMs, most recently used first */
+  int nStmtCache;               /* Number of VMs in pStmtCache */
+  int mxStmtCache;              /* Maximum nStmtCache, or 0 if disabled */
+  int aStmtCacheStat[2];        /* Statement cache hits and misses */
   int activeVdbeCnt;            /* Number of VDBEs currently executing */
   int writeVdbeCnt;             /* Number of active VDBEs that are writing */
   int vdbeExecCnt;              /* Number of nested calls to VdbeExec() */
@@ -845,6 +891,7 @@ struct sqlite3 {
 #ifndef SQLITE_OMIT_WAL
   int (*xWalCallback)(void *, sqlite3 *, const char *, int);
   void *pWalArg;
+  BgCheckpoint *pBgCkpt;        /* Background auto-checkpoint, or NULL */
 #endif
   void(*xCollNeeded)(void*,sqlite3*,int eTextRep,const char*);
   void(*xCollNeeded16)(void*,sqlite3*,int eTextRep,const void*);
@@ -1483,19 +1530,31 @@ struct Index {
   u8 *aSortOrder;  /* Array of size Index.nColumn. True==DESC, False==ASC */
   char **azColl;   /* Array of collation sequence names for index */
   IndexSample *aSample;    /* Array of SQLITE_INDEX_SAMPLES samples */
+#ifdef SQLITE_ENABLE_STAT3
+  int nSample;             /* Number of elements in aSample[] */
+  unsigned avgEq;          /* Average nEq value for keys not in aSample */
+#endif
 };
 
 /*
-** Each sample stored in the sqlite_stat2 table is represented in memory 
-** using a structure of this type.
+** Each sample stored in the sqlite_stat2 or sqlite_stat3 table is 
+** represented in memory using a structure of this type. The sqlite_stat2
+** samples store SQLITE_INTEGER values in u.r. The nEq, nLt and nDLt 
+** fields are only used with sqlite_stat3.
 */
 struct IndexSample {
   union {
     char *z;        /* Value if eType is SQLITE_TEXT or SQLITE_BLOB */
-    double r;       /* Value if eType is SQLITE_FLOAT or SQLITE_INTEGER */
+    double r;       /* Value if eType is SQLITE_FLOAT (or SQLITE_INTEGER) */
+    i64 i;          /* Value if eType is SQLITE_INTEGER (sqlite_stat3) */
   } u;
   u8 eType;         /* SQLITE_NULL, SQLITE_INTEGER ... etc. */
-  u8 nByte;         /* Size in byte of text or blob. */
+  int nByte;        /* Size in byte of text or blob. */
+#ifdef SQLITE_ENABLE_STAT3
+  unsigned nEq;     /* Est. number of rows where the key equals this sample */
+  unsigned nLt;     /* Est. number of rows where key is less than this sample */
+  unsigned nDLt;    /* Est. number of distinct keys less than this sample */
+#endif
 };
 
 /*
@@ -1913,6 +1972,7 @@ struct WhereLevel {
   int addrNxt;          /* Jump here to start the next IN combination */
   int addrCont;         /* Jump here to continue with the next loop cycle */
   int addrFirst;        /* First instruction of interior of the loop */
+  int addrSkip;         /* Seek to the next value of a skip-scan column */
   u8 iFrom;             /* Which entry in the FROM clause */
   u8 op, p5;            /* Opcode and P5 of the opcode that ends the loop */
   int p1, p2;           /* Operands of the opcode used to ends the loop */
@@ -2057,6 +2117,7 @@ struct Select {
 #define SF_UsesEphemeral   0x0008  /* Uses the OpenEphemeral opcode */
 #define SF_Expanded        0x0010  /* sqlite3SelectExpand() called on this */
 #define SF_HasTypeInfo     0x0020  /* FROM subqueries have Table metadata */
+#define SF_UseSorter       0x0040  /* Sort using a sorter */
 
 
 /*
@@ -2437,6 +2498,8 @@ struct Sqlite3Config {
   int nPage;                        /* Number of pages in pPage[] */
   int mxParserStack;                /* maximum depth of the parser stack */
   int sharedCacheEnabled;           /* true if shared-cache mode enabled */
+  sqlite3_int64 szMmap;             /* mmap() space per open file */
+  sqlite3_int64 mxMmap;             /* Maximum value for szMmap */
   /* The above might be initialized to non-zero.  The following need to always
   ** initially be zero, however. */
   int isInit;                       /* True after initialization has finished */
@@ -2952,7 +3015,7 @@ void sqlite3ValueSetStr(sqlite3_value*, int, const void *,u8,
 void sqlite3ValueFree(sqlite3_value*);
 sqlite3_value *sqlite3ValueNew(sqlite3 *);
 char *sqlite3Utf16to8(sqlite3 *, const void*, int, u8);
-#ifdef SQLITE_ENABLE_STAT2
+#if defined(SQLITE_ENABLE_STAT2) || defined(SQLITE_ENABLE_STAT3)
 char *sqlite3Utf8to16(sqlite3 *, u8, char *, int, int *);
 #endif
 int sqlite3ValueFromExpr(sqlite3 *, Expr *, u8, u8, sqlite3_value **);
@@ -3084,6 +3147,13 @@ VTable *sqlite3GetVTable(sqlite3*, Table*);
 const char *sqlite3JournalModename(int);
 int sqlite3Checkpoint(sqlite3*, int, int, int*, int*);
 int sqlite3WalDefaultHook(void*,sqlite3*,const char*,int);
+#ifndef SQLITE_OMIT_WAL
+  void sqlite3BgCheckpointFinish(sqlite3*);
+#else
+# define sqlite3BgCheckpointFinish(x)
+#endif
+int sqlite3ThreadCreate(SQLiteThread**,void*(*)(void*),void*);
+int sqlite3ThreadJoin(SQLiteThread*, void**);
 
 /* Declarations for functions in fkey.c. All of these are replaced by
 ** no-op macros if OMIT_FOREIGN_KEY is defined. In this case no foreign
@@ -86,6 +86,9 @@ int sqlite3_status(int op, int *pCurrent, int *pHighwater, int resetFlag){
   if( op<0 || op>=ArraySize(wsdStat.nowValue) ){
     return SQLITE_MISUSE_BKPT;
   }
+  if( sqlite3PCacheSlotStatus(op, pCurrent, pHighwater, resetFlag) ){
+    return SQLITE_OK;
+  }
   *pCurrent = wsdStat.nowValue[op];
   *pHighwater = wsdStat.mxValue[op];
   if( resetFlag ){
@@ -132,6 +135,24 @@ int sqlite3_db_status(
       break;
     }
 
+    /*
+    ** Statement cache hits and misses. The current value for hits is the
+    ** number of statements in the cache.
+    */
+    case SQLITE_DBSTATUS_STMT_CACHE_HIT:
+    case SQLITE_DBSTATUS_STMT_CACHE_MISS: {
+      testcase( op==SQLITE_DBSTATUS_STMT_CACHE_HIT );
+      testcase( op==SQLITE_DBSTATUS_STMT_CACHE_MISS );
+      assert( (op-SQLITE_DBSTATUS_STMT_CACHE_HIT)>=0 );
+      assert( (op-SQLITE_DBSTATUS_STMT_CACHE_HIT)<2 );
+      *pCurrent = op==SQLITE_DBSTATUS_STMT_CACHE_HIT ? db->nStmtCache : 0;
+      *pHighwater = db->aStmtCacheStat[op - SQLITE_DBSTATUS_STMT_CACHE_HIT];
+      if( resetFlag ){
+        db->aStmtCacheStat[op - SQLITE_DBSTATUS_STMT_CACHE_HIT] = 0;
+      }
+      break;
+    }
+
     /* 
     ** Return an approximation for the amount of memory currently used
     ** by all pagers associated with the given database connection.  The
@@ -210,6 +231,9 @@ int sqlite3_db_status(
       for(pVdbe=db->pVdbe; pVdbe; pVdbe=pVdbe->pNext){
         sqlite3VdbeDeleteObject(db, pVdbe);
       }
+      for(pVdbe=db->pStmtCache; pVdbe; pVdbe=pVdbe->pNext){
+        sqlite3VdbeDeleteObject(db, pVdbe);
+      }
       db->pnBytesFreed = 0;
 
       *pHighwater = 0;
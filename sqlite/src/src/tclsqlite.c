@@ -3574,7 +3574,9 @@ static void init_all(Tcl_Interp *interp){
     extern int SqlitetestOnefile_Init();
     extern int SqlitetestOsinst_Init(Tcl_Interp*);
     extern int Sqlitetestbackup_Init(Tcl_Interp*);
+    extern int Sqlitetestcompact_Init(Tcl_Interp*);
     extern int Sqlitetestintarray_Init(Tcl_Interp*);
+    extern int Sqlitetestpcachemt_Init(Tcl_Interp*);
     extern int Sqlitetestvfs_Init(Tcl_Interp *);
     extern int SqlitetestStat_Init(Tcl_Interp*);
     extern int Sqlitetestrtree_Init(Tcl_Interp*);
@@ -3614,7 +3616,9 @@ static void init_all(Tcl_Interp *interp){
     SqlitetestOnefile_Init(interp);
     SqlitetestOsinst_Init(interp);
     Sqlitetestbackup_Init(interp);
+    Sqlitetestcompact_Init(interp);
     Sqlitetestintarray_Init(interp);
+    Sqlitetestpcachemt_Init(interp);
     Sqlitetestvfs_Init(interp);
     SqlitetestStat_Init(interp);
     Sqlitetestrtree_Init(interp);
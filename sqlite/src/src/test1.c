@@ -1700,7 +1700,7 @@ static int test_blob_read(
   if( blobHandleFromObj(interp, objv[1], &pBlob) ) return TCL_ERROR;
   if( TCL_OK!=Tcl_GetIntFromObj(interp, objv[2], &iOffset)
    || TCL_OK!=Tcl_GetIntFromObj(interp, objv[3], &nByte)
-  ){ 
+  ){
     return TCL_ERROR;
   }
 
@@ -1718,6 +1718,91 @@ static int test_blob_read(
   return (rc==SQLITE_OK ? TCL_OK : TCL_ERROR);
 }
 
+/*
+** An instance of this structure is passed to testBlobChunk() by the
+** [sqlite3_blob_stream] command.
+*/
+typedef struct TestBlobStream TestBlobStream;
+struct TestBlobStream {
+  Tcl_Obj *pData;                 /* Concatenation of all pieces */
+  Tcl_Obj *pSizes;                /* List of piece sizes */
+  int nLimit;                     /* Stop after this many pieces, or -1 */
+};
+
+/*
+** The callback passed to sqlite3_blob_stream() by [sqlite3_blob_stream].
+*/
+static int testBlobChunk(void *pArg, const void *pData, int nData){
+  TestBlobStream *p = (TestBlobStream *)pArg;
+  int nSize;
+  Tcl_ListObjLength(0, p->pSizes, &nSize);
+  if( nSize==p->nLimit ) return SQLITE_INTERRUPT;
+  Tcl_AppendObjToObj(p->pData,
+      Tcl_NewByteArrayObj((const unsigned char *)pData, nData)
+  );
+  Tcl_ListObjAppendElement(0, p->pSizes, Tcl_NewIntObj(nData));
+  return SQLITE_OK;
+}
+
+/*
+** sqlite3_blob_stream  CHANNEL OFFSET N ?NCHUNK?
+**
+**   This command calls sqlite3_blob_stream() to read N bytes from offset
+**   OFFSET of the blob handle underlying channel CHANNEL. If NCHUNK is
+**   specified, the callback returns SQLITE_INTERRUPT when it is invoked
+**   for the (NCHUNK+1)th time.
+**
+**   On success, a list of two elements is returned: a byte-array object
+**   containing the data read and a list of the sizes of the pieces
+**   passed to the callback. On failure, the interpreter result is set
+**   to the text representation of the returned error code and a Tcl
+**   exception is thrown.
+*/
+static int test_blob_stream(
+  ClientData clientData, /* Not used */
+  Tcl_Interp *interp,    /* The TCL interpreter that invoked this command */
+  int objc,              /* Number of arguments */
+  Tcl_Obj *CONST objv[]  /* Command arguments */
+){
+  sqlite3_blob *pBlob;
+  int nByte;
+  int iOffset;
+  int rc;
+  TestBlobStream stream;
+
+  if( objc!=4 && objc!=5 ){
+    Tcl_WrongNumArgs(interp, 1, objv, "CHANNEL OFFSET N ?NCHUNK?");
+    return TCL_ERROR;
+  }
+
+  if( blobHandleFromObj(interp, objv[1], &pBlob) ) return TCL_ERROR;
+  stream.nLimit = -1;
+  if( TCL_OK!=Tcl_GetIntFromObj(interp, objv[2], &iOffset)
+   || TCL_OK!=Tcl_GetIntFromObj(interp, objv[3], &nByte)
+   || (objc==5 && TCL_OK!=Tcl_GetIntFromObj(interp, objv[4], &stream.nLimit))
+  ){
+    return TCL_ERROR;
+  }
+
+  stream.pData = Tcl_NewByteArrayObj(0, 0);
+  stream.pSizes = Tcl_NewObj();
+  Tcl_IncrRefCount(stream.pData);
+  Tcl_IncrRefCount(stream.pSizes);
+  rc = sqlite3_blob_stream(pBlob, nByte, iOffset, testBlobChunk, &stream);
+  if( rc==SQLITE_OK ){
+    Tcl_Obj *pRet = Tcl_NewObj();
+    Tcl_ListObjAppendElement(0, pRet, stream.pData);
+    Tcl_ListObjAppendElement(0, pRet, stream.pSizes);
+    Tcl_SetObjResult(interp, pRet);
+  }else{
+    Tcl_SetResult(interp, (char *)sqlite3TestErrorName(rc), TCL_VOLATILE);
+  }
+  Tcl_DecrRefCount(stream.pData);
+  Tcl_DecrRefCount(stream.pSizes);
+
+  return (rc==SQLITE_OK ? TCL_OK : TCL_ERROR);
+}
+
 /*
 ** sqlite3_blob_write CHANNEL OFFSET DATA ?NDATA?
 **
@@ -5050,10 +5135,11 @@ static int test_limit(
     { "SQLITE_LIMIT_LIKE_PATTERN_LENGTH", SQLITE_LIMIT_LIKE_PATTERN_LENGTH  },
     { "SQLITE_LIMIT_VARIABLE_NUMBER",     SQLITE_LIMIT_VARIABLE_NUMBER      },
     { "SQLITE_LIMIT_TRIGGER_DEPTH",       SQLITE_LIMIT_TRIGGER_DEPTH        },
+    { "SQLITE_LIMIT_WORKER_THREADS",      SQLITE_LIMIT_WORKER_THREADS       },
     
     /* Out of range test cases */
     { "SQLITE_LIMIT_TOOSMALL",            -1,                               },
-    { "SQLITE_LIMIT_TOOBIG",              SQLITE_LIMIT_TRIGGER_DEPTH+1      },
+    { "SQLITE_LIMIT_TOOBIG",              SQLITE_LIMIT_WORKER_THREADS+1     },
   };
   int i, id;
   int val;
@@ -5489,6 +5575,7 @@ int Sqlitetest1_Init(Tcl_Interp *interp){
   extern int sqlite3_interrupt_count;
   extern int sqlite3_open_file_count;
   extern int sqlite3_sort_count;
+  extern int sqlite3_sorter_pma_count;
   extern int sqlite3_current_time;
 #if SQLITE_OS_UNIX && defined(__APPLE__) && SQLITE_ENABLE_LOCKING_STYLE
   extern int sqlite3_hostid_num;
@@ -5668,6 +5755,7 @@ int Sqlitetest1_Init(Tcl_Interp *interp){
 #endif
 #ifndef SQLITE_OMIT_INCRBLOB
      { "sqlite3_blob_read",   test_blob_read, 0  },
+     { "sqlite3_blob_stream", test_blob_stream, 0  },
      { "sqlite3_blob_write",  test_blob_write, 0  },
      { "sqlite3_blob_reopen", test_blob_reopen, 0  },
      { "sqlite3_blob_bytes",  test_blob_bytes, 0  },
@@ -5693,6 +5781,10 @@ int Sqlitetest1_Init(Tcl_Interp *interp){
   extern int sqlite3_pager_readdb_count;
   extern int sqlite3_pager_writedb_count;
   extern int sqlite3_pager_writej_count;
+#ifndef SQLITE_OMIT_WAL
+  extern int sqlite3_wal_framecache_hit;
+  extern int sqlite3_wal_ckptwrite_count;
+#endif
 #if SQLITE_OS_WIN
   extern int sqlite3_os_type;
 #endif
@@ -5723,6 +5815,8 @@ int Sqlitetest1_Init(Tcl_Interp *interp){
       (char*)&sqlite3_found_count, TCL_LINK_INT);
   Tcl_LinkVar(interp, "sqlite_sort_count", 
       (char*)&sqlite3_sort_count, TCL_LINK_INT);
+  Tcl_LinkVar(interp, "sqlite_sorter_pma_count", 
+      (char*)&sqlite3_sorter_pma_count, TCL_LINK_INT);
   Tcl_LinkVar(interp, "sqlite3_max_blobsize", 
       (char*)&sqlite3_max_blobsize, TCL_LINK_INT);
   Tcl_LinkVar(interp, "sqlite_like_count", 
@@ -5745,6 +5839,12 @@ int Sqlitetest1_Init(Tcl_Interp *interp){
       (char*)&sqlite3_pager_writedb_count, TCL_LINK_INT);
   Tcl_LinkVar(interp, "sqlite3_pager_writej_count",
       (char*)&sqlite3_pager_writej_count, TCL_LINK_INT);
+#ifndef SQLITE_OMIT_WAL
+  Tcl_LinkVar(interp, "sqlite3_wal_framecache_hit",
+      (char*)&sqlite3_wal_framecache_hit, TCL_LINK_INT);
+  Tcl_LinkVar(interp, "sqlite3_wal_ckptwrite_count",
+      (char*)&sqlite3_wal_ckptwrite_count, TCL_LINK_INT);
+#endif
 #ifndef SQLITE_OMIT_UTF16
   Tcl_LinkVar(interp, "unaligned_string_counter",
       (char*)&unaligned_string_counter, TCL_LINK_INT);
@@ -29,9 +29,12 @@ const char *sqlite3TestErrorName(int);
 
 struct TestAsyncGlobal {
   int isInstalled;                     /* True when async VFS is installed */
-} testasync_g = { 0 };
+  int nWriter;                         /* Number of writer threads running */
+} testasync_g = { 0, 0 };
 
+/* Mutex and condition used to protect and signal testasync_g.nWriter */
 TCL_DECLARE_MUTEX(testasync_g_writerMutex);
+static Tcl_Condition testasync_g_writerCond;
 
 /*
 ** sqlite3async_initialize PARENT-VFS ISDEFAULT
@@ -79,10 +82,11 @@ static int testAsyncShutdown(
   return TCL_OK;
 }
 
-static Tcl_ThreadCreateType tclWriterThread(ClientData pIsStarted){
-  Tcl_MutexLock(&testasync_g_writerMutex);
-  *((int *)pIsStarted) = 1;
+static Tcl_ThreadCreateType tclWriterThread(ClientData notUsed){
   sqlite3async_run();
+  Tcl_MutexLock(&testasync_g_writerMutex);
+  testasync_g.nWriter--;
+  Tcl_ConditionNotify(&testasync_g_writerCond);
   Tcl_MutexUnlock(&testasync_g_writerMutex);
   Tcl_ExitThread(0);
   TCL_THREAD_CREATE_RETURN;
@@ -91,7 +95,8 @@ static Tcl_ThreadCreateType tclWriterThread(ClientData pIsStarted){
 /*
 ** sqlite3async_start
 **
-** Start a new writer thread.
+** Start a new writer thread. If this command is invoked more than once,
+** each invocation starts another writer thread.
 */
 static int testAsyncStart(
   void * clientData,
@@ -99,28 +104,30 @@ static int testAsyncStart(
   int objc,
   Tcl_Obj *CONST objv[]
 ){
-  volatile int isStarted = 0;
-  ClientData threadData = (ClientData)&isStarted;
-
   Tcl_ThreadId x;
   const int nStack = TCL_THREAD_STACK_DEFAULT;
   const int flags = TCL_THREAD_NOFLAGS;
   int rc;
 
-  rc = Tcl_CreateThread(&x, tclWriterThread, threadData, nStack, flags);
+  Tcl_MutexLock(&testasync_g_writerMutex);
+  testasync_g.nWriter++;
+  Tcl_MutexUnlock(&testasync_g_writerMutex);
+
+  rc = Tcl_CreateThread(&x, tclWriterThread, 0, nStack, flags);
   if( rc!=TCL_OK ){
+    Tcl_MutexLock(&testasync_g_writerMutex);
+    testasync_g.nWriter--;
+    Tcl_MutexUnlock(&testasync_g_writerMutex);
     Tcl_AppendResult(interp, "Tcl_CreateThread() failed", 0);
     return TCL_ERROR;
   }
-
-  while( isStarted==0 ) { /* Busy loop */ }
   return TCL_OK;
 }
 
 /*
 ** sqlite3async_wait
 **
-** Wait for the current writer thread to terminate.
+** Wait for all current writer threads to terminate.
 **
 ** If the current writer thread is set to run forever then this
 ** command would block forever.  To prevent that, an error is returned. 
@@ -144,6 +151,9 @@ static int testAsyncWait(
   }
 
   Tcl_MutexLock(&testasync_g_writerMutex);
+  while( testasync_g.nWriter>0 ){
+    Tcl_ConditionWait(&testasync_g_writerCond, &testasync_g_writerMutex, 0);
+  }
   Tcl_MutexUnlock(&testasync_g_writerMutex);
   return TCL_OK;
 }
@@ -158,8 +168,11 @@ static int testAsyncControl(
   Tcl_Obj *CONST objv[]
 ){
   int rc = SQLITE_OK;
-  int aeOpt[] = { SQLITEASYNC_HALT, SQLITEASYNC_DELAY, SQLITEASYNC_LOCKFILES };
-  const char *azOpt[] = { "halt", "delay", "lockfiles", 0 };
+  int aeOpt[] = { 
+    SQLITEASYNC_HALT, SQLITEASYNC_DELAY, SQLITEASYNC_LOCKFILES, 
+    SQLITEASYNC_MAXQUEUE
+  };
+  const char *azOpt[] = { "halt", "delay", "lockfiles", "maxqueue", 0 };
   const char *az[] = { "never", "now", "idle", 0 };
   int iVal;
   int eOpt;
@@ -185,6 +198,7 @@ static int testAsyncControl(
         break;
       }
       case SQLITEASYNC_DELAY:
+      case SQLITEASYNC_MAXQUEUE:
         if( Tcl_GetIntFromObj(interp, objv[2], &iVal) ){
           return TCL_ERROR;
         }
@@ -204,6 +218,7 @@ static int testAsyncControl(
     rc = sqlite3async_control(
         eOpt==SQLITEASYNC_HALT ? SQLITEASYNC_GET_HALT :
         eOpt==SQLITEASYNC_DELAY ? SQLITEASYNC_GET_DELAY :
+        eOpt==SQLITEASYNC_MAXQUEUE ? SQLITEASYNC_GET_MAXQUEUE :
         SQLITEASYNC_GET_LOCKFILES, &iVal);
   }
 
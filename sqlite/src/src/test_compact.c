@@ -0,0 +1,148 @@
+/*
+** 2013 May 16
+**
+** The author disclaims copyright to this source code.  In place of
+** a legal notice, here is a blessing:
+**
+**    May you do good and not evil.
+**    May you find forgiveness for yourself and forgive others.
+**    May you share freely, never taking more than you give.
+**
+*************************************************************************
+** This file contains test logic for the sqlite3_compact() interface.
+**
+*/
+
+#include "tcl.h"
+#include <sqlite3.h>
+#include <assert.h>
+
+/* These functions are implemented in test1.c. */
+int getDbPointer(Tcl_Interp *, const char *, sqlite3 **);
+const char *sqlite3TestErrorName(int);
+
+static int compactTestCmd(
+  ClientData clientData,
+  Tcl_Interp *interp,
+  int objc,
+  Tcl_Obj *const*objv
+){
+  enum CompactSubCommandEnum {
+    COMPACT_STEP, COMPACT_FINISH, COMPACT_REMAINING, COMPACT_PAGECOUNT
+  };
+  struct CompactSubCommand {
+    const char *zCmd;
+    enum CompactSubCommandEnum eCmd;
+    int nArg;
+    const char *zArg;
+  } aSub[] = {
+    {"step",      COMPACT_STEP      , 1, "npage" },
+    {"finish",    COMPACT_FINISH    , 0, ""      },
+    {"remaining", COMPACT_REMAINING , 0, ""      },
+    {"pagecount", COMPACT_PAGECOUNT , 0, ""      },
+    {0, 0, 0, 0}
+  };
+
+  sqlite3_compact *p = (sqlite3_compact *)clientData;
+  int iCmd;
+  int rc;
+
+  rc = Tcl_GetIndexFromObjStruct(
+      interp, objv[1], aSub, sizeof(aSub[0]), "option", 0, &iCmd
+  );
+  if( rc!=TCL_OK ){
+    return rc;
+  }
+  if( objc!=(2 + aSub[iCmd].nArg) ){
+    Tcl_WrongNumArgs(interp, 2, objv, aSub[iCmd].zArg);
+    return TCL_ERROR;
+  }
+
+  switch( aSub[iCmd].eCmd ){
+
+    case COMPACT_FINISH: {
+      const char *zCmdName;
+      Tcl_CmdInfo cmdInfo;
+      zCmdName = Tcl_GetString(objv[0]);
+      Tcl_GetCommandInfo(interp, zCmdName, &cmdInfo);
+      cmdInfo.deleteProc = 0;
+      Tcl_SetCommandInfo(interp, zCmdName, &cmdInfo);
+      Tcl_DeleteCommand(interp, zCmdName);
+
+      rc = sqlite3_compact_finish(p);
+      Tcl_SetResult(interp, (char *)sqlite3TestErrorName(rc), TCL_STATIC);
+      break;
+    }
+
+    case COMPACT_STEP: {
+      int nPage;
+      if( TCL_OK!=Tcl_GetIntFromObj(interp, objv[2], &nPage) ){
+        return TCL_ERROR;
+      }
+      rc = sqlite3_compact_step(p, nPage);
+      Tcl_SetResult(interp, (char *)sqlite3TestErrorName(rc), TCL_STATIC);
+      break;
+    }
+
+    case COMPACT_REMAINING:
+      Tcl_SetObjResult(interp, Tcl_NewIntObj(sqlite3_compact_remaining(p)));
+      break;
+
+    case COMPACT_PAGECOUNT:
+      Tcl_SetObjResult(interp, Tcl_NewIntObj(sqlite3_compact_pagecount(p)));
+      break;
+  }
+
+  return TCL_OK;
+}
+
+static void compactTestFinish(ClientData clientData){
+  sqlite3_compact *pCompact = (sqlite3_compact *)clientData;
+  sqlite3_compact_finish(pCompact);
+}
+
+/*
+**     sqlite3_compact CMDNAME DBHANDLE DBNAME MAXRATE
+**
+*/
+static int compactTestInit(
+  ClientData clientData,
+  Tcl_Interp *interp,
+  int objc,
+  Tcl_Obj *const*objv
+){
+  sqlite3_compact *pCompact;
+  sqlite3 *db;
+  const char *zDbName;
+  const char *zCmd;
+  int nMaxRate;
+
+  if( objc!=5 ){
+    Tcl_WrongNumArgs(interp, 1, objv, "CMDNAME DBHANDLE DBNAME MAXRATE");
+    return TCL_ERROR;
+  }
+
+  zCmd = Tcl_GetString(objv[1]);
+  getDbPointer(interp, Tcl_GetString(objv[2]), &db);
+  zDbName = Tcl_GetString(objv[3]);
+  if( TCL_OK!=Tcl_GetIntFromObj(interp, objv[4], &nMaxRate) ){
+    return TCL_ERROR;
+  }
+
+  pCompact = sqlite3_compact_init(db, zDbName, nMaxRate);
+  if( !pCompact ){
+    Tcl_AppendResult(interp, "sqlite3_compact_init() failed", 0);
+    return TCL_ERROR;
+  }
+
+  Tcl_CreateObjCommand(interp, zCmd, compactTestCmd, pCompact,
+      compactTestFinish
+  );
+  Tcl_SetObjResult(interp, objv[1]);
+  return TCL_OK;
+}
+
+int Sqlitetestcompact_Init(Tcl_Interp *interp){
+  Tcl_CreateObjCommand(interp, "sqlite3_compact", compactTestInit, 0, 0);
+  return TCL_OK;
+}
@@ -502,6 +502,30 @@ finish_rjf:
   return rc;
 }
 
+/*
+** Parameter p is a handle opened on a database file. Return the handle 
+** that holds the transaction state for the database. This is usually p
+** itself, but may be another handle opened on the same file if p is a 
+** second handle used only for writing (as opened by the asynchronous IO 
+** backend, for example). If there is no open transaction, return NULL.
+*/
+static jt_file *locateTransactionHandle(jt_file *p){
+  jt_file *pMain = p;
+  if( !p->pWritable ){
+    enterJtMutex();
+    for(pMain=g.pList; pMain; pMain=pMain->pNext){
+      if( (pMain->flags&SQLITE_OPEN_MAIN_DB)
+       && pMain->pWritable
+       && 0==strcmp(pMain->zName, p->zName)
+      ){
+        break;
+      }
+    }
+    leaveJtMutex();
+  }
+  return pMain;
+}
+
 /*
 ** Write data to an jt-file.
 */
@@ -538,11 +562,14 @@ static int jtWrite(
     }
   }
 
-  if( p->flags&SQLITE_OPEN_MAIN_DB && p->pWritable ){
-    if( iAmt<p->nPagesize 
-     && p->nPagesize%iAmt==0 
+  if( p->flags&SQLITE_OPEN_MAIN_DB ){
+    jt_file *pMain = locateTransactionHandle(p);
+    if( pMain==0 ){
+      /* No-op. There is no write transaction open on the database. */
+    }else if( iAmt<pMain->nPagesize 
+     && pMain->nPagesize%iAmt==0 
      && iOfst>=(PENDING_BYTE+512) 
-     && iOfst+iAmt<=PENDING_BYTE+p->nPagesize
+     && iOfst+iAmt<=PENDING_BYTE+pMain->nPagesize
     ){
       /* No-op. This special case is hit when the backup code is copying a
       ** to a database with a larger page-size than the source database and
@@ -550,10 +577,16 @@ static int jtWrite(
       ** pending-byte page.
       */
     }else{
-      u32 pgno = iOfst/p->nPagesize + 1;
-      assert( (iAmt==1||iAmt==p->nPagesize) && ((iOfst+iAmt)%p->nPagesize)==0 );
-      assert( pgno<=p->nPage || p->nSync>0 );
-      assert( pgno>p->nPage || sqlite3BitvecTest(p->pWritable, pgno) );
+      /* A VFS shim may combine writes of adjacent pages into one. */
+      u32 pgno = iOfst/pMain->nPagesize + 1;
+      u32 nPg = (iAmt==1 ? 1 : iAmt/pMain->nPagesize);
+      assert( (iAmt==1||(iAmt%pMain->nPagesize)==0) 
+           && ((iOfst+iAmt)%pMain->nPagesize)==0 
+      );
+      for(; nPg>0; nPg--, pgno++){
+        assert( pgno<=pMain->nPage || pMain->nSync>0 );
+        assert( pgno>pMain->nPage || sqlite3BitvecTest(pMain->pWritable, pgno) );
+      }
     }
   }
 
@@ -576,11 +609,14 @@ static int jtTruncate(sqlite3_file *pFile, sqlite_int64 size){
     jt_file *pMain = locateDatabaseHandle(p->zName);
     closeTransaction(pMain);
   }
-  if( p->flags&SQLITE_OPEN_MAIN_DB && p->pWritable ){
-    u32 pgno;
-    u32 locking_page = (u32)(PENDING_BYTE/p->nPagesize+1);
-    for(pgno=size/p->nPagesize+1; pgno<=p->nPage; pgno++){
-      assert( pgno==locking_page || sqlite3BitvecTest(p->pWritable, pgno) );
+  if( p->flags&SQLITE_OPEN_MAIN_DB ){
+    jt_file *pMain = locateTransactionHandle(p);
+    if( pMain ){
+      u32 pgno;
+      u32 locking_page = (u32)(PENDING_BYTE/pMain->nPagesize+1);
+      for(pgno=size/pMain->nPagesize+1; pgno<=pMain->nPage; pgno++){
+        assert( pgno==locking_page || sqlite3BitvecTest(pMain->pWritable,pgno) );
+      }
     }
   }
   return sqlite3OsTruncate(p->pReal, size);
@@ -1094,6 +1094,69 @@ static int test_db_config_lookaside(
   return TCL_OK;
 }
 
+/*
+** Usage:    sqlite3_db_config_stmt_cache  CONNECTION  SIZE
+**
+** Set the size of the statement cache of CONNECTION, or leave it unchanged
+** if SIZE is negative. Return the size in effect after the call.
+*/
+static int test_db_config_stmt_cache(
+  void * clientData,
+  Tcl_Interp *interp,
+  int objc,
+  Tcl_Obj *CONST objv[]
+){
+  int rc;
+  int sz, res;
+  sqlite3 *db;
+  int getDbPointer(Tcl_Interp*, const char*, sqlite3**);
+  if( objc!=3 ){
+    Tcl_WrongNumArgs(interp, 1, objv, "CONNECTION SIZE");
+    return TCL_ERROR;
+  }
+  if( getDbPointer(interp, Tcl_GetString(objv[1]), &db) ) return TCL_ERROR;
+  if( Tcl_GetIntFromObj(interp, objv[2], &sz) ) return TCL_ERROR;
+  rc = sqlite3_db_config(db, SQLITE_DBCONFIG_STMT_CACHE, sz, &res);
+  if( rc!=SQLITE_OK ){
+    Tcl_AppendResult(interp, sqlite3TestErrorName(rc), (char*)0);
+    return TCL_ERROR;
+  }
+  Tcl_SetObjResult(interp, Tcl_NewIntObj(res));
+  return TCL_OK;
+}
+
+/*
+** Usage:    sqlite3_db_config_wal_bgcheckpoint  CONNECTION  ONOFF
+**
+** Enable or disable background auto-checkpoints for CONNECTION, or leave
+** the setting unchanged if ONOFF is negative. Return the setting in
+** effect after the call.
+*/
+static int test_db_config_wal_bgcheckpoint(
+  void * clientData,
+  Tcl_Interp *interp,
+  int objc,
+  Tcl_Obj *CONST objv[]
+){
+  int rc;
+  int onoff, res;
+  sqlite3 *db;
+  int getDbPointer(Tcl_Interp*, const char*, sqlite3**);
+  if( objc!=3 ){
+    Tcl_WrongNumArgs(interp, 1, objv, "CONNECTION ONOFF");
+    return TCL_ERROR;
+  }
+  if( getDbPointer(interp, Tcl_GetString(objv[1]), &db) ) return TCL_ERROR;
+  if( Tcl_GetIntFromObj(interp, objv[2], &onoff) ) return TCL_ERROR;
+  rc = sqlite3_db_config(db, SQLITE_DBCONFIG_WAL_BGCHECKPOINT, onoff, &res);
+  if( rc!=SQLITE_OK ){
+    Tcl_AppendResult(interp, sqlite3TestErrorName(rc), (char*)0);
+    return TCL_ERROR;
+  }
+  Tcl_SetObjResult(interp, Tcl_NewIntObj(res));
+  return TCL_OK;
+}
+
 /*
 ** Usage:
 **
@@ -1296,7 +1359,9 @@ static int test_db_status(
     { "STMT_USED",           SQLITE_DBSTATUS_STMT_USED           },
     { "LOOKASIDE_HIT",       SQLITE_DBSTATUS_LOOKASIDE_HIT       },
     { "LOOKASIDE_MISS_SIZE", SQLITE_DBSTATUS_LOOKASIDE_MISS_SIZE },
-    { "LOOKASIDE_MISS_FULL", SQLITE_DBSTATUS_LOOKASIDE_MISS_FULL }
+    { "LOOKASIDE_MISS_FULL", SQLITE_DBSTATUS_LOOKASIDE_MISS_FULL },
+    { "STMT_CACHE_HIT",      SQLITE_DBSTATUS_STMT_CACHE_HIT      },
+    { "STMT_CACHE_MISS",     SQLITE_DBSTATUS_STMT_CACHE_MISS     }
   };
   Tcl_Obj *pResult;
   if( objc!=4 ){
@@ -1423,6 +1488,9 @@ int Sqlitetest_malloc_Init(Tcl_Interp *interp){
      { "sqlite3_config_lookaside",   test_config_lookaside         ,0 },
      { "sqlite3_config_error",       test_config_error             ,0 },
      { "sqlite3_db_config_lookaside",test_db_config_lookaside      ,0 },
+     { "sqlite3_db_config_stmt_cache",test_db_config_stmt_cache    ,0 },
+     { "sqlite3_db_config_wal_bgcheckpoint",
+                                 test_db_config_wal_bgcheckpoint ,0 },
      { "sqlite3_dump_memsys3",       test_dump_memsys3             ,3 },
      { "sqlite3_dump_memsys5",       test_dump_memsys3             ,5 },
      { "sqlite3_install_memsys3",    test_install_memsys3          ,0 },
@@ -0,0 +1,185 @@
+/*
+** 2013 April 2
+**
+** The author disclaims copyright to this source code.  In place of
+** a legal notice, here is a blessing:
+**
+**    May you do good and not evil.
+**    May you find forgiveness for yourself and forgive others.
+**    May you share freely, never taking more than you give.
+**
+*************************************************************************
+**
+** This file contains code used for testing the SQLite system.
+** None of the code in this file goes into a deliverable build.
+**
+** This file implements the [sqlite3_pcache_stress] command, which drives
+** the installed page cache from several threads at once in order to
+** measure how throughput scales with the number of threads. Each thread
+** creates its own cache, as a database connection would, and repeatedly
+** fetches and unpins random pages of it. The working set is larger than
+** the cache, so pages are recycled continuously.
+**
+** Also, the [sqlite_pcache_shards] variable is linked to the number of
+** mode (3) shards used by pcache1.c after the next sqlite3_initialize().
+*/
+#include "sqliteInt.h"
+#include <tcl.h>
+
+#if SQLITE_THREADSAFE
+
+/*
+** One instance of this structure is passed to each thread started by
+** [sqlite3_pcache_stress].
+*/
+typedef struct PcacheStress PcacheStress;
+struct PcacheStress {
+  int iSeed;                /* Seed for this thread's PRNG */
+  int nIter;                /* Number of pages to fetch */
+  int nPage;                /* Size of the working set, in pages */
+  int nCache;               /* Configured size of the cache */
+  int nFetch;               /* OUT: Number of pages actually fetched */
+  int nError;               /* OUT: Number of corrupt pages seen */
+};
+
+/*
+** Size of the pages allocated by [sqlite3_pcache_stress].
+*/
+#define PCACHE_STRESS_PAGESIZE 1024
+
+/*
+** Body of each thread started by [sqlite3_pcache_stress].
+**
+** Each page is stamped with its own key when it is first created. The
+** first pointer-sized word of a new page is always zeroed by the cache,
+** so a non-zero value there indicates that the stamp is valid and must
+** match the key used to fetch the page.
+*/
+static Tcl_ThreadCreateType pcacheStressThread(ClientData pArg){
+  PcacheStress *p = (PcacheStress *)pArg;
+  sqlite3_pcache_methods *pMethods = &sqlite3GlobalConfig.pcache;
+  sqlite3_pcache *pCache;
+  unsigned int iRand = (unsigned int)p->iSeed;
+  int i;
+
+  pCache = pMethods->xCreate(PCACHE_STRESS_PAGESIZE, 1);
+  if( pCache==0 ){
+    p->nError++;
+    TCL_THREAD_CREATE_RETURN;
+  }
+  pMethods->xCachesize(pCache, p->nCache);
+  for(i=0; i<p->nIter; i++){
+    unsigned int iKey;
+    unsigned char *aPg;
+    iRand = iRand*1103515245 + 12345;
+    iKey = 1 + (iRand>>8) % (unsigned int)p->nPage;
+    aPg = (unsigned char *)pMethods->xFetch(pCache, iKey, 2);
+    if( aPg==0 ) continue;
+    p->nFetch++;
+    if( *(void **)aPg==0 ){
+      memcpy(&aPg[sizeof(void*)], &iKey, sizeof(iKey));
+      *(void **)aPg = (void *)aPg;
+    }else{
+      unsigned int iStamp;
+      memcpy(&iStamp, &aPg[sizeof(void*)], sizeof(iStamp));
+      if( iStamp!=iKey || *(void **)aPg!=(void *)aPg ) p->nError++;
+    }
+    pMethods->xUnpin(pCache, aPg, (iRand & 0xff)==0);
+  }
+  pMethods->xDestroy(pCache);
+  TCL_THREAD_CREATE_RETURN;
+}
+
+/*
+** Usage:  sqlite3_pcache_stress NTHREAD NITER NPAGE NCACHE
+**
+** Start NTHREAD threads, each of which creates its own page cache with a
+** cache_size of NCACHE and fetches NITER random pages from a working set
+** of NPAGE pages. Wait for all threads to finish, then return a list of
+** three integers: the total number of pages fetched, the elapsed time in
+** microseconds and the number of corrupt pages detected.
+*/
+static int pcacheStressCmd(
+  void * clientData,
+  Tcl_Interp *interp,
+  int objc,
+  Tcl_Obj *CONST objv[]
+){
+  int nThread, nIter, nPage, nCache;
+  PcacheStress *aStress;
+  Tcl_ThreadId *aId;
+  Tcl_Time t0, t1;
+  Tcl_WideInt nFetch = 0;
+  int nError = 0;
+  int i;
+  Tcl_Obj *pRet;
+
+  if( objc!=5 ){
+    Tcl_WrongNumArgs(interp, 1, objv, "NTHREAD NITER NPAGE NCACHE");
+    return TCL_ERROR;
+  }
+  if( Tcl_GetIntFromObj(interp, objv[1], &nThread) ) return TCL_ERROR;
+  if( Tcl_GetIntFromObj(interp, objv[2], &nIter) ) return TCL_ERROR;
+  if( Tcl_GetIntFromObj(interp, objv[3], &nPage) ) return TCL_ERROR;
+  if( Tcl_GetIntFromObj(interp, objv[4], &nCache) ) return TCL_ERROR;
+  if( nThread<1 || nPage<1 ){
+    Tcl_AppendResult(interp, "NTHREAD and NPAGE must be positive", 0);
+    return TCL_ERROR;
+  }
+  if( sqlite3GlobalConfig.isInit==0 ){
+    Tcl_AppendResult(interp, "library is not initialized", 0);
+    return TCL_ERROR;
+  }
+
+  aStress = (PcacheStress *)ckalloc(sizeof(PcacheStress)*nThread);
+  aId = (Tcl_ThreadId *)ckalloc(sizeof(Tcl_ThreadId)*nThread);
+  memset(aStress, 0, sizeof(PcacheStress)*nThread);
+
+  Tcl_GetTime(&t0);
+  for(i=0; i<nThread; i++){
+    aStress[i].iSeed = i+1;
+    aStress[i].nIter = nIter;
+    aStress[i].nPage = nPage;
+    aStress[i].nCache = nCache;
+    if( Tcl_CreateThread(&aId[i], pcacheStressThread, (ClientData)&aStress[i],
+          TCL_THREAD_STACK_DEFAULT, TCL_THREAD_JOINABLE)!=TCL_OK ){
+      break;
+    }
+  }
+  nThread = i;
+  for(i=0; i<nThread; i++){
+    int res;
+    Tcl_JoinThread(aId[i], &res);
+    nFetch += aStress[i].nFetch;
+    nError += aStress[i].nError;
+  }
+  Tcl_GetTime(&t1);
+
+  pRet = Tcl_NewObj();
+  Tcl_ListObjAppendElement(interp, pRet, Tcl_NewWideIntObj(nFetch));
+  Tcl_ListObjAppendElement(interp, pRet, Tcl_NewWideIntObj(
+      ((Tcl_WideInt)t1.sec - t0.sec)*1000000 + (t1.usec - t0.usec)
+  ));
+  Tcl_ListObjAppendElement(interp, pRet, Tcl_NewIntObj(nError));
+  Tcl_SetObjResult(interp, pRet);
+
+  ckfree((char *)aStress);
+  ckfree((char *)aId);
+  return TCL_OK;
+}
+
+/*
+** Register commands with the TCL interpreter.
+*/
+int Sqlitetestpcachemt_Init(Tcl_Interp *interp){
+  extern int sqlite3_pcache_shards;
+  Tcl_CreateObjCommand(interp, "sqlite3_pcache_stress", pcacheStressCmd, 0, 0);
+  Tcl_LinkVar(interp, "sqlite_pcache_shards",
+      (char*)&sqlite3_pcache_shards, TCL_LINK_INT);
+  return TCL_OK;
+}
+#else
+int Sqlitetestpcachemt_Init(Tcl_Interp *interp){
+  return TCL_OK;
+}
+#endif /* SQLITE_THREADSAFE */
@@ -343,3 +343,179 @@ end_of_vacuum:
 }
 
 #endif  /* SQLITE_OMIT_VACUUM && SQLITE_OMIT_ATTACH */
+
+/*
+** An instance of this object records the state of an online compaction
+** started by sqlite3_compact_init().
+*/
+struct sqlite3_compact {
+  sqlite3 *db;            /* Database connection */
+  char *zDb;              /* Name of database to compact */
+  int nMaxRate;           /* Maximum pages removed per second, or 0 */
+  int nRemaining;         /* Free pages in the database after last step */
+  int nPagecount;         /* Pages in the database file after last step */
+  int rc;                 /* Error code of last step, or SQLITE_OK */
+  sqlite3_int64 iNext;    /* Earliest time (in ms) for the next step */
+};
+
+/*
+** Run "PRAGMA zDb.zPragma" and store the integer it returns in *piOut.
+*/
+static int compactIntPragma(
+  sqlite3 *db,                    /* Database connection */
+  const char *zDb,                /* Name of database */
+  const char *zPragma,            /* Name of pragma */
+  int *piOut                      /* OUT: Value returned by pragma */
+){
+  sqlite3_stmt *pStmt;
+  char *zSql;
+  int rc;
+
+  zSql = sqlite3MPrintf(db, "PRAGMA \"%w\".%s", zDb, zPragma);
+  if( zSql==0 ) return SQLITE_NOMEM;
+  rc = sqlite3_prepare(db, zSql, -1, &pStmt, 0);
+  sqlite3DbFree(db, zSql);
+  if( rc!=SQLITE_OK ) return rc;
+  *piOut = 0;
+  if( sqlite3_step(pStmt)==SQLITE_ROW ){
+    *piOut = sqlite3_column_int(pStmt, 0);
+  }
+  return sqlite3_finalize(pStmt);
+}
+
+/*
+** Update the sqlite3_compact.nRemaining and nPagecount fields.
+*/
+static int compactProgress(sqlite3_compact *p){
+  int rc;
+  rc = compactIntPragma(p->db, p->zDb, "freelist_count", &p->nRemaining);
+  if( rc==SQLITE_OK ){
+    rc = compactIntPragma(p->db, p->zDb, "page_count", &p->nPagecount);
+  }
+  return rc;
+}
+
+/*
+** Create an sqlite3_compact object to compact database zDb of connection
+** db. See the documentation for sqlite3_compact_init() in sqlite.h.in.
+*/
+sqlite3_compact *sqlite3_compact_init(
+  sqlite3 *db,                    /* Database connection */
+  const char *zDb,                /* Name of database to compact */
+  int nMaxRate                    /* Max pages removed per second, or 0 */
+){
+  sqlite3_compact *p = 0;         /* Value to return */
+  int eMode = 0;                  /* Value of PRAGMA auto_vacuum */
+  int rc;
+
+  sqlite3_mutex_enter(db->mutex);
+  if( sqlite3FindDbName(db, zDb)<0 ){
+    sqlite3Error(db, SQLITE_ERROR, "unknown database %s", zDb);
+  }else{
+    rc = compactIntPragma(db, zDb, "auto_vacuum", &eMode);
+    if( rc==SQLITE_OK && eMode==0 ){
+      sqlite3Error(db, SQLITE_ERROR, "database %s is not in auto_vacuum mode",
+          zDb
+      );
+    }else if( rc==SQLITE_OK ){
+      int nDb = sqlite3Strlen30(zDb);
+      p = (sqlite3_compact *)sqlite3MallocZero(sizeof(*p) + nDb + 1);
+      if( p==0 ){
+        sqlite3Error(db, SQLITE_NOMEM, 0);
+      }else{
+        p->db = db;
+        p->zDb = (char *)&p[1];
+        memcpy(p->zDb, zDb, nDb+1);
+        p->nMaxRate = nMaxRate;
+        if( compactProgress(p)!=SQLITE_OK ){
+          sqlite3_free(p);
+          p = 0;
+        }
+      }
+    }
+  }
+  sqlite3ApiExit(db, SQLITE_OK);  /* Report any OOM error */
+  sqlite3_mutex_leave(db->mutex);
+  return p;
+}
+
+/*
+** Remove up to nPage free pages from the database, or all of them if
+** nPage is negative. Return SQLITE_DONE if there are no free pages left,
+** SQLITE_OK if there are, or an error code.
+*/
+int sqlite3_compact_step(sqlite3_compact *p, int nPage){
+  sqlite3 *db = p->db;
+  int nDone = 0;                  /* Pages removed by this step */
+  int rc = SQLITE_OK;
+
+  /* If a rate limit is set, wait until the pages removed by earlier steps
+  ** are paid for. This is done before entering the database mutex so that
+  ** other threads may use the connection meanwhile.  */
+  if( p->nMaxRate>0 ){
+    sqlite3_int64 iNow;
+    sqlite3OsCurrentTimeInt64(db->pVfs, &iNow);
+    while( iNow<p->iNext ){
+      int nMs = (p->iNext-iNow)>1000 ? 1000 : (int)(p->iNext-iNow);
+      sqlite3OsSleep(db->pVfs, nMs*1000);
+      iNow += nMs;
+    }
+    if( p->iNext<iNow ) p->iNext = iNow;
+  }
+
+  sqlite3_mutex_enter(db->mutex);
+  if( nPage!=0 ){
+    /* "PRAGMA incremental_vacuum(N)" returns one empty row for each page
+    ** removed from the database.  */
+    sqlite3_stmt *pStmt;
+    char *zSql = sqlite3MPrintf(db, "PRAGMA \"%w\".incremental_vacuum(%d)",
+        p->zDb, nPage<0 ? 0 : nPage
+    );
+    if( zSql==0 ){
+      rc = SQLITE_NOMEM;
+    }else{
+      rc = sqlite3_prepare(db, zSql, -1, &pStmt, 0);
+      sqlite3DbFree(db, zSql);
+    }
+    if( rc==SQLITE_OK ){
+      while( sqlite3_step(pStmt)==SQLITE_ROW ) nDone++;
+      rc = sqlite3_finalize(pStmt);
+    }
+  }
+  if( rc==SQLITE_OK ){
+    rc = compactProgress(p);
+  }
+  if( p->nMaxRate>0 ){
+    p->iNext += ((sqlite3_int64)nDone * 1000) / p->nMaxRate;
+  }
+  if( rc==SQLITE_OK && p->nRemaining==0 ){
+    rc = SQLITE_DONE;
+  }
+  rc = sqlite3ApiExit(db, rc);
+  p->rc = (rc==SQLITE_DONE || rc==SQLITE_BUSY || rc==SQLITE_LOCKED) ?
+      SQLITE_OK : rc;
+  sqlite3_mutex_leave(db->mutex);
+  return rc;
+}
+
+/*
+** Release all resources associated with an sqlite3_compact object.
+*/
+int sqlite3_compact_finish(sqlite3_compact *p){
+  int rc;
+  if( p==0 ) return SQLITE_OK;
+  rc = p->rc;
+  sqlite3_free(p);
+  return rc;
+}
+
+/*
+** Return the number of free pages in the database, and the number of
+** pages in the database file, as of the most recent step.
+*/
+int sqlite3_compact_remaining(sqlite3_compact *p){
+  return p->nRemaining;
+}
+int sqlite3_compact_pagecount(sqlite3_compact *p){
+  return p->nPagecount;
+}
@@ -241,6 +241,62 @@ static VdbeCursor *allocateCursor(
   return pCx;
 }
 
+/*
+** Continue parsing the record header of cursor pC until the type and
+** offset of field iField are known. zData points to the start of the
+** record and must contain at least the first pC->iHdrEnd bytes of it.
+**
+** Fields beyond the end of the header are given an offset of zero. This
+** tells OP_Column to store a NULL (or the default value) instead of
+** deserializing a value from the record. SQLITE_CORRUPT is returned if
+** the header is inconsistent with the size of the record.
+*/
+static int vdbeParseRecordHeader(VdbeCursor *pC, const u8 *zData, int iField){
+  u32 *aType = pC->aType;         /* Type of each field */
+  u32 *aOffset = pC->aOffset;     /* Offset of the content of each field */
+  const u8 *zIdx;                 /* Next unparsed byte of the header */
+  const u8 *zEndHdr;              /* First byte past the header */
+  u32 offset;                     /* Offset to the content of field i */
+  u32 szField;                    /* Size of the content of field i */
+  int i;                          /* Loop counter */
+
+  assert( iField>=pC->nHdrParsed && iField<pC->nField );
+  zEndHdr = &zData[pC->iHdrEnd];
+  zIdx = &zData[pC->iHdrOffset];
+  offset = pC->iDataOffset;
+  for(i=pC->nHdrParsed; i<=iField; i++){
+    if( zIdx<zEndHdr ){
+      aOffset[i] = offset;
+      zIdx += getVarint32(zIdx, aType[i]);
+      szField = sqlite3VdbeSerialTypeLen(aType[i]);
+      offset += szField;
+      if( offset<szField ){  /* True if offset overflows */
+        zIdx = &zEndHdr[1];  /* Forces SQLITE_CORRUPT return below */
+        break;
+      }
+    }else{
+      aType[i] = 0;
+      aOffset[i] = 0;
+    }
+  }
+  pC->nHdrParsed = i;
+  pC->iHdrOffset = (u32)(zIdx - zData);
+  pC->iDataOffset = offset;
+
+  /* If we have read more header data than was contained in the header,
+  ** or if the end of the last field appears to be past the end of the
+  ** record, or if the end of the last field appears to be before the end
+  ** of the record (when all fields present), then we must be dealing 
+  ** with a corrupt database.
+  */
+  if( (zIdx > zEndHdr) || (offset > (u32)pC->payloadSize)
+       || (zIdx==zEndHdr && offset!=(u32)pC->payloadSize) ){
+    pC->cacheStatus = CACHE_STALE;
+    return SQLITE_CORRUPT_BKPT;
+  }
+  return SQLITE_OK;
+}
+
 /*
 ** Try to convert a value into a numeric representation if we can
 ** do so without loss of information.  In other words, if the string
@@ -2077,6 +2133,11 @@ case OP_NotNull: {            /* same as TK_NOTNULL, jump, in1 */
 ** then the cache of the cursor is reset prior to extracting the column.
 ** The first OP_Column against a pseudo-table after the value of the content
 ** register has changed should have this bit set.
+**
+** The record header is parsed only as far as column P2, and the parsed
+** part is kept with the cursor until the cursor moves.  If the record
+** is held in memory, a run of OP_Column instructions on the same cursor
+** is executed as a single batch.
 */
 case OP_Column: {
   u32 payloadSize;   /* Number of bytes in the record */
@@ -2090,14 +2151,10 @@ case OP_Column: {
   u32 *aOffset;      /* aOffset[i] is offset to start of data for i-th column */
   int nField;        /* number of fields in the record */
   int len;           /* The length of the serialized data for the column */
-  int i;             /* Loop counter */
   char *zData;       /* Part of the record being decoded */
   Mem *pDest;        /* Where to write the extracted value */
   Mem sMem;          /* For storing the record being decoded */
-  u8 *zIdx;          /* Index into header */
-  u8 *zEndHdr;       /* Pointer to first byte after the header */
   u32 offset;        /* Offset into the data */
-  u32 szField;       /* Number of bytes in the content of a field */
   int szHdr;         /* Size of the header size field at start of record */
   int avail;         /* Number of bytes of available data */
   Mem *pReg;         /* PseudoTable input register */
@@ -2181,8 +2238,9 @@ case OP_Column: {
   nField = pC->nField;
   assert( p2<nField );
 
-  /* Read and parse the table header.  Store the results of the parse
-  ** into the record header cache fields of the cursor.
+  /* If the cursor has moved to a new record, reset the record header cache
+  ** of the cursor and read the size of the header. The header itself is
+  ** parsed below, only as far as field p2.
   */
   aType = pC->aType;
   if( pC->cacheStatus==p->cacheCtr ){
@@ -2231,6 +2289,7 @@ case OP_Column: {
     ** extra bytes for the header length itself.  32768*3 + 3 = 98307.
     */
     if( offset > 98307 ){
+      pC->cacheStatus = CACHE_STALE;
       rc = SQLITE_CORRUPT_BKPT;
       goto op_column_out;
     }
@@ -2250,64 +2309,47 @@ case OP_Column: {
     */
     len = nField*5 + 3;
     if( len > (int)offset ) len = (int)offset;
+    pC->nHdrParsed = 0;
+    pC->iHdrOffset = szHdr;
+    pC->iHdrEnd = len;
+    pC->iDataOffset = offset;
+  }
 
-    /* The KeyFetch() or DataFetch() above are fast and will get the entire
-    ** record header in most cases.  But they will fail to get the complete
-    ** record header if the record header does not fit on a single page
-    ** in the B-Tree.  When that happens, use sqlite3VdbeMemFromBtree() to
-    ** acquire the complete header text.
-    */
-    if( !zRec && avail<len ){
-      sMem.flags = 0;
-      sMem.db = 0;
-      rc = sqlite3VdbeMemFromBtree(pCrsr, 0, len, pC->isIndex, &sMem);
-      if( rc!=SQLITE_OK ){
-        goto op_column_out;
+  /* Parse the record header as far as field p2, filling in the aType[]
+  ** and aOffset[] arrays.  aType[i] will contain the type integer for the
+  ** i-th column and aOffset[i] will contain the offset from the beginning
+  ** of the record to the start of the data for the i-th column.
+  **
+  ** The KeyFetch() or DataFetch() calls are fast and will get the entire
+  ** record header in most cases.  But they will fail to get the complete
+  ** record header if the record header does not fit on a single page
+  ** in the B-Tree.  When that happens, use sqlite3VdbeMemFromBtree() to
+  ** acquire the complete header text.
+  */
+  if( p2>=pC->nHdrParsed ){
+    if( zRec ){
+      zData = zRec;
+    }else{
+      if( pC->isIndex ){
+        zData = (char*)sqlite3BtreeKeyFetch(pCrsr, &avail);
+      }else{
+        zData = (char*)sqlite3BtreeDataFetch(pCrsr, &avail);
       }
-      zData = sMem.z;
-    }
-    zEndHdr = (u8 *)&zData[len];
-    zIdx = (u8 *)&zData[szHdr];
-
-    /* Scan the header and use it to fill in the aType[] and aOffset[]
-    ** arrays.  aType[i] will contain the type integer for the i-th
-    ** column and aOffset[i] will contain the offset from the beginning
-    ** of the record to the start of the data for the i-th column
-    */
-    for(i=0; i<nField; i++){
-      if( zIdx<zEndHdr ){
-        aOffset[i] = offset;
-        zIdx += getVarint32(zIdx, aType[i]);
-        szField = sqlite3VdbeSerialTypeLen(aType[i]);
-        offset += szField;
-        if( offset<szField ){  /* True if offset overflows */
-          zIdx = &zEndHdr[1];  /* Forces SQLITE_CORRUPT return below */
-          break;
+      if( avail<(int)pC->iHdrEnd ){
+        sMem.flags = 0;
+        sMem.db = 0;
+        rc = sqlite3VdbeMemFromBtree(pCrsr, 0, pC->iHdrEnd, pC->isIndex, &sMem);
+        if( rc!=SQLITE_OK ){
+          pC->cacheStatus = CACHE_STALE;
+          goto op_column_out;
         }
-      }else{
-        /* If i is less that nField, then there are less fields in this
-        ** record than SetNumColumns indicated there are columns in the
-        ** table. Set the offset for any extra columns not present in
-        ** the record to 0. This tells code below to store a NULL
-        ** instead of deserializing a value from the record.
-        */
-        aOffset[i] = 0;
+        zData = sMem.z;
       }
     }
+    rc = vdbeParseRecordHeader(pC, (u8*)zData, p2);
     sqlite3VdbeMemRelease(&sMem);
     sMem.flags = MEM_Null;
-
-    /* If we have read more header data than was contained in the header,
-    ** or if the end of the last field appears to be past the end of the
-    ** record, or if the end of the last field appears to be before the end
-    ** of the record (when all fields present), then we must be dealing 
-    ** with a corrupt database.
-    */
-    if( (zIdx > zEndHdr) || (offset > payloadSize)
-         || (zIdx==zEndHdr && offset!=payloadSize) ){
-      rc = SQLITE_CORRUPT_BKPT;
-      goto op_column_out;
-    }
+    if( rc!=SQLITE_OK ) goto op_column_out;
   }
 
   /* Get the column information. If aOffset[p2] is non-zero, then 
@@ -2357,6 +2399,56 @@ case OP_Column: {
 
   rc = sqlite3VdbeMemMakeWriteable(pDest);
 
+  /* If the whole record is in memory and the instructions that follow
+  ** extract more columns from the same cursor, as they do ahead of an
+  ** OP_ResultRow, OP_MakeRecord or OP_IdxInsert into a sorter, decode
+  ** those columns here too. This saves the instruction dispatch and the
+  ** cursor and header cache checks above for each of them.
+  */
+  while( rc==SQLITE_OK && zRec && pOp[1].opcode==OP_Column
+      && pOp[1].p1==p1 && (pOp[1].p5 & OPFLAG_CLEARCACHE)==0
+      && (pC->pseudoTableReg==0 || (pC->pseudoTableReg!=pOp->p3
+                                    && pC->pseudoTableReg!=pOp[1].p3))
+  ){
+#ifdef SQLITE_TEST
+    if( sqlite3_interrupt_count>0 ) break;
+#endif
+#ifndef SQLITE_OMIT_PROGRESS_CALLBACK
+    /* Batched instructions count towards the progress callback */
+    if( checkProgress ){
+      if( db->nProgressOps==nProgressOps ) break;
+      nProgressOps++;
+    }
+#endif
+    UPDATE_MAX_BLOBSIZE(pDest);
+    REGISTER_TRACE(pOp->p3, pDest);
+    pc++;
+    pOp++;
+#ifdef SQLITE_DEBUG
+    if( p->trace ){
+      sqlite3VdbePrintOp(p->trace, pc, pOp);
+    }
+#endif
+    p2 = pOp->p2;
+    assert( p2<nField );
+    assert( pOp->p3>0 && pOp->p3<=p->nMem );
+    pDest = &aMem[pOp->p3];
+    memAboutToChange(p, pDest);
+    MemSetTypeFlag(pDest, MEM_Null);
+    if( p2>=pC->nHdrParsed ){
+      rc = vdbeParseRecordHeader(pC, (u8*)zRec, p2);
+      if( rc!=SQLITE_OK ) break;
+    }
+    if( aOffset[p2] ){
+      sqlite3VdbeMemReleaseExternal(pDest);
+      sqlite3VdbeSerialGet((u8 *)&zRec[aOffset[p2]], aType[p2], pDest);
+      pDest->enc = encoding;
+    }else if( pOp->p4type==P4_MEM ){
+      sqlite3VdbeMemShallowCopy(pDest, pOp->p4.pMem, MEM_Static);
+    }
+    rc = sqlite3VdbeMemMakeWriteable(pDest);
+  }
+
 op_column_out:
   UPDATE_MAX_BLOBSIZE(pDest);
   REGISTER_TRACE(pOp->p3, pDest);
@@ -3165,6 +3257,31 @@ case OP_OpenEphemeral: {
   break;
 }
 
+/* Opcode: SorterOpen P1 P2 * P4 *
+**
+** This opcode works like OP_OpenEphemeral except that it opens
+** a transient index that is specifically designed to sort large
+** tables using an external merge-sort algorithm.  Keys are added
+** with OP_SorterInsert and read back in order with OP_SorterSort,
+** OP_SorterNext and OP_SorterData.
+*/
+case OP_SorterOpen: {
+  VdbeCursor *pCx;
+
+  assert( pOp->p1>=0 );
+  assert( pOp->p4type==P4_KEYINFO );
+  pCx = allocateCursor(p, pOp->p1, pOp->p2, -1, 0);
+  if( pCx==0 ) goto no_mem;
+  pCx->pKeyInfo = pOp->p4.pKeyInfo;
+  pCx->pKeyInfo->enc = ENC(p->db);
+  pCx->isTable = 0;
+  pCx->isIndex = 1;
+  pCx->nullRow = 1;
+  rc = sqlite3VdbeSorterInit(db, pCx);
+  if( rc==SQLITE_NOMEM ) goto no_mem;
+  break;
+}
+
 /* Opcode: OpenPseudo P1 P2 P3 * *
 **
 ** Open a new cursor that points to a fake table that contains a single
@@ -4307,6 +4424,135 @@ case OP_Next: {        /* jump */
   break;
 }
 
+/* Opcode: SorterInsert P1 P2 * * *
+**
+** Register P2 holds an SQL index key made using the
+** MakeRecord instructions.  This opcode adds that key to the
+** sorter opened by OP_SorterOpen on cursor P1.
+*/
+case OP_SorterInsert: {       /* in2 */
+  VdbeCursor *pC;
+
+  assert( pOp->p1>=0 && pOp->p1<p->nCursor );
+  pC = p->apCsr[pOp->p1];
+  assert( pC!=0 && pC->pSorter!=0 );
+  pIn2 = &aMem[pOp->p2];
+  assert( pIn2->flags & MEM_Blob );
+  rc = ExpandBlob(pIn2);
+  if( rc==SQLITE_OK ){
+    rc = sqlite3VdbeSorterWrite(db, pC, pIn2);
+  }
+  if( rc==SQLITE_NOMEM ) goto no_mem;
+  break;
+}
+
+/* Opcode: SorterSort P1 P2 * * *
+**
+** Sort the keys added to the sorter on cursor P1 and point the cursor
+** at the first of them.  If the sorter is empty, jump to P2.
+**
+** Like OP_Sort, this opcode adjusts the sqlite3_sort_count and
+** sqlite3_search_count variables used by the test scripts and
+** increments the SQLITE_STMTSTATUS_SORT counter of the statement.
+*/
+case OP_SorterSort: {       /* jump */
+  VdbeCursor *pC;
+  int res;
+
+#ifdef SQLITE_TEST
+  sqlite3_sort_count++;
+  sqlite3_search_count--;
+#endif
+  p->aCounter[SQLITE_STMTSTATUS_SORT-1]++;
+  assert( pOp->p1>=0 && pOp->p1<p->nCursor );
+  pC = p->apCsr[pOp->p1];
+  assert( pC!=0 && pC->pSorter!=0 );
+  res = 1;
+  rc = sqlite3VdbeSorterRewind(db, pC, &res);
+  if( rc==SQLITE_NOMEM ) goto no_mem;
+  pC->nullRow = (u8)res;
+  pC->cacheStatus = CACHE_STALE;
+  assert( pOp->p2>0 && pOp->p2<p->nOp );
+  if( res ){
+    pc = pOp->p2 - 1;
+  }
+  break;
+}
+
+/* Opcode: SorterNext P1 P2 * * *
+**
+** Advance the sorter on cursor P1 to its next key.  If there is one,
+** jump to P2.  Otherwise fall through to the next instruction.
+*/
+case OP_SorterNext: {       /* jump */
+  VdbeCursor *pC;
+  int res;
+
+  CHECK_FOR_INTERRUPT;
+  assert( pOp->p1>=0 && pOp->p1<p->nCursor );
+  pC = p->apCsr[pOp->p1];
+  assert( pC!=0 && pC->pSorter!=0 );
+  res = 1;
+  rc = sqlite3VdbeSorterNext(db, pC, &res);
+  if( rc==SQLITE_NOMEM ) goto no_mem;
+  pC->nullRow = (u8)res;
+  pC->cacheStatus = CACHE_STALE;
+  if( res==0 ){
+    pc = pOp->p2 - 1;
+#ifdef SQLITE_TEST
+    sqlite3_search_count++;
+#endif
+  }
+  break;
+}
+
+/* Opcode: SorterData P1 P2 * * *
+**
+** Write into register P2 the current key of the sorter on cursor P1.
+*/
+case OP_SorterData: {
+  VdbeCursor *pC;
+
+  pOut = &aMem[pOp->p2];
+  memAboutToChange(p, pOut);
+  assert( pOp->p1>=0 && pOp->p1<p->nCursor );
+  pC = p->apCsr[pOp->p1];
+  assert( pC!=0 && pC->pSorter!=0 );
+  assert( pC->nullRow==0 );
+  rc = sqlite3VdbeSorterRowkey(pC, pOut);
+  if( rc==SQLITE_NOMEM ) goto no_mem;
+  pOut->enc = SQLITE_UTF8;  /* In case the blob is ever cast to text */
+  UPDATE_MAX_BLOBSIZE(pOut);
+  break;
+}
+
+/* Opcode: SorterCompare P1 P2 P3 * *
+**
+** P1 is a sorter cursor whose keys end in a rowid, as for an index.
+** Compare the current sorter key with the record in register P3,
+** ignoring the rowid at the end of each.  If the two differ, or if the
+** sorter key contains a NULL, jump to P2.  Otherwise fall through.
+**
+** This is used by CREATE UNIQUE INDEX to find duplicate keys once they
+** have been sorted next to each other.
+*/
+case OP_SorterCompare: {       /* jump, in3 */
+  VdbeCursor *pC;
+  int res;
+
+  assert( pOp->p1>=0 && pOp->p1<p->nCursor );
+  pC = p->apCsr[pOp->p1];
+  assert( pC!=0 && pC->pSorter!=0 );
+  pIn3 = &aMem[pOp->p3];
+  assert( pIn3->flags & MEM_Blob );
+  res = 0;
+  rc = sqlite3VdbeSorterCompare(pC, pIn3, &res);
+  if( res ){
+    pc = pOp->p2-1;
+  }
+  break;
+}
+
 /* Opcode: IdxInsert P1 P2 P3 * P5
 **
 ** Register P2 holds a SQL index key made using the
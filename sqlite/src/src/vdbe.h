@@ -201,6 +201,10 @@ void sqlite3VdbeCountChanges(Vdbe*);
 sqlite3 *sqlite3VdbeDb(Vdbe*);
 void sqlite3VdbeSetSql(Vdbe*, const char *z, int n, int);
 void sqlite3VdbeSwap(Vdbe*,Vdbe*);
+Vdbe *sqlite3VdbeCacheFind(sqlite3*, const char*, int, const char**);
+int sqlite3VdbeCacheFinalize(Vdbe*);
+void sqlite3VdbeCacheSize(sqlite3*, int);
+void sqlite3VdbeCacheClear(sqlite3*);
 VdbeOp *sqlite3VdbeTakeOpArray(Vdbe*, int*, int*);
 sqlite3_value *sqlite3VdbeGetValue(Vdbe*, int, u8);
 void sqlite3VdbeSetVarmask(Vdbe*, int);
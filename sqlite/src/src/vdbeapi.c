@@ -79,7 +79,7 @@ int sqlite3_finalize(sqlite3_stmt *pStmt){
     mutex = v->db->mutex;
 #endif
     sqlite3_mutex_enter(mutex);
-    rc = sqlite3VdbeFinalize(v);
+    rc = sqlite3VdbeCacheFinalize(v);
     rc = sqlite3ApiExit(db, rc);
     sqlite3_mutex_leave(mutex);
   }
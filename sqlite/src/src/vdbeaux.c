@@ -59,6 +59,11 @@ void sqlite3VdbeSetSql(Vdbe *p, const char *z, int n, int isPrepareV2){
   assert( p->zSql==0 );
   p->zSql = sqlite3DbStrNDup(p->db, z, n);
   p->isPrepareV2 = (u8)isPrepareV2;
+#ifndef SQLITE_OMIT_COMPLETE
+  if( isPrepareV2 && p->db->mxStmtCache>0 && p->zSql ){
+    p->semiTerm = (u8)sqlite3_complete(p->zSql);
+  }
+#endif
 }
 
 /*
@@ -88,6 +93,199 @@ void sqlite3VdbeSwap(Vdbe *pA, Vdbe *pB){
   pA->zSql = pB->zSql;
   pB->zSql = zTmp;
   pB->isPrepareV2 = pA->isPrepareV2;
+  pA->semiTerm = pB->semiTerm;
+}
+
+/*
+** Remove VM p from the list of active VMs of its database connection.
+*/
+static void vdbeUnlink(Vdbe *p){
+  sqlite3 *db = p->db;
+  if( p->pPrev ){
+    p->pPrev->pNext = p->pNext;
+  }else{
+    assert( db->pVdbe==p );
+    db->pVdbe = p->pNext;
+  }
+  if( p->pNext ){
+    p->pNext->pPrev = p->pPrev;
+  }
+}
+
+/*
+** Discard entries from the end of the statement cache of connection db
+** until no more than nKeep remain.
+*/
+static void vdbeCacheTrim(sqlite3 *db, int nKeep){
+  Vdbe *p;
+  Vdbe **pp = &db->pStmtCache;
+  int i;
+  for(i=0; i<nKeep && *pp; i++){
+    pp = &(*pp)->pNext;
+  }
+  p = *pp;
+  *pp = 0;
+  while( p ){
+    Vdbe *pNext = p->pNext;
+    p->magic = VDBE_MAGIC_DEAD;
+    p->db = 0;
+    sqlite3VdbeDeleteObject(db, p);
+    db->nStmtCache--;
+    p = pNext;
+  }
+  assert( db->nStmtCache==i );
+}
+
+/*
+** Return true if the schema cookies that VM p was compiled against, as
+** recorded by its OP_VerifyCookie instructions, match the schemas
+** currently loaded by the connection.
+*/
+static int vdbeSchemaIsCurrent(Vdbe *p){
+  sqlite3 *db = p->db;
+  int i;
+  for(i=0; i<p->nOp; i++){
+    VdbeOp *pOp = &p->aOp[i];
+    if( pOp->opcode==OP_VerifyCookie ){
+      Schema *pSchema;
+      if( pOp->p1>=db->nDb ) return 0;
+      pSchema = db->aDb[pOp->p1].pSchema;
+      if( pSchema==0 || !DbHasProperty(db, pOp->p1, DB_SchemaLoaded)
+       || pSchema->schema_cookie!=pOp->p2 || pSchema->iGeneration!=pOp->p3
+      ){
+        return 0;
+      }
+    }
+  }
+  return 1;
+}
+
+/*
+** Search the statement cache of connection db for a VM compiled from the
+** SQL statement at the start of zSql, where nBytes is the length of zSql
+** in bytes or negative if zSql is nul-terminated.
+**
+** If one is found, it is removed from the cache, linked back into the
+** list of active VMs and returned, and *pzTail (if not NULL) is set to
+** the end of the statement within zSql as sqlite3_prepare_v2() would
+** have done. Otherwise NULL is returned.
+**
+** The cached text matches only if the input ends at the same point or
+** the cached statement is terminated by a semicolon. Otherwise, the text
+** that follows would have been compiled as part of the same statement.
+** A match that was compiled against a different version of the schema
+** is discarded.
+*/
+Vdbe *sqlite3VdbeCacheFind(
+  sqlite3 *db,                  /* Database connection */
+  const char *zSql,             /* SQL text to prepare */
+  int nBytes,                   /* Length of zSql in bytes, or -1 */
+  const char **pzTail           /* OUT: End of the statement in zSql */
+){
+  Vdbe *p;
+  Vdbe *pNext;
+  assert( sqlite3_mutex_held(db->mutex) );
+  for(p=db->pStmtCache; p; p=pNext){
+    int n = sqlite3Strlen30(p->zSql);
+    pNext = p->pNext;
+    if( nBytes>=0 && nBytes<n ) continue;
+    if( zSql[0]!=p->zSql[0] || strncmp(zSql, p->zSql, n)!=0 ) continue;
+    if( !p->semiTerm && n!=nBytes && zSql[n]!=0 ) continue;
+
+    if( p->pPrev ){
+      p->pPrev->pNext = p->pNext;
+    }else{
+      db->pStmtCache = p->pNext;
+    }
+    if( p->pNext ){
+      p->pNext->pPrev = p->pPrev;
+    }
+    db->nStmtCache--;
+    if( vdbeSchemaIsCurrent(p) ) break;
+    p->magic = VDBE_MAGIC_DEAD;
+    p->db = 0;
+    sqlite3VdbeDeleteObject(db, p);
+  }
+  if( p==0 ) return 0;
+
+  if( db->pVdbe ){
+    db->pVdbe->pPrev = p;
+  }
+  p->pNext = db->pVdbe;
+  p->pPrev = 0;
+  db->pVdbe = p;
+  memset(p->aCounter, 0, sizeof(p->aCounter));
+  if( pzTail ){
+    *pzTail = &zSql[sqlite3Strlen30(p->zSql)];
+  }
+  return p;
+}
+
+/*
+** Finalize VM p on behalf of sqlite3_finalize().
+**
+** If the statement cache of the connection is enabled and p may be
+** reused, p is reset, its parameters are set to NULL and it is moved to
+** the front of the cache instead of being deleted. The least recently
+** used entry is discarded if this makes the cache too large. Either way
+** the return value is the same as for sqlite3VdbeFinalize().
+*/
+int sqlite3VdbeCacheFinalize(Vdbe *p){
+  sqlite3 *db = p->db;
+  int rc = SQLITE_OK;
+  int i;
+
+  if( db->mxStmtCache==0 || !p->isPrepareV2 || p->zSql==0 || p->expired ){
+    return sqlite3VdbeFinalize(p);
+  }
+  if( p->magic==VDBE_MAGIC_RUN || p->magic==VDBE_MAGIC_HALT ){
+    rc = sqlite3VdbeReset(p);
+    assert( (rc & db->errMask)==rc );
+  }
+  for(i=0; i<p->nVar; i++){
+    sqlite3VdbeMemRelease(&p->aVar[i]);
+    p->aVar[i].flags = MEM_Null;
+  }
+
+  /* A statement that was compiled for particular parameter values, or
+  ** that expired while it was running, cannot be reused. */
+  if( p->expmask || p->expired || db->mallocFailed ){
+    sqlite3VdbeDelete(p);
+    return rc;
+  }
+  sqlite3VdbeMakeReady(p, -1, 0, 0, 0, 0, 0);
+
+  vdbeUnlink(p);
+  p->pPrev = 0;
+  p->pNext = db->pStmtCache;
+  if( p->pNext ){
+    p->pNext->pPrev = p;
+  }
+  db->pStmtCache = p;
+  db->nStmtCache++;
+  vdbeCacheTrim(db, db->mxStmtCache);
+  return rc;
+}
+
+/*
+** Set the maximum number of VMs held by the statement cache of connection
+** db. Zero disables the cache.
+*/
+void sqlite3VdbeCacheSize(sqlite3 *db, int mxStmt){
+  assert( sqlite3_mutex_held(db->mutex) );
+  assert( mxStmt>=0 );
+  db->mxStmtCache = mxStmt;
+  vdbeCacheTrim(db, mxStmt);
+}
+
+/*
+** Discard the contents of the statement cache of connection db. This is
+** called whenever cached VMs might have become obsolete.
+*/
+void sqlite3VdbeCacheClear(sqlite3 *db){
+  if( db->pStmtCache ){
+    vdbeCacheTrim(db, 0);
+  }
 }
 
 #ifdef SQLITE_DEBUG
@@ -1536,6 +1734,9 @@ void sqlite3VdbeFreeCursor(Vdbe *p, VdbeCursor *pCx){
   if( pCx==0 ){
     return;
   }
+  if( pCx->pSorter ){
+    sqlite3VdbeSorterClose(p->db, pCx);
+  }
   if( pCx->pBt ){
     sqlite3BtreeClose(pCx->pBt);
     /* The pCx->pCursor will be close automatically, if it exists, by
@@ -2419,15 +2620,7 @@ void sqlite3VdbeDelete(Vdbe *p){
 
   if( NEVER(p==0) ) return;
   db = p->db;
-  if( p->pPrev ){
-    p->pPrev->pNext = p->pNext;
-  }else{
-    assert( db->pVdbe==p );
-    db->pVdbe = p->pNext;
-  }
-  if( p->pNext ){
-    p->pNext->pPrev = p->pPrev;
-  }
+  vdbeUnlink(p);
   p->magic = VDBE_MAGIC_DEAD;
   p->db = 0;
   sqlite3VdbeDeleteObject(db, p);
@@ -3159,6 +3352,7 @@ void sqlite3ExpirePreparedStatements(sqlite3 *db){
   for(p = db->pVdbe; p; p=p->pNext){
     p->expired = 1;
   }
+  sqlite3VdbeCacheClear(db);
 }
 
 /*
@@ -412,6 +412,41 @@ int sqlite3_blob_write(sqlite3_blob *pBlob, const void *z, int n, int iOffset){
   return blobReadWrite(pBlob, (void *)z, n, iOffset, sqlite3BtreePutData);
 }
 
+/*
+** An instance of this structure is passed as the buffer argument to
+** blobStreamData(). It holds the callback and context pointer passed to
+** sqlite3_blob_stream().
+*/
+typedef struct BlobStream BlobStream;
+struct BlobStream {
+  int (*xChunk)(void*, const void*, int);  /* Callback for each piece */
+  void *pArg;                              /* First argument to xChunk */
+};
+
+/*
+** The xCall argument passed to blobReadWrite() by sqlite3_blob_stream().
+*/
+static int blobStreamData(BtCursor *pCsr, u32 offset, u32 amt, void *z){
+  BlobStream *p = (BlobStream *)z;
+  return sqlite3BtreeStreamData(pCsr, offset, amt, p->xChunk, p->pArg);
+}
+
+/*
+** Pass data from a blob handle to a callback without copying it.
+*/
+int sqlite3_blob_stream(
+  sqlite3_blob *pBlob,
+  int n,
+  int iOffset,
+  int (*xChunk)(void*, const void*, int),
+  void *pArg
+){
+  BlobStream stream;
+  stream.xChunk = xChunk;
+  stream.pArg = pArg;
+  return blobReadWrite(pBlob, (void *)&stream, n, iOffset, blobStreamData);
+}
+
 /*
 ** Query a blob handle for the size of the data.
 **
@@ -1032,11 +1032,11 @@ int sqlite3ValueFromExpr(
   }
   op = pExpr->op;
 
-  /* op can only be TK_REGISTER if we have compiled with SQLITE_ENABLE_STAT2.
-  ** The ifdef here is to enable us to achieve 100% branch test coverage even
-  ** when SQLITE_ENABLE_STAT2 is omitted.
+  /* op can only be TK_REGISTER if we have compiled with SQLITE_ENABLE_STAT2
+  ** or SQLITE_ENABLE_STAT3. The ifdef here is to enable us to achieve 100%
+  ** branch test coverage even when both are omitted.
   */
-#ifdef SQLITE_ENABLE_STAT2
+#if defined(SQLITE_ENABLE_STAT2) || defined(SQLITE_ENABLE_STAT3)
   if( op==TK_REGISTER ) op = pExpr->op2;
 #else
   if( NEVER(op==TK_REGISTER) ) op = pExpr->op2;
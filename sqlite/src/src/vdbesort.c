@@ -0,0 +1,1128 @@
+/*
+** 2013 April 19
+**
+** The author disclaims copyright to this source code.  In place of
+** a legal notice, here is a blessing:
+**
+**    May you do good and not evil.
+**    May you find forgiveness for yourself and forgive others.
+**    May you share freely, never taking more than you give.
+**
+*************************************************************************
+**
+** This file contains code for the VdbeSorter object, used in concert with
+** a VdbeCursor to sort large numbers of keys for CREATE INDEX statements
+** and for the ORDER BY clauses of SELECT statements.
+**
+** Keys passed to sqlite3VdbeSorterWrite() are accumulated in an unsorted
+** in-memory list. If all keys fit within the memory budget, the list is
+** sorted in place when the sorter is rewound. Otherwise, each time the
+** list grows larger than the budget it is sorted and written to a
+** temporary file as a "packed-memory-array" (PMA), and the PMAs are
+** merged together when the sorter is rewound.
+**
+** A PMA is a sequence of keys, each stored as a varint byte count
+** followed by the key itself, in sorted order. PMAs are merged
+** SORTER_MAX_MERGE_COUNT at a time using a tournament tree. If there are
+** more PMAs than that, intermediate merge passes write longer PMAs to a
+** second temporary file until few enough remain.
+**
+** If the SQLITE_LIMIT_WORKER_THREADS limit is greater than zero, lists
+** are sorted and written to disk by up to that many background threads
+** while the VM goes on collecting the next list. Each thread writes its
+** PMAs to a temporary file of its own.
+*/
+#include "sqliteInt.h"
+#include "vdbeInt.h"
+
+typedef struct SorterRecord SorterRecord;
+typedef struct SorterTask SorterTask;
+typedef struct SorterPma SorterPma;
+typedef struct VdbeSorterIter VdbeSorterIter;
+typedef struct FileWriter FileWriter;
+
+/*
+** Minimum amount of memory, in pages, that the sorter uses for its
+** in-memory list before spilling to disk, and the maximum number of PMAs
+** merged in a single pass.
+*/
+#define SORTER_MIN_WORKING 10
+#define SORTER_MAX_MERGE_COUNT 16
+
+/*
+** Each key written to the sorter is stored in a SorterRecord, with the
+** key itself in the same allocation immediately after the structure.
+*/
+struct SorterRecord {
+  SorterRecord *pNext;            /* Pointer to next record in list */
+  int nVal;                       /* Size of the key in bytes */
+  void *pVal;                     /* Pointer to the key */
+};
+
+/*
+** A sorted run that has been written to a temporary file.
+*/
+struct SorterPma {
+  sqlite3_file *pFile;            /* File containing the PMA */
+  i64 iStart;                     /* Offset of the first byte of the PMA */
+  i64 iEof;                       /* Offset one byte past the end of it */
+};
+
+/*
+** A SorterTask sorts a list of records and writes it to pFile as a new
+** PMA, either synchronously or on a background thread. While pThread is
+** not NULL, the task and everything it points to belong to that thread,
+** except for pSorter->pKeyInfo, which is only read.
+*/
+struct SorterTask {
+  VdbeSorter *pSorter;            /* Sorter this task belongs to */
+  SQLiteThread *pThread;          /* Thread running the task, or NULL */
+  SorterRecord *pList;            /* Records to sort and write */
+  UnpackedRecord *pUnpacked;      /* Space used to unpack keys */
+  sqlite3_file *pFile;            /* Temporary file written by this task */
+  i64 iWriteOff;                  /* Current size of pFile */
+  i64 iStart;                     /* Start of the PMA written by the task */
+  int bPma;                       /* True if a PMA was written and not used */
+  int rc;                         /* Result of running the task */
+};
+
+/*
+** An iterator that reads keys from a single PMA.
+*/
+struct VdbeSorterIter {
+  sqlite3_file *pFile;            /* File the PMA is stored in */
+  i64 iReadOff;                   /* Current read offset */
+  i64 iEof;                       /* 1 byte past EOF for this iterator */
+  int nBuffer;                    /* Size of aBuffer[] in bytes */
+  u8 *aBuffer;                    /* Buffer of file content */
+  int nAlloc;                     /* Bytes of space at aAlloc */
+  u8 *aAlloc;                     /* Space for keys that span buffers */
+  int nKey;                       /* Number of bytes in key */
+  u8 *aKey;                       /* Pointer to current key, or NULL at EOF */
+};
+
+/*
+** Buffered output used to write a PMA to a temporary file. Writes are
+** aligned to nBuffer byte boundaries within the file.
+*/
+struct FileWriter {
+  int rc;                         /* Error code, if any */
+  u8 *aBuffer;                    /* Pointer to write buffer */
+  int nBuffer;                    /* Size of write buffer in bytes */
+  int iBufStart;                  /* First byte of buffer to write */
+  int iBufEnd;                    /* Last byte of buffer to write */
+  i64 iWriteOff;                  /* Offset of start of buffer in file */
+  sqlite3_file *pFile;            /* File to write to */
+};
+
+/*
+** An instance of the following object is attached to each sorter cursor.
+*/
+struct VdbeSorter {
+  KeyInfo *pKeyInfo;              /* Copy of the cursor KeyInfo, db==0 */
+  UnpackedRecord *pUnpacked;      /* Space used by the VM thread */
+  int szUnpacked;                 /* Size of each pUnpacked allocation */
+  int mnPmaSize;                  /* Minimum PMA size, in bytes */
+  int mxPmaSize;                  /* Maximum PMA size, in bytes.  0==no limit */
+  int nBuffer;                    /* Size of file buffers, in bytes */
+  sqlite3_vfs *pVfs;              /* VFS used to open temporary files */
+
+  SorterRecord *pRecord;          /* Unsorted records in memory */
+  int nInMemory;                  /* Bytes of memory used by pRecord list */
+  int bSpilled;                   /* True once any list is written to disk */
+
+  int nWorker;                    /* Number of background threads to use */
+  int nTask;                      /* Number of entries in aTask[] */
+  int iTask;                      /* Task used for the most recent flush */
+  SorterTask *aTask;              /* Tasks that write PMAs */
+
+  int nPma;                       /* Number of PMAs in aPma[] */
+  int nPmaAlloc;                  /* Allocated size of aPma[] */
+  SorterPma *aPma;                /* PMAs written so far */
+  sqlite3_file *pMerge;           /* Output of the last merge pass */
+  sqlite3_file *pMerge2;          /* Input of the last merge pass */
+
+  int nTree;                      /* Used size of aTree/aIter (power of 2) */
+  int *aTree;                     /* Current state of incremental merge */
+  VdbeSorterIter *aIter;          /* Array of iterators to merge */
+};
+
+#ifdef SQLITE_TEST
+/*
+** The number of PMAs written by all sorters. Used by the test scripts to
+** check that a sort spilled to disk.
+*/
+int sqlite3_sorter_pma_count = 0;
+#endif
+
+/*
+** Free the list of sorted records starting at pRecord.
+*/
+static void vdbeSorterRecordFree(SorterRecord *pRecord){
+  SorterRecord *p;
+  SorterRecord *pNext;
+  for(p=pRecord; p; p=pNext){
+    pNext = p->pNext;
+    sqlite3_free(p);
+  }
+}
+
+/*
+** Compare key1 (buffer pKey1, size nKey1 bytes) with key2 (buffer pKey2,
+** size nKey2 bytes). Argument pKeyInfo supplies the collation functions
+** used by the comparison. pUnpacked is space used to unpack key2. If
+** *pbCached is true, pUnpacked already holds key2 unpacked by a previous
+** call. Either way *pbCached is set on return.
+**
+** If the bOmitRowid argument is non-zero, assume both keys end in a rowid
+** field. For the purposes of the comparison, ignore it. Also, if bOmitRowid
+** is true and key2 contains even a single NULL value, it is considered to
+** be less than key1. Even if key1 also contains NULL values.
+*/
+static int vdbeSorterCompare(
+  KeyInfo *pKeyInfo,              /* Collation functions for the keys */
+  UnpackedRecord *pUnpacked,      /* Space to unpack key2 into */
+  int szUnpacked,                 /* Size of pUnpacked in bytes */
+  int *pbCached,                  /* IN/OUT: True if key2 is in pUnpacked */
+  int bOmitRowid,                 /* Ignore rowid field at end of keys */
+  const void *pKey1, int nKey1,   /* Left side of comparison */
+  const void *pKey2, int nKey2    /* Right side of comparison */
+){
+  UnpackedRecord *r2;
+  if( *pbCached ){
+    r2 = pUnpacked;
+  }else{
+    /* pUnpacked is obtained from sqlite3Malloc() and so is 8-byte aligned,
+    ** which means sqlite3VdbeRecordUnpack() uses it as is. */
+    r2 = sqlite3VdbeRecordUnpack(pKeyInfo, nKey2, pKey2,
+                                 (char*)pUnpacked, szUnpacked);
+    assert( r2==pUnpacked );
+    assert( (r2->flags & UNPACKED_NEED_FREE)==0 );
+    *pbCached = !bOmitRowid;
+  }
+  if( bOmitRowid ){
+    int i;
+    r2->nField = pKeyInfo->nField;
+    for(i=0; i<r2->nField; i++){
+      if( r2->aMem[i].flags & MEM_Null ) return -1;
+    }
+    r2->flags |= UNPACKED_PREFIX_MATCH;
+  }
+  return sqlite3VdbeRecordCompare(nKey1, pKey1, r2);
+}
+
+/*
+** Merge the two sorted lists p1 and p2 into a single list.
+** Set *ppOut to the head of the new list.
+*/
+static void vdbeSorterMerge(
+  SorterTask *pTask,              /* Task doing the sort */
+  SorterRecord *p1,               /* First list to merge */
+  SorterRecord *p2,               /* Second list to merge */
+  SorterRecord **ppOut            /* OUT: Head of merged list */
+){
+  VdbeSorter *pSorter = pTask->pSorter;
+  SorterRecord *pFinal = 0;
+  SorterRecord **pp = &pFinal;
+  int bCached = 0;                /* True if p2 is unpacked already */
+
+  while( p1 && p2 ){
+    int res;
+    res = vdbeSorterCompare(pSorter->pKeyInfo, pTask->pUnpacked,
+        pSorter->szUnpacked, &bCached, 0,
+        p1->pVal, p1->nVal, p2->pVal, p2->nVal
+    );
+    if( res<=0 ){
+      *pp = p1;
+      pp = &p1->pNext;
+      p1 = p1->pNext;
+    }else{
+      *pp = p2;
+      pp = &p2->pNext;
+      p2 = p2->pNext;
+      bCached = 0;
+    }
+  }
+  *pp = p1 ? p1 : p2;
+  *ppOut = pFinal;
+}
+
+/*
+** Sort the linked list of records headed at pTask->pList. Records are
+** kept in the order they were written when their keys compare equal.
+*/
+static void vdbeSorterSort(SorterTask *pTask){
+  int i;
+  SorterRecord **aSlot;
+  SorterRecord *p;
+  SorterRecord *pPrev = 0;
+  SorterRecord *pNext;
+  static const int nSlot = 64;
+  SorterRecord *aSlotSpace[64];
+
+  /* The list is built by prepending each new record, so it starts out in
+  ** reverse order of insertion. Reverse it first.
+  */
+  for(p=pTask->pList; p; p=pNext){
+    pNext = p->pNext;
+    p->pNext = pPrev;
+    pPrev = p;
+  }
+  p = pPrev;
+
+  aSlot = aSlotSpace;
+  memset(aSlot, 0, sizeof(aSlotSpace));
+  while( p ){
+    pNext = p->pNext;
+    p->pNext = 0;
+    for(i=0; aSlot[i]; i++){
+      assert( i<nSlot-1 );
+      vdbeSorterMerge(pTask, aSlot[i], p, &p);
+      aSlot[i] = 0;
+    }
+    aSlot[i] = p;
+    p = pNext;
+  }
+
+  p = 0;
+  for(i=0; i<nSlot; i++){
+    if( aSlot[i] ) vdbeSorterMerge(pTask, aSlot[i], p, &p);
+  }
+  pTask->pList = p;
+}
+
+/*
+** Initialize a FileWriter object to write to pFile starting at offset
+** iStart.
+*/
+static void fileWriterInit(
+  sqlite3_file *pFile,            /* File to write to */
+  FileWriter *p,                  /* Object to populate */
+  int nBuf,                       /* Buffer size */
+  i64 iStart                      /* Offset of pFile to begin writing at */
+){
+  memset(p, 0, sizeof(FileWriter));
+  p->aBuffer = (u8*)sqlite3Malloc(nBuf);
+  if( !p->aBuffer ){
+    p->rc = SQLITE_NOMEM;
+  }else{
+    p->iBufEnd = p->iBufStart = (int)(iStart % nBuf);
+    p->iWriteOff = iStart - p->iBufStart;
+    p->nBuffer = nBuf;
+    p->pFile = pFile;
+  }
+}
+
+/*
+** Write nData bytes of data to the file-write object.
+*/
+static void fileWriterWrite(FileWriter *p, const u8 *pData, int nData){
+  int nRem = nData;
+  while( nRem>0 && p->rc==SQLITE_OK ){
+    int nCopy = nRem;
+    if( nCopy>(p->nBuffer - p->iBufEnd) ){
+      nCopy = p->nBuffer - p->iBufEnd;
+    }
+
+    memcpy(&p->aBuffer[p->iBufEnd], &pData[nData-nRem], nCopy);
+    p->iBufEnd += nCopy;
+    if( p->iBufEnd==p->nBuffer ){
+      p->rc = sqlite3OsWrite(p->pFile,
+          &p->aBuffer[p->iBufStart], p->iBufEnd - p->iBufStart,
+          p->iWriteOff + p->iBufStart
+      );
+      p->iBufStart = p->iBufEnd = 0;
+      p->iWriteOff += p->nBuffer;
+    }
+    assert( p->iBufEnd<p->nBuffer );
+
+    nRem -= nCopy;
+  }
+}
+
+/*
+** Write value iVal encoded as a varint to the file-write object.
+*/
+static void fileWriterWriteVarint(FileWriter *p, u64 iVal){
+  int nByte;
+  u8 aByte[10];
+  nByte = sqlite3PutVarint(aByte, iVal);
+  fileWriterWrite(p, aByte, nByte);
+}
+
+/*
+** Flush any buffered data to disk and clean up the file-writer object.
+** The results of using the file-writer after this call are undefined.
+** Return SQLITE_OK if flushing the buffered data succeeds or is not
+** required. Otherwise, return an SQLite error code.
+**
+** Before returning, set *piEof to the offset immediately following the
+** last byte written to the file.
+*/
+static int fileWriterFinish(FileWriter *p, i64 *piEof){
+  int rc;
+  if( p->rc==SQLITE_OK && ALWAYS(p->aBuffer) && p->iBufEnd>p->iBufStart ){
+    p->rc = sqlite3OsWrite(p->pFile,
+        &p->aBuffer[p->iBufStart], p->iBufEnd - p->iBufStart,
+        p->iWriteOff + p->iBufStart
+    );
+  }
+  *piEof = (p->iWriteOff + p->iBufEnd);
+  sqlite3_free(p->aBuffer);
+  rc = p->rc;
+  memset(p, 0, sizeof(FileWriter));
+  return rc;
+}
+
+/*
+** Sort the records in pTask->pList and write them to pTask->pFile as a
+** new PMA, freeing each record once written. This is the body of each
+** SorterTask, and may run on a background thread.
+*/
+static int vdbeSorterListToPMA(SorterTask *pTask){
+  VdbeSorter *pSorter = pTask->pSorter;
+  FileWriter writer;
+  SorterRecord *p;
+  SorterRecord *pNext;
+
+  vdbeSorterSort(pTask);
+  fileWriterInit(pTask->pFile, &writer, pSorter->nBuffer, pTask->iWriteOff);
+  for(p=pTask->pList; p; p=pNext){
+    pNext = p->pNext;
+    fileWriterWriteVarint(&writer, p->nVal);
+    fileWriterWrite(&writer, p->pVal, p->nVal);
+    sqlite3_free(p);
+  }
+  pTask->pList = 0;
+  pTask->iStart = pTask->iWriteOff;
+  pTask->rc = fileWriterFinish(&writer, &pTask->iWriteOff);
+  pTask->bPma = 1;
+  return pTask->rc;
+}
+
+/*
+** The entry point of SorterTask background threads.
+*/
+static void *vdbeSorterTaskMain(void *pCtx){
+  SorterTask *pTask = (SorterTask*)pCtx;
+  return SQLITE_INT_TO_PTR(vdbeSorterListToPMA(pTask));
+}
+
+/*
+** Wait for the task to finish, if it is running on a background thread,
+** and append the PMA it wrote, if any, to VdbeSorter.aPma[]. Return the
+** result of the task.
+*/
+static int vdbeSorterJoinTask(VdbeSorter *pSorter, SorterTask *pTask){
+  int rc = pTask->rc;
+  if( pTask->pThread ){
+    void *pRet = 0;
+    int rc2 = sqlite3ThreadJoin(pTask->pThread, &pRet);
+    pTask->pThread = 0;
+    rc = SQLITE_PTR_TO_INT(pRet);
+    if( rc==SQLITE_OK ) rc = rc2;
+  }
+  if( rc==SQLITE_OK && pTask->bPma ){
+    if( pSorter->nPma>=pSorter->nPmaAlloc ){
+      int nNew = pSorter->nPmaAlloc ? pSorter->nPmaAlloc*2 : 16;
+      SorterPma *aNew;
+      aNew = sqlite3Realloc(pSorter->aPma, nNew*sizeof(SorterPma));
+      if( aNew==0 ) return SQLITE_NOMEM;
+      pSorter->aPma = aNew;
+      pSorter->nPmaAlloc = nNew;
+    }
+    pSorter->aPma[pSorter->nPma].pFile = pTask->pFile;
+    pSorter->aPma[pSorter->nPma].iStart = pTask->iStart;
+    pSorter->aPma[pSorter->nPma].iEof = pTask->iWriteOff;
+    pSorter->nPma++;
+    pTask->bPma = 0;
+#ifdef SQLITE_TEST
+    sqlite3_sorter_pma_count++;
+#endif
+  }
+  pTask->rc = rc;
+  return rc;
+}
+
+/*
+** Wait for all background tasks to finish. Return the first error
+** reported by any of them.
+*/
+static int vdbeSorterJoinAll(VdbeSorter *pSorter){
+  int rc = SQLITE_OK;
+  int i;
+  for(i=0; i<pSorter->nTask; i++){
+    int rc2 = vdbeSorterJoinTask(pSorter, &pSorter->aTask[i]);
+    if( rc==SQLITE_OK ) rc = rc2;
+  }
+  return rc;
+}
+
+/*
+** Open a temporary file for use by the sorter.
+*/
+static int vdbeSorterOpenTempFile(sqlite3_vfs *pVfs, sqlite3_file **ppFile){
+  int dummy;
+  return sqlite3OsOpenMalloc(pVfs, 0, ppFile,
+      SQLITE_OPEN_TEMP_JOURNAL |
+      SQLITE_OPEN_READWRITE    | SQLITE_OPEN_CREATE |
+      SQLITE_OPEN_EXCLUSIVE    | SQLITE_OPEN_DELETEONCLOSE, &dummy
+  );
+}
+
+/*
+** Hand the in-memory list of records to the next SorterTask to be
+** written to disk as a PMA. If worker threads are enabled, the task
+** runs in the background and this function returns as soon as it has
+** started.
+*/
+static int vdbeSorterFlushPMA(VdbeSorter *pSorter){
+  SorterTask *pTask;
+  int rc;
+
+  pSorter->iTask = (pSorter->iTask + 1) % pSorter->nTask;
+  pTask = &pSorter->aTask[pSorter->iTask];
+  rc = vdbeSorterJoinTask(pSorter, pTask);
+  if( rc==SQLITE_OK && pTask->pFile==0 ){
+    rc = vdbeSorterOpenTempFile(pSorter->pVfs, &pTask->pFile);
+    assert( rc!=SQLITE_OK || pTask->pFile );
+  }
+  if( rc!=SQLITE_OK ) return rc;
+
+  assert( pTask->pList==0 );
+  pTask->pList = pSorter->pRecord;
+  pSorter->pRecord = 0;
+  pSorter->nInMemory = 0;
+  pSorter->bSpilled = 1;
+  if( pSorter->nWorker>0 ){
+    rc = sqlite3ThreadCreate(&pTask->pThread, vdbeSorterTaskMain, pTask);
+  }else{
+    rc = vdbeSorterListToPMA(pTask);
+  }
+  return rc;
+}
+
+/*
+** Initialize the temporary index cursor just opened as a sorter cursor.
+*/
+int sqlite3VdbeSorterInit(sqlite3 *db, VdbeCursor *pCsr){
+  int pgsz;                       /* Page size of main database */
+  int mxCache;                    /* Cache size */
+  int nField;                     /* Number of fields in pCsr->pKeyInfo */
+  int nByte;                      /* Bytes of space for the KeyInfo copy */
+  int i;
+  VdbeSorter *pSorter;            /* The new sorter */
+  KeyInfo *pKeyInfo;              /* Copy of pCsr->pKeyInfo */
+
+  assert( pCsr->pKeyInfo && pCsr->pBt==0 );
+  pCsr->pSorter = pSorter = sqlite3MallocZero(sizeof(VdbeSorter));
+  if( pSorter==0 ){
+    return SQLITE_NOMEM;
+  }
+
+  /* The sorter uses its own copy of the KeyInfo with the db pointer
+  ** cleared, so that keys can be compared on background threads without
+  ** touching the database connection or its lookaside allocator.
+  */
+  nField = pCsr->pKeyInfo->nField;
+  nByte = sizeof(KeyInfo) + (nField-1)*sizeof(CollSeq*) + nField;
+  pSorter->pKeyInfo = pKeyInfo = (KeyInfo*)sqlite3Malloc(nByte);
+  if( pKeyInfo==0 ){
+    return SQLITE_NOMEM;
+  }
+  memcpy(pKeyInfo, pCsr->pKeyInfo, nByte - nField);
+  pKeyInfo->db = 0;
+  pKeyInfo->enc = ENC(db);
+  if( pCsr->pKeyInfo->aSortOrder ){
+    pKeyInfo->aSortOrder = (u8*)&pKeyInfo->aColl[nField];
+    memcpy(pKeyInfo->aSortOrder, pCsr->pKeyInfo->aSortOrder, nField);
+  }
+
+  pgsz = sqlite3BtreeGetPageSize(db->aDb[0].pBt);
+  pSorter->pVfs = db->pVfs;
+  pSorter->nBuffer = pgsz;
+  if( !sqlite3TempInMemory(db) ){
+    pSorter->mnPmaSize = SORTER_MIN_WORKING * pgsz;
+    mxCache = db->aDb[0].pSchema->cache_size;
+    if( mxCache<SORTER_MIN_WORKING ) mxCache = SORTER_MIN_WORKING;
+    pSorter->mxPmaSize = mxCache * pgsz;
+  }
+
+  pSorter->nWorker = db->aLimit[SQLITE_LIMIT_WORKER_THREADS];
+  pSorter->nTask = pSorter->nWorker>0 ? pSorter->nWorker : 1;
+  pSorter->aTask = sqlite3MallocZero(pSorter->nTask*sizeof(SorterTask));
+  if( pSorter->aTask==0 ){
+    pSorter->nTask = 0;
+    return SQLITE_NOMEM;
+  }
+
+  /* Each task and the VM thread need their own space to unpack keys. */
+  pSorter->szUnpacked = ROUND8(sizeof(UnpackedRecord))
+                      + (nField+1)*sizeof(Mem) + 7;
+  pSorter->pUnpacked = sqlite3Malloc(pSorter->szUnpacked);
+  if( pSorter->pUnpacked==0 ) return SQLITE_NOMEM;
+  for(i=0; i<pSorter->nTask; i++){
+    SorterTask *pTask = &pSorter->aTask[i];
+    pTask->pSorter = pSorter;
+    pTask->pUnpacked = sqlite3Malloc(pSorter->szUnpacked);
+    if( pTask->pUnpacked==0 ) return SQLITE_NOMEM;
+  }
+  return SQLITE_OK;
+}
+
+/*
+** Free all resources used by the merge iterators.
+*/
+static void vdbeSorterIterZero(VdbeSorterIter *pIter){
+  sqlite3_free(pIter->aAlloc);
+  sqlite3_free(pIter->aBuffer);
+  memset(pIter, 0, sizeof(VdbeSorterIter));
+}
+
+static void vdbeSorterMergeFree(VdbeSorter *pSorter){
+  int i;
+  if( pSorter->aIter ){
+    for(i=0; i<pSorter->nTree; i++){
+      vdbeSorterIterZero(&pSorter->aIter[i]);
+    }
+    sqlite3_free(pSorter->aIter);
+    pSorter->aIter = 0;
+    pSorter->aTree = 0;
+    pSorter->nTree = 0;
+  }
+}
+
+/*
+** Free any cursor components allocated by sqlite3VdbeSorterXXX routines.
+*/
+void sqlite3VdbeSorterClose(sqlite3 *db, VdbeCursor *pCsr){
+  VdbeSorter *pSorter = pCsr->pSorter;
+  UNUSED_PARAMETER(db);
+  if( pSorter ){
+    int i;
+    vdbeSorterJoinAll(pSorter);
+    vdbeSorterMergeFree(pSorter);
+    for(i=0; i<pSorter->nTask; i++){
+      SorterTask *pTask = &pSorter->aTask[i];
+      vdbeSorterRecordFree(pTask->pList);
+      sqlite3_free(pTask->pUnpacked);
+      if( pTask->pFile ) sqlite3OsCloseFree(pTask->pFile);
+    }
+    if( pSorter->pMerge ) sqlite3OsCloseFree(pSorter->pMerge);
+    if( pSorter->pMerge2 ) sqlite3OsCloseFree(pSorter->pMerge2);
+    vdbeSorterRecordFree(pSorter->pRecord);
+    sqlite3_free(pSorter->aTask);
+    sqlite3_free(pSorter->aPma);
+    sqlite3_free(pSorter->pUnpacked);
+    sqlite3_free(pSorter->pKeyInfo);
+    sqlite3_free(pSorter);
+    pCsr->pSorter = 0;
+  }
+}
+
+/*
+** Add a record to the sorter.
+*/
+int sqlite3VdbeSorterWrite(
+  sqlite3 *db,                    /* Database handle */
+  VdbeCursor *pCsr,               /* Sorter cursor */
+  Mem *pVal                       /* Memory cell containing record */
+){
+  VdbeSorter *pSorter = pCsr->pSorter;
+  int rc = SQLITE_OK;
+  int nReq;
+  SorterRecord *pNew;
+
+  assert( pSorter );
+  nReq = sizeof(SorterRecord) + pVal->n;
+  pNew = (SorterRecord*)sqlite3Malloc(nReq);
+  if( pNew==0 ){
+    db->mallocFailed = 1;
+    return SQLITE_NOMEM;
+  }
+  pNew->pVal = (void*)&pNew[1];
+  memcpy(pNew->pVal, pVal->z, pVal->n);
+  pNew->nVal = pVal->n;
+  pNew->pNext = pSorter->pRecord;
+  pSorter->pRecord = pNew;
+  pSorter->nInMemory += nReq;
+
+  /* See if the contents of the sorter should now be written out. They
+  ** are written out when either of the following are true:
+  **
+  **   * The total memory allocated for the in-memory list is greater
+  **     than (page-size * cache-size), or
+  **
+  **   * The total memory allocated for the in-memory list is greater
+  **     than (page-size * 10) and sqlite3HeapNearlyFull() returns true.
+  */
+  if( pSorter->mxPmaSize>0 && (
+        (pSorter->nInMemory>pSorter->mxPmaSize)
+     || (pSorter->nInMemory>pSorter->mnPmaSize && sqlite3HeapNearlyFull())
+  )){
+    rc = vdbeSorterFlushPMA(pSorter);
+  }
+
+  return rc;
+}
+
+/*
+** Read nByte bytes of data from the PMA that pIter iterates through.
+** Set *ppOut to point to a buffer containing the data. The buffer is
+** valid until the next call to this function for the same iterator.
+*/
+static int vdbeSorterIterRead(
+  VdbeSorterIter *p,              /* Iterator */
+  int nByte,                      /* Bytes of data to read */
+  u8 **ppOut                      /* OUT: Pointer to buffer containing data */
+){
+  int iBuf;                       /* Offset within buffer to read from */
+  int nAvail;                     /* Bytes of data available in buffer */
+
+  /* If the buffer is empty, fill it from the file. A read never goes past
+  ** the end of the PMA, so the end of the fill is clipped to iEof.
+  */
+  iBuf = (int)(p->iReadOff % p->nBuffer);
+  if( iBuf==0 ){
+    int nRead;
+    int rc;
+    if( (p->iEof - p->iReadOff) > (i64)p->nBuffer ){
+      nRead = p->nBuffer;
+    }else{
+      nRead = (int)(p->iEof - p->iReadOff);
+    }
+    assert( nRead>0 );
+    rc = sqlite3OsRead(p->pFile, p->aBuffer, nRead, p->iReadOff);
+    assert( rc!=SQLITE_IOERR_SHORT_READ );
+    if( rc!=SQLITE_OK ) return rc;
+  }
+  nAvail = p->nBuffer - iBuf;
+
+  if( nByte<=nAvail ){
+    /* The requested data is available in the in-memory buffer. */
+    *ppOut = &p->aBuffer[iBuf];
+    p->iReadOff += nByte;
+  }else{
+    /* The requested data is not all available in the in-memory buffer.
+    ** Assemble it in aAlloc[], growing it if required.
+    */
+    int nRem;
+    if( p->nAlloc<nByte ){
+      u8 *aNew;
+      int nNew = p->nAlloc*2;
+      while( nByte>nNew ) nNew = nNew*2;
+      aNew = sqlite3Realloc(p->aAlloc, nNew);
+      if( !aNew ) return SQLITE_NOMEM;
+      p->nAlloc = nNew;
+      p->aAlloc = aNew;
+    }
+
+    memcpy(p->aAlloc, &p->aBuffer[iBuf], nAvail);
+    p->iReadOff += nAvail;
+    nRem = nByte - nAvail;
+
+    while( nRem>0 ){
+      int rc;
+      int nCopy;
+      u8 *aNext;
+      nCopy = nRem;
+      if( nRem>p->nBuffer ) nCopy = p->nBuffer;
+      rc = vdbeSorterIterRead(p, nCopy, &aNext);
+      if( rc!=SQLITE_OK ) return rc;
+      assert( aNext!=p->aAlloc );
+      memcpy(&p->aAlloc[nByte - nRem], aNext, nCopy);
+      nRem -= nCopy;
+    }
+
+    *ppOut = p->aAlloc;
+  }
+
+  return SQLITE_OK;
+}
+
+/*
+** Read a varint from the stream of data accessed by p. Set *pnOut to
+** the value read.
+*/
+static int vdbeSorterIterVarint(VdbeSorterIter *p, u64 *pnOut){
+  int iBuf;
+
+  iBuf = (int)(p->iReadOff % p->nBuffer);
+  if( iBuf && (p->nBuffer-iBuf)>=9 ){
+    p->iReadOff += sqlite3GetVarint(&p->aBuffer[iBuf], pnOut);
+  }else{
+    u8 aVarint[16], *a;
+    int i = 0, rc;
+    do{
+      rc = vdbeSorterIterRead(p, 1, &a);
+      if( rc ) return rc;
+      aVarint[(i++)&0xf] = a[0];
+    }while( (a[0]&0x80)!=0 );
+    sqlite3GetVarint(aVarint, pnOut);
+  }
+
+  return SQLITE_OK;
+}
+
+/*
+** Advance iterator pIter to the next key in its PMA. Set aKey to NULL
+** if the end of the PMA has been reached.
+*/
+static int vdbeSorterIterNext(VdbeSorterIter *pIter){
+  int rc;
+  u64 nRec = 0;
+
+  if( pIter->iReadOff>=pIter->iEof ){
+    /* This is an EOF condition */
+    vdbeSorterIterZero(pIter);
+    return SQLITE_OK;
+  }
+
+  rc = vdbeSorterIterVarint(pIter, &nRec);
+  if( rc==SQLITE_OK ){
+    pIter->nKey = (int)nRec;
+    rc = vdbeSorterIterRead(pIter, (int)nRec, &pIter->aKey);
+  }
+
+  return rc;
+}
+
+/*
+** Initialize iterator pIter to scan through the PMA pPma and point it
+** at the first key.
+*/
+static int vdbeSorterIterInit(
+  VdbeSorter *pSorter,            /* Sorter object */
+  const SorterPma *pPma,          /* PMA to iterate through */
+  VdbeSorterIter *pIter           /* Iterator to populate */
+){
+  int rc = SQLITE_OK;
+  int nBuf = pSorter->nBuffer;
+
+  assert( pPma->iEof>pPma->iStart );
+  assert( pIter->aAlloc==0 && pIter->aBuffer==0 );
+  pIter->pFile = pPma->pFile;
+  pIter->iReadOff = pPma->iStart;
+  pIter->iEof = pPma->iEof;
+  pIter->nAlloc = 128;
+  pIter->aAlloc = (u8*)sqlite3Malloc(pIter->nAlloc);
+  pIter->nBuffer = nBuf;
+  pIter->aBuffer = (u8*)sqlite3Malloc(nBuf);
+
+  if( !pIter->aBuffer || !pIter->aAlloc ){
+    rc = SQLITE_NOMEM;
+  }else{
+    /* The buffer is aligned to nBuf byte boundaries within the file. If
+    ** the PMA starts part way through a block, load the rest of it now.
+    */
+    int iBuf = (int)(pIter->iReadOff % nBuf);
+    if( iBuf ){
+      int nRead = nBuf - iBuf;
+      if( (pIter->iReadOff + nRead) > pIter->iEof ){
+        nRead = (int)(pIter->iEof - pIter->iReadOff);
+      }
+      rc = sqlite3OsRead(
+          pIter->pFile, &pIter->aBuffer[iBuf], nRead, pIter->iReadOff
+      );
+      assert( rc!=SQLITE_IOERR_SHORT_READ );
+    }
+  }
+
+  if( rc==SQLITE_OK ){
+    rc = vdbeSorterIterNext(pIter);
+  }
+  return rc;
+}
+
+/*
+** This function is called to compare two iterator keys when merging
+** multiple b-tree segments. Parameter iOut is the index of the aTree[]
+** value to recalculate.
+*/
+static void vdbeSorterDoCompare(VdbeSorter *pSorter, int iOut){
+  int i1;
+  int i2;
+  int iRes;
+  VdbeSorterIter *p1;
+  VdbeSorterIter *p2;
+
+  assert( iOut<pSorter->nTree && iOut>0 );
+
+  if( iOut>=(pSorter->nTree/2) ){
+    i1 = (iOut - pSorter->nTree/2) * 2;
+    i2 = i1 + 1;
+  }else{
+    i1 = pSorter->aTree[iOut*2];
+    i2 = pSorter->aTree[iOut*2+1];
+  }
+
+  p1 = &pSorter->aIter[i1];
+  p2 = &pSorter->aIter[i2];
+
+  if( p1->aKey==0 ){
+    iRes = i2;
+  }else if( p2->aKey==0 ){
+    iRes = i1;
+  }else{
+    int res;
+    int bCached = 0;
+    res = vdbeSorterCompare(pSorter->pKeyInfo, pSorter->pUnpacked,
+        pSorter->szUnpacked, &bCached, 0,
+        p1->aKey, p1->nKey, p2->aKey, p2->nKey
+    );
+    if( res<=0 ){
+      iRes = i1;
+    }else{
+      iRes = i2;
+    }
+  }
+
+  pSorter->aTree[iOut] = iRes;
+}
+
+/*
+** Set up a tournament tree to merge the nPma PMAs starting at aPma.
+*/
+static int vdbeSorterMergeInit(
+  VdbeSorter *pSorter,            /* Sorter object */
+  const SorterPma *aPma,          /* PMAs to merge */
+  int nPma                        /* Number of entries in aPma[] */
+){
+  int rc = SQLITE_OK;
+  int nTree;
+  int nByte;
+  int i;
+
+  assert( nPma>0 && nPma<=SORTER_MAX_MERGE_COUNT );
+  assert( pSorter->aIter==0 );
+  for(nTree=2; nTree<nPma; nTree+=nTree);
+  nByte = nTree * (sizeof(int)+sizeof(VdbeSorterIter));
+  pSorter->aIter = (VdbeSorterIter*)sqlite3MallocZero(nByte);
+  if( pSorter->aIter==0 ) return SQLITE_NOMEM;
+  pSorter->aTree = (int*)&pSorter->aIter[nTree];
+  pSorter->nTree = nTree;
+
+  for(i=0; i<nPma && rc==SQLITE_OK; i++){
+    rc = vdbeSorterIterInit(pSorter, &aPma[i], &pSorter->aIter[i]);
+  }
+  for(i=nTree-1; rc==SQLITE_OK && i>0; i--){
+    vdbeSorterDoCompare(pSorter, i);
+  }
+  return rc;
+}
+
+/*
+** Advance the merge to its next key. Set *pbEof to true if there are
+** no more keys.
+*/
+static int vdbeSorterMergeNext(VdbeSorter *pSorter, int *pbEof){
+  int iPrev = pSorter->aTree[1];
+  int i;
+  int rc;
+
+  rc = vdbeSorterIterNext(&pSorter->aIter[iPrev]);
+  for(i=(pSorter->nTree+iPrev)/2; rc==SQLITE_OK && i>0; i=i/2){
+    vdbeSorterDoCompare(pSorter, i);
+  }
+  *pbEof = (pSorter->aIter[pSorter->aTree[1]].aKey==0);
+  return rc;
+}
+
+/*
+** Merge groups of SORTER_MAX_MERGE_COUNT PMAs into longer PMAs until no
+** more than SORTER_MAX_MERGE_COUNT remain.
+*/
+static int vdbeSorterMergePasses(VdbeSorter *pSorter){
+  int rc = SQLITE_OK;
+
+  while( rc==SQLITE_OK && pSorter->nPma>SORTER_MAX_MERGE_COUNT ){
+    sqlite3_file *pOut = 0;       /* File written by this pass */
+    i64 iWriteOff = 0;            /* Current size of pOut */
+    int nOut = 0;                 /* Number of PMAs written by this pass */
+    int i;
+
+    /* The output of the pass before last is no longer needed. Reuse it
+    ** for this pass if it exists. */
+    if( pSorter->pMerge2 ){
+      pOut = pSorter->pMerge2;
+      pSorter->pMerge2 = 0;
+    }else{
+      rc = vdbeSorterOpenTempFile(pSorter->pVfs, &pOut);
+    }
+
+    for(i=0; rc==SQLITE_OK && i<pSorter->nPma; i+=SORTER_MAX_MERGE_COUNT){
+      FileWriter writer;
+      int nMerge = pSorter->nPma - i;
+      int bEof = 0;
+      if( nMerge>SORTER_MAX_MERGE_COUNT ) nMerge = SORTER_MAX_MERGE_COUNT;
+
+      rc = vdbeSorterMergeInit(pSorter, &pSorter->aPma[i], nMerge);
+      fileWriterInit(pOut, &writer, pSorter->nBuffer, iWriteOff);
+      while( rc==SQLITE_OK && bEof==0 ){
+        VdbeSorterIter *pIter = &pSorter->aIter[pSorter->aTree[1]];
+        fileWriterWriteVarint(&writer, pIter->nKey);
+        fileWriterWrite(&writer, pIter->aKey, pIter->nKey);
+        rc = vdbeSorterMergeNext(pSorter, &bEof);
+      }
+      vdbeSorterMergeFree(pSorter);
+      if( rc==SQLITE_OK ){
+        /* aPma[nOut] is never past aPma[i], so it can be overwritten. */
+        pSorter->aPma[nOut].pFile = pOut;
+        pSorter->aPma[nOut].iStart = iWriteOff;
+        rc = fileWriterFinish(&writer, &iWriteOff);
+        pSorter->aPma[nOut].iEof = iWriteOff;
+        nOut++;
+      }else{
+        fileWriterFinish(&writer, &iWriteOff);
+      }
+    }
+
+    if( rc==SQLITE_OK ){
+      /* The PMAs written by the tasks are only read by the first pass. */
+      for(i=0; i<pSorter->nTask; i++){
+        SorterTask *pTask = &pSorter->aTask[i];
+        if( pTask->pFile ){
+          sqlite3OsCloseFree(pTask->pFile);
+          pTask->pFile = 0;
+        }
+      }
+      pSorter->nPma = nOut;
+    }
+    pSorter->pMerge2 = pSorter->pMerge;
+    pSorter->pMerge = pOut;
+  }
+
+  return rc;
+}
+
+/*
+** Once the sorter has been populated, this function is called to prepare
+** for iterating through its contents in sorted order.
+*/
+int sqlite3VdbeSorterRewind(sqlite3 *db, VdbeCursor *pCsr, int *pbEof){
+  VdbeSorter *pSorter = pCsr->pSorter;
+  int rc;
+
+  assert( pSorter );
+
+  /* If no data has been written to disk, then do not do so now. Instead,
+  ** sort the in-memory list.
+  */
+  if( pSorter->bSpilled==0 ){
+    SorterTask *pTask = &pSorter->aTask[0];
+    assert( pTask->pList==0 );
+    pTask->pList = pSorter->pRecord;
+    vdbeSorterSort(pTask);
+    pSorter->pRecord = pTask->pList;
+    pTask->pList = 0;
+    *pbEof = !pSorter->pRecord;
+    return SQLITE_OK;
+  }
+
+  /* Write the current in-memory list to a PMA, then wait for all tasks
+  ** to finish. */
+  rc = SQLITE_OK;
+  if( pSorter->pRecord ){
+    rc = vdbeSorterFlushPMA(pSorter);
+  }
+  if( rc==SQLITE_OK ){
+    rc = vdbeSorterJoinAll(pSorter);
+  }
+  if( rc==SQLITE_OK ){
+    rc = vdbeSorterMergePasses(pSorter);
+  }
+  if( rc==SQLITE_OK ){
+    rc = vdbeSorterMergeInit(pSorter, pSorter->aPma, pSorter->nPma);
+  }
+  if( rc==SQLITE_OK ){
+    *pbEof = (pSorter->aIter[pSorter->aTree[1]].aKey==0);
+  }else if( rc==SQLITE_NOMEM ){
+    db->mallocFailed = 1;
+  }
+  return rc;
+}
+
+/*
+** Advance to the next element in the sorter.
+*/
+int sqlite3VdbeSorterNext(sqlite3 *db, VdbeCursor *pCsr, int *pbEof){
+  VdbeSorter *pSorter = pCsr->pSorter;
+  int rc = SQLITE_OK;
+
+  if( pSorter->aTree ){
+    rc = vdbeSorterMergeNext(pSorter, pbEof);
+    if( rc==SQLITE_NOMEM ) db->mallocFailed = 1;
+  }else{
+    SorterRecord *pFree = pSorter->pRecord;
+    pSorter->pRecord = pFree->pNext;
+    pFree->pNext = 0;
+    vdbeSorterRecordFree(pFree);
+    *pbEof = !pSorter->pRecord;
+  }
+  return rc;
+}
+
+/*
+** Return a pointer to a buffer owned by the sorter that contains the
+** current key.
+*/
+static void *vdbeSorterRowkey(
+  VdbeSorter *pSorter,            /* Sorter object */
+  int *pnKey                      /* OUT: Size of current key in bytes */
+){
+  void *pKey;
+  if( pSorter->aTree ){
+    VdbeSorterIter *pIter;
+    pIter = &pSorter->aIter[ pSorter->aTree[1] ];
+    *pnKey = pIter->nKey;
+    pKey = pIter->aKey;
+  }else{
+    *pnKey = pSorter->pRecord->nVal;
+    pKey = pSorter->pRecord->pVal;
+  }
+  return pKey;
+}
+
+/*
+** Copy the current sorter key into the memory cell pOut.
+*/
+int sqlite3VdbeSorterRowkey(VdbeCursor *pCsr, Mem *pOut){
+  VdbeSorter *pSorter = pCsr->pSorter;
+  void *pKey; int nKey;           /* Sorter key to copy into pOut */
+
+  pKey = vdbeSorterRowkey(pSorter, &nKey);
+  if( sqlite3VdbeMemGrow(pOut, nKey, 0) ){
+    return SQLITE_NOMEM;
+  }
+  pOut->n = nKey;
+  MemSetTypeFlag(pOut, MEM_Blob);
+  memcpy(pOut->z, pKey, nKey);
+
+  return SQLITE_OK;
+}
+
+/*
+** Compare the key in memory cell pVal with the key that the sorter cursor
+** passed as the first argument currently points to. For the purposes of
+** the comparison, ignore the rowid field at the end of each record.
+**
+** If an error occurs, return an SQLite error code (i.e. SQLITE_NOMEM).
+** Otherwise, set *pRes to a negative, zero or positive value if the
+** key in pVal is smaller than, equal to or larger than the current sorter
+** key.
+*/
+int sqlite3VdbeSorterCompare(
+  VdbeCursor *pCsr,               /* Sorter cursor */
+  Mem *pVal,                      /* Value to compare to current sorter key */
+  int *pRes                       /* OUT: Result of comparison */
+){
+  VdbeSorter *pSorter = pCsr->pSorter;
+  void *pKey; int nKey;           /* Sorter key to compare pVal with */
+  int bCached = 0;
+
+  pKey = vdbeSorterRowkey(pSorter, &nKey);
+  *pRes = vdbeSorterCompare(pSorter->pKeyInfo, pSorter->pUnpacked,
+      pSorter->szUnpacked, &bCached, 1, pVal->z, pVal->n, pKey, nKey
+  );
+  return SQLITE_OK;
+}
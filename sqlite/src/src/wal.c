@@ -253,6 +253,19 @@ int sqlite3WalTrace = 0;
 # define WALTRACE(X)
 #endif
 
+/*
+** The following counters are incremented by the reader page-to-frame
+** cache and by checkpoints, so that the test scripts can check that
+** these optimizations are in use.
+*/
+#ifdef SQLITE_TEST
+int sqlite3_wal_framecache_hit = 0;   /* Lookups answered from the cache */
+int sqlite3_wal_ckptwrite_count = 0;  /* Writes made by checkpoints */
+# define WAL_INCR(x) x++
+#else
+# define WAL_INCR(x)
+#endif
+
 /*
 ** The maximum (and only) versions of the wal and wal-index formats
 ** that may be interpreted by this version of SQLite.
@@ -403,6 +416,39 @@ struct WalCkptInfo {
   WAL_HDRSIZE + ((iFrame)-1)*(i64)((szPage)+WAL_FRAME_HDRSIZE)         \
 )
 
+/*
+** Number of entries in the per-connection cache of page lookups used
+** by sqlite3WalFindFrame(). This must be a power of two.
+*/
+#ifndef WAL_FRAMECACHE_NSLOT
+# define WAL_FRAMECACHE_NSLOT 64
+#endif
+
+/*
+** Maximum number of consecutive database pages written by a single call
+** to sqlite3OsWrite() during a checkpoint.
+*/
+#ifndef WAL_CKPT_NBATCH
+# define WAL_CKPT_NBATCH 16
+#endif
+
+/*
+** A cache of the results of recent sqlite3WalFindFrame() calls. Entry i
+** records that page aPgno[i] is found in frame aFrame[i] of the WAL, or
+** not in the WAL at all if aFrame[i] is zero. The results are valid for
+** the WAL content identified by mxFrame and aFrameCksum only. Since the
+** running frame checksum covers the salt values and every frame up to
+** mxFrame, any change to the log, including a rollback or a restart,
+** changes one of them and invalidates the cache.
+*/
+typedef struct WalFrameCache WalFrameCache;
+struct WalFrameCache {
+  u32 mxFrame;                     /* Value of hdr.mxFrame for this content */
+  u32 aFrameCksum[2];              /* Value of hdr.aFrameCksum likewise */
+  u32 aPgno[WAL_FRAMECACHE_NSLOT];  /* Page number, or zero for a free slot */
+  u32 aFrame[WAL_FRAMECACHE_NSLOT]; /* Frame containing aPgno[i], or zero */
+};
+
 /*
 ** An open write-ahead log file is represented by an instance of the
 ** following object.
@@ -423,6 +469,7 @@ struct Wal {
   WalIndexHdr hdr;           /* Wal-index header for current transaction */
   const char *zWalName;      /* Name of WAL file */
   u32 nCkpt;                 /* Checkpoint sequence counter in the wal-header */
+  WalFrameCache cache;       /* Results of recent sqlite3WalFindFrame() calls */
 #ifdef SQLITE_DEBUG
   u8 lockError;              /* True if a locking error has occurred */
 #endif
@@ -1586,6 +1633,19 @@ static int walPagesize(Wal *pWal){
   return (pWal->hdr.szPage&0xfe00) + ((pWal->hdr.szPage&0x0001)<<16);
 }
 
+/*
+** Write the nPage consecutive database pages in buffer aBuf to the
+** database file, starting at page iFirst. This is called by
+** walCheckpoint() to write a batch of pages copied from the WAL.
+*/
+static int walCheckpointWrite(Wal *pWal, u8 *aBuf, int nPage, u32 iFirst){
+  int szPage = walPagesize(pWal);
+  i64 iOffset = (iFirst-1)*(i64)szPage;
+  testcase( IS_BIG_INT(iOffset) );
+  WAL_INCR(sqlite3_wal_ckptwrite_count);
+  return sqlite3OsWrite(pWal->pDbFd, aBuf, nPage*szPage, iOffset);
+}
+
 /*
 ** Copy as much content as we can from the WAL back into the database file
 ** in response to an sqlite3_wal_checkpoint() request or the equivalent.
@@ -1635,6 +1695,10 @@ static int walCheckpoint(
   int i;                          /* Loop counter */
   volatile WalCkptInfo *pInfo;    /* The checkpoint status information */
   int (*xBusy)(void*) = 0;        /* Function to call when waiting for locks */
+  u8 *aBatch = 0;                 /* Buffer for up to WAL_CKPT_NBATCH pages */
+  int mxBatch;                    /* Capacity of aBatch[] in pages */
+  int nBatch = 0;                 /* Number of pages currently in aBatch[] */
+  u32 iFirst = 0;                 /* Database page of the first in aBatch[] */
 
   szPage = walPagesize(pWal);
   testcase( szPage<=32768 );
@@ -1697,20 +1761,39 @@ static int walCheckpoint(
       }
     }
 
-    /* Iterate through the contents of the WAL, copying data to the db file. */
+    /* Allocate a buffer large enough for WAL_CKPT_NBATCH pages. If this
+    ** fails, fall back to writing one page at a time from zBuf. */
+    sqlite3BeginBenignMalloc();
+    aBatch = (u8*)sqlite3Malloc(szPage*WAL_CKPT_NBATCH);
+    sqlite3EndBenignMalloc();
+    mxBatch = aBatch ? WAL_CKPT_NBATCH : 1;
+
+    /* Iterate through the contents of the WAL, copying data to the db file.
+    ** The iterator visits pages in ascending order, so runs of consecutive
+    ** database pages are gathered in the buffer and written to the
+    ** database file with a single call to sqlite3OsWrite(). */
     while( rc==SQLITE_OK && 0==walIteratorNext(pIter, &iDbpage, &iFrame) ){
       i64 iOffset;
       assert( walFramePgno(pWal, iFrame)==iDbpage );
       if( iFrame<=nBackfill || iFrame>mxSafeFrame || iDbpage>mxPage ) continue;
+      if( nBatch>0 && (nBatch==mxBatch || iDbpage!=iFirst+nBatch) ){
+        rc = walCheckpointWrite(pWal, aBatch?aBatch:zBuf, nBatch, iFirst);
+        nBatch = 0;
+        if( rc!=SQLITE_OK ) break;
+      }
+      if( nBatch==0 ) iFirst = iDbpage;
       iOffset = walFrameOffset(iFrame, szPage) + WAL_FRAME_HDRSIZE;
       /* testcase( IS_BIG_INT(iOffset) ); // requires a 4GiB WAL file */
-      rc = sqlite3OsRead(pWal->pWalFd, zBuf, szPage, iOffset);
-      if( rc!=SQLITE_OK ) break;
-      iOffset = (iDbpage-1)*(i64)szPage;
-      testcase( IS_BIG_INT(iOffset) );
-      rc = sqlite3OsWrite(pWal->pDbFd, zBuf, szPage, iOffset);
+      rc = sqlite3OsRead(pWal->pWalFd, 
+          (aBatch ? &aBatch[nBatch*szPage] : zBuf), szPage, iOffset
+      );
       if( rc!=SQLITE_OK ) break;
+      nBatch++;
+    }
+    if( rc==SQLITE_OK && nBatch>0 ){
+      rc = walCheckpointWrite(pWal, aBatch?aBatch:zBuf, nBatch, iFirst);
     }
+    sqlite3_free(aBatch);
 
     /* If work was actually accomplished... */
     if( rc==SQLITE_OK ){
@@ -1849,6 +1932,9 @@ static int walIndexTryHdr(Wal *pWal, int *pChanged){
   if( memcmp(&h1, &h2, sizeof(h1))!=0 ){
     return 1;   /* Dirty read */
   }  
+  if( memcmp(&pWal->hdr, &h1, sizeof(WalIndexHdr))==0 && h1.isInit ){
+    return 0;   /* Unchanged since the checksum was last verified */
+  }
   if( h1.isInit==0 ){
     return 1;   /* Malformed header - probably all zeros */
   }
@@ -2205,23 +2291,23 @@ void sqlite3WalEndReadTransaction(Wal *pWal){
 }
 
 /*
-** Read a page from the WAL, if it is present in the WAL and if the 
-** current read transaction is configured to use the WAL.  
+** Search the wal file for page pgno. If found, set *piRead to the frame that
+** contains the page. Otherwise, if pgno is not in the wal file, set *piRead
+** to zero.
 **
-** The *pInWal is set to 1 if the requested page is in the WAL and
-** has been loaded.  Or *pInWal is set to 0 if the page was not in 
-** the WAL and needs to be read out of the database.
+** Return SQLITE_OK if successful, or an error code if an error occurs. If an
+** error does occur, the final value of *piRead is undefined.
 */
-int sqlite3WalRead(
+int sqlite3WalFindFrame(
   Wal *pWal,                      /* WAL handle */
   Pgno pgno,                      /* Database page number to read data for */
-  int *pInWal,                    /* OUT: True if data is read from WAL */
-  int nOut,                       /* Size of buffer pOut in bytes */
-  u8 *pOut                        /* Buffer to write page data to */
+  u32 *piRead                     /* OUT: Frame number (or zero) */
 ){
   u32 iRead = 0;                  /* If !=0, WAL frame to return data from */
   u32 iLast = pWal->hdr.mxFrame;  /* Last page in WAL for this reader */
   int iHash;                      /* Used to loop through N hash tables */
+  WalFrameCache *pCache;          /* Cache of recent lookups */
+  int iSlot;                      /* Slot in pCache for page pgno */
 
   /* This routine is only be called from within a read transaction. */
   assert( pWal->readLock>=0 || pWal->lockError );
@@ -2233,7 +2319,25 @@ int sqlite3WalRead(
   ** WAL were empty.
   */
   if( iLast==0 || pWal->readLock==0 ){
-    *pInWal = 0;
+    *piRead = 0;
+    return SQLITE_OK;
+  }
+
+  /* Check the cache of recent lookups. If the WAL content has changed
+  ** since the cache was filled, empty it first.  */
+  pCache = &pWal->cache;
+  iSlot = pgno & (WAL_FRAMECACHE_NSLOT-1);
+  if( pCache->mxFrame!=iLast
+   || pCache->aFrameCksum[0]!=pWal->hdr.aFrameCksum[0]
+   || pCache->aFrameCksum[1]!=pWal->hdr.aFrameCksum[1]
+  ){
+    memset(pCache->aPgno, 0, sizeof(pCache->aPgno));
+    pCache->mxFrame = iLast;
+    pCache->aFrameCksum[0] = pWal->hdr.aFrameCksum[0];
+    pCache->aFrameCksum[1] = pWal->hdr.aFrameCksum[1];
+  }else if( pCache->aPgno[iSlot]==pgno ){
+    WAL_INCR(sqlite3_wal_framecache_hit);
+    *piRead = pCache->aFrame[iSlot];
     return SQLITE_OK;
   }
 
@@ -2304,26 +2408,34 @@ int sqlite3WalRead(
   }
 #endif
 
-  /* If iRead is non-zero, then it is the log frame number that contains the
-  ** required page. Read and return data from the log file.
-  */
-  if( iRead ){
-    int sz;
-    i64 iOffset;
-    sz = pWal->hdr.szPage;
-    sz = (pWal->hdr.szPage&0xfe00) + ((pWal->hdr.szPage&0x0001)<<16);
-    testcase( sz<=32768 );
-    testcase( sz>=65536 );
-    iOffset = walFrameOffset(iRead, sz) + WAL_FRAME_HDRSIZE;
-    *pInWal = 1;
-    /* testcase( IS_BIG_INT(iOffset) ); // requires a 4GiB WAL */
-    return sqlite3OsRead(pWal->pWalFd, pOut, nOut, iOffset);
-  }
-
-  *pInWal = 0;
+  pCache->aPgno[iSlot] = pgno;
+  pCache->aFrame[iSlot] = iRead;
+  *piRead = iRead;
   return SQLITE_OK;
 }
 
+/*
+** Read the contents of frame iRead from the wal file into buffer pOut
+** (which is nOut bytes in size). Return SQLITE_OK if successful, or an
+** error code otherwise.
+*/
+int sqlite3WalReadFrame(
+  Wal *pWal,                      /* WAL handle */
+  u32 iRead,                      /* Frame to read */
+  int nOut,                       /* Size of buffer pOut in bytes */
+  u8 *pOut                        /* Buffer to write page data to */
+){
+  int sz;
+  i64 iOffset;
+  sz = pWal->hdr.szPage;
+  sz = (pWal->hdr.szPage&0xfe00) + ((pWal->hdr.szPage&0x0001)<<16);
+  testcase( sz<=32768 );
+  testcase( sz>=65536 );
+  iOffset = walFrameOffset(iRead, sz) + WAL_FRAME_HDRSIZE;
+  /* testcase( IS_BIG_INT(iOffset) ); // requires a 4GiB WAL */
+  return sqlite3OsRead(pWal->pWalFd, pOut, nOut, iOffset);
+}
+
 
 /* 
 ** Return the size of the database in pages (or zero, if unknown).
@@ -118,10 +118,10 @@ struct WhereTerm {
 #define TERM_ORINFO     0x10   /* Need to free the WhereTerm.u.pOrInfo object */
 #define TERM_ANDINFO    0x20   /* Need to free the WhereTerm.u.pAndInfo obj */
 #define TERM_OR_OK      0x40   /* Used during OR-clause processing */
-#ifdef SQLITE_ENABLE_STAT2
+#if defined(SQLITE_ENABLE_STAT2) || defined(SQLITE_ENABLE_STAT3)
 #  define TERM_VNULL    0x80   /* Manufactured x>NULL or x<=NULL term */
 #else
-#  define TERM_VNULL    0x00   /* Disabled if not using stat2 */
+#  define TERM_VNULL    0x00   /* Disabled if not using stat2 or stat3 */
 #endif
 
 /*
@@ -253,6 +253,7 @@ struct WhereCost {
 #define WHERE_VIRTUALTABLE 0x08000000  /* Use virtual-table processing */
 #define WHERE_MULTI_OR     0x10000000  /* OR using multiple indices */
 #define WHERE_TEMP_INDEX   0x20000000  /* Uses an ephemeral index */
+#define WHERE_SKIPSCAN     0x40000000  /* Loop over values of 1st index col */
 
 /*
 ** Initialize a preallocated WhereClause structure.
@@ -1331,11 +1332,11 @@ static void exprAnalyze(
   }
 #endif /* SQLITE_OMIT_VIRTUALTABLE */
 
-#ifdef SQLITE_ENABLE_STAT2
-  /* When sqlite_stat2 histogram data is available an operator of the
-  ** form "x IS NOT NULL" can sometimes be evaluated more efficiently
-  ** as "x>NULL" if x is not an INTEGER PRIMARY KEY.  So construct a
-  ** virtual term of that form.
+#if defined(SQLITE_ENABLE_STAT2) || defined(SQLITE_ENABLE_STAT3)
+  /* When sqlite_stat2 or sqlite_stat3 histogram data is available an
+  ** operator of the form "x IS NOT NULL" can sometimes be evaluated more
+  ** efficiently as "x>NULL" if x is not an INTEGER PRIMARY KEY.  So
+  ** construct a virtual term of that form.
   **
   ** Note that the virtual term must be tagged with TERM_VNULL.  This
   ** TERM_VNULL tag will suppress the not-null check at the beginning
@@ -1370,7 +1371,7 @@ static void exprAnalyze(
       pNewTerm->prereqAll = pTerm->prereqAll;
     }
   }
-#endif /* SQLITE_ENABLE_STAT2 */
+#endif /* SQLITE_ENABLE_STAT2 || SQLITE_ENABLE_STAT3 */
 
   /* Prevent ON clause terms of a LEFT JOIN from being used to drive
   ** an index for tables to the left of the join.
@@ -2363,6 +2364,167 @@ static int whereRangeRegion(
 }
 #endif   /* #ifdef SQLITE_ENABLE_STAT2 */
 
+#ifdef SQLITE_ENABLE_STAT3
+/*
+** Argument pIdx is a pointer to an index structure that has an array of
+** pIdx->nSample samples of the first indexed column, in order of
+** increasing key, loaded from the sqlite_stat3 table. Each sample records
+** the number of rows in the index with the same key (nEq), with smaller
+** keys (nLt) and the number of distinct smaller keys (nDLt).
+**
+** This function estimates where value pVal lies among all keys in the
+** index and writes the result into aStat[] as follows:
+**
+**    aStat[0]      Est. number of rows less than pVal
+**    aStat[1]      Est. number of rows equal to pVal
+**
+** If pVal is equal to one of the samples, the counts for that sample are
+** exact. Otherwise pVal lies in the gap between two adjacent samples (or
+** before the first or after the last). In that case aStat[0] is
+** interpolated to a point one third of the way into the gap if roundUp is
+** false, or two thirds of the way if roundUp is true, and aStat[1] is set
+** to Index.avgEq, the average number of rows for keys that are not samples.
+**
+** SQLITE_OK is returned if successful. Or, if a collation sequence cannot
+** be found, or an OOM occurs while converting text values between
+** encodings, an error code is returned and aStat[] is undefined.
+*/
+static int whereKeyStats(
+  Parse *pParse,              /* Database connection */
+  Index *pIdx,                /* Index to consider domain of */
+  sqlite3_value *pVal,        /* Value to consider */
+  int roundUp,                /* Round up if true.  Round down if false */
+  i64 *aStat                  /* OUT: stats written here */
+){
+  IndexSample *aSample = pIdx->aSample;
+  int nSample = pIdx->nSample;
+  int i = 0;
+  int isEq = 0;
+  int eType = sqlite3_value_type(pVal);
+
+  assert( roundUp==0 || roundUp==1 );
+  assert( nSample>0 );
+  if( eType==SQLITE_INTEGER ){
+    i64 v = sqlite3_value_int64(pVal);
+    double r = (double)v;
+    for(i=0; i<nSample; i++){
+      if( aSample[i].eType==SQLITE_NULL ) continue;
+      if( aSample[i].eType>=SQLITE_TEXT ) break;
+      if( aSample[i].eType==SQLITE_INTEGER ){
+        if( aSample[i].u.i>=v ){
+          isEq = aSample[i].u.i==v;
+          break;
+        }
+      }else if( aSample[i].u.r>=r ){
+        isEq = aSample[i].u.r==r;
+        break;
+      }
+    }
+  }else if( eType==SQLITE_FLOAT ){
+    double r = sqlite3_value_double(pVal);
+    for(i=0; i<nSample; i++){
+      double rS;
+      if( aSample[i].eType==SQLITE_NULL ) continue;
+      if( aSample[i].eType>=SQLITE_TEXT ) break;
+      if( aSample[i].eType==SQLITE_INTEGER ){
+        rS = (double)aSample[i].u.i;
+      }else{
+        rS = aSample[i].u.r;
+      }
+      if( rS>=r ){
+        isEq = rS==r;
+        break;
+      }
+    }
+  }else if( eType==SQLITE_NULL ){
+    i = 0;
+    isEq = aSample[0].eType==SQLITE_NULL;
+  }else{
+    sqlite3 *db = pParse->db;
+    CollSeq *pColl;
+    const u8 *z;
+    int n;
+
+    /* pVal comes from sqlite3ValueFromExpr() so the type cannot be NULL */
+    assert( eType==SQLITE_TEXT || eType==SQLITE_BLOB );
+
+    if( eType==SQLITE_BLOB ){
+      z = (const u8 *)sqlite3_value_blob(pVal);
+      pColl = db->pDfltColl;
+      assert( pColl->enc==SQLITE_UTF8 );
+    }else{
+      pColl = sqlite3GetCollSeq(db, SQLITE_UTF8, 0, *pIdx->azColl);
+      if( pColl==0 ){
+        sqlite3ErrorMsg(pParse, "no such collation sequence: %s",
+                        *pIdx->azColl);
+        return SQLITE_ERROR;
+      }
+      z = (const u8 *)sqlite3ValueText(pVal, pColl->enc);
+      if( !z ){
+        return SQLITE_NOMEM;
+      }
+      assert( z && pColl && pColl->xCmp );
+    }
+    n = sqlite3ValueBytes(pVal, pColl->enc);
+
+    for(i=0; i<nSample; i++){
+      int c;
+      int eSampletype = aSample[i].eType;
+      if( eSampletype==SQLITE_NULL || eSampletype<eType ) continue;
+      if( eSampletype!=eType ) break;
+#ifndef SQLITE_OMIT_UTF16
+      if( pColl->enc!=SQLITE_UTF8 ){
+        int nByte;
+        char *zSample = sqlite3Utf8to16(
+            db, pColl->enc, aSample[i].u.z, aSample[i].nByte, &nByte
+        );
+        if( !zSample ){
+          assert( db->mallocFailed );
+          return SQLITE_NOMEM;
+        }
+        c = pColl->xCmp(pColl->pUser, nByte, zSample, n, z);
+        sqlite3DbFree(db, zSample);
+      }else
+#endif
+      {
+        c = pColl->xCmp(pColl->pUser, aSample[i].nByte, aSample[i].u.z, n, z);
+      }
+      if( c>=0 ){
+        isEq = c==0;
+        break;
+      }
+    }
+  }
+
+  /* At this point, aSample[i] is the first sample that is greater than
+  ** or equal to pVal. Or if i==nSample, then all samples are less than
+  ** pVal. If aSample[i] is equal to pVal, then isEq is true.  */
+  if( isEq ){
+    assert( i<nSample );
+    aStat[0] = aSample[i].nLt;
+    aStat[1] = aSample[i].nEq;
+  }else{
+    i64 iLower, iUpper, iGap;
+    if( i==0 ){
+      iLower = 0;
+      iUpper = aSample[0].nLt;
+    }else{
+      iLower = (i64)aSample[i-1].nEq + aSample[i-1].nLt;
+      iUpper = i>=nSample ? (i64)pIdx->aiRowEst[0] : (i64)aSample[i].nLt;
+    }
+    iGap = iUpper>iLower ? iUpper - iLower : 0;
+    if( roundUp ){
+      iGap = (iGap*2)/3;
+    }else{
+      iGap = iGap/3;
+    }
+    aStat[0] = iLower + iGap;
+    aStat[1] = pIdx->avgEq;
+  }
+  return SQLITE_OK;
+}
+#endif   /* #ifdef SQLITE_ENABLE_STAT3 */
+
 /*
 ** If expression pExpr represents a literal value, set *pp to point to
 ** an sqlite3_value structure containing the same value, with affinity
@@ -2379,7 +2541,7 @@ static int whereRangeRegion(
 **
 ** If an error occurs, return an error code. Otherwise, SQLITE_OK.
 */
-#ifdef SQLITE_ENABLE_STAT2
+#if defined(SQLITE_ENABLE_STAT2) || defined(SQLITE_ENABLE_STAT3)
 static int valueFromExpr(
   Parse *pParse, 
   Expr *pExpr, 
@@ -2427,17 +2589,19 @@ static int valueFromExpr(
 **
 ** then nEq should be passed 0.
 **
-** The returned value is an integer between 1 and 100, inclusive. A return
-** value of 1 indicates that the proposed range scan is expected to visit
-** approximately 1/100th (1%) of the rows selected by the nEq equality
-** constraints (if any). A return value of 100 indicates that it is expected
-** that the range scan will visit every row (100%) selected by the equality
-** constraints.
-**
-** In the absence of sqlite_stat2 ANALYZE data, each range inequality
-** reduces the search space by 3/4ths.  Hence a single constraint (x>?)
-** results in a return of 25 and a range constraint (x>? AND x<?) results
-** in a return of 6.
+** The value returned in *pEst is a percentage greater than 0 and no
+** larger than 100. A value of 1 indicates that the proposed range scan is
+** expected to visit approximately 1/100th (1%) of the rows selected by the
+** nEq equality constraints (if any). A value of 100 indicates that it is
+** expected that the range scan will visit every row (100%) selected by the
+** equality constraints. With sqlite_stat2 data, or with no data, the
+** value is always an integer. With sqlite_stat3 data it may be a fraction
+** of 1%, as the samples record row counts, not just key positions.
+**
+** In the absence of sqlite_stat2 or sqlite_stat3 ANALYZE data, each range
+** inequality reduces the search space by 3/4ths.  Hence a single
+** constraint (x>?) results in a return of 25 and a range constraint
+** (x>? AND x<?) results in a return of 6.
 */
 static int whereRangeScanEst(
   Parse *pParse,       /* Parsing & code generating context */
@@ -2445,16 +2609,77 @@ static int whereRangeScanEst(
   int nEq,             /* index into p->aCol[] of the range-compared column */
   WhereTerm *pLower,   /* Lower bound on the range. ex: "x>123" Might be NULL */
   WhereTerm *pUpper,   /* Upper bound on the range. ex: "x<455" Might be NULL */
-  int *piEst           /* OUT: Return value */
+  double *pEst         /* OUT: Return value */
 ){
   int rc = SQLITE_OK;
+  int iEst;
+
+#ifdef SQLITE_ENABLE_STAT3
 
+  if( nEq==0 && p->nSample && p->aiRowEst[0]>0 ){
+    sqlite3_value *pRangeVal;
+    i64 nTotal = p->aiRowEst[0];
+    i64 iLower = 0;              /* Est. rows less than the lower bound */
+    i64 iUpper = nTotal;         /* Est. rows less than the upper bound */
+    i64 a[2];                    /* Output of whereKeyStats() */
+    int nUnknown = 0;            /* Bounds whose value is not known */
+    u8 aff = p->pTable->aCol[p->aiColumn[0]].affinity;
+
+    if( pLower ){
+      Expr *pExpr = pLower->pExpr->pRight;
+      pRangeVal = 0;
+      rc = valueFromExpr(pParse, pExpr, aff, &pRangeVal);
+      assert( pLower->eOperator==WO_GT || pLower->eOperator==WO_GE );
+      if( rc==SQLITE_OK && pRangeVal ){
+        rc = whereKeyStats(pParse, p, pRangeVal, 0, a);
+        iLower = a[0];
+        if( pLower->eOperator==WO_GT ) iLower += a[1];
+      }else if( (pLower->wtFlags & TERM_VNULL)==0 ){
+        nUnknown++;
+      }
+      sqlite3ValueFree(pRangeVal);
+    }
+    if( rc==SQLITE_OK && pUpper ){
+      Expr *pExpr = pUpper->pExpr->pRight;
+      pRangeVal = 0;
+      rc = valueFromExpr(pParse, pExpr, aff, &pRangeVal);
+      assert( pUpper->eOperator==WO_LT || pUpper->eOperator==WO_LE );
+      if( rc==SQLITE_OK && pRangeVal ){
+        rc = whereKeyStats(pParse, p, pRangeVal, 1, a);
+        iUpper = a[0];
+        if( pUpper->eOperator==WO_LE ) iUpper += a[1];
+      }else{
+        nUnknown++;
+      }
+      sqlite3ValueFree(pRangeVal);
+    }
+    if( rc==SQLITE_OK && nUnknown<(pLower!=0)+(pUpper!=0) ){
+      /* At least one bound was located using the samples. Each bound that
+      ** was not (a variable with no value bound to it, for example) is
+      ** assumed to exclude 3/4ths of the range, as if there were no data.
+      ** A range that is estimated to be empty is assumed to hold one row. */
+      double rEst;
+      if( iUpper>iLower ){
+        rEst = (100.0*(double)(iUpper - iLower))/(double)nTotal;
+      }else{
+        rEst = 100.0/(double)nTotal;
+      }
+      while( nUnknown-- ) rEst /= 4.0;
+      if( rEst>100.0 ) rEst = 100.0;
+      *pEst = rEst;
+      WHERETRACE(("range scan rows: %lld..%lld est=%g\n", iLower, iUpper, rEst));
+      return SQLITE_OK;
+    }
+    if( rc!=SQLITE_OK ){
+      return rc;
+    }
+  }
+#else
 #ifdef SQLITE_ENABLE_STAT2
 
   if( nEq==0 && p->aSample ){
     sqlite3_value *pLowerVal = 0;
     sqlite3_value *pUpperVal = 0;
-    int iEst;
     int iLower = 0;
     int iUpper = SQLITE_INDEX_SAMPLES;
     int roundUpUpper = 0;
@@ -2496,9 +2721,9 @@ static int whereRangeScanEst(
     testcase( iEst==SQLITE_INDEX_SAMPLES );
     assert( iEst<=SQLITE_INDEX_SAMPLES );
     if( iEst<1 ){
-      *piEst = 50/SQLITE_INDEX_SAMPLES;
+      *pEst = 50/SQLITE_INDEX_SAMPLES;
     }else{
-      *piEst = (iEst*100)/SQLITE_INDEX_SAMPLES;
+      *pEst = (iEst*100)/SQLITE_INDEX_SAMPLES;
     }
     sqlite3ValueFree(pLowerVal);
     sqlite3ValueFree(pUpperVal);
@@ -2510,21 +2735,23 @@ range_est_fallback:
   UNUSED_PARAMETER(p);
   UNUSED_PARAMETER(nEq);
 #endif
+#endif /* SQLITE_ENABLE_STAT3 */
   assert( pLower || pUpper );
-  *piEst = 100;
-  if( pLower && (pLower->wtFlags & TERM_VNULL)==0 ) *piEst /= 4;
-  if( pUpper ) *piEst /= 4;
+  iEst = 100;
+  if( pLower && (pLower->wtFlags & TERM_VNULL)==0 ) iEst /= 4;
+  if( pUpper ) iEst /= 4;
+  *pEst = iEst;
   return rc;
 }
 
-#ifdef SQLITE_ENABLE_STAT2
+#if defined(SQLITE_ENABLE_STAT2) || defined(SQLITE_ENABLE_STAT3)
 /*
 ** Estimate the number of rows that will be returned based on
 ** an equality constraint x=VALUE and where that VALUE occurs in
 ** the histogram data.  This only works when x is the left-most
-** column of an index and sqlite_stat2 histogram data is available
-** for that index.  When pExpr==NULL that means the constraint is
-** "x IS NULL" instead of "x=VALUE".
+** column of an index and sqlite_stat2 or sqlite_stat3 histogram data
+** is available for that index.  When pExpr==NULL that means the
+** constraint is "x IS NULL" instead of "x=VALUE".
 **
 ** Write the estimated row count into *pnRow and return SQLITE_OK. 
 ** If unable to make an estimate, leave *pnRow unchanged and return
@@ -2542,10 +2769,14 @@ static int whereEqualScanEst(
   double *pnRow        /* Write the revised row estimate here */
 ){
   sqlite3_value *pRhs = 0;  /* VALUE on right-hand side of pTerm */
+#ifdef SQLITE_ENABLE_STAT3
+  i64 a[2];                 /* Rows less than and equal to pRhs */
+#else
   int iLower, iUpper;       /* Range of histogram regions containing pRhs */
+  double nRowEst;           /* New estimate of the number of rows */
+#endif
   u8 aff;                   /* Column affinity */
   int rc;                   /* Subfunction return code */
-  double nRowEst;           /* New estimate of the number of rows */
 
   assert( p->aSample!=0 );
   aff = p->pTable->aCol[p->aiColumn[0]].affinity;
@@ -2556,6 +2787,12 @@ static int whereEqualScanEst(
     pRhs = sqlite3ValueNew(pParse->db);
   }
   if( pRhs==0 ) return SQLITE_NOTFOUND;
+#ifdef SQLITE_ENABLE_STAT3
+  rc = whereKeyStats(pParse, p, pRhs, 0, a);
+  if( rc ) goto whereEqualScanEst_cancel;
+  WHERETRACE(("equality scan rows: %lld\n", a[1]));
+  *pnRow = (double)a[1];
+#else
   rc = whereRangeRegion(pParse, p, pRhs, 0, &iLower);
   if( rc ) goto whereEqualScanEst_cancel;
   rc = whereRangeRegion(pParse, p, pRhs, 1, &iUpper);
@@ -2568,12 +2805,62 @@ static int whereEqualScanEst(
     nRowEst = (iUpper-iLower)*p->aiRowEst[0]/SQLITE_INDEX_SAMPLES;
     *pnRow = nRowEst;
   }
+#endif
 
 whereEqualScanEst_cancel:
   sqlite3ValueFree(pRhs);
   return rc;
 }
-#endif /* defined(SQLITE_ENABLE_STAT2) */
+#endif /* defined(SQLITE_ENABLE_STAT2) || defined(SQLITE_ENABLE_STAT3) */
+
+#ifdef SQLITE_ENABLE_STAT3
+/*
+** Estimate the number of rows that will be returned based on
+** an IN constraint where the right-hand side of the IN operator
+** is a list of values.  Example:
+**
+**        WHERE x IN (1,2,3,4)
+**
+** The estimate is the sum of the sqlite_stat3 estimates for each value in
+** the list, as computed by whereEqualScanEst(), but no more than the number
+** of rows in the index. Values that are not constants are assumed to
+** match the average number of rows per key from sqlite_stat1.
+**
+** Write the estimated row count into *pnRow and return SQLITE_OK. 
+** If unable to make an estimate, leave *pnRow unchanged and return
+** non-zero.
+**
+** This routine can fail if it is unable to load a collating sequence
+** required for string comparison, or if unable to allocate memory
+** for a UTF conversion required for comparison.  The error is stored
+** in the pParse structure.
+*/
+static int whereInScanEst(
+  Parse *pParse,       /* Parsing & code generating context */
+  Index *p,            /* The index whose left-most column is pTerm */
+  ExprList *pList,     /* The value list on the RHS of "x IN (v1,v2,v3,...)" */
+  double *pnRow        /* Write the revised row estimate here */
+){
+  int rc = SQLITE_OK;       /* Subfunction return code */
+  double nEst;              /* Number of rows for a single term */
+  double nRowEst = 0.0;     /* New estimate of the number of rows */
+  int i;                    /* Loop counter */
+
+  assert( p->aSample!=0 );
+  for(i=0; rc==SQLITE_OK && i<pList->nExpr; i++){
+    nEst = p->aiRowEst[1];
+    rc = whereEqualScanEst(pParse, p, pList->a[i].pExpr, &nEst);
+    if( rc==SQLITE_NOTFOUND ) rc = SQLITE_OK;
+    nRowEst += nEst;
+  }
+  if( rc==SQLITE_OK ){
+    if( nRowEst > p->aiRowEst[0] ) nRowEst = p->aiRowEst[0];
+    *pnRow = nRowEst;
+    WHERETRACE(("IN row estimate: est=%g\n", nRowEst));
+  }
+  return rc;
+}
+#endif /* defined(SQLITE_ENABLE_STAT3) */
 
 #ifdef SQLITE_ENABLE_STAT2
 /*
@@ -2789,6 +3076,21 @@ static void bestBtreeIndex(
     **    the sub-select is assumed to return 25 rows for the purposes of 
     **    determining nInMul.
     **
+    **  nSkip:
+    **    The number of leading index columns that are not constrained but
+    **    are counted in nEq anyway, because the index is to be used for a
+    **    skip-scan. For example, given an index on (a, b) and the WHERE
+    **    clause:
+    **
+    **      WHERE b = 5
+    **
+    **    SQLite may seek to each distinct value of column a in turn and
+    **    search for b=5 within it. This is only worthwhile if there are few
+    **    distinct values of a, so nSkip is 0 unless the sqlite_stat1 data
+    **    for the index says that each value of a matches at least 18 rows.
+    **    If nSkip is 1, nInMul is multiplied by the number of distinct values
+    **    of column a.
+    **
     **  bInEst:  
     **    Set to true if there was at least one "x IN (SELECT ...)" term used 
     **    in determining the value of nInMul.  Note that the RHS of the
@@ -2800,9 +3102,10 @@ static void bestBtreeIndex(
     **    value of 100 means the entire table is searched.  Range constraints
     **    might reduce this to a value less than 100 to indicate that only
     **    a fraction of the table needs searching.  In the absence of
-    **    sqlite_stat2 ANALYZE data, a single inequality reduces the search
-    **    space to 1/4rd its original size.  So an x>? constraint reduces
-    **    estBound to 25.  Two constraints (x>? AND x<?) reduce estBound to 6.
+    **    sqlite_stat2 or sqlite_stat3 ANALYZE data, a single inequality
+    **    reduces the search space to 1/4rd its original size.  So an x>?
+    **    constraint reduces estBound to 25.  Two constraints (x>? AND x<?)
+    **    reduce estBound to 6.
     **
     **  bSort:   
     **    Boolean. True if there is an ORDER BY clause that will require an 
@@ -2825,22 +3128,38 @@ static void bestBtreeIndex(
     **             SELECT a, b, c FROM tbl WHERE a = 1;
     */
     int nEq;                      /* Number of == or IN terms matching index */
+    int nSkip = 0;                /* Number of leading columns skipped */
     int bInEst = 0;               /* True if "x IN (SELECT...)" seen */
     int nInMul = 1;               /* Number of distinct equalities to lookup */
-    int estBound = 100;           /* Estimated reduction in search space */
+    double estBound = 100;        /* Estimated reduction in search space */
     int nBound = 0;               /* Number of range constraints seen */
     int bSort = 0;                /* True if external sort required */
     int bLookup = 0;              /* True if not a covering index */
     WhereTerm *pTerm;             /* A single term of the WHERE clause */
-#ifdef SQLITE_ENABLE_STAT2
+#if defined(SQLITE_ENABLE_STAT2) || defined(SQLITE_ENABLE_STAT3)
     WhereTerm *pFirstTerm = 0;    /* First term matching the index */
 #endif
 
-    /* Determine the values of nEq and nInMul */
+    /* Determine the values of nEq, nSkip and nInMul. The default
+    ** estimates set by sqlite3DefaultRowEst() are never more than 10 rows
+    ** per key, so a skip-scan is only considered for indexes that have
+    ** sqlite_stat1 data.  */
     for(nEq=0; nEq<pProbe->nColumn; nEq++){
       int j = pProbe->aiColumn[nEq];
       pTerm = findTerm(pWC, iCur, j, notReady, eqTermMask, pIdx);
-      if( pTerm==0 ) break;
+      if( pTerm==0 ){
+        if( nEq==0 && pIdx && pProbe->nColumn>1 && aiRowEst[1]>=18
+         && pProbe->bUnordered==0
+         && findTerm(pWC, iCur, j, notReady, WO_LT|WO_LE|WO_GT|WO_GE, pIdx)==0
+        ){
+          nSkip = 1;
+          nInMul = aiRowEst[0]/aiRowEst[1];
+          if( nInMul<1 ) nInMul = 1;
+          wsFlags |= WHERE_SKIPSCAN;
+          continue;
+        }
+        break;
+      }
       wsFlags |= (WHERE_COLUMN_EQ|WHERE_ROWID_EQ);
       if( pTerm->eOperator & WO_IN ){
         Expr *pExpr = pTerm->pExpr;
@@ -2856,7 +3175,7 @@ static void bestBtreeIndex(
       }else if( pTerm->eOperator & WO_ISNULL ){
         wsFlags |= WHERE_COLUMN_NULL;
       }
-#ifdef SQLITE_ENABLE_STAT2
+#if defined(SQLITE_ENABLE_STAT2) || defined(SQLITE_ENABLE_STAT3)
       if( nEq==0 && pProbe->aSample ) pFirstTerm = pTerm;
 #endif
       used |= pTerm->prereqRight;
@@ -2884,17 +3203,26 @@ static void bestBtreeIndex(
     }else if( pProbe->onError!=OE_None ){
       testcase( wsFlags & WHERE_COLUMN_IN );
       testcase( wsFlags & WHERE_COLUMN_NULL );
-      if( (wsFlags & (WHERE_COLUMN_IN|WHERE_COLUMN_NULL))==0 ){
+      testcase( wsFlags & WHERE_SKIPSCAN );
+      if( (wsFlags & (WHERE_COLUMN_IN|WHERE_COLUMN_NULL|WHERE_SKIPSCAN))==0 ){
         wsFlags |= WHERE_UNIQUE;
       }
     }
 
+    /* A skip-scan is only useful if there is a constraint on the column
+    ** that follows the skipped column.  */
+    if( nSkip && (wsFlags & (WHERE_COLUMN_EQ|WHERE_COLUMN_RANGE))==0 ){
+      nEq = nSkip = 0;
+      nInMul = 1;
+      wsFlags = 0;
+    }
+
     /* If there is an ORDER BY clause and the index being considered will
     ** naturally scan rows in the required order, set the appropriate flags
     ** in wsFlags. Otherwise, if there is an ORDER BY clause but the index
     ** will scan rows in a different order, set the bSort variable.  */
     if( pOrderBy ){
-      if( (wsFlags & WHERE_COLUMN_IN)==0
+      if( (wsFlags & (WHERE_COLUMN_IN|WHERE_SKIPSCAN))==0
         && pProbe->bUnordered==0
         && isSortingIndex(pParse, pWC->pMaskSet, pProbe, iCur, pOrderBy,
                           nEq, wsFlags, &rev)
@@ -2937,7 +3265,7 @@ static void bestBtreeIndex(
       nInMul = (int)(nRow / aiRowEst[nEq]);
     }
 
-#ifdef SQLITE_ENABLE_STAT2
+#if defined(SQLITE_ENABLE_STAT2) || defined(SQLITE_ENABLE_STAT3)
     /* If the constraint is of the form x=VALUE and histogram
     ** data is available for column x, then it might be possible
     ** to get a better estimate on the number of rows based on
@@ -2952,12 +3280,12 @@ static void bestBtreeIndex(
         whereInScanEst(pParse, pProbe, pFirstTerm->pExpr->x.pList, &nRow);
       }
     }
-#endif /* SQLITE_ENABLE_STAT2 */
+#endif /* SQLITE_ENABLE_STAT2 || SQLITE_ENABLE_STAT3 */
 
     /* Adjust the number of output rows and downward to reflect rows
     ** that are excluded by range constraints.
     */
-    nRow = (nRow * (double)estBound) / (double)100;
+    nRow = (nRow * estBound) / (double)100;
     if( nRow<1 ) nRow = 1;
 
     /* Experiments run on real SQLite databases show that the time needed
@@ -3002,6 +3330,11 @@ static void bestBtreeIndex(
           */
           cost += nInMul*log10N;
         }
+        if( nSkip ){
+          /* For a skip-scan, plus one more index search to find each
+          ** distinct value of the skipped column */
+          cost += (aiRowEst[0]/aiRowEst[1])*log10N;
+        }
       }else{
         /* For a rowid primary key lookup:
         **    nInMult table searches to find the initial entry for each range
@@ -3041,7 +3374,7 @@ static void bestBtreeIndex(
     */
     if( nRow>2 && cost<=pCost->rCost ){
       int k;                       /* Loop counter */
-      int nSkipEq = nEq;           /* Number of == constraints to skip */
+      int nSkipEq = nEq - nSkip;   /* Number of == constraints to skip */
       int nSkipRange = nBound;     /* Number of < constraints to skip */
       Bitmask thisTab;             /* Bitmap for pSrc */
 
@@ -3083,7 +3416,7 @@ static void bestBtreeIndex(
 
 
     WHERETRACE((
-      "%s(%s): nEq=%d nInMul=%d estBound=%d bSort=%d bLookup=%d wsFlags=0x%x\n"
+      "%s(%s): nEq=%d nInMul=%d estBound=%g bSort=%d bLookup=%d wsFlags=0x%x\n"
       "         notReady=0x%llx log10N=%.1f nRow=%.1f cost=%.1f used=0x%llx\n",
       pSrc->pTab->zName, (pIdx ? pIdx->zName : "ipk"), 
       nEq, nInMul, estBound, bSort, bLookup, wsFlags,
@@ -3332,6 +3665,14 @@ static int codeEqualityTerm(
 ** The only thing it does is allocate the pLevel->iMem memory cell and
 ** compute the affinity string.
 **
+** If the plan is a skip-scan (WHERE_SKIPSCAN), the first of the nEq
+** columns is not constrained. Instead, this routine generates a loop
+** over the distinct values of the first column of the index, leaving the
+** current value in the first register. pLevel->addrSkip is set to the
+** instruction that seeks to the next distinct value, and pLevel->addrNxt
+** to a label that is resolved before the jump to it, so that when the
+** search for each value is finished the next one is tried.
+**
 ** This routine always allocates at least one memory cell and returns
 ** the index of that memory cell. The code that
 ** calls this routine will use that memory cell to store the termination
@@ -3387,10 +3728,30 @@ static int codeAllEqualityTerms(
     pParse->db->mallocFailed = 1;
   }
 
+  /* For a skip-scan, loop through the distinct values of the first
+  ** column of the index.  The index cursor is left pointing to the first
+  ** entry with the current value, which is copied into register regBase.
+  */
+  j = 0;
+  if( pLevel->plan.wsFlags & WHERE_SKIPSCAN ){
+    int iIdxCur = pLevel->iIdxCur;
+    int bRev = (pLevel->plan.wsFlags & WHERE_REVERSE)!=0;
+    int addr;
+    assert( nEq>1 || (pLevel->plan.wsFlags & WHERE_COLUMN_RANGE)!=0 );
+    sqlite3VdbeAddOp2(v, (bRev?OP_Last:OP_Rewind), iIdxCur, pLevel->addrBrk);
+    addr = sqlite3VdbeAddOp0(v, OP_Goto);
+    pLevel->addrSkip = sqlite3VdbeAddOp4Int(v, (bRev?OP_SeekLt:OP_SeekGt),
+                                            iIdxCur, pLevel->addrBrk, regBase, 1);
+    sqlite3VdbeJumpHere(v, addr);
+    sqlite3VdbeAddOp3(v, OP_Column, iIdxCur, 0, regBase);
+    if( zAff ) zAff[0] = SQLITE_AFF_NONE;
+    j = 1;
+  }
+
   /* Evaluate the equality constraints
   */
   assert( pIdx->nColumn>=nEq );
-  for(j=0; j<nEq; j++){
+  for(; j<nEq; j++){
     int r1;
     int k = pIdx->aiColumn[j];
     pTerm = findTerm(pWC, iCur, k, notReady, pLevel->plan.wsFlags, pIdx);
@@ -3423,6 +3784,9 @@ static int codeAllEqualityTerms(
       }
     }
   }
+  if( pLevel->addrSkip && pLevel->u.in.nIn==0 ){
+    pLevel->addrNxt = sqlite3VdbeMakeLabel(v);
+  }
   *pzAff = zAff;
   return regBase;
 }
@@ -3463,6 +3827,9 @@ static void explainAppendTerm(
 **
 **   "a=? AND b>?"
 **
+** For a skip-scan on an index on (a, b) with the WHERE clause "b>2", the
+** string is "ANY(a) AND b>?".
+**
 ** The returned pointer points to memory obtained from sqlite3DbMalloc().
 ** It is the responsibility of the caller to free the buffer when it is
 ** no longer required.
@@ -3483,7 +3850,13 @@ static char *explainIndexRange(sqlite3 *db, WhereLevel *pLevel, Table *pTab){
   txt.db = db;
   sqlite3StrAccumAppend(&txt, " (", 2);
   for(i=0; i<nEq; i++){
-    explainAppendTerm(&txt, i, aCol[aiColumn[i]].zName, "=");
+    if( i==0 && (pPlan->wsFlags & WHERE_SKIPSCAN) ){
+      sqlite3StrAccumAppend(&txt, "ANY(", 4);
+      sqlite3StrAccumAppend(&txt, aCol[aiColumn[i]].zName, -1);
+      sqlite3StrAccumAppend(&txt, ")", 1);
+    }else{
+      explainAppendTerm(&txt, i, aCol[aiColumn[i]].zName, "=");
+    }
   }
 
   j = i;
@@ -3810,6 +4183,13 @@ static Bitmask codeOneLoopStart(
     **         If there are no inequality constraints, then N is at
     **         least one.
     **
+    **         For a skip-scan (WHERE_SKIPSCAN), the first of the N
+    **         columns is unconstrained, and the search is repeated for
+    **         each of its distinct values. So with the index on (x,y,z)
+    **         and few distinct values of x, the following may use it:
+    **
+    **            y=10 AND z<=10
+    **
     **         This case is also used when there are no WHERE clause
     **         constraints but an index is selected anyway, in order
     **         to force the output order to conform to an ORDER BY.
@@ -4889,6 +5269,11 @@ void sqlite3WhereEnd(WhereInfo *pWInfo){
         sqlite3VdbeJumpHere(v, pIn->addrInTop-1);
       }
       sqlite3DbFree(db, pLevel->u.in.aInLoop);
+    }else if( pLevel->addrSkip ){
+      sqlite3VdbeResolveLabel(v, pLevel->addrNxt);
+    }
+    if( pLevel->addrSkip ){
+      sqlite3VdbeAddOp2(v, OP_Goto, 0, pLevel->addrSkip);
     }
     sqlite3VdbeResolveLabel(v, pLevel->addrBrk);
     if( pLevel->iLeftJoin ){
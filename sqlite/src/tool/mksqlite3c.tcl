@@ -231,6 +231,7 @@ foreach file {
    malloc.c
    printf.c
    random.c
+   threads.c
    utf.c
    util.c
    hash.c
@@ -253,6 +254,7 @@ foreach file {
 
    vdbemem.c
    vdbeaux.c
+   vdbesort.c
    vdbeapi.c
    vdbetrace.c
    vdbe.c
@@ -236,6 +236,7 @@ proc main {argv} {
     SQLITE_ENABLE_OVERSIZE_CELL_CHECK \
     SQLITE_ENABLE_RTREE \
     SQLITE_ENABLE_STAT2 \
+    SQLITE_ENABLE_STAT3 \
     SQLITE_ENABLE_UNLOCK_NOTIFY \
     SQLITE_ENABLE_UPDATE_DELETE_LIMIT \
   ]
@@ -6,6 +6,8 @@
 /* @(#) $Id$ */
 
 #include "zutil.h"
+#include "adler32_simd.h"
+#include "x86.h"
 
 #define local static
 
@@ -81,8 +83,26 @@ uLong ZEXPORT adler32(adler, buf, len)
     }
 
     /* initial Adler-32 value (deferred check for len == 1 speed) */
-    if (buf == Z_NULL)
+    if (buf == Z_NULL) {
+        /* inflate and most callers start with adler32(0, Z_NULL, 0), so
+         * this is where the CPU features for the SIMD versions are set up.
+         */
+        x86_check_features();
         return 1L;
+    }
+
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || \
+    defined(_M_X64)
+    if (len >= ADLER32_SIMD_MIN_LEN) {
+        if (x86_cpu_enable_avx2)
+            return adler32_avx2(adler | (sum2 << 16), buf, len);
+        if (x86_cpu_enable_ssse3)
+            return adler32_ssse3(adler | (sum2 << 16), buf, len);
+    }
+#elif defined(__arm__) || defined(__aarch64__)
+    if (len >= ADLER32_SIMD_MIN_LEN && arm_cpu_enable_neon)
+        return adler32_neon(adler | (sum2 << 16), buf, len);
+#endif
 
     /* in case short lengths are provided, keep it somewhat fast */
     if (len < 16) {
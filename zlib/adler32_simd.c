@@ -0,0 +1,284 @@
+/* adler32_simd.c -- compute the Adler-32 checksum of a data stream with
+ * SSSE3, AVX2 or NEON
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ *
+ * Per block of B bytes b[0..B-1], the scalar loop computes
+ *
+ *   s1' = s1 + sum(b[i])
+ *   s2' = s2 + B * s1 + sum((B - i) * b[i])
+ *
+ * so s1 is a horizontal byte sum and s2 is a multiply-add of the bytes with
+ * the taps B, B-1, ..., 1, plus B times the s1 from before the block. The
+ * vector loops below accumulate these sums in 32-bit lanes for up to NMAX
+ * bytes and reduce modulo BASE once, like the scalar code.
+ */
+
+#include <assert.h>
+
+#include "adler32_simd.h"
+
+#define BASE 65521U     /* largest prime smaller than 65536 */
+#define NMAX 5552
+/* NMAX is the largest n such that 255n(n+1)/2 + (n+1)(BASE-1) <= 2^32-1 */
+
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || \
+    defined(_M_X64) || defined(__ARM_NEON) || defined(__ARM_NEON__)
+
+/* Checksums the bytes that are left over after the vector loop. */
+local uLong adler32_tail(unsigned s1, unsigned s2, const Bytef *buf,
+                         uInt len)
+{
+    while (len--) {
+        s1 += *buf++;
+        s2 += s1;
+    }
+    s1 %= BASE;
+    s2 %= BASE;
+    return s1 | ((uLong)s2 << 16);
+}
+
+#endif
+
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || \
+    defined(_M_X64)
+
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#include <immintrin.h>
+
+/* The functions are only called after a CPUID check, so they can be built
+ * without compiler flags that would let it use the instructions elsewhere.
+ */
+#if defined(__GNUC__) || defined(__clang__)
+#  define TARGET_SSSE3 __attribute__((target("ssse3")))
+#  define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#  define TARGET_SSSE3
+#  define TARGET_AVX2
+#endif
+
+/* Returns the sum of the four 32-bit lanes of v. */
+TARGET_SSSE3 local unsigned hsum_epi32(__m128i v)
+{
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+    return (unsigned)_mm_cvtsi128_si32(v);
+}
+
+/* ========================================================================= */
+TARGET_SSSE3 uLong ZLIB_INTERNAL adler32_ssse3(adler, buf, len)
+    uLong adler;
+    const Bytef *buf;
+    uInt len;
+{
+    unsigned s1 = adler & 0xffff;
+    unsigned s2 = (adler >> 16) & 0xffff;
+    unsigned blocks = len / 32;
+
+    const __m128i tap1 =
+        _mm_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25,
+                      24, 23, 22, 21, 20, 19, 18, 17);
+    const __m128i tap2 =
+        _mm_setr_epi8(16, 15, 14, 13, 12, 11, 10, 9,
+                      8, 7, 6, 5, 4, 3, 2, 1);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ones = _mm_set1_epi16(1);
+
+    len -= blocks * 32;
+    while (blocks) {
+        unsigned n = NMAX / 32;
+        __m128i v_ps, v_s1, v_s2;
+
+        if (n > blocks)
+            n = blocks;
+        blocks -= n;
+
+        /* v_ps collects the s1 value before each block; it is multiplied
+         * by the block size when the blocks are done.
+         */
+        v_ps = _mm_cvtsi32_si128((int)(s1 * n));
+        v_s2 = _mm_cvtsi32_si128((int)s2);
+        v_s1 = _mm_setzero_si128();
+
+        do {
+            const __m128i bytes1 = _mm_loadu_si128((const __m128i *)buf);
+            const __m128i bytes2 =
+                _mm_loadu_si128((const __m128i *)(buf + 16));
+
+            v_ps = _mm_add_epi32(v_ps, v_s1);
+
+            v_s1 = _mm_add_epi32(v_s1, _mm_sad_epu8(bytes1, zero));
+            v_s2 = _mm_add_epi32(v_s2, _mm_madd_epi16(
+                       _mm_maddubs_epi16(bytes1, tap1), ones));
+            v_s1 = _mm_add_epi32(v_s1, _mm_sad_epu8(bytes2, zero));
+            v_s2 = _mm_add_epi32(v_s2, _mm_madd_epi16(
+                       _mm_maddubs_epi16(bytes2, tap2), ones));
+
+            buf += 32;
+        } while (--n);
+
+        v_s2 = _mm_add_epi32(v_s2, _mm_slli_epi32(v_ps, 5));
+
+        s1 = (s1 + hsum_epi32(v_s1)) % BASE;
+        s2 = hsum_epi32(v_s2) % BASE;
+    }
+
+    return adler32_tail(s1, s2, buf, len);
+}
+
+/* ========================================================================= */
+TARGET_AVX2 uLong ZLIB_INTERNAL adler32_avx2(adler, buf, len)
+    uLong adler;
+    const Bytef *buf;
+    uInt len;
+{
+    unsigned s1 = adler & 0xffff;
+    unsigned s2 = (adler >> 16) & 0xffff;
+    unsigned blocks = len / 64;
+
+    const __m256i tap1 =
+        _mm256_setr_epi8(64, 63, 62, 61, 60, 59, 58, 57,
+                         56, 55, 54, 53, 52, 51, 50, 49,
+                         48, 47, 46, 45, 44, 43, 42, 41,
+                         40, 39, 38, 37, 36, 35, 34, 33);
+    const __m256i tap2 =
+        _mm256_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25,
+                         24, 23, 22, 21, 20, 19, 18, 17,
+                         16, 15, 14, 13, 12, 11, 10, 9,
+                         8, 7, 6, 5, 4, 3, 2, 1);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i ones = _mm256_set1_epi16(1);
+
+    len -= blocks * 64;
+    while (blocks) {
+        unsigned n = NMAX / 64;
+        __m256i v_ps, v_s1, v_s2;
+
+        if (n > blocks)
+            n = blocks;
+        blocks -= n;
+
+        v_ps = _mm256_setr_epi32((int)(s1 * n), 0, 0, 0, 0, 0, 0, 0);
+        v_s2 = _mm256_setr_epi32((int)s2, 0, 0, 0, 0, 0, 0, 0);
+        v_s1 = _mm256_setzero_si256();
+
+        do {
+            const __m256i bytes1 = _mm256_loadu_si256((const __m256i *)buf);
+            const __m256i bytes2 =
+                _mm256_loadu_si256((const __m256i *)(buf + 32));
+
+            v_ps = _mm256_add_epi32(v_ps, v_s1);
+
+            v_s1 = _mm256_add_epi32(v_s1, _mm256_sad_epu8(bytes1, zero));
+            v_s2 = _mm256_add_epi32(v_s2, _mm256_madd_epi16(
+                       _mm256_maddubs_epi16(bytes1, tap1), ones));
+            v_s1 = _mm256_add_epi32(v_s1, _mm256_sad_epu8(bytes2, zero));
+            v_s2 = _mm256_add_epi32(v_s2, _mm256_madd_epi16(
+                       _mm256_maddubs_epi16(bytes2, tap2), ones));
+
+            buf += 64;
+        } while (--n);
+
+        v_s2 = _mm256_add_epi32(v_s2, _mm256_slli_epi32(v_ps, 6));
+
+        s1 = (s1 + hsum_epi32(_mm_add_epi32(
+                 _mm256_castsi256_si128(v_s1),
+                 _mm256_extracti128_si256(v_s1, 1)))) % BASE;
+        s2 = hsum_epi32(_mm_add_epi32(
+                 _mm256_castsi256_si128(v_s2),
+                 _mm256_extracti128_si256(v_s2, 1))) % BASE;
+    }
+
+    return adler32_tail(s1, s2, buf, len);
+}
+
+#elif defined(__arm__) || defined(__aarch64__)
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+
+#include <arm_neon.h>
+
+/* ========================================================================= */
+uLong ZLIB_INTERNAL adler32_neon(adler, buf, len)
+    uLong adler;
+    const Bytef *buf;
+    uInt len;
+{
+    static const uint16_t taps[32] = {
+        32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17,
+        16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1
+    };
+    unsigned s1 = adler & 0xffff;
+    unsigned s2 = (adler >> 16) & 0xffff;
+    unsigned blocks = len / 32;
+
+    len -= blocks * 32;
+    while (blocks) {
+        unsigned n = NMAX / 32;
+        uint32x4_t v_s1, v_s2;
+        uint16x8_t v_col1, v_col2, v_col3, v_col4;
+        uint32x2_t sum1, sum2, s1s2;
+
+        if (n > blocks)
+            n = blocks;
+        blocks -= n;
+
+        v_s2 = vsetq_lane_u32(s1 * n, vdupq_n_u32(0), 0);
+        v_s1 = vdupq_n_u32(0);
+        v_col1 = v_col2 = v_col3 = v_col4 = vdupq_n_u16(0);
+
+        /* v_s1 collects the byte sums. v_s2 first collects the s1 value
+         * before each block, and the columns collect the sums of the bytes
+         * at each position in the block, which are multiplied by the taps
+         * at the end.
+         */
+        do {
+            const uint8x16_t bytes1 = vld1q_u8(buf);
+            const uint8x16_t bytes2 = vld1q_u8(buf + 16);
+
+            v_s2 = vaddq_u32(v_s2, v_s1);
+            v_s1 = vpadalq_u16(v_s1, vpadalq_u8(vpaddlq_u8(bytes1), bytes2));
+            v_col1 = vaddw_u8(v_col1, vget_low_u8(bytes1));
+            v_col2 = vaddw_u8(v_col2, vget_high_u8(bytes1));
+            v_col3 = vaddw_u8(v_col3, vget_low_u8(bytes2));
+            v_col4 = vaddw_u8(v_col4, vget_high_u8(bytes2));
+
+            buf += 32;
+        } while (--n);
+
+        v_s2 = vshlq_n_u32(v_s2, 5);
+        v_s2 = vmlal_u16(v_s2, vget_low_u16(v_col1), vld1_u16(taps + 0));
+        v_s2 = vmlal_u16(v_s2, vget_high_u16(v_col1), vld1_u16(taps + 4));
+        v_s2 = vmlal_u16(v_s2, vget_low_u16(v_col2), vld1_u16(taps + 8));
+        v_s2 = vmlal_u16(v_s2, vget_high_u16(v_col2), vld1_u16(taps + 12));
+        v_s2 = vmlal_u16(v_s2, vget_low_u16(v_col3), vld1_u16(taps + 16));
+        v_s2 = vmlal_u16(v_s2, vget_high_u16(v_col3), vld1_u16(taps + 20));
+        v_s2 = vmlal_u16(v_s2, vget_low_u16(v_col4), vld1_u16(taps + 24));
+        v_s2 = vmlal_u16(v_s2, vget_high_u16(v_col4), vld1_u16(taps + 28));
+
+        sum1 = vpadd_u32(vget_low_u32(v_s1), vget_high_u32(v_s1));
+        sum2 = vpadd_u32(vget_low_u32(v_s2), vget_high_u32(v_s2));
+        s1s2 = vpadd_u32(sum1, sum2);
+
+        s1 = (s1 + vget_lane_u32(s1s2, 0)) % BASE;
+        s2 = (s2 + vget_lane_u32(s1s2, 1)) % BASE;
+    }
+
+    return adler32_tail(s1, s2, buf, len);
+}
+
+#else
+
+/* Not built with NEON: arm_cpu_enable_neon is never set. */
+uLong ZLIB_INTERNAL adler32_neon(adler, buf, len)
+    uLong adler;
+    const Bytef *buf;
+    uInt len;
+{
+    assert(0);
+    return adler;
+}
+
+#endif  /* __ARM_NEON */
+
+#endif  /* x86 / ARM */
@@ -0,0 +1,20 @@
+/* adler32_simd.h -- SIMD versions of adler32()
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+#ifndef ADLER32_SIMD_H
+#define ADLER32_SIMD_H
+
+#include "zutil.h"
+
+/* Inputs shorter than this are not worth the vector setup. */
+#define ADLER32_SIMD_MIN_LEN 64
+
+/* x86: callers must check x86_cpu_enable_ssse3 or x86_cpu_enable_avx2. */
+uLong ZLIB_INTERNAL adler32_ssse3(uLong adler, const Bytef *buf, uInt len);
+uLong ZLIB_INTERNAL adler32_avx2(uLong adler, const Bytef *buf, uInt len);
+
+/* ARM: callers must check arm_cpu_enable_neon. */
+uLong ZLIB_INTERNAL adler32_neon(uLong adler, const Bytef *buf, uInt len);
+
+#endif  /* ADLER32_SIMD_H */
@@ -0,0 +1,166 @@
+/* checksum_bench.c -- adler32() and crc32() throughput
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ *
+ * Checks the SIMD versions of adler32() and crc32() against bytewise
+ * reference versions for all lengths and alignments up to a few blocks,
+ * then measures throughput with the SIMD versions on and off.
+ *
+ * Link against the static library, so that the CPU feature flags of x86.h
+ * can be switched off:
+ *
+ *   checksum_bench [MBYTES]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "zlib.h"
+#include "x86.h"
+
+static unsigned long ref_adler32(unsigned long adler, const unsigned char *buf,
+                                 size_t len)
+{
+    unsigned long s1 = adler & 0xffff, s2 = adler >> 16;
+
+    while (len--) {
+        s1 = (s1 + *buf++) % 65521;
+        s2 = (s2 + s1) % 65521;
+    }
+    return s1 | (s2 << 16);
+}
+
+static unsigned long ref_crc32(unsigned long crc, const unsigned char *buf,
+                               size_t len)
+{
+    int k;
+
+    crc ^= 0xffffffffUL;
+    while (len--) {
+        crc ^= *buf++;
+        for (k = 0; k < 8; k++)
+            crc = crc & 1 ? (crc >> 1) ^ 0xedb88320UL : crc >> 1;
+    }
+    return crc ^ 0xffffffffUL;
+}
+
+static double now_sec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int check(const unsigned char *data)
+{
+    size_t len, off;
+    unsigned long seed;
+    int errors = 0;
+
+    for (off = 0; off < 16; off++) {
+        for (len = 0; len < 600; len++) {
+            seed = (len * 2654435761UL) & 0xffffffffUL;
+            if (adler32(seed % 65521 | (seed % 65519) << 16, data + off,
+                        (uInt)len) !=
+                ref_adler32(seed % 65521 | (seed % 65519) << 16, data + off,
+                            len) ||
+                crc32(seed, data + off, (uInt)len) !=
+                ref_crc32(seed, data + off, len)) {
+                printf("mismatch: offset %u length %u\n", (unsigned)off,
+                       (unsigned)len);
+                errors++;
+            }
+        }
+    }
+
+    /* Longer than NMAX, with the sums starting near BASE - 1. */
+    for (len = 5500; len < 5600; len += 13) {
+        if (adler32(0xfff0fff0UL, data, (uInt)(len * 7)) !=
+            ref_adler32(0xfff0fff0UL, data, len * 7)) {
+            printf("mismatch: adler32 length %u\n", (unsigned)(len * 7));
+            errors++;
+        }
+    }
+    return errors;
+}
+
+/* Returns MB/s for checksumming nbytes in blocks of size bytes. */
+static double bench(int use_crc, const unsigned char *data, size_t size,
+                    size_t nbytes, unsigned long *result)
+{
+    unsigned long sum = use_crc ? crc32(0, Z_NULL, 0) : adler32(0, Z_NULL, 0);
+    size_t done;
+    double t = now_sec();
+
+    for (done = 0; done < nbytes; done += size) {
+        sum = use_crc ? crc32(sum, data, (uInt)size) :
+                        adler32(sum, data, (uInt)size);
+    }
+    t = now_sec() - t;
+    *result = sum;
+    return nbytes / t / (1 << 20);
+}
+
+int main(int argc, char **argv)
+{
+    static const size_t sizes[] = { 64, 256, 1024, 4096, 16384, 65536,
+                                    1 << 20 };
+    static const char *names[] = { "adler32", "crc32" };
+    size_t mbytes = argc > 1 ? (size_t)atoi(argv[1]) : 256;
+    size_t i, nbytes = mbytes << 20;
+    unsigned char *data = malloc(1 << 20);
+    int use_crc, errors;
+    int simd = 0, ssse3 = 0, avx2 = 0, neon = 0, armcrc = 0;
+
+    for (i = 0; i < 1 << 20; i++)
+        data[i] = (unsigned char)(rand() >> 7);
+
+    /* The feature flags are set up by the first crc32(0, Z_NULL, 0). */
+    crc32(0, Z_NULL, 0);
+    printf("simd %d ssse3 %d avx2 %d neon %d armv8-crc %d\n",
+           x86_cpu_enable_simd, x86_cpu_enable_ssse3, x86_cpu_enable_avx2,
+           arm_cpu_enable_neon, arm_cpu_enable_crc32);
+
+    errors = check(data);
+    simd = x86_cpu_enable_simd;
+    ssse3 = x86_cpu_enable_ssse3;
+    avx2 = x86_cpu_enable_avx2;
+    neon = arm_cpu_enable_neon;
+    armcrc = arm_cpu_enable_crc32;
+    x86_cpu_enable_avx2 = 0;
+    errors += check(data);
+
+    printf("\n%-8s %8s %12s %12s\n", "", "size", "scalar MB/s", "simd MB/s");
+    for (use_crc = 0; use_crc < 2; use_crc++) {
+        for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+            unsigned long r1, r2;
+            double scalar, fast;
+
+            x86_cpu_enable_simd = x86_cpu_enable_ssse3 = 0;
+            x86_cpu_enable_avx2 = arm_cpu_enable_neon = 0;
+            arm_cpu_enable_crc32 = 0;
+            scalar = bench(use_crc, data, sizes[i], nbytes, &r1);
+
+            x86_cpu_enable_simd = simd;
+            x86_cpu_enable_ssse3 = ssse3;
+            x86_cpu_enable_avx2 = avx2;
+            arm_cpu_enable_neon = neon;
+            arm_cpu_enable_crc32 = armcrc;
+            fast = bench(use_crc, data, sizes[i], nbytes, &r2);
+
+            if (r1 != r2) {
+                printf("mismatch: %s size %u\n", names[use_crc],
+                       (unsigned)sizes[i]);
+                errors++;
+            }
+            printf("%-8s %8u %12.0f %12.0f\n", names[use_crc],
+                   (unsigned)sizes[i], scalar, fast);
+        }
+    }
+
+    free(data);
+    printf("\n%s\n", errors ? "Failure" : "Success");
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,169 @@
+/* deflate_bench.c -- deflate() throughput and compression ratio by level
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ *
+ * Compresses each file at levels 1, 2, 3 and 6 and reports the compressed
+ * size and the throughput, measured in uncompressed bytes. Each result is
+ * inflated and checked against the original file.
+ *
+ * Input is fed to deflate() in 16K pieces, as a streaming compressor of
+ * HTTP responses would:
+ *
+ *   deflate_bench FILE...
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "zlib.h"
+
+#define IN_PIECE 16384
+#define NLEVELS 4
+
+static const int levels[NLEVELS] = { 1, 2, 3, 6 };
+
+static double now_sec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static unsigned char *read_file(const char *name, size_t *size)
+{
+    FILE *f = fopen(name, "rb");
+    unsigned char *data;
+    long n;
+
+    if (!f)
+        return NULL;
+    fseek(f, 0, SEEK_END);
+    n = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    data = malloc(n ? n : 1);
+    if (fread(data, 1, n, f) != (size_t)n) {
+        free(data);
+        data = NULL;
+    }
+    fclose(f);
+    *size = n;
+    return data;
+}
+
+/* Deflates src into dst, which has room for dst_len bytes, and returns the
+ * compressed length, or 0 on error.
+ */
+static size_t deflate_all(const unsigned char *src, size_t src_len,
+                          unsigned char *dst, size_t dst_len, int level)
+{
+    z_stream strm;
+    size_t left = src_len;
+    int ret;
+
+    memset(&strm, 0, sizeof(strm));
+    if (deflateInit(&strm, level) != Z_OK)
+        return 0;
+    strm.next_in = (Bytef *)src;
+    strm.next_out = dst;
+    strm.avail_out = (uInt)dst_len;
+    do {
+        strm.avail_in = left < IN_PIECE ? (uInt)left : IN_PIECE;
+        left -= strm.avail_in;
+        ret = deflate(&strm, left ? Z_NO_FLUSH : Z_FINISH);
+    } while (ret == Z_OK && strm.avail_out);
+    deflateEnd(&strm);
+    return ret == Z_STREAM_END ? strm.total_out : 0;
+}
+
+/* Returns MB/s of uncompressed input, or 0 if the output does not inflate to
+ * the input. Sets *csize to the compressed length.
+ */
+static double bench(const unsigned char *data, size_t size, int level,
+                    unsigned char *comp, size_t comp_len, unsigned char *out,
+                    size_t *csize, int reps)
+{
+    uLongf out_len = size;
+    double t;
+    int i;
+
+    t = now_sec();
+    for (i = 0; i < reps; i++) {
+        *csize = deflate_all(data, size, comp, comp_len, level);
+        if (*csize == 0)
+            return 0;
+    }
+    t = now_sec() - t;
+    if (uncompress(out, &out_len, comp, *csize) != Z_OK || out_len != size ||
+        memcmp(out, data, size) != 0)
+        return 0;
+    return (double)size * reps / t / (1 << 20);
+}
+
+int main(int argc, char **argv)
+{
+    double total_time[NLEVELS] = { 0, 0, 0, 0 };
+    size_t total_comp[NLEVELS] = { 0, 0, 0, 0 };
+    size_t total_bytes = 0;
+    int i, l, errors = 0;
+
+    if (argc < 2) {
+        fprintf(stderr, "usage: deflate_bench FILE...\n");
+        return 2;
+    }
+
+    printf("%-24s", "file");
+    for (l = 0; l < NLEVELS; l++)
+        printf("   level %d MB/s  ratio", levels[l]);
+    printf("\n");
+
+    for (i = 1; i < argc; i++) {
+        size_t size, comp_len;
+        unsigned char *data = read_file(argv[i], &size);
+        unsigned char *comp, *out;
+        int reps;
+
+        if (!data || size == 0) {
+            fprintf(stderr, "%s: cannot read\n", argv[i]);
+            free(data);
+            continue;
+        }
+        comp_len = compressBound(size);
+        comp = malloc(comp_len);
+        out = malloc(size);
+        /* Compress about 64 MB of input per measurement. */
+        reps = (int)((64 << 20) / size) + 1;
+        total_bytes += size;
+
+        printf("%-24.24s", argv[i]);
+        for (l = 0; l < NLEVELS; l++) {
+            size_t csize;
+            double rate = bench(data, size, levels[l], comp, comp_len, out,
+                                &csize, reps);
+
+            if (rate == 0) {
+                printf(" %21s", "wrong output");
+                errors++;
+                continue;
+            }
+            total_time[l] += size / rate;
+            total_comp[l] += csize;
+            printf(" %14.0f %5.1f%%", rate, 100.0 * csize / size);
+        }
+        printf("\n");
+        free(out);
+        free(comp);
+        free(data);
+    }
+
+    /* Totals weight each file by its size. */
+    printf("%-24s", "total");
+    for (l = 0; l < NLEVELS; l++) {
+        if (total_time[l] > 0)
+            printf(" %14.0f %5.1f%%", total_bytes / total_time[l],
+                   100.0 * total_comp[l] / total_bytes);
+    }
+    printf("\n\n%s\n", errors ? "Failure" : "Success");
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,107 @@
+/* gzseek_bench.c -- gzseek() latency with and without an index
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ *
+ * Reads 4K at random positions of a gzip file after gzseek(), first without
+ * an index, then with one from gzbuildindex(), then with the same index saved
+ * with gzsaveindex() and loaded into a new gzFile with gzloadindex(). The
+ * data read with an index is checked against the data read without one.
+ *
+ *   gzseek_bench FILE.gz [SPAN]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "zlib.h"
+
+#define INDEX_NAME "gzseek_bench.idx"
+#define READ_SIZE 4096
+#define SEEKS 200
+
+static double now_sec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Reads READ_SIZE bytes at each of offsets into data, and returns the average
+ * time per seek and read in ms, or -1 on error.
+ */
+static double bench(gzFile gz, const z_off_t *offsets, unsigned char *data)
+{
+    double t;
+    int i;
+
+    t = now_sec();
+    for (i = 0; i < SEEKS; i++) {
+        if (gzseek(gz, offsets[i], SEEK_SET) != offsets[i] ||
+            gzread(gz, data + (size_t)i * READ_SIZE, READ_SIZE) < 0)
+            return -1;
+    }
+    return (now_sec() - t) * 1000 / SEEKS;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long span = argc > 2 ? strtoul(argv[2], NULL, 10) : 0;
+    z_off_t offsets[SEEKS], size;
+    unsigned char *ref, *data;
+    gzFile gz;
+    double plain, indexed, loaded, t;
+    int i, errors = 0;
+
+    if (argc < 2) {
+        fprintf(stderr, "usage: gzseek_bench FILE.gz [SPAN]\n");
+        return 2;
+    }
+    gz = gzopen(argv[1], "rb");
+    if (gz == NULL) {
+        fprintf(stderr, "%s: cannot open\n", argv[1]);
+        return 2;
+    }
+
+    /* Find the uncompressed size, and pick offsets in the second half. */
+    while (gzseek(gz, 1 << 20, SEEK_CUR) != -1 && !gzeof(gz) &&
+           gzgetc(gz) != -1)
+        ;
+    size = gztell(gz);
+    for (i = 0; i < SEEKS; i++)
+        offsets[i] = size / 2 + (z_off_t)((double)rand() / RAND_MAX *
+                                          (size / 2));
+    ref = calloc(SEEKS, READ_SIZE);
+    data = calloc(SEEKS, READ_SIZE);
+
+    plain = bench(gz, offsets, ref);
+    t = now_sec();
+    if (gzbuildindex(gz, span) != 0) {
+        fprintf(stderr, "%s: cannot build index\n", argv[1]);
+        return 1;
+    }
+    t = now_sec() - t;
+    indexed = bench(gz, offsets, data);
+    errors += memcmp(ref, data, (size_t)SEEKS * READ_SIZE) != 0;
+    errors += gzsaveindex(gz, INDEX_NAME) != 0;
+    gzclose(gz);
+
+    memset(data, 0, (size_t)SEEKS * READ_SIZE);
+    gz = gzopen(argv[1], "rb");
+    errors += gzloadindex(gz, INDEX_NAME) != 0;
+    loaded = bench(gz, offsets, data);
+    errors += memcmp(ref, data, (size_t)SEEKS * READ_SIZE) != 0;
+    gzclose(gz);
+    remove(INDEX_NAME);
+
+    printf("%lu MB uncompressed, index built in %.0f ms\n",
+           (unsigned long)(size >> 20), t * 1000);
+    printf("ms per seek: no index %.2f, index %.2f, loaded index %.2f\n",
+           plain, indexed, loaded);
+    free(data);
+    free(ref);
+    printf("\n%s\n", errors || plain < 0 || indexed < 0 || loaded < 0 ?
+           "Failure" : "Success");
+    return errors ? 1 : 0;
+}
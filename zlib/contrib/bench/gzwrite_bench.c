@@ -0,0 +1,166 @@
+/* gzwrite_bench.c -- gzwrite() throughput with gzsetparallel()
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ *
+ * Writes each file to a temporary gzip file at level 6, on the calling
+ * thread and then with 2, 4 and 8 threads, and reports the throughput of
+ * each, measured in uncompressed bytes, and the compressed size. Each
+ * result is read back with gzread() and checked against the original file.
+ *
+ *   gzwrite_bench FILE...
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "zlib.h"
+
+#define TEMP_NAME "gzwrite_bench.gz"
+#define NTHREADS 4
+
+static const int threads[NTHREADS] = { 1, 2, 4, 8 };
+
+static double now_sec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static unsigned char *read_file(const char *name, size_t *size)
+{
+    FILE *f = fopen(name, "rb");
+    unsigned char *data;
+    long n;
+
+    if (!f)
+        return NULL;
+    fseek(f, 0, SEEK_END);
+    n = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    data = malloc(n ? n : 1);
+    if (fread(data, 1, n, f) != (size_t)n) {
+        free(data);
+        data = NULL;
+    }
+    fclose(f);
+    *size = n;
+    return data;
+}
+
+/* Writes data with the given number of threads, reps times, and returns
+ * MB/s of uncompressed input, or 0 on error. Sets *csize to the size of the
+ * gzip file.
+ */
+static double bench(const unsigned char *data, size_t size, int nthreads,
+                    int reps, long *csize)
+{
+    gzFile gz;
+    FILE *f;
+    double t;
+    int i;
+
+    t = now_sec();
+    for (i = 0; i < reps; i++) {
+        gz = gzopen(TEMP_NAME, "wb6");
+        if (gz == NULL)
+            return 0;
+        if (nthreads > 1 && gzsetparallel(gz, nthreads, 0) != 0) {
+            gzclose(gz);
+            return 0;
+        }
+        if (gzwrite(gz, data, (unsigned)size) != (int)size) {
+            gzclose(gz);
+            return 0;
+        }
+        if (gzclose(gz) != Z_OK)
+            return 0;
+    }
+    t = now_sec() - t;
+
+    f = fopen(TEMP_NAME, "rb");
+    if (f == NULL)
+        return 0;
+    fseek(f, 0, SEEK_END);
+    *csize = ftell(f);
+    fclose(f);
+    return (double)size * reps / t / (1 << 20);
+}
+
+/* Returns 1 if the gzip file holds exactly data. */
+static int verify(const unsigned char *data, size_t size)
+{
+    gzFile gz = gzopen(TEMP_NAME, "rb");
+    unsigned char *out = malloc(size + 1);
+    int got, ok;
+
+    if (gz == NULL || out == NULL) {
+        free(out);
+        return 0;
+    }
+    got = gzread(gz, out, (unsigned)size + 1);
+    ok = got == (int)size && memcmp(out, data, size) == 0;
+    gzclose(gz);
+    free(out);
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    double total[NTHREADS] = { 0, 0, 0, 0 };
+    size_t total_bytes = 0;
+    int i, t, errors = 0;
+
+    if (argc < 2) {
+        fprintf(stderr, "usage: gzwrite_bench FILE...\n");
+        return 2;
+    }
+
+    printf("%-24s %5s", "file", "");
+    for (t = 0; t < NTHREADS; t++)
+        printf(" %5d thr MB/s %6s", threads[t], "ratio");
+    printf("\n");
+
+    for (i = 1; i < argc; i++) {
+        size_t size;
+        unsigned char *data = read_file(argv[i], &size);
+        int reps;
+
+        if (!data || size == 0) {
+            fprintf(stderr, "%s: cannot read\n", argv[i]);
+            free(data);
+            continue;
+        }
+        /* Compress about 64 MB of input per measurement. */
+        reps = (int)((64 << 20) / size) + 1;
+        total_bytes += size;
+
+        printf("%-24.24s %5s", argv[i], "");
+        for (t = 0; t < NTHREADS; t++) {
+            long csize = 0;
+            double rate = bench(data, size, threads[t], reps, &csize);
+
+            if (rate == 0 || !verify(data, size)) {
+                printf(" %20s", "wrong output");
+                errors++;
+                continue;
+            }
+            total[t] += size / rate;
+            printf(" %14.0f %5.1f%%", rate, 100.0 * csize / size);
+        }
+        printf("\n");
+        free(data);
+    }
+
+    /* Totals weight each file by its size. */
+    printf("%-24s %5s", "total", "");
+    for (t = 0; t < NTHREADS; t++)
+        printf(" %14.0f %6s", total[t] > 0 ? total_bytes / total[t] : 0, "");
+    printf("\n");
+
+    remove(TEMP_NAME);
+    printf("\n%s\n", errors ? "Failure" : "Success");
+    return errors ? 1 : 0;
+}
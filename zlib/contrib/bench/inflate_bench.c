@@ -0,0 +1,181 @@
+/* inflate_bench.c -- inflate() throughput over a corpus of files
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ *
+ * Compresses each file with deflate at levels 1 and 6, then inflates it
+ * with inflate_fast() and with inflate_fast_chunk() and reports the
+ * throughput of each, measured in uncompressed bytes. The output is checked
+ * against the original file.
+ *
+ * Output is produced in 64K pieces, as a streaming decoder would, so that
+ * matches that reach back into the sliding window are covered too.
+ *
+ * Link against the static library, so that the CPU feature flags of x86.h
+ * can be switched off:
+ *
+ *   inflate_bench FILE...
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "zutil.h"
+#include "inffast_chunk.h"
+#include "x86.h"
+
+#define OUT_PIECE 65536
+
+static double now_sec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static unsigned char *read_file(const char *name, size_t *size)
+{
+    FILE *f = fopen(name, "rb");
+    unsigned char *data;
+    long n;
+
+    if (!f)
+        return NULL;
+    fseek(f, 0, SEEK_END);
+    n = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    data = malloc(n ? n : 1);
+    if (fread(data, 1, n, f) != (size_t)n) {
+        free(data);
+        data = NULL;
+    }
+    fclose(f);
+    *size = n;
+    return data;
+}
+
+/* Inflates src into dst, which has room for dst_len bytes, and returns the
+ * number of bytes produced, or -1 on error.
+ */
+static long inflate_all(const unsigned char *src, size_t src_len,
+                        unsigned char *dst, size_t dst_len)
+{
+    z_stream strm;
+    int ret;
+
+    memset(&strm, 0, sizeof(strm));
+    if (inflateInit(&strm) != Z_OK)
+        return -1;
+    strm.next_in = (Bytef *)src;
+    strm.avail_in = (uInt)src_len;
+    strm.next_out = dst;
+    do {
+        size_t left = dst_len - strm.total_out;
+        strm.avail_out = (uInt)(left < OUT_PIECE ? left : OUT_PIECE);
+        ret = inflate(&strm, Z_NO_FLUSH);
+    } while (ret == Z_OK && strm.total_out < dst_len);
+    inflateEnd(&strm);
+    return ret == Z_STREAM_END ? (long)strm.total_out : -1;
+}
+
+/* Returns MB/s of uncompressed output, or 0 if the output was wrong. */
+static double bench(const unsigned char *src, size_t src_len,
+                    const unsigned char *orig, size_t orig_len,
+                    unsigned char *dst, int reps)
+{
+    double t;
+    int i;
+
+    t = now_sec();
+    for (i = 0; i < reps; i++) {
+        if (inflate_all(src, src_len, dst, orig_len + 1) != (long)orig_len)
+            return 0;
+    }
+    t = now_sec() - t;
+    if (memcmp(dst, orig, orig_len) != 0)
+        return 0;
+    return (double)orig_len * reps / t / (1 << 20);
+}
+
+int main(int argc, char **argv)
+{
+    static const int levels[] = { 1, 6 };
+    double total_plain[2] = { 0, 0 }, total_chunk[2] = { 0, 0 };
+    size_t total_bytes = 0;
+    int i, l, errors = 0;
+    int enabled;
+
+    if (argc < 2) {
+        fprintf(stderr, "usage: inflate_bench FILE...\n");
+        return 2;
+    }
+
+    /* The feature flags are set up by adler32(0, Z_NULL, 0). */
+    adler32(0, Z_NULL, 0);
+#ifdef INFLATE_FAST_CHUNK
+    enabled = INFLATE_FAST_CHUNK_ENABLED;
+#else
+    enabled = 0;
+#endif
+    printf("inflate_fast_chunk %s\n\n", enabled ? "available" : "not available");
+    printf("%-32s %5s %10s %12s %12s\n", "file", "level", "ratio",
+           "fast MB/s", "chunk MB/s");
+
+    for (i = 1; i < argc; i++) {
+        size_t size, csize;
+        unsigned char *data = read_file(argv[i], &size);
+        unsigned char *comp, *out;
+        int reps;
+
+        if (!data || size == 0) {
+            fprintf(stderr, "%s: cannot read\n", argv[i]);
+            free(data);
+            continue;
+        }
+        comp = malloc(compressBound(size));
+        out = malloc(size + 1);
+        /* Inflate about 256 MB of output per measurement. */
+        reps = (int)((256 << 20) / size) + 1;
+        total_bytes += size;
+
+        for (l = 0; l < 2; l++) {
+            uLongf clen = compressBound(size);
+            double plain, chunk;
+
+            compress2(comp, &clen, data, size, levels[l]);
+            csize = clen;
+
+#ifdef INFLATE_FAST_CHUNK
+            INFLATE_FAST_CHUNK_ENABLED = 0;
+#endif
+            plain = bench(comp, csize, data, size, out, reps);
+#ifdef INFLATE_FAST_CHUNK
+            INFLATE_FAST_CHUNK_ENABLED = enabled;
+#endif
+            chunk = bench(comp, csize, data, size, out, reps);
+
+            if (plain == 0 || chunk == 0) {
+                printf("%s: level %d: wrong output\n", argv[i], levels[l]);
+                errors++;
+                continue;
+            }
+            total_plain[l] += size / plain;
+            total_chunk[l] += size / chunk;
+            printf("%-32.32s %5d %9.1f%% %12.0f %12.0f\n", argv[i], levels[l],
+                   100.0 * csize / size, plain, chunk);
+        }
+        free(out);
+        free(comp);
+        free(data);
+    }
+
+    /* Totals weight each file by its size. */
+    for (l = 0; l < 2; l++) {
+        if (total_plain[l] > 0)
+            printf("%-32s %5d %10s %12.0f %12.0f\n", "total", levels[l], "",
+                   total_bytes / total_plain[l], total_bytes / total_chunk[l]);
+    }
+    printf("\n%s\n", errors ? "Failure" : "Success");
+    return errors ? 1 : 0;
+}
@@ -27,6 +27,7 @@
 #endif /* MAKECRCH */
 
 #include "deflate.h"
+#include "crc32_simd.h"
 #include "x86.h"
 #include "zutil.h"      /* for STDC and FAR definitions */
 
@@ -225,13 +226,37 @@ unsigned long ZEXPORT crc32(crc, buf, len)
     const unsigned char FAR *buf;
     uInt len;
 {
-    if (buf == Z_NULL) return 0UL;
+    if (buf == Z_NULL) {
+        /* Callers start with crc32(0, Z_NULL, 0), so this is where the CPU
+         * features for the SIMD versions are set up.
+         */
+        x86_check_features();
+        return 0UL;
+    }
 
 #ifdef DYNAMIC_CRC_TABLE
     if (crc_table_empty)
         make_crc_table();
 #endif /* DYNAMIC_CRC_TABLE */
 
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || \
+    defined(_M_X64)
+    if (x86_cpu_enable_simd && len >= CRC32_PCLMUL_MIN_LEN) {
+        uInt chunk = len & ~CRC32_PCLMUL_CHUNK_MASK;
+
+        crc = crc32_pclmul((unsigned)crc ^ 0xffffffffU, buf, chunk) ^
+              0xffffffffUL;
+        len -= chunk;
+        if (len == 0)
+            return crc;
+        buf += chunk;
+    }
+#elif defined(__arm__) || defined(__aarch64__)
+    if (arm_cpu_enable_crc32)
+        return crc32_armv8((unsigned)crc ^ 0xffffffffU, buf, len) ^
+               0xffffffffUL;
+#endif
+
 #ifdef BYFOUR
     if (sizeof(void *) == sizeof(ptrdiff_t)) {
         u4 endian;
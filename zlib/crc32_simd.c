@@ -0,0 +1,157 @@
+/* crc32_simd.c -- compute the CRC-32 of a data stream with PCLMULQDQ or the
+ * ARMv8 CRC32 instructions
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ *
+ * The PCLMULQDQ version folds four 128-bit lanes in parallel, as in
+ * crc_folding.c, and then reduces them with a Barrett reduction. See
+ * "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ
+ * Instruction", Intel, 2009, which also gives the constants.
+ */
+
+#include <assert.h>
+
+#include "crc32_simd.h"
+
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || \
+    defined(_M_X64)
+
+#include <emmintrin.h>
+#include <smmintrin.h>
+#include <wmmintrin.h>
+
+#if defined(__GNUC__) || defined(__clang__)
+#  define TARGET_PCLMUL __attribute__((target("sse4.1,pclmul")))
+#else
+#  define TARGET_PCLMUL
+#endif
+
+/* Constants of the bit-reflected CRC-32 polynomial: x^(4*128+32) mod P and
+ * x^(4*128-32) mod P to fold by 512 bits, the same for 128 bits, x^64 mod P,
+ * and P with its Barrett constant mu.
+ */
+#define K1K2 _mm_set_epi32(0x00000001, 0xc6e41596, 0x00000001, 0x54442bd4)
+#define K3K4 _mm_set_epi32(0x00000000, 0xccaa009e, 0x00000001, 0x751997d0)
+#define K5K0 _mm_set_epi32(0x00000000, 0x00000000, 0x00000001, 0x63cd6124)
+#define POLY _mm_set_epi32(0x00000001, 0xf7011641, 0x00000001, 0xdb710641)
+
+/* Folds x into the next 128 bits of data. */
+#define FOLD(x, k, data) \
+    _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x, k, 0x00), \
+                                _mm_clmulepi64_si128(x, k, 0x11)), data)
+
+/* ========================================================================= */
+TARGET_PCLMUL unsigned ZLIB_INTERNAL crc32_pclmul(crc, buf, len)
+    unsigned crc;
+    const Bytef *buf;
+    uInt len;
+{
+    __m128i x0, x1, x2, x3, x4;
+    const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+
+    assert(len >= CRC32_PCLMUL_MIN_LEN);
+    assert((len & CRC32_PCLMUL_CHUNK_MASK) == 0);
+
+    x1 = _mm_loadu_si128((const __m128i *)(buf + 0x00));
+    x2 = _mm_loadu_si128((const __m128i *)(buf + 0x10));
+    x3 = _mm_loadu_si128((const __m128i *)(buf + 0x20));
+    x4 = _mm_loadu_si128((const __m128i *)(buf + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)crc));
+    buf += 64;
+    len -= 64;
+
+    /* Fold 512 bits at a time. */
+    x0 = K1K2;
+    while (len >= 64) {
+        x1 = FOLD(x1, x0, _mm_loadu_si128((const __m128i *)(buf + 0x00)));
+        x2 = FOLD(x2, x0, _mm_loadu_si128((const __m128i *)(buf + 0x10)));
+        x3 = FOLD(x3, x0, _mm_loadu_si128((const __m128i *)(buf + 0x20)));
+        x4 = FOLD(x4, x0, _mm_loadu_si128((const __m128i *)(buf + 0x30)));
+        buf += 64;
+        len -= 64;
+    }
+
+    /* Fold the four lanes into one, then 128 bits at a time. */
+    x0 = K3K4;
+    x1 = FOLD(x1, x0, x2);
+    x1 = FOLD(x1, x0, x3);
+    x1 = FOLD(x1, x0, x4);
+    while (len >= 16) {
+        x1 = FOLD(x1, x0, _mm_loadu_si128((const __m128i *)buf));
+        buf += 16;
+        len -= 16;
+    }
+
+    /* Fold 128 bits to 64. */
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+    x0 = K5K0;
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, mask32);
+    x1 = _mm_xor_si128(_mm_clmulepi64_si128(x1, x0, 0x00), x2);
+
+    /* Barrett reduction to 32 bits. */
+    x0 = POLY;
+    x2 = _mm_and_si128(x1, mask32);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, mask32);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    return (unsigned)_mm_extract_epi32(x1, 1);
+}
+
+#elif defined(__arm__) || defined(__aarch64__)
+
+#if defined(__ARM_FEATURE_CRC32)
+
+#include <arm_acle.h>
+#include <stdint.h>
+
+/* ========================================================================= */
+unsigned ZLIB_INTERNAL crc32_armv8(crc, buf, len)
+    unsigned crc;
+    const Bytef *buf;
+    uInt len;
+{
+    const uint64_t *buf8;
+
+    while (len && ((uintptr_t)buf & 7)) {
+        crc = __crc32b(crc, *buf++);
+        len--;
+    }
+
+    buf8 = (const uint64_t *)buf;
+    while (len >= 32) {
+        crc = __crc32d(crc, buf8[0]);
+        crc = __crc32d(crc, buf8[1]);
+        crc = __crc32d(crc, buf8[2]);
+        crc = __crc32d(crc, buf8[3]);
+        buf8 += 4;
+        len -= 32;
+    }
+    while (len >= 8) {
+        crc = __crc32d(crc, *buf8++);
+        len -= 8;
+    }
+
+    buf = (const Bytef *)buf8;
+    while (len--)
+        crc = __crc32b(crc, *buf++);
+    return crc;
+}
+
+#else
+
+/* Not built with the CRC32 extension: arm_cpu_enable_crc32 is never set. */
+unsigned ZLIB_INTERNAL crc32_armv8(crc, buf, len)
+    unsigned crc;
+    const Bytef *buf;
+    uInt len;
+{
+    assert(0);
+    return crc;
+}
+
+#endif  /* __ARM_FEATURE_CRC32 */
+
+#endif  /* x86 / ARM */
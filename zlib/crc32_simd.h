@@ -0,0 +1,26 @@
+/* crc32_simd.h -- SIMD versions of crc32()
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+#ifndef CRC32_SIMD_H
+#define CRC32_SIMD_H
+
+#include "zutil.h"
+
+/* crc32_pclmul() takes at least CRC32_PCLMUL_MIN_LEN bytes, in a multiple
+ * of 16.
+ */
+#define CRC32_PCLMUL_MIN_LEN 64
+#define CRC32_PCLMUL_CHUNK_MASK 15
+
+/* The crc arguments and results are not inverted, unlike crc32(). */
+
+/* x86: callers must check x86_cpu_enable_simd. */
+unsigned ZLIB_INTERNAL crc32_pclmul(unsigned crc, const Bytef *buf,
+                                    uInt len);
+
+/* ARM: callers must check arm_cpu_enable_crc32. */
+unsigned ZLIB_INTERNAL crc32_armv8(unsigned crc, const Bytef *buf,
+                                   uInt len);
+
+#endif  /* CRC32_SIMD_H */
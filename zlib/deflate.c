@@ -81,6 +81,7 @@ local void fill_window    OF((deflate_state *s));
 local block_state deflate_stored OF((deflate_state *s, int flush, int clas));
 local block_state deflate_fast   OF((deflate_state *s, int flush, int clas));
 #ifndef FASTEST
+local block_state deflate_quick  OF((deflate_state *s, int flush, int clas));
 local block_state deflate_slow   OF((deflate_state *s, int flush, int clas));
 #endif
 local block_state deflate_rle    OF((deflate_state *s, int flush));
@@ -152,7 +153,7 @@ local const config configuration_table[2] = {
 local const config configuration_table[10] = {
 /*      good lazy nice chain */
 /* 0 */ {0,    0,  0,    0, deflate_stored},  /* store only */
-/* 1 */ {4,    4,  8,    4, deflate_fast}, /* max speed, no lazy matches */
+/* 1 */ {4,    4,  8,    4, deflate_quick}, /* max speed, no chains */
 /* 2 */ {4,    5, 16,    8, deflate_fast},
 /* 3 */ {4,    6, 32,   32, deflate_fast},
 
@@ -166,7 +167,7 @@ local const config configuration_table[10] = {
 
 /* Note: the deflate() code requires max_lazy >= MIN_MATCH and max_chain >= 4
  * For deflate_fast() (levels <= 3) good is ignored and lazy has a different
- * meaning.
+ * meaning. deflate_quick() (level 1) ignores all four.
  */
 
 #define EQUAL 0
@@ -1830,7 +1831,124 @@ local block_state deflate_fast(s, flush, clas)
 
 #ifndef FASTEST
 /* ===========================================================================
- * Same as above, but achieves better compression. We use a lazy
+ * Return the number of bytes, at most max, that the strings at scan and match
+ * have in common. This compares eight bytes at a time on 64-bit targets that
+ * have cheap unaligned loads; up to seven bytes past max may be read, which
+ * the window padding allows for.
+ */
+local INLINE uInt quick_match_len(scan, match, max)
+    const Bytef *scan;
+    const Bytef *match;
+    uInt max;
+{
+    uInt len = 0;
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__aarch64__))
+    unsigned long long a, b;
+
+    while (len < max) {
+        zmemcpy(&a, scan + len, sizeof(a));
+        zmemcpy(&b, match + len, sizeof(b));
+        if (a != b) {
+            len += (uInt)__builtin_ctzll(a ^ b) >> 3;
+            break;
+        }
+        len += 8;
+    }
+    return len < max ? len : max;
+#else
+    while (len < max && scan[len] == match[len])
+        len++;
+    return len;
+#endif
+}
+
+/* ===========================================================================
+ * Compress as much as possible from the input stream, return the current
+ * block state.
+ * This is the level 1 strategy, for compressing on the fly. It looks up each
+ * string in the hash table once and takes the match found there, if any,
+ * instead of walking the hash chain, and does not insert the strings inside a
+ * match. With SSE4.2, insert_string() hashes four bytes with crc32 below level
+ * 6, so the one candidate is rarely a false hit.
+ */
+local block_state deflate_quick(s, flush, clas)
+    deflate_state *s;
+    int flush;
+    int clas;
+{
+    IPos hash_head;       /* head of the hash chain */
+    int bflush;           /* set if current block must be flushed */
+    uInt match_dist;      /* distance of the match, if any */
+    uInt match_len;       /* length of the match, or 0 */
+
+    if (clas != 0) {
+        /* We haven't patched this code for alternative class data. */
+        return Z_BUF_ERROR;
+    }
+
+    for (;;) {
+        /* Make sure that we always have enough lookahead, except
+         * at the end of the input file. We need MAX_MATCH bytes
+         * for the next match, plus MIN_MATCH bytes to insert the
+         * string following the next match.
+         */
+        if (s->lookahead < MIN_LOOKAHEAD) {
+            fill_window(s);
+            if (s->lookahead < MIN_LOOKAHEAD && flush == Z_NO_FLUSH) {
+                return need_more;
+            }
+            if (s->lookahead == 0) break; /* flush the current block */
+        }
+
+        /* Insert the string window[strstart .. strstart+2] in the
+         * dictionary, and take the previous string with the same hash
+         * if it matches. As in deflate_fast(), matches with the string of
+         * window index 0 are not allowed.
+         */
+        match_len = 0;
+        if (s->lookahead >= MIN_MATCH) {
+            hash_head = insert_string(s, s->strstart);
+            match_dist = s->strstart - hash_head;
+            if (hash_head != NIL && match_dist <= MAX_DIST(s)) {
+                match_len = quick_match_len(s->window + s->strstart,
+                                            s->window + hash_head,
+                                            s->lookahead < MAX_MATCH ?
+                                            s->lookahead : MAX_MATCH);
+                if (match_len == MIN_MATCH && match_dist > TOO_FAR)
+                    match_len = 0;
+            }
+        }
+
+        if (match_len >= MIN_MATCH) {
+            check_match(s, s->strstart, s->strstart - match_dist, match_len);
+
+            _tr_tally_dist(s, match_dist, match_len - MIN_MATCH, bflush);
+
+            s->lookahead -= match_len;
+            s->strstart += match_len;
+            s->ins_h = s->window[s->strstart];
+            UPDATE_HASH(s, s->ins_h, s->window[s->strstart+1]);
+#if MIN_MATCH != 3
+            Call UPDATE_HASH() MIN_MATCH-3 more times
+#endif
+            /* If lookahead < MIN_MATCH, ins_h is garbage, but it does not
+             * matter since it will be recomputed at next deflate call.
+             */
+        } else {
+            /* No match, output a literal byte */
+            Tracevv((stderr,"%c", s->window[s->strstart]));
+            _tr_tally_lit (s, s->window[s->strstart], bflush);
+            s->lookahead--;
+            s->strstart++;
+        }
+        if (bflush) FLUSH_BLOCK(s, 0);
+    }
+    FLUSH_BLOCK(s, flush == Z_FINISH);
+    return flush == Z_FINISH ? finish_done : block_done;
+}
+
+/* ===========================================================================
+ * Same as deflate_fast(), but achieves better compression. We use a lazy
  * evaluation for matches: a match is finally adopted only if there is
  * no better match at the next window position.
  */
@@ -60,6 +60,15 @@
 #  endif
 #endif
 
+/* seek on the file descriptor, with 64-bit offsets if available */
+#if defined(_WIN32) && !defined(__BORLANDC__)
+#  define LSEEK (z_off64_t)_lseeki64
+#elif defined(_LARGEFILE64_SOURCE) && _LFS64_LARGEFILE-0
+#  define LSEEK lseek64
+#else
+#  define LSEEK lseek
+#endif
+
 /* provide prototypes for these when building zlib without LFS */
 #if !defined(_LARGEFILE64_SOURCE) || _LFS64_LARGEFILE-0 == 0
     ZEXTERN gzFile ZEXPORT gzopen64 OF((const char *, const char *));
@@ -101,9 +110,13 @@ typedef struct {
     z_off64_t raw;          /* where the raw data started, for seeking */
     int how;                /* 0: get header, 1: copy, 2: decompress */
     int direct;             /* true if last read direct, false if gzip */
+    struct gz_index_s *index;   /* access points for seeking, or NULL */
         /* just for writing */
     int level;              /* compression level */
     int strategy;           /* compression strategy */
+    int threads;            /* compression threads, see gzsetparallel() */
+    unsigned block;         /* input block size for parallel compression */
+    struct gz_par_s *par;   /* parallel compression state, or NULL */
         /* seek request */
     z_off64_t skip;         /* amount to skip (already rewound if backwards) */
     int seek;               /* true if seek request pending */
@@ -117,6 +130,7 @@ typedef gz_state FAR *gz_statep;
 
 /* shared functions */
 void ZLIB_INTERNAL gz_error OF((gz_statep, int, const char *));
+int ZLIB_INTERNAL gz_index_seek OF((gz_statep, z_off64_t));
 #if defined UNDER_CE
 char ZLIB_INTERNAL *gz_strwinerror OF((DWORD error));
 #endif
@@ -5,14 +5,6 @@
 
 #include "gzguts.h"
 
-#if defined(_WIN32) && !defined(__BORLANDC__)
-#  define LSEEK (z_off64_t)_lseeki64
-#elif defined(_LARGEFILE64_SOURCE) && _LFS64_LARGEFILE-0
-#  define LSEEK lseek64
-#else
-#  define LSEEK lseek
-#endif
-
 /* Local functions */
 local void gz_reset OF((gz_statep));
 local gzFile gz_open OF((const char *, int, const char *));
@@ -105,6 +97,10 @@ local gzFile gz_open(path, fd, mode)
     state->mode = GZ_NONE;
     state->level = Z_DEFAULT_COMPRESSION;
     state->strategy = Z_DEFAULT_STRATEGY;
+    state->threads = 1;         /* compress on the calling thread */
+    state->block = 0;
+    state->par = NULL;
+    state->index = NULL;        /* no access points for seeking */
     while (*mode) {
         if (*mode >= '0' && *mode <= '9')
             state->level = *mode - '0';
@@ -320,6 +316,15 @@ z_off64_t ZEXPORT gzseek64(file, offset, whence)
         return state->pos;
     }
 
+    /* if reading with an index, start from the closest access point */
+    if (state->mode == GZ_READ && state->index != NULL &&
+        state->pos + offset >= 0) {
+        ret = state->pos + offset;
+        if (gz_index_seek(state, ret) == -1)
+            return -1;
+        offset = ret - state->pos;
+    }
+
     /* calculate skip amount, rewinding if needed for back seek when reading */
     if (offset < 0) {
         if (state->mode != GZ_READ)         /* writing -- can't go backwards */
@@ -13,6 +13,39 @@ local int gz_head OF((gz_statep));
 local int gz_decomp OF((gz_statep));
 local int gz_make OF((gz_statep));
 local int gz_skip OF((gz_statep, z_off64_t));
+local int gz_index_update OF((gz_statep, unsigned char *, unsigned));
+local void gz_index_free OF((gz_statep));
+
+/* Access points for gzseek(), see gzbuildindex() in zlib.h.  An access point
+   is a deflate block boundary, where inflate() can be restarted from the bit
+   offset in the compressed data and the 32K of uncompressed data before it,
+   as in examples/zran.c.  Each point also saves the running check value and
+   length of its gzip member so that the trailer can still be verified. */
+#define GZ_WINSIZE 32768U       /* window size */
+#define GZ_SPAN 1048576L        /* default distance between access points */
+
+typedef struct {
+    z_off64_t out;          /* offset in the uncompressed data */
+    z_off64_t in;           /* offset of the next compressed byte after start */
+    int bits;               /* bits of the byte before in left to use, 0..7 */
+    unsigned long check;    /* crc32() of the gzip member up to out */
+    unsigned long total;    /* length of the gzip member up to out, mod 2^32 */
+    unsigned have;          /* length of window, at most GZ_WINSIZE */
+    unsigned char *window;  /* uncompressed data just before out */
+} gz_point;
+
+struct gz_index_s {
+    int have;               /* number of access points */
+    int size;               /* allocated size of list */
+    gz_point *list;         /* access points in order of out */
+        /* just for building */
+    int build;              /* true while gzbuildindex() is reading */
+    z_off64_t span;         /* minimum distance between access points */
+    z_off64_t last;         /* out of the last access point, or 0 */
+    unsigned char *window;  /* last GZ_WINSIZE bytes of output, circular */
+    unsigned next;          /* where to write next in window */
+    unsigned whave;         /* bytes in window */
+};
 
 /* Use read() to load a buffer -- return -1 on error, otherwise 0.  Read from
    state->fd, and update state->eof, state->err, and state->msg as appropriate.
@@ -233,11 +266,15 @@ local int gz_head(state)
 local int gz_decomp(state)
     gz_statep state;
 {
-    int ret;
+    int ret, flush;
     unsigned had;
     unsigned long crc, len;
+    unsigned char *next;
     z_streamp strm = &(state->strm);
 
+    /* stop at each block boundary if building an index */
+    flush = state->index != NULL && state->index->build ? Z_BLOCK : Z_NO_FLUSH;
+
     /* fill output buffer up to end of deflate stream */
     had = strm->avail_out;
     do {
@@ -250,7 +287,8 @@ local int gz_decomp(state)
         }
 
         /* decompress and handle errors */
-        ret = inflate(strm, Z_NO_FLUSH);
+        next = strm->next_out;
+        ret = inflate(strm, flush);
         if (ret == Z_STREAM_ERROR || ret == Z_NEED_DICT) {
             gz_error(state, Z_STREAM_ERROR,
                       "internal error: inflate stream corrupt");
@@ -265,6 +303,8 @@ local int gz_decomp(state)
                       strm->msg == NULL ? "compressed data error" : strm->msg);
             return -1;
         }
+        if (flush == Z_BLOCK && gz_index_update(state, next, had) == -1)
+            return -1;
     } while (strm->avail_out && ret != Z_STREAM_END);
 
     /* update available output and crc check value */
@@ -358,6 +398,404 @@ local int gz_skip(state, len)
     return 0;
 }
 
+/* While building an index, keep the last GZ_WINSIZE bytes of the output that
+   inflate() just wrote from next, and add an access point if inflate() stopped
+   at a block boundary at least span bytes after the last point.  had is
+   strm->avail_out at the start of gz_decomp().  Return -1 on error, 0 on
+   success. */
+local int gz_index_update(state, next, had)
+    gz_statep state;
+    unsigned char *next;
+    unsigned had;
+{
+    unsigned n, copy;
+    z_off64_t in, out;
+    gz_point *point;
+    struct gz_index_s *index = state->index;
+    z_streamp strm = &(state->strm);
+
+    /* update the window */
+    n = (unsigned)(strm->next_out - next);
+    if (n >= GZ_WINSIZE) {
+        memcpy(index->window, strm->next_out - GZ_WINSIZE, GZ_WINSIZE);
+        index->next = 0;
+        index->whave = GZ_WINSIZE;
+    }
+    else if (n) {
+        copy = GZ_WINSIZE - index->next;
+        if (copy > n)
+            copy = n;
+        memcpy(index->window + index->next, next, copy);
+        memcpy(index->window, next + copy, n - copy);
+        index->next = (index->next + n) & (GZ_WINSIZE - 1);
+        index->whave = index->whave + n > GZ_WINSIZE ? GZ_WINSIZE :
+                       index->whave + n;
+    }
+
+    /* add an access point if at a block boundary that is not the end */
+    out = state->pos + (had - strm->avail_out);
+    if ((strm->data_type & 192) != 128 || out - index->last < index->span)
+        return 0;
+    in = LSEEK(state->fd, 0, SEEK_CUR);
+    if (in == -1) {
+        gz_error(state, Z_ERRNO, zstrerror());
+        return -1;
+    }
+    if (index->have == index->size) {
+        n = index->size ? index->size << 1 : 16;
+        point = realloc(index->list, n * sizeof(gz_point));
+        if (point == NULL) {
+            gz_error(state, Z_MEM_ERROR, "out of memory");
+            return -1;
+        }
+        index->list = point;
+        index->size = n;
+    }
+    point = index->list + index->have;
+    point->window = malloc(index->whave);
+    if (point->window == NULL) {
+        gz_error(state, Z_MEM_ERROR, "out of memory");
+        return -1;
+    }
+    point->have = index->whave;
+    n = index->whave - index->next;         /* oldest bytes are at next */
+    if (index->whave == GZ_WINSIZE) {
+        memcpy(point->window, index->window + index->next, n);
+        memcpy(point->window + n, index->window, index->next);
+    }
+    else
+        memcpy(point->window, index->window, index->whave);
+    point->out = out;
+    point->in = in - strm->avail_in - state->start;
+    point->bits = strm->data_type & 7;
+    n = had - strm->avail_out;
+    point->check = crc32(strm->adler, strm->next_out - n, n);
+    point->total = strm->total_out;
+    index->have++;
+    index->last = out;
+    return 0;
+}
+
+/* Free the index of state, if any. */
+local void gz_index_free(state)
+    gz_statep state;
+{
+    struct gz_index_s *index = state->index;
+
+    if (index == NULL)
+        return;
+    while (index->have)
+        free(index->list[--index->have].window);
+    free(index->list);
+    free(index->window);
+    free(index);
+    state->index = NULL;
+}
+
+/* Start decompressing at the closest access point at or before pos, if that
+   is closer than the current position.  Return 1 if state->pos was moved to
+   an access point, 0 if not, or -1 on error. */
+int ZLIB_INTERNAL gz_index_seek(state, pos)
+    gz_statep state;
+    z_off64_t pos;
+{
+    int lo, hi, mid, ch;
+    gz_point *point;
+    struct gz_index_s *index = state->index;
+    z_streamp strm = &(state->strm);
+
+    /* find the last access point at or before pos */
+    lo = -1;
+    hi = index->have;
+    while (hi - lo > 1) {
+        mid = (lo + hi) >> 1;
+        if (index->list[mid].out <= pos)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    if (lo < 0)
+        return 0;
+    point = index->list + lo;
+    if (pos >= state->pos && point->out <= state->pos)
+        return 0;                       /* reading on is as good */
+
+    /* allocate buffers and inflate memory if this is the first time in */
+    if (state->size == 0 && gz_head(state) == -1)
+        return -1;
+    if (state->size == 0)
+        return 0;
+
+    /* go to the byte with the first bits to use, and reset the state */
+    if (LSEEK(state->fd, state->start + point->in - (point->bits ? 1 : 0),
+              SEEK_SET) == -1) {
+        gz_error(state, Z_ERRNO, zstrerror());
+        return -1;
+    }
+    state->have = 0;
+    state->eof = 0;
+    state->seek = 0;
+    gz_error(state, Z_OK, NULL);
+    strm->avail_in = 0;
+
+    /* restart inflate at the access point */
+    inflateReset(strm);
+    if (point->bits) {
+        ch = NEXT();
+        if (ch == -1) {
+            if (state->err == Z_OK)
+                gz_error(state, Z_DATA_ERROR, "unexpected end of file");
+            return -1;
+        }
+        inflatePrime(strm, point->bits, ch >> (8 - point->bits));
+    }
+    inflateSetDictionary(strm, point->window, point->have);
+    strm->adler = point->check;
+    strm->total_out = point->total;
+    state->how = GZIP;
+    state->direct = 0;
+    state->pos = point->out;
+    return 1;
+}
+
+/* -- see zlib.h -- */
+int ZEXPORT gzbuildindex(file, span)
+    gzFile file;
+    unsigned long span;
+{
+    struct gz_index_s *index;
+    gz_statep state;
+    z_streamp strm;
+
+    /* get internal structure */
+    if (file == NULL)
+        return -1;
+    state = (gz_statep)file;
+    strm = &(state->strm);
+
+    /* check that we're reading and that there's no error */
+    if (state->mode != GZ_READ || state->err != Z_OK)
+        return -1;
+
+    /* start over with an empty index */
+    if (gzrewind(file) == -1)
+        return -1;
+    gz_index_free(state);
+    index = malloc(sizeof(struct gz_index_s));
+    if (index == NULL) {
+        gz_error(state, Z_MEM_ERROR, "out of memory");
+        return -1;
+    }
+    index->window = malloc(GZ_WINSIZE);
+    if (index->window == NULL) {
+        free(index);
+        gz_error(state, Z_MEM_ERROR, "out of memory");
+        return -1;
+    }
+    index->have = 0;
+    index->size = 0;
+    index->list = NULL;
+    index->build = 1;
+    index->span = span ? (z_off64_t)span : GZ_SPAN;
+    index->last = 0;
+    index->next = 0;
+    index->whave = 0;
+    state->index = index;
+
+    /* decompress the whole file, adding access points along the way */
+    do {
+        state->pos += state->have;
+        state->have = 0;
+        if (gz_make(state) == -1) {
+            gz_index_free(state);
+            return -1;
+        }
+    } while (state->have || !(state->eof && strm->avail_in == 0));
+
+    /* done building -- go back to the start */
+    index->build = 0;
+    free(index->window);
+    index->window = NULL;
+    return gzrewind(file);
+}
+
+/* Write val to out as four bytes, least significant first.  Return -1 on
+   error, 0 on success. */
+local int gz_put4(out, val)
+    FILE *out;
+    unsigned long val;
+{
+    unsigned char buf[4];
+
+    buf[0] = (unsigned char)val;
+    buf[1] = (unsigned char)(val >> 8);
+    buf[2] = (unsigned char)(val >> 16);
+    buf[3] = (unsigned char)(val >> 24);
+    return fwrite(buf, 1, 4, out) == 4 ? 0 : -1;
+}
+
+/* Read four bytes, least significant first, from in to *val.  Return -1 on
+   error, 0 on success. */
+local int gz_get4(in, val)
+    FILE *in;
+    unsigned long *val;
+{
+    unsigned char buf[4];
+
+    if (fread(buf, 1, 4, in) != 4)
+        return -1;
+    *val = buf[0] + ((unsigned)buf[1] << 8) + ((unsigned long)buf[2] << 16) +
+           ((unsigned long)buf[3] << 24);
+    return 0;
+}
+
+/* Write a non-negative offset to out as eight bytes.  Return -1 on error, 0
+   on success. */
+local int gz_put_off(out, off)
+    FILE *out;
+    z_off64_t off;
+{
+    return gz_put4(out, (unsigned long)(off & 0xffffffffUL)) == -1 ||
+           gz_put4(out, (unsigned long)((off >> 16) >> 16)) == -1 ? -1 : 0;
+}
+
+/* Read an offset written by gz_put_off() from in to *off.  Return -1 on
+   error or if the offset does not fit in z_off64_t, 0 on success. */
+local int gz_get_off(in, off)
+    FILE *in;
+    z_off64_t *off;
+{
+    unsigned long low, high;
+
+    if (gz_get4(in, &low) == -1 || gz_get4(in, &high) == -1 ||
+        high > 0x7fffffffUL || (sizeof(z_off64_t) < 8 &&
+                                (high || low > 0x7fffffffUL)))
+        return -1;
+    *off = (((z_off64_t)high << 16) << 16) + (z_off64_t)low;
+    return 0;
+}
+
+/* -- see zlib.h -- */
+int ZEXPORT gzsaveindex(file, path)
+    gzFile file;
+    const char *path;
+{
+    int k, ret;
+    gz_point *point;
+    gz_statep state;
+    FILE *out;
+
+    /* get internal structure and check that there's an index */
+    if (file == NULL || path == NULL)
+        return -1;
+    state = (gz_statep)file;
+    if (state->mode != GZ_READ || state->index == NULL ||
+        state->index->build)
+        return -1;
+
+    /* write "gzix", the number of access points, and the access points */
+    out = fopen(path, "wb");
+    if (out == NULL)
+        return -1;
+    ret = fwrite("gzix", 1, 4, out) == 4 ? 0 : -1;
+    if (ret == 0)
+        ret = gz_put4(out, (unsigned long)state->index->have);
+    for (k = 0; k < state->index->have && ret == 0; k++) {
+        point = state->index->list + k;
+        if (gz_put_off(out, point->out) == -1 ||
+            gz_put_off(out, point->in) == -1 ||
+            putc(point->bits, out) == EOF ||
+            gz_put4(out, point->check) == -1 ||
+            gz_put4(out, point->total) == -1 ||
+            gz_put4(out, point->have) == -1 ||
+            fwrite(point->window, 1, point->have, out) != point->have)
+            ret = -1;
+    }
+    if (fclose(out) != 0)
+        ret = -1;
+    return ret;
+}
+
+/* -- see zlib.h -- */
+int ZEXPORT gzloadindex(file, path)
+    gzFile file;
+    const char *path;
+{
+    unsigned long count, have;
+    unsigned char magic[4];
+    gz_point *point;
+    struct gz_index_s *index;
+    gz_statep state;
+    FILE *in;
+
+    /* get internal structure */
+    if (file == NULL || path == NULL)
+        return -1;
+    state = (gz_statep)file;
+    if (state->mode != GZ_READ)
+        return -1;
+
+    /* read the header and allocate the index */
+    in = fopen(path, "rb");
+    if (in == NULL)
+        return -1;
+    index = NULL;
+    if (fread(magic, 1, 4, in) != 4 || memcmp(magic, "gzix", 4) ||
+        gz_get4(in, &count) == -1 ||
+        count > 0x7fffffffUL / sizeof(gz_point))
+        goto bad;
+    index = malloc(sizeof(struct gz_index_s));
+    if (index == NULL)
+        goto bad;
+    index->have = 0;
+    index->size = (int)count;
+    index->list = malloc(count ? count * sizeof(gz_point) : 1);
+    index->build = 0;
+    index->window = NULL;
+    if (index->list == NULL)
+        goto bad;
+
+    /* read the access points, checking that they make sense */
+    while (index->have < index->size) {
+        point = index->list + index->have;
+        if (gz_get_off(in, &point->out) == -1 ||
+            gz_get_off(in, &point->in) == -1 ||
+            (point->bits = getc(in)) == EOF || point->bits > 7 ||
+            (point->bits && point->in == 0) ||
+            (index->have && point->out <= point[-1].out) ||
+            gz_get4(in, &point->check) == -1 ||
+            gz_get4(in, &point->total) == -1 ||
+            gz_get4(in, &have) == -1 || have > GZ_WINSIZE)
+            goto bad;
+        point->have = (unsigned)have;
+        point->window = malloc(have ? have : 1);
+        if (point->window == NULL)
+            goto bad;
+        index->have++;
+        if (fread(point->window, 1, have, in) != have)
+            goto bad;
+    }
+    if (getc(in) != EOF)
+        goto bad;
+    fclose(in);
+
+    /* replace the current index */
+    gz_index_free(state);
+    state->index = index;
+    return 0;
+
+  bad:
+    fclose(in);
+    if (index != NULL) {
+        if (index->list != NULL)
+            while (index->have)
+                free(index->list[--index->have].window);
+        free(index->list);
+        free(index);
+    }
+    return -1;
+}
+
 /* -- see zlib.h -- */
 int ZEXPORT gzread(file, buf, len)
     gzFile file;
@@ -640,6 +1078,7 @@ int ZEXPORT gzclose_r(file)
         return Z_STREAM_ERROR;
 
     /* free memory and close file */
+    gz_index_free(state);
     if (state->size) {
         inflateEnd(&(state->strm));
         free(state->out);
@@ -10,6 +10,515 @@ local int gz_init OF((gz_statep));
 local int gz_comp OF((gz_statep, int));
 local int gz_zero OF((gz_statep, z_off64_t));
 
+/* Parallel compression: see gzsetparallel() in zlib.h.
+
+   The input is cut into blocks of state->block bytes. Each block is
+   compressed as a raw deflate stream by a worker thread, with the last 32K of
+   the input before it as the dictionary, and ends with a sync flush so that
+   it ends on a byte boundary. The last block ends with Z_FINISH instead.
+   Written one after the other, the blocks form one deflate stream, which the
+   calling thread wraps in a gzip header and trailer. The trailer's CRC is put
+   together from the CRCs of the blocks with crc32_combine().
+
+   The calling thread writes the blocks in order as they are done. It waits
+   for the oldest block when 2 * threads blocks are in flight, or when the
+   output is flushed. */
+#ifndef NO_GZPARALLEL
+
+#ifdef _WIN32
+#  include <windows.h>
+   typedef CRITICAL_SECTION gz_lock;
+   typedef CONDITION_VARIABLE gz_cond;
+   typedef HANDLE gz_thread;
+#  define gz_lock_init(l) InitializeCriticalSection(l)
+#  define gz_lock_free(l) DeleteCriticalSection(l)
+#  define gz_lock_get(l) EnterCriticalSection(l)
+#  define gz_lock_put(l) LeaveCriticalSection(l)
+#  define gz_cond_init(c) InitializeConditionVariable(c)
+#  define gz_cond_free(c)
+#  define gz_cond_wait(c, l) SleepConditionVariableCS(c, l, INFINITE)
+#  define gz_cond_wake_all(c) WakeAllConditionVariable(c)
+#else
+#  include <pthread.h>
+   typedef pthread_mutex_t gz_lock;
+   typedef pthread_cond_t gz_cond;
+   typedef pthread_t gz_thread;
+#  define gz_lock_init(l) pthread_mutex_init(l, NULL)
+#  define gz_lock_free(l) pthread_mutex_destroy(l)
+#  define gz_lock_get(l) pthread_mutex_lock(l)
+#  define gz_lock_put(l) pthread_mutex_unlock(l)
+#  define gz_cond_init(c) pthread_cond_init(c, NULL)
+#  define gz_cond_free(c) pthread_cond_destroy(c)
+#  define gz_cond_wait(c, l) pthread_cond_wait(c, l)
+#  define gz_cond_wake_all(c) pthread_cond_broadcast(c)
+#endif
+
+#define GZ_DICT 32768           /* dictionary size, the deflate window */
+#define GZ_BLOCK 131072         /* default block size */
+
+/* operating system in the gzip header, as OS_CODE in zutil.h */
+#if defined(WIN32) && !defined(__CYGWIN__)
+#  define GZ_OS_CODE 0x0b
+#else
+#  define GZ_OS_CODE 0x03
+#endif
+
+/* One block of input and its compressed data */
+typedef struct gz_job_s {
+    struct gz_job_s *next;      /* next job in the work queue or free list */
+    struct gz_job_s *order;     /* next job to write */
+    unsigned char *in;          /* dictionary followed by the block */
+    unsigned dict;              /* length of the dictionary */
+    unsigned len;               /* length of the block */
+    int flush;                  /* Z_SYNC_FLUSH, or Z_FINISH for the last */
+    int level;                  /* compression level for this block */
+    int strategy;               /* compression strategy for this block */
+    unsigned char *out;         /* compressed data */
+    unsigned size;              /* allocated size of out */
+    unsigned have;              /* length of the compressed data */
+    unsigned long check;        /* crc32() of the block */
+    int done;                   /* 1 when compressed, -1 if out of memory */
+} gz_job;
+
+struct gz_par_s {
+        /* shared with the worker threads */
+    gz_lock lock;               /* protects the work queue, stop and done */
+    gz_cond work;               /* signals a queued job or stop */
+    gz_cond done;               /* signals a compressed job */
+    gz_job *head;               /* work queue */
+    gz_job *tail;
+    int stop;                   /* true to make the workers exit */
+        /* only used by the calling thread */
+    int threads;                /* number of worker threads started */
+    gz_thread *tid;             /* worker threads */
+    unsigned block;             /* block size */
+    gz_job *first;              /* jobs not written yet, in order */
+    gz_job *last;
+    int pending;                /* number of jobs from first to last */
+    gz_job *cur;                /* job being filled, or NULL */
+    gz_job *free;               /* jobs to reuse */
+    int started;                /* true if the gzip header was written */
+    unsigned long check;        /* crc32() of the gzip member so far */
+    unsigned long total;        /* length of the gzip member so far */
+};
+
+local void gz_worker OF((struct gz_par_s *));
+local int gz_par_init OF((gz_statep));
+local void gz_par_free OF((gz_statep));
+local int gz_par_comp OF((gz_statep, int));
+
+/* Compress the job on strm, which is reused from job to job. Return 1 on
+   success, or -1 if out of memory. */
+local int gz_compress_job(strm, job, level, strategy)
+    z_streamp strm;
+    gz_job *job;
+    int *level;
+    int *strategy;
+{
+    unsigned char *out;
+
+    deflateReset(strm);
+    if (job->level != *level || job->strategy != *strategy) {
+        if (deflateParams(strm, job->level, job->strategy) != Z_OK)
+            return -1;
+        *level = job->level;
+        *strategy = job->strategy;
+    }
+    if (job->dict)
+        deflateSetDictionary(strm, job->in, job->dict);
+
+    strm->next_in = job->in + job->dict;
+    strm->avail_in = job->len;
+    job->have = 0;
+    do {
+        if (job->have == job->size) {
+            out = realloc(job->out, job->size << 1);
+            if (out == NULL)
+                return -1;
+            job->out = out;
+            job->size <<= 1;
+        }
+        strm->next_out = job->out + job->have;
+        strm->avail_out = job->size - job->have;
+        (void)deflate(strm, job->flush);
+        job->have = job->size - strm->avail_out;
+    } while (strm->avail_out == 0);
+
+    job->check = crc32(crc32(0L, Z_NULL, 0), job->in + job->dict, job->len);
+    return 1;
+}
+
+/* Worker thread: compress queued jobs until told to stop. */
+local void gz_worker(par)
+    struct gz_par_s *par;
+{
+    z_stream strm;
+    int ok, done;
+    int level = Z_DEFAULT_COMPRESSION, strategy = Z_DEFAULT_STRATEGY;
+    gz_job *job;
+
+    strm.zalloc = Z_NULL;
+    strm.zfree = Z_NULL;
+    strm.opaque = Z_NULL;
+    ok = deflateInit2(&strm, level, Z_DEFLATED, -15, 8, strategy) == Z_OK;
+
+    for (;;) {
+        gz_lock_get(&par->lock);
+        while (par->head == NULL && !par->stop)
+            gz_cond_wait(&par->work, &par->lock);
+        job = par->head;
+        if (job == NULL) {
+            gz_lock_put(&par->lock);
+            break;
+        }
+        par->head = job->next;
+        if (par->head == NULL)
+            par->tail = NULL;
+        gz_lock_put(&par->lock);
+
+        done = ok ? gz_compress_job(&strm, job, &level, &strategy) : -1;
+
+        gz_lock_get(&par->lock);
+        job->done = done;
+        gz_cond_wake_all(&par->done);
+        gz_lock_put(&par->lock);
+    }
+
+    if (ok)
+        (void)deflateEnd(&strm);
+}
+
+#ifdef _WIN32
+local DWORD WINAPI gz_worker_main(LPVOID par)
+{
+    gz_worker((struct gz_par_s *)par);
+    return 0;
+}
+#else
+local void *gz_worker_main(void *par)
+{
+    gz_worker((struct gz_par_s *)par);
+    return NULL;
+}
+#endif
+
+/* Start the worker threads. Return -1 on failure or 0 on success. */
+local int gz_par_init(state)
+    gz_statep state;
+{
+    struct gz_par_s *par;
+    int n;
+
+    par = malloc(sizeof(struct gz_par_s));
+    if (par == NULL)
+        return -1;
+    memset(par, 0, sizeof(struct gz_par_s));
+    par->tid = malloc(state->threads * sizeof(gz_thread));
+    if (par->tid == NULL) {
+        free(par);
+        return -1;
+    }
+    gz_lock_init(&par->lock);
+    gz_cond_init(&par->work);
+    gz_cond_init(&par->done);
+    par->block = state->block;
+    par->check = crc32(0L, Z_NULL, 0);
+    state->par = par;
+
+    for (n = 0; n < state->threads; n++) {
+#ifdef _WIN32
+        par->tid[n] = CreateThread(NULL, 0, gz_worker_main, par, 0, NULL);
+        if (par->tid[n] == NULL)
+            break;
+#else
+        if (pthread_create(par->tid + n, NULL, gz_worker_main, par) != 0)
+            break;
+#endif
+    }
+    par->threads = n;
+    if (n < state->threads) {
+        gz_par_free(state);
+        return -1;
+    }
+    return 0;
+}
+
+/* Stop the worker threads and free the parallel compression state. */
+local void gz_par_free(state)
+    gz_statep state;
+{
+    struct gz_par_s *par = state->par;
+    gz_job *job, *next;
+    int n;
+
+    gz_lock_get(&par->lock);
+    par->stop = 1;
+    gz_cond_wake_all(&par->work);
+    gz_lock_put(&par->lock);
+    for (n = 0; n < par->threads; n++) {
+#ifdef _WIN32
+        WaitForSingleObject(par->tid[n], INFINITE);
+        CloseHandle(par->tid[n]);
+#else
+        pthread_join(par->tid[n], NULL);
+#endif
+    }
+
+    /* after an error, jobs may be left in the write order */
+    if (par->cur != NULL) {
+        par->cur->order = par->first;
+        par->first = par->cur;
+    }
+    for (job = par->first; job != NULL; job = next) {
+        next = job->order;
+        job->next = par->free;
+        par->free = job;
+    }
+    for (job = par->free; job != NULL; job = next) {
+        next = job->next;
+        free(job->out);
+        free(job->in);
+        free(job);
+    }
+
+    gz_cond_free(&par->done);
+    gz_cond_free(&par->work);
+    gz_lock_free(&par->lock);
+    free(par->tid);
+    free(par);
+    state->par = NULL;
+}
+
+/* Return an empty job, or NULL if out of memory. */
+local gz_job *gz_par_job(state)
+    gz_statep state;
+{
+    struct gz_par_s *par = state->par;
+    gz_job *job;
+
+    job = par->free;
+    if (job != NULL)
+        par->free = job->next;
+    else {
+        job = malloc(sizeof(gz_job));
+        if (job == NULL) {
+            gz_error(state, Z_MEM_ERROR, "out of memory");
+            return NULL;
+        }
+        job->size = par->block + (par->block >> 3) + 64;
+        job->in = malloc(GZ_DICT + par->block);
+        job->out = malloc(job->size);
+        if (job->in == NULL || job->out == NULL) {
+            free(job->out);
+            free(job->in);
+            free(job);
+            gz_error(state, Z_MEM_ERROR, "out of memory");
+            return NULL;
+        }
+    }
+    job->dict = 0;
+    job->len = 0;
+    return job;
+}
+
+/* Write a compressed job to the output file, preceded by the gzip header if
+   it is the first of a gzip member, and followed by the trailer if it is the
+   last. Return -1 on error or 0 on success. */
+local int gz_par_write(state, job)
+    gz_statep state;
+    gz_job *job;
+{
+    struct gz_par_s *par = state->par;
+    unsigned char buf[10];
+    int got;
+
+    if (!par->started) {
+        buf[0] = 0x1f;
+        buf[1] = 0x8b;
+        buf[2] = Z_DEFLATED;
+        buf[3] = 0;                     /* flags */
+        buf[4] = buf[5] = buf[6] = buf[7] = 0;      /* no time stamp */
+        buf[8] = state->level == 9 ? 2 :
+                 (state->strategy >= Z_HUFFMAN_ONLY || (state->level >= 0 &&
+                  state->level < 2) ? 4 : 0);
+        buf[9] = GZ_OS_CODE;
+        if ((got = write(state->fd, buf, 10)) != 10)
+            goto error;
+        par->started = 1;
+    }
+
+    if (job->have && ((got = write(state->fd, job->out, job->have)) < 0 ||
+                      (unsigned)got != job->have))
+        goto error;
+    par->check = crc32_combine(par->check, job->check, job->len);
+    par->total += job->len;
+
+    if (job->flush == Z_FINISH) {
+        buf[0] = (unsigned char)par->check;
+        buf[1] = (unsigned char)(par->check >> 8);
+        buf[2] = (unsigned char)(par->check >> 16);
+        buf[3] = (unsigned char)(par->check >> 24);
+        buf[4] = (unsigned char)par->total;
+        buf[5] = (unsigned char)(par->total >> 8);
+        buf[6] = (unsigned char)(par->total >> 16);
+        buf[7] = (unsigned char)(par->total >> 24);
+        if ((got = write(state->fd, buf, 8)) != 8)
+            goto error;
+        par->started = 0;
+        par->check = crc32(0L, Z_NULL, 0);
+        par->total = 0;
+    }
+
+    job->next = par->free;
+    par->free = job;
+    return 0;
+
+  error:
+    job->next = par->free;
+    par->free = job;
+    gz_error(state, Z_ERRNO, got < 0 ? zstrerror() : "write error");
+    return -1;
+}
+
+/* Write the compressed jobs at the front of the write order. If all is true,
+   wait for all of them, otherwise only while too many are in flight. Return
+   -1 on error or 0 on success. */
+local int gz_par_flush(state, all)
+    gz_statep state;
+    int all;
+{
+    struct gz_par_s *par = state->par;
+    gz_job *job;
+    int done;
+
+    while ((job = par->first) != NULL) {
+        gz_lock_get(&par->lock);
+        if (all || par->pending >= 2 * par->threads) {
+            while (job->done == 0)
+                gz_cond_wait(&par->done, &par->lock);
+        }
+        done = job->done;
+        gz_lock_put(&par->lock);
+        if (done == 0)
+            break;
+
+        par->first = job->order;
+        if (par->first == NULL)
+            par->last = NULL;
+        par->pending--;
+        if (done < 0) {
+            job->next = par->free;
+            par->free = job;
+            gz_error(state, Z_MEM_ERROR, "out of memory");
+            return -1;
+        }
+        if (gz_par_write(state, job) == -1)
+            return -1;
+    }
+    return 0;
+}
+
+/* Queue the current job for compression. flush is Z_SYNC_FLUSH, Z_FULL_FLUSH
+   or Z_FINISH. After Z_SYNC_FLUSH, the next job is started with the end of
+   this one as its dictionary. Return -1 on error or 0 on success. */
+local int gz_par_queue(state, flush)
+    gz_statep state;
+    int flush;
+{
+    struct gz_par_s *par = state->par;
+    gz_job *job = par->cur, *next;
+    unsigned n;
+
+    job->flush = flush == Z_FINISH ? Z_FINISH : Z_SYNC_FLUSH;
+    job->level = state->level;
+    job->strategy = state->strategy;
+    job->done = 0;
+    job->next = NULL;
+    job->order = NULL;
+
+    par->cur = NULL;
+    if (flush == Z_SYNC_FLUSH) {
+        next = gz_par_job(state);
+        if (next == NULL)
+            return -1;
+        n = job->dict + job->len;
+        if (n > GZ_DICT)
+            n = GZ_DICT;
+        memcpy(next->in, job->in + job->dict + job->len - n, n);
+        next->dict = n;
+        par->cur = next;
+    }
+
+    gz_lock_get(&par->lock);
+    if (par->tail == NULL)
+        par->head = job;
+    else
+        par->tail->next = job;
+    par->tail = job;
+    gz_cond_wake_all(&par->work);
+    gz_lock_put(&par->lock);
+
+    if (par->last == NULL)
+        par->first = job;
+    else
+        par->last->order = job;
+    par->last = job;
+    par->pending++;
+
+    return gz_par_flush(state, 0);
+}
+
+/* gz_comp() for parallel compression. Besides the deflate() flush values,
+   flush may be Z_BLOCK to end the current block without waiting for the
+   output, for gzsetparams(). */
+local int gz_par_comp(state, flush)
+    gz_statep state;
+    int flush;
+{
+    struct gz_par_s *par = state->par;
+    z_streamp strm = &(state->strm);
+    gz_job *job;
+    unsigned n;
+
+    /* copy the input into blocks, and queue each full block */
+    while (strm->avail_in) {
+        if (par->cur == NULL && (par->cur = gz_par_job(state)) == NULL)
+            return -1;
+        job = par->cur;
+        n = par->block - job->len;
+        if (n > strm->avail_in)
+            n = strm->avail_in;
+        memcpy(job->in + job->dict + job->len, strm->next_in, n);
+        job->len += n;
+        strm->next_in += n;
+        strm->avail_in -= n;
+        if (job->len == par->block && gz_par_queue(state, Z_SYNC_FLUSH) == -1)
+            return -1;
+    }
+    if (flush == Z_NO_FLUSH)
+        return 0;
+
+    /* end the current block; an empty one is needed to end the member */
+    if (flush == Z_FINISH && par->cur == NULL &&
+        (par->cur = gz_par_job(state)) == NULL)
+        return -1;
+    if (par->cur != NULL) {
+        if (par->cur->len || flush == Z_FINISH) {
+            if (gz_par_queue(state, flush == Z_FINISH ? Z_FINISH :
+                             flush == Z_FULL_FLUSH ? Z_FULL_FLUSH :
+                             Z_SYNC_FLUSH) == -1)
+                return -1;
+        }
+        else if (flush == Z_FULL_FLUSH)
+            par->cur->dict = 0;
+    }
+    if (flush == Z_BLOCK)
+        return 0;
+    return gz_par_flush(state, 1);
+}
+
+#endif /* !NO_GZPARALLEL */
+
 /* Initialize state for writing a gzip file.  Mark initialization by setting
    state->size to non-zero.  Return -1 on failure or 0 on success. */
 local int gz_init(state)
@@ -30,6 +539,14 @@ local int gz_init(state)
         return -1;
     }
 
+#ifndef NO_GZPARALLEL
+    /* start the worker threads, or else compress on this thread */
+    if (state->threads > 1 && gz_par_init(state) == 0) {
+        state->size = state->want;
+        return 0;
+    }
+#endif
+
     /* allocate deflate memory, set up for gzip compression */
     strm->zalloc = Z_NULL;
     strm->zfree = Z_NULL;
@@ -68,6 +585,11 @@ local int gz_comp(state, flush)
     if (state->size == 0 && gz_init(state) == -1)
         return -1;
 
+#ifndef NO_GZPARALLEL
+    if (state->par != NULL)
+        return gz_par_comp(state, flush);
+#endif
+
     /* run deflate() on provided input until it produces no more output */
     ret = Z_OK;
     do {
@@ -485,6 +1007,14 @@ int ZEXPORT gzsetparams(file, level, strategy)
     }
 
     /* change compression parameters for subsequent input */
+#ifndef NO_GZPARALLEL
+    if (state->par != NULL) {
+        /* end the current block, which has the previous parameters */
+        if (gz_comp(state, Z_BLOCK) == -1)
+            return state->err;
+    }
+    else
+#endif
     if (state->size) {
         /* flush previous input with previous parameters before changing */
         if (strm->avail_in && gz_comp(state, Z_PARTIAL_FLUSH) == -1)
@@ -496,6 +1026,39 @@ int ZEXPORT gzsetparams(file, level, strategy)
     return Z_OK;
 }
 
+/* -- see zlib.h -- */
+int ZEXPORT gzsetparallel(file, threads, block)
+    gzFile file;
+    int threads;
+    unsigned block;
+{
+    gz_statep state;
+
+    /* get internal structure and check that we're writing */
+    if (file == NULL)
+        return -1;
+    state = (gz_statep)file;
+    if (state->mode != GZ_WRITE)
+        return -1;
+
+    /* make sure we haven't already allocated memory */
+    if (state->size != 0)
+        return -1;
+
+    /* check and set requested parameters */
+    if (block == 0)
+        block = GZ_BLOCK;
+    if (block < GZ_DICT || block > (1U << 30))
+        return -1;
+#ifdef NO_GZPARALLEL
+    if (threads > 1)
+        return -1;
+#endif
+    state->threads = threads > 1 ? threads : 1;
+    state->block = block;
+    return 0;
+}
+
 /* -- see zlib.h -- */
 int ZEXPORT gzclose_w(file)
     gzFile file;
@@ -520,6 +1083,11 @@ int ZEXPORT gzclose_w(file)
 
     /* flush, free memory, and close file */
     ret += gz_comp(state, Z_FINISH);
+#ifndef NO_GZPARALLEL
+    if (state->par != NULL)
+        gz_par_free(state);
+    else
+#endif
     (void)deflateEnd(&(state->strm));
     free(state->out);
     free(state->in);
@@ -0,0 +1,338 @@
+/* inffast_chunk.c -- fast decoding with a 64-bit bit buffer and chunk copies
+ * Copyright (C) 1995-2008, 2010 Mark Adler
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "zutil.h"
+#include "inftrees.h"
+#include "inflate.h"
+#include "inffast_chunk.h"
+
+#ifdef INFLATE_FAST_CHUNK
+
+/* Size of the unaligned copies used for matches. */
+#define CHUNK 16
+
+/* Returns the next eight bytes of input. The target is little-endian, so
+   the first byte is in the low bits, where the bit buffer wants it.
+ */
+local uint64_t load64(const unsigned char FAR *p)
+{
+    uint64_t v;
+
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+/* Copies CHUNK bytes from src to dst, which may overlap. The compiler turns
+   this into one vector load and one store.
+ */
+local void chunk_copy(unsigned char FAR *dst, const unsigned char FAR *src)
+{
+    unsigned char tmp[CHUNK];
+
+    memcpy(tmp, src, CHUNK);
+    memcpy(dst, tmp, CHUNK);
+}
+
+/* Copies a match of len bytes from dist bytes back in the output, and
+   returns the new end of the output. This may write up to CHUNK - 1 bytes
+   past the end of the match.
+
+   While the distance is shorter than a chunk, each chunk copy would read
+   bytes it has not written yet, so the first bytes are copied a distance at
+   a time. The output repeats every dist bytes, so after each such step the
+   distance can be doubled.
+ */
+local unsigned char FAR *chunk_copy_back(out, dist, len)
+unsigned char FAR *out;
+unsigned dist;
+unsigned len;
+{
+    unsigned char FAR *end = out + len;
+
+    if (dist == 1) {
+        memset(out, out[-1], len);
+        return end;
+    }
+    while (dist < CHUNK && dist < len) {
+        chunk_copy(out, out - dist);
+        out += dist;
+        len -= dist;
+        dist += dist;
+    }
+    do {
+        chunk_copy(out, out - dist);
+        out += CHUNK;
+    } while (out < end);
+    return end;
+}
+
+/*
+   Decode literal, length, and distance codes and write out the resulting
+   literal and match bytes until either not enough input or output is
+   available, an end-of-block is encountered, or a data error is encountered.
+   This is inflate_fast() with two changes that matter on 64-bit targets:
+
+    - The bit buffer is 64 bits wide and is refilled with one unaligned
+      eight byte load at the top of each loop. That leaves at least 56 bits
+      in the buffer, which is enough for a whole length/distance pair (48
+      bits, see inffast.c), so no other refills are needed.
+
+    - Matches are copied CHUNK bytes at a time instead of byte by byte.
+
+   Entry assumptions:
+
+        state->mode == LEN
+        strm->avail_in >= INFLATE_FAST_CHUNK_MIN_INPUT
+        strm->avail_out >= INFLATE_FAST_CHUNK_MIN_OUTPUT
+        start >= strm->avail_out
+        state->bits < 8
+
+   On return, state->mode is one of:
+
+        LEN -- ran out of enough output space or enough available input
+        TYPE -- reached end of block code, inflate() to interpret next block
+        BAD -- error in block data
+
+   Notes:
+
+    - While in < last, at least eight bytes of input are left for the load.
+
+    - While out < end, there is room for a 258 byte match and the CHUNK - 1
+      bytes a chunk copy may write past it. Those bytes are overwritten by
+      later output, or left in the unused part of the output buffer.
+
+    - Copies from the window are exact, so the window is never read past its
+      end.
+ */
+void ZLIB_INTERNAL inflate_fast_chunk(strm, start)
+z_streamp strm;
+unsigned start;         /* inflate()'s starting value for strm->avail_out */
+{
+    struct inflate_state FAR *state;
+    unsigned char FAR *in;      /* local strm->next_in */
+    unsigned char FAR *last;    /* while in < last, enough input available */
+    unsigned char FAR *out;     /* local strm->next_out */
+    unsigned char FAR *beg;     /* inflate()'s initial strm->next_out */
+    unsigned char FAR *end;     /* while out < end, enough space available */
+    unsigned char FAR *in_end;  /* end of the input */
+    unsigned char FAR *out_end; /* end of the output */
+#ifdef INFLATE_STRICT
+    unsigned dmax;              /* maximum distance from zlib header */
+#endif
+    unsigned wsize;             /* window size or zero if not using window */
+    unsigned whave;             /* valid bytes in the window */
+    unsigned wnext;             /* window write index */
+    unsigned char FAR *window;  /* allocated sliding window, if wsize != 0 */
+    uint64_t hold;              /* local strm->hold */
+    unsigned bits;              /* local strm->bits */
+    code const FAR *lcode;      /* local strm->lencode */
+    code const FAR *dcode;      /* local strm->distcode */
+    unsigned lmask;             /* mask for first level of length codes */
+    unsigned dmask;             /* mask for first level of distance codes */
+    code here;                  /* retrieved table entry */
+    unsigned op;                /* code bits, operation, extra bits, or */
+                                /*  window position, window bytes to copy */
+    unsigned len;               /* match length, unused bytes */
+    unsigned dist;              /* match distance */
+    unsigned char FAR *from;    /* where to copy match from */
+
+    /* copy state to local variables */
+    state = (struct inflate_state FAR *)strm->state;
+    in = strm->next_in;
+    in_end = in + strm->avail_in;
+    last = in_end - (INFLATE_FAST_CHUNK_MIN_INPUT - 1);
+    out = strm->next_out;
+    out_end = out + strm->avail_out;
+    beg = out - (start - strm->avail_out);
+    end = out_end - (INFLATE_FAST_CHUNK_MIN_OUTPUT - 1);
+#ifdef INFLATE_STRICT
+    dmax = state->dmax;
+#endif
+    wsize = state->wsize;
+    whave = state->whave;
+    wnext = state->wnext;
+    window = state->window;
+    hold = state->hold;
+    bits = state->bits;
+    lcode = state->lencode;
+    dcode = state->distcode;
+    lmask = (1U << state->lenbits) - 1;
+    dmask = (1U << state->distbits) - 1;
+
+    /* decode literals and length/distances until end-of-block or not enough
+       input data or output space */
+    do {
+        /* Fill the bit buffer to 56 to 63 bits. Bits above bits in hold are
+           either zero or the same input bits loaded again. */
+        hold |= load64(in) << bits;
+        in += (63 - bits) >> 3;
+        bits |= 56;
+
+        here = lcode[hold & lmask];
+      dolen:
+        op = (unsigned)(here.bits);
+        hold >>= op;
+        bits -= op;
+        op = (unsigned)(here.op);
+        if (op == 0) {                          /* literal */
+            Tracevv((stderr, here.val >= 0x20 && here.val < 0x7f ?
+                    "inflate:         literal '%c'\n" :
+                    "inflate:         literal 0x%02x\n", here.val));
+            *out++ = (unsigned char)(here.val);
+        }
+        else if (op & 16) {                     /* length base */
+            len = (unsigned)(here.val);
+            op &= 15;                           /* number of extra bits */
+            if (op) {
+                len += (unsigned)hold & ((1U << op) - 1);
+                hold >>= op;
+                bits -= op;
+            }
+            Tracevv((stderr, "inflate:         length %u\n", len));
+            here = dcode[hold & dmask];
+          dodist:
+            op = (unsigned)(here.bits);
+            hold >>= op;
+            bits -= op;
+            op = (unsigned)(here.op);
+            if (op & 16) {                      /* distance base */
+                dist = (unsigned)(here.val);
+                op &= 15;                       /* number of extra bits */
+                dist += (unsigned)hold & ((1U << op) - 1);
+#ifdef INFLATE_STRICT
+                if (dist > dmax) {
+                    strm->msg = (char *)"invalid distance too far back";
+                    state->mode = BAD;
+                    break;
+                }
+#endif
+                hold >>= op;
+                bits -= op;
+                Tracevv((stderr, "inflate:         distance %u\n", dist));
+                op = (unsigned)(out - beg);     /* max distance in output */
+                if (dist > op) {                /* see if copy from window */
+                    op = dist - op;             /* distance back in window */
+                    if (op > whave) {
+                        if (state->sane) {
+                            strm->msg =
+                                (char *)"invalid distance too far back";
+                            state->mode = BAD;
+                            break;
+                        }
+#ifdef INFLATE_ALLOW_INVALID_DISTANCE_TOOFAR_ARRR
+                        if (len <= op - whave) {
+                            do {
+                                *out++ = 0;
+                            } while (--len);
+                            continue;
+                        }
+                        len -= op - whave;
+                        do {
+                            *out++ = 0;
+                        } while (--op > whave);
+                        if (op == 0) {
+                            from = out - dist;
+                            do {
+                                *out++ = *from++;
+                            } while (--len);
+                            continue;
+                        }
+#endif
+                    }
+                    if (wnext == 0) {           /* very common case */
+                        from = window + wsize - op;
+                        if (op >= len) {
+                            zmemcpy(out, from, len);
+                            out += len;
+                            continue;
+                        }
+                        zmemcpy(out, from, op); /* some from window */
+                        out += op;
+                        len -= op;
+                    }
+                    else if (wnext < op) {      /* wrap around window */
+                        from = window + wsize + wnext - op;
+                        op -= wnext;
+                        if (op >= len) {
+                            zmemcpy(out, from, len);
+                            out += len;
+                            continue;
+                        }
+                        zmemcpy(out, from, op); /* some from end of window */
+                        out += op;
+                        len -= op;
+                        if (wnext >= len) {
+                            zmemcpy(out, window, len);
+                            out += len;
+                            continue;
+                        }
+                        zmemcpy(out, window, wnext);
+                        out += wnext;           /* some from start of window */
+                        len -= wnext;
+                    }
+                    else {                      /* contiguous in window */
+                        from = window + wnext - op;
+                        if (op >= len) {
+                            zmemcpy(out, from, len);
+                            out += len;
+                            continue;
+                        }
+                        zmemcpy(out, from, op); /* some from window */
+                        out += op;
+                        len -= op;
+                    }
+                    out = chunk_copy_back(out, dist, len);  /* rest from
+                                                               output */
+                }
+                else {
+                    out = chunk_copy_back(out, dist, len);
+                }
+            }
+            else if ((op & 64) == 0) {          /* 2nd level distance code */
+                here = dcode[here.val + (hold & ((1U << op) - 1))];
+                goto dodist;
+            }
+            else {
+                strm->msg = (char *)"invalid distance code";
+                state->mode = BAD;
+                break;
+            }
+        }
+        else if ((op & 64) == 0) {              /* 2nd level length code */
+            here = lcode[here.val + (hold & ((1U << op) - 1))];
+            goto dolen;
+        }
+        else if (op & 32) {                     /* end-of-block */
+            Tracevv((stderr, "inflate:         end of block\n"));
+            state->mode = TYPE;
+            break;
+        }
+        else {
+            strm->msg = (char *)"invalid literal/length code";
+            state->mode = BAD;
+            break;
+        }
+    } while (in < last && out < end);
+
+    /* return unused bytes */
+    len = bits >> 3;
+    in -= len;
+    bits -= len << 3;
+    hold &= (1U << bits) - 1;
+
+    /* update state and return */
+    strm->next_in = in;
+    strm->next_out = out;
+    strm->avail_in = (unsigned)(in_end - in);
+    strm->avail_out = (unsigned)(out_end - out);
+    state->hold = (unsigned long)hold;
+    state->bits = bits;
+    return;
+}
+
+#endif /* INFLATE_FAST_CHUNK */
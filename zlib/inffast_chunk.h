@@ -0,0 +1,31 @@
+/* inffast_chunk.h -- header to use inffast_chunk.c
+ * Copyright (C) 1995-2003, 2010 Mark Adler
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+/* WARNING: this file should *not* be used by applications. It is
+   part of the implementation of the compression library and is
+   subject to change. Applications should only use zlib.h.
+ */
+
+/* inflate_fast_chunk() needs a 64-bit little-endian target with unaligned
+   loads and stores, and is used when the CPU feature flag below is set.
+ */
+#if defined(__x86_64__) || defined(_M_X64)
+#  define INFLATE_FAST_CHUNK
+#  define INFLATE_FAST_CHUNK_ENABLED x86_cpu_enable_simd
+#elif defined(__aarch64__) && !defined(__AARCH64EB__)
+#  define INFLATE_FAST_CHUNK
+#  define INFLATE_FAST_CHUNK_ENABLED arm_cpu_enable_neon
+#endif
+
+/* Minimum strm->avail_in and strm->avail_out for inflate_fast_chunk(). It
+   reads eight bytes of input at a time, and may write up to 15 bytes past
+   the end of a 258 byte match.
+ */
+#define INFLATE_FAST_CHUNK_MIN_INPUT 8
+#define INFLATE_FAST_CHUNK_MIN_OUTPUT (258 + 15)
+
+#ifdef INFLATE_FAST_CHUNK
+void ZLIB_INTERNAL inflate_fast_chunk OF((z_streamp strm, unsigned start));
+#endif
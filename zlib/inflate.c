@@ -84,6 +84,8 @@
 #include "inftrees.h"
 #include "inflate.h"
 #include "inffast.h"
+#include "inffast_chunk.h"
+#include "x86.h"
 
 #ifdef MAKEFIXED
 #  ifndef BUILDFIXED
@@ -174,6 +176,8 @@ int stream_size;
     int ret;
     struct inflate_state FAR *state;
 
+    x86_check_features();
+
     if (version == Z_NULL || version[0] != ZLIB_VERSION[0] ||
         stream_size != (int)(sizeof(z_stream)))
         return Z_VERSION_ERROR;
@@ -1004,6 +1008,18 @@ int flush;
         case LEN_:
             state->mode = LEN;
         case LEN:
+#ifdef INFLATE_FAST_CHUNK
+            if (INFLATE_FAST_CHUNK_ENABLED &&
+                have >= INFLATE_FAST_CHUNK_MIN_INPUT &&
+                left >= INFLATE_FAST_CHUNK_MIN_OUTPUT) {
+                RESTORE();
+                inflate_fast_chunk(strm, out);
+                LOAD();
+                if (state->mode == TYPE)
+                    state->back = -1;
+                break;
+            }
+#endif
             if (have >= 6 && left >= 258) {
                 RESTORE();
                 inflate_fast(strm, out);
@@ -71,6 +71,7 @@
 #define gzopen MOZ_Z_gzopen
 #define gzdopen MOZ_Z_gzdopen
 #define gzsetparams MOZ_Z_gzsetparams
+#define gzsetparallel MOZ_Z_gzsetparallel
 #define gzread MOZ_Z_gzread
 #define gzwrite MOZ_Z_gzwrite
 #define gzprintf MOZ_Z_gzprintf
@@ -82,6 +83,9 @@
 #define gzflush MOZ_Z_gzflush
 #define gzseek MOZ_Z_gzseek
 #define gzrewind MOZ_Z_gzrewind
+#define gzbuildindex MOZ_Z_gzbuildindex
+#define gzsaveindex MOZ_Z_gzsaveindex
+#define gzloadindex MOZ_Z_gzloadindex
 #define gztell MOZ_Z_gztell
 #define gzeof MOZ_Z_gzeof
 #define gzclose MOZ_Z_gzclose
@@ -137,6 +141,7 @@
 #define crc32_combine64 MOZ_Z_crc32_combine64
 #define gz_error MOZ_Z_gz_error
 #define gz_intmax MOZ_Z_gz_intmax
+#define gz_index_seek MOZ_Z_gz_index_seek
 #define gz_strwinerror MOZ_Z_gz_strwinerror
 #define gzbuffer MOZ_Z_gzbuffer
 #define gzclose_r MOZ_Z_gzclose_r
@@ -8,6 +8,10 @@
 #include "x86.h"
 
 int x86_cpu_enable_simd = 0;
+int x86_cpu_enable_ssse3 = 0;
+int x86_cpu_enable_avx2 = 0;
+int arm_cpu_enable_neon = 0;
+int arm_cpu_enable_crc32 = 0;
 
 void ZLIB_INTERNAL crc_fold_init(deflate_state *const s) {
     assert(0);
@@ -30,6 +34,66 @@ void ZLIB_INTERNAL fill_window_sse(deflate_state *s)
     assert(0);
 }
 
+#if (defined(__arm__) || defined(__aarch64__)) && defined(__linux__)
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#define AT_HWCAP_ 16
+#define AT_HWCAP2_ 26
+#if defined(__aarch64__)
+#  define HWCAP_NEON_ (1 << 1)      /* HWCAP_ASIMD */
+#  define HWCAP_CRC32_ (1 << 7)     /* HWCAP_CRC32 */
+#else
+#  define HWCAP_NEON_ (1 << 12)     /* HWCAP_NEON */
+#  define HWCAP2_CRC32_ (1 << 4)    /* HWCAP2_CRC32 */
+#endif
+
+static pthread_once_t cpu_check_inited_once = PTHREAD_ONCE_INIT;
+
+/* getauxval() needs Android API level 18, so read the auxiliary vector
+ * from /proc instead.
+ */
+static void _arm_check_features(void)
+{
+    unsigned long hwcap = 0, hwcap2 = 0;
+    unsigned long entry[2];
+    int fd;
+
+    fd = open("/proc/self/auxv", O_RDONLY);
+    if (fd < 0)
+        return;
+    while (read(fd, entry, sizeof(entry)) == sizeof(entry) && entry[0]) {
+        if (entry[0] == AT_HWCAP_)
+            hwcap = entry[1];
+        else if (entry[0] == AT_HWCAP2_)
+            hwcap2 = entry[1];
+    }
+    close(fd);
+
+    /* The kernels are only built when the compiler is allowed to use the
+     * instructions, see adler32_simd.c and crc32_simd.c.
+     */
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    arm_cpu_enable_neon = !!(hwcap & HWCAP_NEON_);
+#endif
+#if defined(__ARM_FEATURE_CRC32)
+#  if defined(__aarch64__)
+    arm_cpu_enable_crc32 = !!(hwcap & HWCAP_CRC32_);
+#  else
+    arm_cpu_enable_crc32 = !!(hwcap2 & HWCAP2_CRC32_);
+#  endif
+#endif
+    (void)hwcap;
+    (void)hwcap2;
+}
+
+void x86_check_features(void)
+{
+    pthread_once(&cpu_check_inited_once, _arm_check_features);
+}
+#else
 void x86_check_features(void)
 {
 }
+#endif
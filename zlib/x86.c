@@ -11,6 +11,10 @@
 #include "x86.h"
 
 int x86_cpu_enable_simd = 0;
+int x86_cpu_enable_ssse3 = 0;
+int x86_cpu_enable_avx2 = 0;
+int arm_cpu_enable_neon = 0;
+int arm_cpu_enable_crc32 = 0;
 
 #ifndef _MSC_VER
 #include <pthread.h>
@@ -23,35 +27,74 @@ void x86_check_features(void)
   pthread_once(&cpu_check_inited_once, _x86_check_features);
 }
 
-static void _x86_check_features(void)
+static void _x86_cpuid(unsigned leaf, unsigned regs[4])
 {
-    int x86_cpu_has_sse2;
-    int x86_cpu_has_sse42;
-    int x86_cpu_has_pclmulqdq;
-    unsigned eax, ebx, ecx, edx;
+    unsigned eax = leaf, ebx, ecx = 0, edx;
 
-    eax = 1;
 #ifdef __i386__
     __asm__ __volatile__ (
         "xchg %%ebx, %1\n\t"
         "cpuid\n\t"
         "xchg %1, %%ebx\n\t"
-    : "+a" (eax), "=S" (ebx), "=c" (ecx), "=d" (edx)
+    : "+a" (eax), "=S" (ebx), "+c" (ecx), "=d" (edx)
     );
 #else
     __asm__ __volatile__ (
         "cpuid\n\t"
-    : "+a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx)
+    : "+a" (eax), "=b" (ebx), "+c" (ecx), "=d" (edx)
     );
 #endif  /* (__i386__) */
 
-    x86_cpu_has_sse2 = edx & 0x4000000;
-    x86_cpu_has_sse42 = ecx & 0x100000;
-    x86_cpu_has_pclmulqdq = ecx & 0x2;
+    regs[0] = eax;
+    regs[1] = ebx;
+    regs[2] = ecx;
+    regs[3] = edx;
+}
+
+/* Returns the mask of register states the OS saves, from XCR0. */
+static unsigned _x86_xgetbv(void)
+{
+    unsigned eax, edx;
+
+    __asm__ __volatile__ (
+        ".byte 0x0f, 0x01, 0xd0\n\t"  /* xgetbv */
+    : "=a" (eax), "=d" (edx)
+    : "c" (0)
+    );
+    return eax;
+}
+
+static void _x86_check_features(void)
+{
+    int x86_cpu_has_sse2;
+    int x86_cpu_has_ssse3;
+    int x86_cpu_has_sse42;
+    int x86_cpu_has_pclmulqdq;
+    int x86_os_saves_ymm;
+    unsigned regs[4];
+
+    _x86_cpuid(1, regs);
+
+    x86_cpu_has_sse2 = regs[3] & 0x4000000;
+    x86_cpu_has_ssse3 = regs[2] & 0x200;
+    x86_cpu_has_sse42 = regs[2] & 0x100000;
+    x86_cpu_has_pclmulqdq = regs[2] & 0x2;
+
+    /* AVX state must be enabled by the OS (OSXSAVE and XCR0 bits 1-2). */
+    x86_os_saves_ymm = (regs[2] & 0x18000000) == 0x18000000 &&
+                       (_x86_xgetbv() & 0x6) == 0x6;
 
     x86_cpu_enable_simd = x86_cpu_has_sse2 &&
                           x86_cpu_has_sse42 &&
                           x86_cpu_has_pclmulqdq;
+
+    x86_cpu_enable_ssse3 = x86_cpu_has_sse2 && x86_cpu_has_ssse3;
+
+    _x86_cpuid(0, regs);
+    if (regs[0] >= 7 && x86_os_saves_ymm) {
+        _x86_cpuid(7, regs);
+        x86_cpu_enable_avx2 = x86_cpu_enable_ssse3 && (regs[1] & 0x20);
+    }
 }
 #else
 #include <intrin.h>
@@ -95,18 +138,33 @@ static int fake_pthread_once(volatile int32_t *once_control,
 static void _x86_check_features(void)
 {
     int x86_cpu_has_sse2;
+    int x86_cpu_has_ssse3;
     int x86_cpu_has_sse42;
     int x86_cpu_has_pclmulqdq;
+    int x86_os_saves_ymm;
     int regs[4];
 
     __cpuid(regs, 1);
 
     x86_cpu_has_sse2 = regs[3] & 0x4000000;
+    x86_cpu_has_ssse3 = regs[2] & 0x200;
     x86_cpu_has_sse42= regs[2] & 0x100000;
     x86_cpu_has_pclmulqdq = regs[2] & 0x2;
 
+    /* AVX state must be enabled by the OS (OSXSAVE and XCR0 bits 1-2). */
+    x86_os_saves_ymm = (regs[2] & 0x18000000) == 0x18000000 &&
+                       (_xgetbv(0) & 0x6) == 0x6;
+
     x86_cpu_enable_simd = x86_cpu_has_sse2 &&
                           x86_cpu_has_sse42 &&
                           x86_cpu_has_pclmulqdq;
+
+    x86_cpu_enable_ssse3 = x86_cpu_has_sse2 && x86_cpu_has_ssse3;
+
+    __cpuid(regs, 0);
+    if (regs[0] >= 7 && x86_os_saves_ymm) {
+        __cpuidex(regs, 7, 0);
+        x86_cpu_enable_avx2 = x86_cpu_enable_ssse3 && (regs[1] & 0x20);
+    }
 }
 #endif  /* _MSC_VER */
@@ -6,7 +6,17 @@
 #ifndef X86_H
 #define X86_H
 
+/* SSE2, SSE4.2 and PCLMULQDQ: CRC folding, CRC hashing and crc32(). */
 extern int x86_cpu_enable_simd;
+/* SSSE3 and AVX2 adler32(). */
+extern int x86_cpu_enable_ssse3;
+extern int x86_cpu_enable_avx2;
+
+/* NEON adler32() and ARMv8 CRC32 instruction crc32(). These are set by
+ * the x86_check_features() of simd_stub.c and are always 0 on x86.
+ */
+extern int arm_cpu_enable_neon;
+extern int arm_cpu_enable_crc32;
 
 void x86_check_features(void);
 
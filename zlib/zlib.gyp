@@ -14,6 +14,8 @@
              'OTHER_CFLAGS' : ['-msse4.2', '-mpclmul'],
           },
           'sources' : [
+            'adler32_simd.c',
+            'crc32_simd.c',
             'crc_folding.c',
             'fill_window_sse.c',
           ],
@@ -27,7 +29,15 @@
             }],
           ],
         }, {
-          'sources' : [ 'simd_stub.c' ],
+          'sources' : [
+            'adler32_simd.c',
+            'crc32_simd.c',
+            'simd_stub.c',
+          ],
+        }],
+        ['target_arch=="arm64"', {
+          # The CRC32 instructions are only used after a runtime check.
+          'cflags' : ['-march=armv8-a+crc'],
         }],
         ['OS=="android"', {
           'toolsets': ['target', 'host'],
@@ -39,9 +49,11 @@
       'type': 'static_library',
       'sources': [
         'adler32.c',
+        'adler32_simd.h',
         'compress.c',
         'crc32.c',
         'crc32.h',
+        'crc32_simd.h',
         'deflate.c',
         'deflate.h',
         'gzclose.c',
@@ -52,6 +64,8 @@
         'infback.c',
         'inffast.c',
         'inffast.h',
+        'inffast_chunk.c',
+        'inffast_chunk.h',
         'inffixed.h',
         'inflate.c',
         'inflate.h',
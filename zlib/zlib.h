@@ -1237,6 +1237,26 @@ ZEXTERN int ZEXPORT gzsetparams OF((gzFile file, int level, int strategy));
    opened for writing.
 */
 
+ZEXTERN int ZEXPORT gzsetparallel OF((gzFile file, int threads,
+                                      unsigned block));
+/*
+     Compress the data written to file on threads worker threads, in
+   independent blocks of block input bytes.  Each block is compressed with the
+   last 32K of the previous block as its dictionary, so the compression ratio
+   is close to that of a single deflate stream, and the blocks are joined into
+   one standard gzip member.  If block is 0, a block size of 128K is used.
+   Blocks end with a sync flush, which adds about five bytes per block.
+
+     This function must be called after gzopen() or gzdopen() for writing, and
+   before any other calls that write the file.  threads <= 1 turns parallel
+   compression off.  Memory use is about 2 * threads * (block + 32K) bytes for
+   the blocks in flight, plus one deflate state per thread.
+
+     gzsetparallel() returns 0 on success, or -1 on failure, such as being
+   called too late, on a file opened for reading, with a block size smaller
+   than 32K, or in a build without thread support.
+*/
+
 ZEXTERN int ZEXPORT gzread OF((gzFile file, voidp buf, unsigned len));
 /*
      Reads the given number of uncompressed bytes from the compressed file.  If
@@ -1363,6 +1383,38 @@ ZEXTERN int ZEXPORT    gzrewind OF((gzFile file));
      gzrewind(file) is equivalent to (int)gzseek(file, 0L, SEEK_SET)
 */
 
+ZEXTERN int ZEXPORT gzbuildindex OF((gzFile file, unsigned long span));
+/*
+     Reads the whole file once to build an index of access points for
+   gzseek(), then rewinds it.  An access point is saved at the first deflate
+   block boundary after every span bytes of uncompressed data, or every 1 MB
+   if span is zero.  Each point holds the 32K of uncompressed data before it,
+   which is the inflate state needed to restart there.  With an index, gzseek()
+   starts decompressing at the closest access point before the new position
+   instead of at the beginning of the file, so it reads at most about span
+   bytes past the point.  The check values in the gzip trailers are still
+   verified after such a seek.
+
+     The index takes about 32K of memory per access point, and is kept until
+   the file is closed or another index is built or loaded.  The file must be
+   opened for reading, and its underlying file descriptor must be seekable.
+   gzbuildindex returns 0 on success, or -1 on error, which may be an error in
+   the compressed data (see gzerror).
+*/
+
+ZEXTERN int ZEXPORT gzsaveindex OF((gzFile file, const char *path));
+ZEXTERN int ZEXPORT gzloadindex OF((gzFile file, const char *path));
+/*
+     gzsaveindex writes the index of file built by gzbuildindex() to path, and
+   gzloadindex reads an index saved this way into file, replacing any index it
+   had.  This saves reading the whole file again to build the index the next
+   time the file is opened.  The index file is portable across systems, but
+   nothing is checked to match it to the gzip file, which must be the same one
+   it was built for.  Both return 0 on success, or -1 if file is not open for
+   reading, if gzsaveindex is called without an index, or on an i/o error or
+   an invalid index file.
+*/
+
 /*
 ZEXTERN z_off_t ZEXPORT    gztell OF((gzFile file));
 